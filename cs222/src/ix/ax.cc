@@ -0,0 +1,632 @@
+#include "ax.h"
+#include "../util/returncodes.h"
+
+#include <assert.h>
+#include <cstring>
+#include <algorithm>
+
+static void deleteNode(AX_Node* node)
+{
+	switch (node->type)
+	{
+		case AX_LEAF:		delete (AX_Leaf*)node;		break;
+		case AX_NODE4:		delete (AX_Node4*)node;		break;
+		case AX_NODE16:		delete (AX_Node16*)node;	break;
+		case AX_NODE48:		delete (AX_Node48*)node;	break;
+		default:			delete (AX_Node256*)node;	break;
+	}
+}
+
+// The slot holding the child reached by byte, NULL if there is none
+static AX_Node** findChild(AX_InnerNode* node, unsigned char byte)
+{
+	switch (node->type)
+	{
+		case AX_NODE4:
+		{
+			AX_Node4* node4 = (AX_Node4*)node;
+			for (unsigned i = 0; i < node->numChildren; ++i)
+			{
+				if (node4->keys[i] == byte)
+					return &node4->children[i];
+			}
+			return NULL;
+		}
+
+		case AX_NODE16:
+		{
+			AX_Node16* node16 = (AX_Node16*)node;
+			unsigned char* key = std::lower_bound(node16->keys, node16->keys + node->numChildren, byte);
+			if (key == node16->keys + node->numChildren || *key != byte)
+				return NULL;
+			return &node16->children[key - node16->keys];
+		}
+
+		case AX_NODE48:
+		{
+			AX_Node48* node48 = (AX_Node48*)node;
+			return node48->childIndex[byte] ? &node48->children[node48->childIndex[byte] - 1] : NULL;
+		}
+
+		default:
+		{
+			AX_Node256* node256 = (AX_Node256*)node;
+			return node256->children[byte] ? &node256->children[byte] : NULL;
+		}
+	}
+}
+
+// The child with the smallest byte above after, pass -1 for the first child
+static AX_Node* findChildAfter(const AX_InnerNode* node, int after)
+{
+	switch (node->type)
+	{
+		case AX_NODE4:
+		case AX_NODE16:
+		{
+			const unsigned char* keys = node->type == AX_NODE4 ? ((const AX_Node4*)node)->keys : ((const AX_Node16*)node)->keys;
+			AX_Node* const* children = node->type == AX_NODE4 ? ((const AX_Node4*)node)->children : ((const AX_Node16*)node)->children;
+			for (unsigned i = 0; i < node->numChildren; ++i)
+			{
+				if (keys[i] > after)
+					return children[i];
+			}
+			return NULL;
+		}
+
+		case AX_NODE48:
+		{
+			const AX_Node48* node48 = (const AX_Node48*)node;
+			for (int byte = after + 1; byte < 256; ++byte)
+			{
+				if (node48->childIndex[byte])
+					return node48->children[node48->childIndex[byte] - 1];
+			}
+			return NULL;
+		}
+
+		default:
+		{
+			const AX_Node256* node256 = (const AX_Node256*)node;
+			for (int byte = after + 1; byte < 256; ++byte)
+			{
+				if (node256->children[byte])
+					return node256->children[byte];
+			}
+			return NULL;
+		}
+	}
+}
+
+static const AX_Leaf* findMinimum(const AX_Node* node)
+{
+	while (node->type != AX_LEAF)
+	{
+		node = findChildAfter((const AX_InnerNode*)node, -1);
+	}
+
+	return (const AX_Leaf*)node;
+}
+
+// Put a child in a sorted Node4 or Node16 with room for it
+template <class Node>
+static void insertSorted(Node* node, unsigned char byte, AX_Node* child)
+{
+	unsigned position = std::lower_bound(node->keys, node->keys + node->numChildren, byte) - node->keys;
+	memmove(node->keys + position + 1, node->keys + position, node->numChildren - position);
+	memmove(node->children + position + 1, node->children + position, (node->numChildren - position) * sizeof(AX_Node*));
+	node->keys[position] = byte;
+	node->children[position] = child;
+	++node->numChildren;
+}
+
+// Move every child of from into the empty node to, in byte order
+static void copyChildren(AX_InnerNode* from, AX_InnerNode* to);
+
+static void addChild(AX_Node*& node, unsigned char byte, AX_Node* child)
+{
+	AX_InnerNode* inner = (AX_InnerNode*)node;
+	switch (node->type)
+	{
+		case AX_NODE4:
+		{
+			if (inner->numChildren < 4)
+				return insertSorted((AX_Node4*)node, byte, child);
+
+			AX_Node16* grown = new AX_Node16();
+			copyChildren(inner, grown);
+			delete (AX_Node4*)node;
+			node = grown;
+			return insertSorted(grown, byte, child);
+		}
+
+		case AX_NODE16:
+		{
+			if (inner->numChildren < 16)
+				return insertSorted((AX_Node16*)node, byte, child);
+
+			AX_Node48* grown = new AX_Node48();
+			copyChildren(inner, grown);
+			delete (AX_Node16*)node;
+			node = grown;
+			return addChild(node, byte, child);
+		}
+
+		case AX_NODE48:
+		{
+			AX_Node48* node48 = (AX_Node48*)node;
+			if (inner->numChildren < 48)
+			{
+				// Deletes leave holes, take the first free slot
+				unsigned slot = 0;
+				while (node48->children[slot])
+					++slot;
+
+				node48->children[slot] = child;
+				node48->childIndex[byte] = slot + 1;
+				++inner->numChildren;
+				return;
+			}
+
+			AX_Node256* grown = new AX_Node256();
+			copyChildren(inner, grown);
+			delete node48;
+			node = grown;
+			return addChild(node, byte, child);
+		}
+
+		default:
+		{
+			((AX_Node256*)node)->children[byte] = child;
+			++inner->numChildren;
+			return;
+		}
+	}
+}
+
+static void copyChildren(AX_InnerNode* from, AX_InnerNode* to)
+{
+	to->prefix.swap(from->prefix);
+	AX_Node* placeholder = to;
+	for (int byte = 0; byte < 256; ++byte)
+	{
+		AX_Node** child = findChild(from, (unsigned char)byte);
+		if (child)
+			addChild(placeholder, (unsigned char)byte, *child);
+	}
+
+	assert(placeholder == to);
+}
+
+// Take the child reached by byte out of the node, shrinking the node once it is sparse enough
+static void removeChild(AX_Node*& node, unsigned char byte)
+{
+	AX_InnerNode* inner = (AX_InnerNode*)node;
+	switch (node->type)
+	{
+		case AX_NODE4:
+		case AX_NODE16:
+		{
+			unsigned char* keys = node->type == AX_NODE4 ? ((AX_Node4*)node)->keys : ((AX_Node16*)node)->keys;
+			AX_Node** children = node->type == AX_NODE4 ? ((AX_Node4*)node)->children : ((AX_Node16*)node)->children;
+			const unsigned position = std::find(keys, keys + inner->numChildren, byte) - keys;
+			memmove(keys + position, keys + position + 1, inner->numChildren - position - 1);
+			memmove(children + position, children + position + 1, (inner->numChildren - position - 1) * sizeof(AX_Node*));
+			--inner->numChildren;
+			break;
+		}
+
+		case AX_NODE48:
+		{
+			AX_Node48* node48 = (AX_Node48*)node;
+			node48->children[node48->childIndex[byte] - 1] = NULL;
+			node48->childIndex[byte] = 0;
+			--inner->numChildren;
+			break;
+		}
+
+		default:
+			((AX_Node256*)node)->children[byte] = NULL;
+			--inner->numChildren;
+			break;
+	}
+
+	// Shrink a little below the next size down, so entries coming and going at the edge do not copy back and forth
+	AX_InnerNode* shrunk = NULL;
+	if (node->type == AX_NODE256 && inner->numChildren <= 40)
+		shrunk = new AX_Node48();
+	else if (node->type == AX_NODE48 && inner->numChildren <= 12)
+		shrunk = new AX_Node16();
+	else if (node->type == AX_NODE16 && inner->numChildren <= 3)
+		shrunk = new AX_Node4();
+
+	if (shrunk)
+	{
+		copyChildren(inner, shrunk);
+		deleteNode(node);
+		node = shrunk;
+		return;
+	}
+
+	// A node left with one child folds into it, the child's path gains our prefix and the byte between us
+	if (node->type == AX_NODE4 && inner->numChildren == 1)
+	{
+		AX_Node4* node4 = (AX_Node4*)node;
+		AX_Node* child = node4->children[0];
+		if (child->type != AX_LEAF)
+		{
+			AX_InnerNode* childInner = (AX_InnerNode*)child;
+			std::vector<unsigned char> prefix;
+			prefix.swap(node4->prefix);
+			prefix.push_back(node4->keys[0]);
+			prefix.insert(prefix.end(), childInner->prefix.begin(), childInner->prefix.end());
+			childInner->prefix.swap(prefix);
+		}
+
+		delete node4;
+		node = child;
+	}
+}
+
+static RC insertLeaf(AX_Node*& node, AX_Leaf* leaf, unsigned depth)
+{
+	const std::vector<unsigned char>& entry = leaf->entry;
+	if (!node)
+	{
+		node = leaf;
+		return rc::OK;
+	}
+
+	if (node->type == AX_LEAF)
+	{
+		// Both entries go under a new node whose prefix is what they share past depth
+		AX_Leaf* existing = (AX_Leaf*)node;
+		if (existing->entry == entry)
+			return rc::ART_INDEX_DUPLICATE_ENTRY;
+
+		unsigned mismatch = depth;
+		while (existing->entry[mismatch] == entry[mismatch])
+			++mismatch;
+
+		AX_Node4* split = new AX_Node4();
+		split->prefix.assign(entry.begin() + depth, entry.begin() + mismatch);
+		insertSorted(split, existing->entry[mismatch], existing);
+		insertSorted(split, entry[mismatch], leaf);
+		node = split;
+		return rc::OK;
+	}
+
+	// An entry leaving the compressed path part way splits the path there
+	AX_InnerNode* inner = (AX_InnerNode*)node;
+	unsigned matched = 0;
+	while (matched < inner->prefix.size() && inner->prefix[matched] == entry[depth + matched])
+		++matched;
+
+	if (matched < inner->prefix.size())
+	{
+		AX_Node4* split = new AX_Node4();
+		split->prefix.assign(inner->prefix.begin(), inner->prefix.begin() + matched);
+		const unsigned char byte = inner->prefix[matched];
+		inner->prefix.erase(inner->prefix.begin(), inner->prefix.begin() + matched + 1);
+		insertSorted(split, byte, inner);
+		insertSorted(split, entry[depth + matched], leaf);
+		node = split;
+		return rc::OK;
+	}
+
+	depth += inner->prefix.size();
+	AX_Node** child = findChild(inner, entry[depth]);
+	if (child)
+		return insertLeaf(*child, leaf, depth + 1);
+
+	addChild(node, entry[depth], leaf);
+	return rc::OK;
+}
+
+static bool eraseLeaf(AX_Node*& node, const std::vector<unsigned char>& entry, unsigned depth)
+{
+	if (!node)
+		return false;
+
+	if (node->type == AX_LEAF)
+	{
+		if (((AX_Leaf*)node)->entry != entry)
+			return false;
+
+		deleteNode(node);
+		node = NULL;
+		return true;
+	}
+
+	AX_InnerNode* inner = (AX_InnerNode*)node;
+	if (entry.size() <= depth + inner->prefix.size() || !std::equal(inner->prefix.begin(), inner->prefix.end(), entry.begin() + depth))
+		return false;
+
+	depth += inner->prefix.size();
+	AX_Node** child = findChild(inner, entry[depth]);
+	if (!child)
+		return false;
+
+	if ((*child)->type != AX_LEAF)
+		return eraseLeaf(*child, entry, depth + 1);
+
+	if (((AX_Leaf*)*child)->entry != entry)
+		return false;
+
+	deleteNode(*child);
+	removeChild(node, entry[depth]);
+	return true;
+}
+
+static const AX_Leaf* seekLeaf(const AX_Node* node, const std::vector<unsigned char>& bound, unsigned depth, bool inclusive)
+{
+	if (!node)
+		return NULL;
+
+	if (node->type == AX_LEAF)
+	{
+		const AX_Leaf* leaf = (const AX_Leaf*)node;
+		return (leaf->entry > bound || (inclusive && leaf->entry == bound)) ? leaf : NULL;
+	}
+
+	// Once the path differs from the bound the whole subtree is either before or after it
+	const AX_InnerNode* inner = (const AX_InnerNode*)node;
+	for (unsigned i = 0; i < inner->prefix.size(); ++i)
+	{
+		if (depth + i >= bound.size() || inner->prefix[i] > bound[depth + i])
+			return findMinimum(node);
+
+		if (inner->prefix[i] < bound[depth + i])
+			return NULL;
+	}
+
+	depth += inner->prefix.size();
+	if (depth >= bound.size())
+		return findMinimum(node);
+
+	AX_Node** child = findChild(const_cast<AX_InnerNode*>(inner), bound[depth]);
+	if (child)
+	{
+		const AX_Leaf* leaf = seekLeaf(*child, bound, depth + 1, inclusive);
+		if (leaf)
+			return leaf;
+	}
+
+	const AX_Node* next = findChildAfter(inner, bound[depth]);
+	return next ? findMinimum(next) : NULL;
+}
+
+static void destroyTree(AX_Node* node)
+{
+	if (!node)
+		return;
+
+	if (node->type != AX_LEAF)
+	{
+		for (int byte = 0; byte < 256; ++byte)
+		{
+			AX_Node** child = findChild((AX_InnerNode*)node, (unsigned char)byte);
+			if (child)
+				destroyTree(*child);
+		}
+	}
+
+	deleteNode(node);
+}
+
+static void countNodes(const AX_Node* node, unsigned counts[AX_NODE_TYPES])
+{
+	if (!node)
+		return;
+
+	++counts[node->type];
+	if (node->type == AX_LEAF)
+		return;
+
+	for (int byte = 0; byte < 256; ++byte)
+	{
+		AX_Node** child = findChild((AX_InnerNode*)node, (unsigned char)byte);
+		if (child)
+			countNodes(*child, counts);
+	}
+}
+
+ArtIndex::ArtIndex(const Attribute& attribute)
+	: _attribute(attribute), _keyAttributes(1, attribute), _root(NULL), _numEntries(0)
+{
+}
+
+ArtIndex::~ArtIndex()
+{
+	destroyTree(_root);
+}
+
+RC ArtIndex::encodeKey(const void* key, std::vector<unsigned char>& encoded) const
+{
+	unsigned char buffer[sizeof(unsigned) + MAX_KEY_SIZE];
+	RC ret = IndexManager::encodeCompositeKey(_keyAttributes, key, 1, buffer);
+	RETURN_ON_ERR(ret);
+
+	unsigned length = 0;
+	memcpy(&length, buffer, sizeof(unsigned));
+	encoded.assign(buffer + sizeof(unsigned), buffer + sizeof(unsigned) + length);
+	return rc::OK;
+}
+
+static void appendBigEndian(std::vector<unsigned char>& entry, unsigned value)
+{
+	entry.push_back(value >> 24);
+	entry.push_back(value >> 16);
+	entry.push_back(value >> 8);
+	entry.push_back(value);
+}
+
+static unsigned readBigEndian(const unsigned char* in)
+{
+	return ((unsigned)in[0] << 24) | ((unsigned)in[1] << 16) | ((unsigned)in[2] << 8) | (unsigned)in[3];
+}
+
+RC ArtIndex::decodeEntry(const std::vector<unsigned char>& entry, RID& rid, void* key) const
+{
+	const unsigned length = entry.size() - 2 * sizeof(unsigned);
+	rid.pageNum = readBigEndian(&entry[length]);
+	rid.slotNum = readBigEndian(&entry[length + sizeof(unsigned)]);
+
+	unsigned char buffer[sizeof(unsigned) + MAX_KEY_SIZE];
+	memcpy(buffer, &length, sizeof(unsigned));
+	memcpy(buffer + sizeof(unsigned), &entry[0], length);
+	return IndexManager::decodeCompositeKey(_keyAttributes, buffer, key);
+}
+
+RC ArtIndex::insertEntry(const void *key, const RID &rid)
+{
+	AX_Leaf* leaf = new AX_Leaf();
+	RC ret = encodeKey(key, leaf->entry);
+	if (ret != rc::OK)
+	{
+		delete leaf;
+		return ret;
+	}
+
+	appendBigEndian(leaf->entry, rid.pageNum);
+	appendBigEndian(leaf->entry, rid.slotNum);
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	ret = insertLeaf(_root, leaf, 0);
+	if (ret != rc::OK)
+	{
+		delete leaf;
+		return ret;
+	}
+
+	++_numEntries;
+	return rc::OK;
+}
+
+RC ArtIndex::deleteEntry(const void *key, const RID &rid)
+{
+	std::vector<unsigned char> entry;
+	RC ret = encodeKey(key, entry);
+	RETURN_ON_ERR(ret);
+
+	appendBigEndian(entry, rid.pageNum);
+	appendBigEndian(entry, rid.slotNum);
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (!eraseLeaf(_root, entry, 0))
+		return rc::ART_INDEX_ENTRY_NOT_FOUND;
+
+	--_numEntries;
+	return rc::OK;
+}
+
+void ArtIndex::clear()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	destroyTree(_root);
+	_root = NULL;
+	_numEntries = 0;
+}
+
+unsigned ArtIndex::getNumEntries() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _numEntries;
+}
+
+void ArtIndex::getNodeCounts(unsigned counts[AX_NODE_TYPES]) const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	memset(counts, 0, AX_NODE_TYPES * sizeof(unsigned));
+	countNodes(_root, counts);
+}
+
+bool ArtIndex::seek(const std::vector<unsigned char>& bound, bool inclusive, std::vector<unsigned char>& entry) const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	const AX_Leaf* leaf = seekLeaf(_root, bound, 0, inclusive);
+	if (!leaf)
+		return false;
+
+	entry = leaf->entry;
+	return true;
+}
+
+RC ArtIndex::scan(const void *lowKey, const void *highKey, bool lowKeyInclusive, bool highKeyInclusive, AX_ScanIterator &ax_ScanIterator)
+{
+	return ax_ScanIterator.init(this, lowKey, highKey, lowKeyInclusive, highKeyInclusive);
+}
+
+AX_ScanIterator::AX_ScanIterator()
+	: _index(NULL), _inclusive(false), _hasHighKey(false), _highKeyInclusive(false)
+{
+}
+
+AX_ScanIterator::~AX_ScanIterator()
+{
+	close();
+}
+
+RC AX_ScanIterator::init(ArtIndex* index, const void *lowKey, const void *highKey, bool lowKeyInclusive, bool highKeyInclusive)
+{
+	close();
+
+	RC ret = rc::OK;
+	_position.clear();
+	_inclusive = true;
+	if (lowKey)
+	{
+		// Entries of lowKey itself are the encoded key followed by a RID, all of them sort below the highest RID
+		ret = index->encodeKey(lowKey, _position);
+		RETURN_ON_ERR(ret);
+
+		if (!lowKeyInclusive)
+		{
+			_position.insert(_position.end(), 2 * sizeof(unsigned), 0xff);
+			_inclusive = false;
+		}
+	}
+
+	_hasHighKey = highKey != NULL;
+	_highKeyInclusive = highKeyInclusive;
+	if (highKey)
+	{
+		ret = _highKey.init(index->getAttribute().type, highKey);
+		RETURN_ON_ERR(ret);
+	}
+
+	_index = index;
+	return rc::OK;
+}
+
+RC AX_ScanIterator::getNextEntry(RID &rid, void *key)
+{
+	if (!_index || !_index->seek(_position, _inclusive, _position))
+	{
+		_index = NULL;
+		return IX_EOF;
+	}
+
+	_inclusive = false;
+	RC ret = _index->decodeEntry(_position, rid, key);
+	RETURN_ON_ERR(ret);
+
+	if (_hasHighKey)
+	{
+		const int result = IndexManager::compareKeys(_index->getAttribute().type, key, _highKey.data());
+		if (result > 0 || (result == 0 && !_highKeyInclusive))
+		{
+			_index = NULL;
+			return IX_EOF;
+		}
+	}
+
+	return rc::OK;
+}
+
+RC AX_ScanIterator::close()
+{
+	_index = NULL;
+	_position.clear();
+	return rc::OK;
+}
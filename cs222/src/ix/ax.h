@@ -0,0 +1,146 @@
+#ifndef _ax_h_
+#define _ax_h_
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <cstring>
+
+#include "ix.h"
+
+// Adaptive radix tree index
+/*
+An in-memory index with nothing on disk, the RelationManager fills it from the table when the index is
+created or the catalog is loaded. Keys are turned into byte strings which memcmp() orders the same as
+IndexManager::compareKeys() orders the keys, the same encoding composite B+tree keys use, followed by the
+RID written big-endian so duplicate keys become distinct entries. No entry is a prefix of another.
+Each inner node branches on one byte and grows from 4 to 16, 48 and 256 children as it fills, shrinking
+back as entries go. A node with one child is folded into the prefix of the node below it, so a chain of
+bytes every key below shares is stored once. Leaves keep the whole entry.
+*/
+enum AX_NodeType
+{
+	AX_LEAF = 0,
+	AX_NODE4,
+	AX_NODE16,
+	AX_NODE48,
+	AX_NODE256,
+	AX_NODE_TYPES
+};
+
+struct AX_Node
+{
+	AX_Node(AX_NodeType type) : type(type) {}
+
+	unsigned char type;
+};
+
+struct AX_Leaf : public AX_Node
+{
+	AX_Leaf() : AX_Node(AX_LEAF) {}
+
+	std::vector<unsigned char> entry;
+};
+
+struct AX_InnerNode : public AX_Node
+{
+	AX_InnerNode(AX_NodeType type) : AX_Node(type), numChildren(0) {}
+
+	unsigned short numChildren;
+	std::vector<unsigned char> prefix; // bytes every entry below shares after the byte that led here
+};
+
+// Node4 and Node16 keep their bytes sorted
+struct AX_Node4 : public AX_InnerNode
+{
+	AX_Node4() : AX_InnerNode(AX_NODE4) {}
+
+	unsigned char keys[4];
+	AX_Node* children[4];
+};
+
+struct AX_Node16 : public AX_InnerNode
+{
+	AX_Node16() : AX_InnerNode(AX_NODE16) {}
+
+	unsigned char keys[16];
+	AX_Node* children[16];
+};
+
+// childIndex holds one more than the child's slot, 0 for no child
+struct AX_Node48 : public AX_InnerNode
+{
+	AX_Node48() : AX_InnerNode(AX_NODE48) { memset(childIndex, 0, sizeof(childIndex)); memset(children, 0, sizeof(children)); }
+
+	unsigned char childIndex[256];
+	AX_Node* children[48];
+};
+
+struct AX_Node256 : public AX_InnerNode
+{
+	AX_Node256() : AX_InnerNode(AX_NODE256) { memset(children, 0, sizeof(children)); }
+
+	AX_Node* children[256];
+};
+
+class AX_ScanIterator;
+class ArtIndex
+{
+public:
+	ArtIndex(const Attribute& attribute);
+	~ArtIndex();
+
+	// Keys use the same format as IndexManager::insertEntry()
+	RC insertEntry(const void *key, const RID &rid);
+	RC deleteEntry(const void *key, const RID &rid);
+	void clear();
+
+	// Same as IndexManager::scan()
+	RC scan(const void *lowKey, const void *highKey, bool lowKeyInclusive, bool highKeyInclusive, AX_ScanIterator &ax_ScanIterator);
+
+	const Attribute& getAttribute() const { return _attribute; }
+	unsigned getNumEntries() const;
+	void getNodeCounts(unsigned counts[AX_NODE_TYPES]) const;
+
+private:
+	// Not copyable, the tree would be freed twice
+	ArtIndex(const ArtIndex& that);
+	ArtIndex& operator=(const ArtIndex& that);
+
+	RC encodeKey(const void* key, std::vector<unsigned char>& encoded) const;
+	RC decodeEntry(const std::vector<unsigned char>& entry, RID& rid, void* key) const;
+
+	// The first entry after bound, or at it if inclusive
+	bool seek(const std::vector<unsigned char>& bound, bool inclusive, std::vector<unsigned char>& entry) const;
+
+	Attribute _attribute;
+	std::vector<Attribute> _keyAttributes; // just _attribute, the way IndexManager::encodeCompositeKey() takes it
+	AX_Node* _root;
+	unsigned _numEntries;
+	mutable std::mutex _mutex;
+
+	friend class AX_ScanIterator;
+};
+
+class AX_ScanIterator {
+public:
+  AX_ScanIterator();  							// Constructor
+  ~AX_ScanIterator(); 							// Destructor
+
+  RC getNextEntry(RID &rid, void *key);  		// Get next matching entry
+  RC close();             						// Terminate index scan
+  RC init(ArtIndex* index, const void *lowKey, const void *highKey, bool lowKeyInclusive, bool highKeyInclusive);
+
+private:
+	// Each step looks up the entry after the last one returned rather than holding on to a node, so
+	// entries inserted or deleted while we scan never leave us pointing at a freed one
+	ArtIndex* _index;
+	std::vector<unsigned char> _position;
+	bool _inclusive;
+
+	KeyValueData _highKey;
+	bool _hasHighKey;
+	bool _highKeyInclusive;
+};
+
+#endif
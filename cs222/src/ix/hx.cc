@@ -0,0 +1,682 @@
+#include "hx.h"
+#include "../rbf/pfm.h"
+#include "../util/returncodes.h"
+#include "../util/dbgout.h"
+#include "../util/hash.h"
+
+#include <assert.h>
+#include <cstring>
+#include <algorithm>
+#include <map>
+
+HashIndexManager* HashIndexManager::_hash_index_manager = 0;
+
+HashIndexManager* HashIndexManager::instance()
+{
+    if(!_hash_index_manager)
+        _hash_index_manager = new HashIndexManager();
+
+    return _hash_index_manager;
+}
+
+HashIndexManager::HashIndexManager()
+	: RecordBasedCoreManager(sizeof(HX_BucketFooter))
+{
+}
+
+HashIndexManager::~HashIndexManager()
+{
+    // We don't want our static pointer to be pointing to deleted data in case the object is ever deleted!
+    _hash_index_manager = NULL;
+}
+
+RC HashIndexManager::readAttribute(FileHandle &/*fileHandle*/, const vector<Attribute> &/*recordDescriptor*/, const RID &/*rid*/, const string /*attributeName*/, void * /*data*/)
+{
+	return rc::FEATURE_NOT_YET_IMPLEMENTED;
+}
+
+RC HashIndexManager::reorganizePage(FileHandle &/*fileHandle*/, const vector<Attribute> &/*recordDescriptor*/, const unsigned /*pageNumber*/)
+{
+	// Bucket pages are always packed, there is never anything to reclaim
+	return rc::OK;
+}
+
+HX_Header* HashIndexManager::getHeader(void* headerPage)
+{
+	return (HX_Header*)((char*)headerPage + PAGE_SIZE - sizeof(HX_Header));
+}
+
+HX_BucketFooter* HashIndexManager::getBucketFooter(void* pageBuffer)
+{
+	return (HX_BucketFooter*)((char*)pageBuffer + PAGE_SIZE - sizeof(HX_BucketFooter));
+}
+
+unsigned HashIndexManager::getBucketFreeSpace(void* pageBuffer)
+{
+	return PAGE_SIZE - sizeof(HX_BucketFooter) - getBucketFooter(pageBuffer)->freeSpaceOffset;
+}
+
+void HashIndexManager::initBucket(void* pageBuffer, unsigned localDepth)
+{
+	memset(pageBuffer, 0, PAGE_SIZE);
+	getBucketFooter(pageBuffer)->localDepth = localDepth;
+}
+
+unsigned HashIndexManager::hashKey(AttrType type, const void* key)
+{
+	switch (type)
+	{
+		case TypeInt:
+			return util::multiplicitive(*(const unsigned*)key);
+
+		case TypeReal:
+		{
+			// 0.0 and -0.0 are the same key, so they have to land in the same bucket
+			float value = 0;
+			unsigned bits = 0;
+			memcpy(&value, key, sizeof(float));
+			if (value != 0.0f)
+				memcpy(&bits, &value, sizeof(unsigned));
+
+			return util::multiplicitive(bits);
+		}
+
+		default:
+		{
+			// Chain the hash through every 4 characters, unlike util::datahash() the order of the chunks matters
+			unsigned length = 0;
+			memcpy(&length, key, sizeof(unsigned));
+			const char* characters = (const char*)key + sizeof(unsigned);
+
+			unsigned hash = util::multiplicitive(length);
+			for (unsigned i = 0; i < length; i += sizeof(unsigned))
+			{
+				unsigned chunk = 0;
+				memcpy(&chunk, characters + i, std::min<unsigned>(sizeof(unsigned), length - i));
+				hash = util::jenkins(hash ^ chunk);
+			}
+
+			return util::multiplicitive(hash);
+		}
+	}
+}
+
+static unsigned getEntryLength(AttrType type, const char* entry)
+{
+	return sizeof(RID) + Attribute::sizeInBytes(type, entry + sizeof(RID));
+}
+
+static void appendEntry(void* pageBuffer, const void* entry, unsigned entryLength)
+{
+	HX_BucketFooter* footer = HashIndexManager::getBucketFooter(pageBuffer);
+	memcpy((char*)pageBuffer + footer->freeSpaceOffset, entry, entryLength);
+	footer->freeSpaceOffset += entryLength;
+	++footer->numEntries;
+}
+
+RC HashIndexManager::createFile(const string &fileName)
+{
+	RC ret = PagedFileManager::instance()->createFile(fileName.c_str());
+	if (ret != rc::OK)
+	{
+		return ret;
+	}
+
+	// Opening the file writes the file header to the reserved page
+	FileHandle fileHandle;
+	ret = openFile(fileName, fileHandle);
+	RETURN_ON_ERR(ret);
+
+	unsigned char headerPage[PAGE_SIZE];
+	ret = fileHandle.readPage(0, headerPage);
+	RETURN_ON_ERR(ret);
+
+	// Start with a directory one entry deep, page 1, naming a single empty bucket, page 2
+	HX_Header* header = getHeader(headerPage);
+	memset(header, 0, sizeof(HX_Header));
+	header->numDirectoryPages = 1;
+	header->directoryPages[0] = 1;
+
+	PageNum directory[HX_DIRECTORY_PAGE_SLOTS] = {0};
+	directory[0] = 2;
+	ret = fileHandle.appendPage(directory);
+	RETURN_ON_ERR(ret);
+
+	unsigned char pageBuffer[PAGE_SIZE];
+	initBucket(pageBuffer, 0);
+	ret = fileHandle.appendPage(pageBuffer);
+	RETURN_ON_ERR(ret);
+
+	ret = fileHandle.writePage(0, headerPage);
+	RETURN_ON_ERR(ret);
+
+	// We're done, leave the file closed
+	return closeFile(fileHandle);
+}
+
+RC HashIndexManager::allocatePage(FileHandle& fileHandle, void* headerPage, PageNum& pageNum)
+{
+	// Reuse a freed page if there is one, the caller writes the reserved page back
+	HX_Header* header = getHeader(headerPage);
+	unsigned char pageBuffer[PAGE_SIZE];
+	if (header->freePageHead == 0)
+	{
+		pageNum = fileHandle.getNumberOfPages();
+		initBucket(pageBuffer, 0);
+		return fileHandle.appendPage(pageBuffer);
+	}
+
+	RC ret = fileHandle.readPage(header->freePageHead, pageBuffer);
+	RETURN_ON_ERR(ret);
+
+	pageNum = header->freePageHead;
+	header->freePageHead = getBucketFooter(pageBuffer)->overflowPage;
+	return rc::OK;
+}
+
+RC HashIndexManager::freePage(FileHandle& fileHandle, void* headerPage, PageNum pageNum)
+{
+	HX_Header* header = getHeader(headerPage);
+	unsigned char pageBuffer[PAGE_SIZE];
+	initBucket(pageBuffer, 0);
+	getBucketFooter(pageBuffer)->overflowPage = header->freePageHead;
+
+	RC ret = fileHandle.writePage(pageNum, pageBuffer);
+	RETURN_ON_ERR(ret);
+
+	header->freePageHead = pageNum;
+	return rc::OK;
+}
+
+RC HashIndexManager::findBucket(FileHandle& fileHandle, HX_Header* header, unsigned hash, PageNum& bucketPage)
+{
+	const unsigned index = hash & ((1u << header->globalDepth) - 1);
+
+	PageNum directory[HX_DIRECTORY_PAGE_SLOTS];
+	RC ret = fileHandle.readPage(header->directoryPages[index / HX_DIRECTORY_PAGE_SLOTS], directory);
+	RETURN_ON_ERR(ret);
+
+	bucketPage = directory[index % HX_DIRECTORY_PAGE_SLOTS];
+	return rc::OK;
+}
+
+RC HashIndexManager::readChain(FileHandle& fileHandle, PageNum bucketPage, AttrType type, std::vector<char>& entries, std::vector<unsigned>& hashes, unsigned& localDepth)
+{
+	unsigned char pageBuffer[PAGE_SIZE];
+	PageNum pageNum = bucketPage;
+	while (pageNum != 0)
+	{
+		RC ret = fileHandle.readPage(pageNum, pageBuffer);
+		RETURN_ON_ERR(ret);
+
+		HX_BucketFooter* footer = getBucketFooter(pageBuffer);
+		if (pageNum == bucketPage)
+			localDepth = footer->localDepth;
+
+		const char* page = (const char*)pageBuffer;
+		entries.insert(entries.end(), page, page + footer->freeSpaceOffset);
+		for (unsigned offset = 0; offset < footer->freeSpaceOffset; offset += getEntryLength(type, page + offset))
+		{
+			hashes.push_back(hashKey(type, page + offset + sizeof(RID)));
+		}
+
+		pageNum = footer->overflowPage;
+	}
+
+	return rc::OK;
+}
+
+RC HashIndexManager::appendToChain(FileHandle& fileHandle, void* headerPage, PageNum& pageNum, void* pageBuffer, const void* entry, unsigned entryLength)
+{
+	if (getBucketFreeSpace(pageBuffer) < entryLength)
+	{
+		// The page is full, link a fresh one after it and carry on there
+		PageNum nextPage = 0;
+		RC ret = allocatePage(fileHandle, headerPage, nextPage);
+		RETURN_ON_ERR(ret);
+
+		HX_BucketFooter* footer = getBucketFooter(pageBuffer);
+		const unsigned localDepth = footer->localDepth;
+		footer->overflowPage = nextPage;
+		ret = fileHandle.writePage(pageNum, pageBuffer);
+		RETURN_ON_ERR(ret);
+
+		initBucket(pageBuffer, localDepth);
+		pageNum = nextPage;
+	}
+
+	appendEntry(pageBuffer, entry, entryLength);
+	return rc::OK;
+}
+
+RC HashIndexManager::doubleDirectory(FileHandle& fileHandle, void* headerPage)
+{
+	HX_Header* header = getHeader(headerPage);
+	if (header->globalDepth >= HX_MAX_GLOBAL_DEPTH)
+		return rc::HASH_INDEX_DIRECTORY_FULL;
+
+	// The new half of the directory starts as a copy of the old half, every bucket is named twice as often
+	const unsigned oldSize = 1u << header->globalDepth;
+	PageNum directory[HX_DIRECTORY_PAGE_SLOTS];
+	if (oldSize < HX_DIRECTORY_PAGE_SLOTS)
+	{
+		RC ret = fileHandle.readPage(header->directoryPages[0], directory);
+		RETURN_ON_ERR(ret);
+
+		memcpy(directory + oldSize, directory, oldSize * sizeof(PageNum));
+		ret = fileHandle.writePage(header->directoryPages[0], directory);
+		RETURN_ON_ERR(ret);
+	}
+	else
+	{
+		const unsigned numPages = header->numDirectoryPages;
+		for (unsigned i = 0; i < numPages; ++i)
+		{
+			RC ret = fileHandle.readPage(header->directoryPages[i], directory);
+			RETURN_ON_ERR(ret);
+
+			PageNum newPage = 0;
+			ret = allocatePage(fileHandle, headerPage, newPage);
+			RETURN_ON_ERR(ret);
+
+			ret = fileHandle.writePage(newPage, directory);
+			RETURN_ON_ERR(ret);
+
+			header->directoryPages[numPages + i] = newPage;
+		}
+
+		header->numDirectoryPages = numPages * 2;
+	}
+
+	++header->globalDepth;
+	return rc::OK;
+}
+
+RC HashIndexManager::splitBucket(FileHandle& fileHandle, void* headerPage, PageNum bucketPage, unsigned hash, AttrType type)
+{
+	HX_Header* header = getHeader(headerPage);
+
+	std::vector<char> entries;
+	std::vector<unsigned> hashes;
+	unsigned localDepth = 0;
+	RC ret = readChain(fileHandle, bucketPage, type, entries, hashes, localDepth);
+	RETURN_ON_ERR(ret);
+
+	if (localDepth == header->globalDepth)
+	{
+		ret = doubleDirectory(fileHandle, headerPage);
+		RETURN_ON_ERR(ret);
+	}
+
+	// Give back the overflow pages, the entries are written out again as two fresh chains
+	unsigned char pageBuffer[PAGE_SIZE];
+	ret = fileHandle.readPage(bucketPage, pageBuffer);
+	RETURN_ON_ERR(ret);
+
+	PageNum overflowPage = getBucketFooter(pageBuffer)->overflowPage;
+	while (overflowPage != 0)
+	{
+		ret = fileHandle.readPage(overflowPage, pageBuffer);
+		RETURN_ON_ERR(ret);
+
+		const PageNum nextPage = getBucketFooter(pageBuffer)->overflowPage;
+		ret = freePage(fileHandle, headerPage, overflowPage);
+		RETURN_ON_ERR(ret);
+
+		overflowPage = nextPage;
+	}
+
+	PageNum splitPage = 0;
+	ret = allocatePage(fileHandle, headerPage, splitPage);
+	RETURN_ON_ERR(ret);
+
+	// Entries with bit localDepth of their hash set move to the new bucket
+	unsigned char splitBuffer[PAGE_SIZE];
+	initBucket(pageBuffer, localDepth + 1);
+	initBucket(splitBuffer, localDepth + 1);
+
+	PageNum lowPage = bucketPage;
+	PageNum highPage = splitPage;
+	unsigned offset = 0;
+	for (unsigned i = 0; i < hashes.size(); ++i)
+	{
+		const unsigned entryLength = getEntryLength(type, &entries[offset]);
+		if ((hashes[i] >> localDepth) & 1)
+			ret = appendToChain(fileHandle, headerPage, highPage, splitBuffer, &entries[offset], entryLength);
+		else
+			ret = appendToChain(fileHandle, headerPage, lowPage, pageBuffer, &entries[offset], entryLength);
+		RETURN_ON_ERR(ret);
+
+		offset += entryLength;
+	}
+
+	ret = fileHandle.writePage(lowPage, pageBuffer);
+	RETURN_ON_ERR(ret);
+
+	ret = fileHandle.writePage(highPage, splitBuffer);
+	RETURN_ON_ERR(ret);
+
+	// Point the directory entries which agree with the bucket on its low localDepth bits and have bit localDepth
+	// set at the new bucket, a directory page at a time
+	PageNum directory[HX_DIRECTORY_PAGE_SLOTS];
+	unsigned loadedPage = header->numDirectoryPages;
+	const unsigned directorySize = 1u << header->globalDepth;
+	const unsigned stride = 1u << (localDepth + 1);
+	for (unsigned index = (hash & (stride / 2 - 1)) | (stride / 2); index < directorySize; index += stride)
+	{
+		const unsigned directoryPage = index / HX_DIRECTORY_PAGE_SLOTS;
+		if (directoryPage != loadedPage)
+		{
+			if (loadedPage != header->numDirectoryPages)
+			{
+				ret = fileHandle.writePage(header->directoryPages[loadedPage], directory);
+				RETURN_ON_ERR(ret);
+			}
+
+			ret = fileHandle.readPage(header->directoryPages[directoryPage], directory);
+			RETURN_ON_ERR(ret);
+			loadedPage = directoryPage;
+		}
+
+		directory[index % HX_DIRECTORY_PAGE_SLOTS] = splitPage;
+	}
+
+	if (loadedPage != header->numDirectoryPages)
+	{
+		ret = fileHandle.writePage(header->directoryPages[loadedPage], directory);
+		RETURN_ON_ERR(ret);
+	}
+
+	return rc::OK;
+}
+
+RC HashIndexManager::insertEntry(FileHandle &fileHandle, const Attribute &attribute, const void *key, const RID &rid)
+{
+	const unsigned keySize = Attribute::sizeInBytes(attribute.type, key);
+	if (keySize == 0)
+		return rc::ATTRIBUTE_INVALID_TYPE;
+	if (keySize > MAX_KEY_SIZE)
+		return rc::HASH_INDEX_KEY_TOO_LARGE;
+
+	char entry[sizeof(RID) + MAX_KEY_SIZE];
+	const unsigned entryLength = sizeof(RID) + keySize;
+	memcpy(entry, &rid, sizeof(RID));
+	memcpy(entry + sizeof(RID), key, keySize);
+	const unsigned hash = hashKey(attribute.type, key);
+
+	// Writers have the file to themselves, lookups share it
+	IX_LatchSet latches;
+	latches.acquire(fileHandle, 0, true);
+
+	unsigned char headerPage[PAGE_SIZE];
+	RC ret = fileHandle.readPage(0, headerPage);
+	RETURN_ON_ERR(ret);
+
+	HX_Header* header = getHeader(headerPage);
+	unsigned char pageBuffer[PAGE_SIZE];
+	while (true)
+	{
+		PageNum bucketPage = 0;
+		ret = findBucket(fileHandle, header, hash, bucketPage);
+		RETURN_ON_ERR(ret);
+
+		// Take the first page of the chain with room for the entry
+		PageNum pageNum = bucketPage;
+		while (pageNum != 0)
+		{
+			ret = fileHandle.readPage(pageNum, pageBuffer);
+			RETURN_ON_ERR(ret);
+
+			if (getBucketFreeSpace(pageBuffer) >= entryLength)
+			{
+				appendEntry(pageBuffer, entry, entryLength);
+				return fileHandle.writePage(pageNum, pageBuffer);
+			}
+
+			pageNum = getBucketFooter(pageBuffer)->overflowPage;
+		}
+
+		// The bucket is full. Splitting cannot separate keys which hash alike, so a run of duplicates would
+		// otherwise split the bucket (and double the directory) every time its chain filled up. Only split
+		// once the keys outside the largest group of equal hashes would fill half a page by themselves
+		std::vector<char> entries;
+		std::vector<unsigned> hashes;
+		unsigned localDepth = 0;
+		ret = readChain(fileHandle, bucketPage, attribute.type, entries, hashes, localDepth);
+		RETURN_ON_ERR(ret);
+
+		std::map<unsigned, unsigned> hashBytes;
+		hashBytes[hash] = entryLength;
+		unsigned totalBytes = entryLength;
+		unsigned offset = 0;
+		for (unsigned i = 0; i < hashes.size(); ++i)
+		{
+			const unsigned length = getEntryLength(attribute.type, &entries[offset]);
+			hashBytes[hashes[i]] += length;
+			totalBytes += length;
+			offset += length;
+		}
+
+		unsigned largestGroup = 0;
+		for (std::map<unsigned, unsigned>::const_iterator it = hashBytes.begin(); it != hashBytes.end(); ++it)
+		{
+			largestGroup = std::max(largestGroup, it->second);
+		}
+
+		const bool canSplit = (totalBytes - largestGroup) * 2 >= PAGE_SIZE - sizeof(HX_BucketFooter);
+		if (canSplit && localDepth < HX_MAX_GLOBAL_DEPTH)
+		{
+			ret = splitBucket(fileHandle, headerPage, bucketPage, hash, attribute.type);
+			RETURN_ON_ERR(ret);
+
+			ret = fileHandle.writePage(0, headerPage);
+			RETURN_ON_ERR(ret);
+			continue;
+		}
+
+		// Chain an overflow page straight after the bucket's own page
+		PageNum overflowPage = 0;
+		ret = allocatePage(fileHandle, headerPage, overflowPage);
+		RETURN_ON_ERR(ret);
+
+		ret = fileHandle.readPage(bucketPage, pageBuffer);
+		RETURN_ON_ERR(ret);
+
+		unsigned char overflowBuffer[PAGE_SIZE];
+		initBucket(overflowBuffer, localDepth);
+		getBucketFooter(overflowBuffer)->overflowPage = getBucketFooter(pageBuffer)->overflowPage;
+		appendEntry(overflowBuffer, entry, entryLength);
+		ret = fileHandle.writePage(overflowPage, overflowBuffer);
+		RETURN_ON_ERR(ret);
+
+		getBucketFooter(pageBuffer)->overflowPage = overflowPage;
+		ret = fileHandle.writePage(bucketPage, pageBuffer);
+		RETURN_ON_ERR(ret);
+
+		return fileHandle.writePage(0, headerPage);
+	}
+}
+
+RC HashIndexManager::deleteEntry(FileHandle &fileHandle, const Attribute &attribute, const void *key, const RID &rid)
+{
+	const unsigned hash = hashKey(attribute.type, key);
+
+	IX_LatchSet latches;
+	latches.acquire(fileHandle, 0, true);
+
+	unsigned char headerPage[PAGE_SIZE];
+	RC ret = fileHandle.readPage(0, headerPage);
+	RETURN_ON_ERR(ret);
+
+	PageNum pageNum = 0;
+	ret = findBucket(fileHandle, getHeader(headerPage), hash, pageNum);
+	RETURN_ON_ERR(ret);
+
+	unsigned char pageBuffer[PAGE_SIZE];
+	unsigned char previousBuffer[PAGE_SIZE];
+	PageNum previousPage = 0;
+	while (pageNum != 0)
+	{
+		ret = fileHandle.readPage(pageNum, pageBuffer);
+		RETURN_ON_ERR(ret);
+
+		HX_BucketFooter* footer = getBucketFooter(pageBuffer);
+		char* page = (char*)pageBuffer;
+		for (unsigned offset = 0; offset < footer->freeSpaceOffset; offset += getEntryLength(attribute.type, page + offset))
+		{
+			const RID* entryRid = (const RID*)(page + offset);
+			if (entryRid->pageNum != rid.pageNum || entryRid->slotNum != rid.slotNum)
+				continue;
+			if (IndexManager::compareKeys(attribute.type, page + offset + sizeof(RID), key) != 0)
+				continue;
+
+			// Close the gap so the entries stay packed
+			const unsigned entryLength = getEntryLength(attribute.type, page + offset);
+			memmove(page + offset, page + offset + entryLength, footer->freeSpaceOffset - offset - entryLength);
+			footer->freeSpaceOffset -= entryLength;
+			--footer->numEntries;
+			memset(page + footer->freeSpaceOffset, 0, entryLength);
+
+			// An overflow page left empty comes off the chain
+			if (footer->numEntries == 0 && previousPage != 0)
+			{
+				getBucketFooter(previousBuffer)->overflowPage = footer->overflowPage;
+				ret = fileHandle.writePage(previousPage, previousBuffer);
+				RETURN_ON_ERR(ret);
+
+				ret = freePage(fileHandle, headerPage, pageNum);
+				RETURN_ON_ERR(ret);
+
+				return fileHandle.writePage(0, headerPage);
+			}
+
+			return fileHandle.writePage(pageNum, pageBuffer);
+		}
+
+		memcpy(previousBuffer, pageBuffer, PAGE_SIZE);
+		previousPage = pageNum;
+		pageNum = footer->overflowPage;
+	}
+
+	return rc::HASH_INDEX_ENTRY_NOT_FOUND;
+}
+
+RC HashIndexManager::deleteRecords(FileHandle &fileHandle)
+{
+	IX_LatchSet latches;
+	latches.acquire(fileHandle, 0, true);
+
+	unsigned char headerPage[PAGE_SIZE];
+	RC ret = fileHandle.readPage(0, headerPage);
+	RETURN_ON_ERR(ret);
+
+	HX_Header* header = getHeader(headerPage);
+	PageNum directory[HX_DIRECTORY_PAGE_SLOTS];
+	const PageNum directoryPage = header->directoryPages[0];
+	ret = fileHandle.readPage(directoryPage, directory);
+	RETURN_ON_ERR(ret);
+
+	// Start over from the first directory page and the bucket it names first, every other page is freed
+	const PageNum bucketPage = directory[0];
+	header->globalDepth = 0;
+	header->freePageHead = 0;
+	header->numDirectoryPages = 1;
+
+	unsigned char pageBuffer[PAGE_SIZE];
+	initBucket(pageBuffer, 0);
+	ret = fileHandle.writePage(bucketPage, pageBuffer);
+	RETURN_ON_ERR(ret);
+
+	const unsigned numPages = fileHandle.getNumberOfPages();
+	for (PageNum pageNum = 1; pageNum < numPages; ++pageNum)
+	{
+		if (pageNum == directoryPage || pageNum == bucketPage)
+			continue;
+
+		ret = freePage(fileHandle, headerPage, pageNum);
+		RETURN_ON_ERR(ret);
+	}
+
+	return fileHandle.writePage(0, headerPage);
+}
+
+RC HashIndexManager::scan(FileHandle &fileHandle, const Attribute &attribute, const void *key, HX_ScanIterator &hx_ScanIterator)
+{
+	return hx_ScanIterator.init(&fileHandle, attribute, key);
+}
+
+HX_ScanIterator::HX_ScanIterator()
+	: _position(0)
+{
+}
+
+HX_ScanIterator::~HX_ScanIterator()
+{
+	close();
+}
+
+RC HX_ScanIterator::init(FileHandle* fileHandle, const Attribute &attribute, const void *key)
+{
+	if (!fileHandle || !fileHandle->hasFile())
+		return rc::FILE_HANDLE_NOT_INITIALIZED;
+
+	if (!key)
+		return rc::HASH_INDEX_RANGE_SCAN;
+
+	_rids.clear();
+	_position = 0;
+
+	RC ret = _key.init(attribute.type, key);
+	RETURN_ON_ERR(ret);
+
+	IX_LatchSet latches;
+	latches.acquire(*fileHandle, 0, false);
+
+	unsigned char headerPage[PAGE_SIZE];
+	ret = fileHandle->readPage(0, headerPage);
+	RETURN_ON_ERR(ret);
+
+	PageNum pageNum = 0;
+	ret = HashIndexManager::findBucket(*fileHandle, HashIndexManager::getHeader(headerPage), HashIndexManager::hashKey(attribute.type, key), pageNum);
+	RETURN_ON_ERR(ret);
+
+	// Pick every match out of the bucket's chain
+	unsigned char pageBuffer[PAGE_SIZE];
+	while (pageNum != 0)
+	{
+		ret = fileHandle->readPage(pageNum, pageBuffer);
+		RETURN_ON_ERR(ret);
+
+		HX_BucketFooter* footer = HashIndexManager::getBucketFooter(pageBuffer);
+		const char* page = (const char*)pageBuffer;
+		for (unsigned offset = 0; offset < footer->freeSpaceOffset; offset += getEntryLength(attribute.type, page + offset))
+		{
+			if (IndexManager::compareKeys(attribute.type, page + offset + sizeof(RID), key) == 0)
+			{
+				_rids.push_back(*(const RID*)(page + offset));
+			}
+		}
+
+		pageNum = footer->overflowPage;
+	}
+
+	return rc::OK;
+}
+
+RC HX_ScanIterator::getNextEntry(RID &rid, void *key)
+{
+	if (_position >= _rids.size())
+		return IX_EOF;
+
+	rid = _rids[_position++];
+	memcpy(key, _key.data(), _key.size());
+	return rc::OK;
+}
+
+RC HX_ScanIterator::close()
+{
+	_rids.clear();
+	_position = 0;
+
+	return rc::OK;
+}
@@ -0,0 +1,110 @@
+#ifndef _hx_h_
+#define _hx_h_
+
+#include <vector>
+#include <string>
+
+#include "ix.h"
+
+// Bucket numbers one directory page holds
+#define HX_DIRECTORY_PAGE_SLOTS (PAGE_SIZE / sizeof(PageNum))
+
+// The most directory pages the reserved page can name, enough for a directory HX_MAX_GLOBAL_DEPTH deep
+#define HX_MAX_DIRECTORY_PAGES 512
+#define HX_MAX_GLOBAL_DEPTH 19
+
+// Extendible hash index layout
+/*
+The reserved page keeps the usual file header at its start and the HX_Header at its end. The directory
+has 2^globalDepth bucket page numbers spread over directory pages, a key goes in the bucket named by the
+directory entry for the low globalDepth bits of its hash. A bucket of local depth d is named by every
+entry that agrees with it on the low d bits, so a full bucket splits in two on bit d and only the
+directory entries pointing at it change, the directory doubles when d reaches globalDepth.
+Bucket pages hold [RID][key] entries packed from the start of the page in no particular order. A bucket
+whose keys all hash alike, or which cannot split since the directory is as deep as it gets, chains
+overflow pages instead
+/-----------------------------------------\
+| Bucket page N                           |
+| --------------------------------------- |
+| [Entry][Entry][Entry][Entry][Entry]...  |
+|               <free space>              |
+|                                         |
+|                       [HX_BucketFooter] |
+\-----------------------------------------/
+*/
+struct HX_Header
+{
+	unsigned globalDepth;
+	PageNum freePageHead; // pages given back by deletes and splits, linked through their overflowPage
+	unsigned numDirectoryPages;
+	PageNum directoryPages[HX_MAX_DIRECTORY_PAGES];
+};
+
+struct HX_BucketFooter
+{
+	unsigned localDepth;
+	unsigned numEntries;
+	unsigned freeSpaceOffset;
+	PageNum overflowPage; // 0 at the end of the chain
+};
+
+class HX_ScanIterator;
+class HashIndexManager : public RecordBasedCoreManager {
+ public:
+  static HashIndexManager* instance();
+
+  // Override parent createFile
+  virtual RC createFile(const string &fileName);
+  virtual RC deleteRecords(FileHandle &fileHandle);
+
+	// From RecordBasedCoreManager
+	virtual RC readAttribute(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid, const string attributeName, void *data);
+	virtual RC reorganizePage(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const unsigned pageNumber);
+
+  // Keys use the same format as IndexManager::insertEntry()
+  RC insertEntry(FileHandle &fileHandle, const Attribute &attribute, const void *key, const RID &rid);
+  RC deleteEntry(FileHandle &fileHandle, const Attribute &attribute, const void *key, const RID &rid);
+
+  // Hash indexes only answer equality, the iterator returns every entry whose key equals key
+  RC scan(FileHandle &fileHandle, const Attribute &attribute, const void *key, HX_ScanIterator &hx_ScanIterator);
+
+  static unsigned hashKey(AttrType type, const void* key);
+  static RC findBucket(FileHandle& fileHandle, HX_Header* header, unsigned hash, PageNum& bucketPage);
+  static HX_Header* getHeader(void* headerPage);
+  static HX_BucketFooter* getBucketFooter(void* pageBuffer);
+  static unsigned getBucketFreeSpace(void* pageBuffer);
+
+ protected:
+  HashIndexManager   ();                            // Constructor
+  virtual ~HashIndexManager  ();                    // Destructor
+
+  RC readChain(FileHandle& fileHandle, PageNum bucketPage, AttrType type, std::vector<char>& entries, std::vector<unsigned>& hashes, unsigned& localDepth);
+  RC appendToChain(FileHandle& fileHandle, void* headerPage, PageNum& pageNum, void* pageBuffer, const void* entry, unsigned entryLength);
+  RC splitBucket(FileHandle& fileHandle, void* headerPage, PageNum bucketPage, unsigned hash, AttrType type);
+  RC doubleDirectory(FileHandle& fileHandle, void* headerPage);
+  RC allocatePage(FileHandle& fileHandle, void* headerPage, PageNum& pageNum); // the caller writes the reserved page back
+  RC freePage(FileHandle& fileHandle, void* headerPage, PageNum pageNum);
+
+  static void initBucket(void* pageBuffer, unsigned localDepth);
+
+ private:
+	static HashIndexManager *_hash_index_manager;
+};
+
+class HX_ScanIterator {
+public:
+  HX_ScanIterator();  							// Constructor
+  ~HX_ScanIterator(); 							// Destructor
+
+  RC getNextEntry(RID &rid, void *key);  		// Get next matching entry
+  RC close();             						// Terminate index scan
+  RC init(FileHandle* fileHandle, const Attribute &attribute, const void *key);
+
+private:
+	// Every match is read when the scan starts, a bucket chain is short and the file latch is let go sooner
+	KeyValueData _key;
+	std::vector<RID> _rids;
+	unsigned _position;
+};
+
+#endif
@@ -5,6 +5,11 @@
 
 #include <assert.h>
 #include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <utility>
+#include <thread>
 
 IndexManager* IndexManager::_index_manager = 0;
 
@@ -17,44 +22,325 @@ IndexManager* IndexManager::instance()
 }
 
 IndexManager::IndexManager()
-	: RecordBasedCoreManager(sizeof(IX_PageIndexFooter))
+	: RecordBasedCoreManager(sizeof(IX_PageIndexFooter)), _indexFiles(new IX_IndexFileMap())
 {
-	Attribute attr;
-	std::vector<Attribute> commonDescriptor;
-	attr.name = "nextSlot_PageNum";			attr.type = TypeInt;		attr.length = 4;			commonDescriptor.push_back(attr);
-	attr.name = "nextSlot_SlotNum";			attr.type = TypeInt;		attr.length = 4;			commonDescriptor.push_back(attr);
-	attr.name = "rid_PageNum";				attr.type = TypeInt;		attr.length = 4;			commonDescriptor.push_back(attr);
-	attr.name = "rid_SlotNum";				attr.type = TypeInt;		attr.length = 4;			commonDescriptor.push_back(attr);
-	attr.name = "keySize";					attr.type = TypeInt;		attr.length = 4;			commonDescriptor.push_back(attr);
+}
+
+IndexManager::~IndexManager()
+{
+    // We don't want our static pointer to be pointing to deleted data in case the object is ever deleted!
+    _index_manager = NULL;
+
+	const IX_IndexFileMap* indexFiles = _indexFiles.load();
+	for (IX_IndexFileMap::const_iterator it = indexFiles->begin(); it != indexFiles->end(); ++it)
+	{
+		delete it->second;
+	}
+
+	delete indexFiles;
+	for (unsigned i = 0; i < _retiredIndexFileMaps.size(); ++i)
+	{
+		delete _retiredIndexFileMaps[i];
+	}
+}
+
+IX_IndexFile& IndexManager::getIndexFile(FileHandle& fileHandle)
+{
+	return getIndexFile(fileHandle.getFilename());
+}
 
-	// Copy the common part of the record descriptor to all types
-	_indexIntRecordDescriptor.insert(_indexIntRecordDescriptor.end(), commonDescriptor.begin(), commonDescriptor.end());
-	_indexRealRecordDescriptor.insert(_indexRealRecordDescriptor.end(), commonDescriptor.begin(), commonDescriptor.end());
-	_indexVarCharRecordDescriptor.insert(_indexVarCharRecordDescriptor.end(), commonDescriptor.begin(), commonDescriptor.end());
+IX_IndexFile& IndexManager::getIndexFile(const std::string& fileName)
+{
+	const IX_IndexFileMap* indexFiles = _indexFiles.load();
+	IX_IndexFileMap::const_iterator finder = indexFiles->find(fileName);
+	if (finder != indexFiles->end())
+	{
+		return *finder->second;
+	}
+
+	// First time we see this file, publish a copy of the map with it added
+	std::lock_guard<std::mutex> guard(_indexFileMutex);
+	indexFiles = _indexFiles.load();
+	finder = indexFiles->find(fileName);
+	if (finder != indexFiles->end())
+	{
+		return *finder->second;
+	}
 
-	// The key part of the record is the only difference
-	attr.name = "key";
+	IX_IndexFileMap* newIndexFiles = new IX_IndexFileMap(*indexFiles);
+	IX_IndexFile* indexFile = new IX_IndexFile();
+	(*newIndexFiles)[fileName] = indexFile;
+	_indexFiles.store(newIndexFiles);
+	_retiredIndexFileMaps.push_back(indexFiles);
+	return *indexFile;
+}
 
-	// Integer key records
-	attr.type = TypeInt;
-	attr.length = 4;
-	_indexIntRecordDescriptor.push_back(attr);
+IX_Latch* IndexManager::getLatch(FileHandle& fileHandle, PageNum pageNum)
+{
+	return getIndexFile(fileHandle).getLatch(pageNum);
+}
 
-	// Real key records
-	attr.type = TypeReal;
-	attr.length = 4;
-	_indexRealRecordDescriptor.push_back(attr);
+IX_PageState::IX_PageState()
+	: node(NULL)
+{
+}
 
-	// VarChar key records
-	attr.type = TypeVarChar;
-	attr.length = MAX_KEY_SIZE;
-	_indexVarCharRecordDescriptor.push_back(attr);
+IX_PageState::~IX_PageState()
+{
+	delete node.load();
 }
 
-IndexManager::~IndexManager()
+IX_IndexFile::IX_IndexFile()
+	: _rootPage(0), _splitFillFactor(IX_DEFAULT_SPLIT_FILL_FACTOR), _appendLeaf(0)
 {
-    // We don't want our static pointer to be pointing to deleted data in case the object is ever deleted!
-    _index_manager = NULL;
+	for (unsigned i = 0; i < IX_LATCH_CHUNKS; ++i)
+	{
+		_chunks[i].store(NULL);
+	}
+}
+
+IX_IndexFile::~IX_IndexFile()
+{
+	for (unsigned i = 0; i < IX_LATCH_CHUNKS; ++i)
+	{
+		delete[] _chunks[i].load();
+	}
+
+	for (std::map<PageNum, IX_PageState*>::iterator it = _overflow.begin(); it != _overflow.end(); ++it)
+	{
+		delete it->second;
+	}
+}
+
+IX_PageState* IX_IndexFile::getPageState(PageNum pageNum)
+{
+	const unsigned chunkIndex = pageNum / IX_LATCH_CHUNK_SIZE;
+	if (chunkIndex >= IX_LATCH_CHUNKS)
+	{
+		std::lock_guard<std::mutex> guard(_overflowMutex);
+		IX_PageState*& state = _overflow[pageNum];
+		if (!state)
+		{
+			state = new IX_PageState();
+		}
+
+		return state;
+	}
+
+	// Page state is made a chunk at a time the first time a page in it is used, and kept for as long as we run.
+	// If another thread made the chunk first we throw ours away and use theirs
+	IX_PageState* chunk = _chunks[chunkIndex].load();
+	if (!chunk)
+	{
+		IX_PageState* newChunk = new IX_PageState[IX_LATCH_CHUNK_SIZE];
+		if (_chunks[chunkIndex].compare_exchange_strong(chunk, newChunk))
+		{
+			chunk = newChunk;
+		}
+		else
+		{
+			delete[] newChunk;
+		}
+	}
+
+	return chunk + pageNum % IX_LATCH_CHUNK_SIZE;
+}
+
+IX_Latch* IX_IndexFile::getLatch(PageNum pageNum)
+{
+	return &getPageState(pageNum)->latch;
+}
+
+bool IX_IndexFile::readCachedNode(PageNum pageNum, unsigned version, void* pageBuffer)
+{
+	IX_CachedNode* node = getPageState(pageNum)->node.load();
+	if (!node)
+		return false;
+
+	const unsigned sequence = node->sequence.load();
+	if ((sequence & 1) || node->version.load() != version)
+		return false;
+
+	memcpy(pageBuffer, node->page, PAGE_SIZE);
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return node->sequence.load() == sequence;
+}
+
+void IX_IndexFile::cacheNode(PageNum pageNum, unsigned version, const void* pageBuffer)
+{
+	IX_PageState* state = getPageState(pageNum);
+	IX_CachedNode* node = state->node.load();
+	if (!node)
+	{
+		IX_CachedNode* newNode = new IX_CachedNode();
+		newNode->sequence.store(0);
+		newNode->version.store(1);
+		if (state->node.compare_exchange_strong(node, newNode))
+		{
+			node = newNode;
+		}
+		else
+		{
+			delete newNode;
+		}
+	}
+
+	// Whoever is already replacing the copy can have it
+	unsigned sequence = node->sequence.load();
+	if ((sequence & 1) || !node->sequence.compare_exchange_strong(sequence, sequence + 1))
+		return;
+
+	node->version.store(version);
+	memcpy(node->page, pageBuffer, PAGE_SIZE);
+	node->sequence.store(sequence + 2);
+}
+
+void IX_IndexFile::clearNodeCache()
+{
+	_appendLeaf.store(0);
+
+	// Latch versions are even whenever a page can be read, so an odd version never matches
+	for (unsigned i = 0; i < IX_LATCH_CHUNKS; ++i)
+	{
+		IX_PageState* chunk = _chunks[i].load();
+		for (unsigned j = 0; chunk && j < IX_LATCH_CHUNK_SIZE; ++j)
+		{
+			IX_CachedNode* node = chunk[j].node.load();
+			if (node)
+			{
+				node->version.store(1);
+			}
+		}
+	}
+
+	std::lock_guard<std::mutex> guard(_overflowMutex);
+	for (std::map<PageNum, IX_PageState*>::iterator it = _overflow.begin(); it != _overflow.end(); ++it)
+	{
+		IX_CachedNode* node = it->second->node.load();
+		if (node)
+		{
+			node->version.store(1);
+		}
+	}
+}
+
+IX_Latch::IX_Latch()
+	: _readers(0), _waitingWriters(0), _writer(false), _version(0)
+{
+}
+
+unsigned IX_Latch::readVersion()
+{
+	unsigned version = _version.load();
+	while (version & 1)
+	{
+		std::this_thread::yield();
+		version = _version.load();
+	}
+
+	return version;
+}
+
+void IX_Latch::lockShared()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (_writer || _waitingWriters > 0)
+	{
+		_changed.wait(lock);
+	}
+
+	++_readers;
+}
+
+void IX_Latch::unlockShared()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	assert(_readers > 0);
+	if (--_readers == 0)
+	{
+		_changed.notify_all();
+	}
+}
+
+void IX_Latch::lock()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	++_waitingWriters;
+	while (_writer || _readers > 0)
+	{
+		_changed.wait(lock);
+	}
+
+	--_waitingWriters;
+	_writer = true;
+	++_version;
+}
+
+void IX_Latch::unlock()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	assert(_writer);
+	++_version;
+	_writer = false;
+	_changed.notify_all();
+}
+
+IX_LatchSet::~IX_LatchSet()
+{
+	releaseAll();
+}
+
+void IX_LatchSet::acquire(FileHandle& fileHandle, PageNum pageNum, bool exclusive)
+{
+	HeldLatch held;
+	held.latch = IndexManager::instance()->getLatch(fileHandle, pageNum);
+	held.exclusive = exclusive;
+
+	if (exclusive)
+		held.latch->lock();
+	else
+		held.latch->lockShared();
+
+	_held.push_back(held);
+}
+
+void IX_LatchSet::release(const HeldLatch& held)
+{
+	if (held.exclusive)
+		held.latch->unlock();
+	else
+		held.latch->unlockShared();
+}
+
+void IX_LatchSet::releaseLast()
+{
+	assert(!_held.empty());
+	release(_held.back());
+	_held.pop_back();
+}
+
+void IX_LatchSet::releaseAncestors()
+{
+	if (_held.size() < 2)
+	{
+		return;
+	}
+
+	for (unsigned i = 0; i + 1 < _held.size(); ++i)
+	{
+		release(_held[i]);
+	}
+
+	_held.erase(_held.begin(), _held.end() - 1);
+}
+
+void IX_LatchSet::releaseAll()
+{
+	// Let go from the bottom up, so nobody waiting at the top gets in while we still hold pages below
+	while (!_held.empty())
+	{
+		releaseLast();
+	}
 }
 
 RC IndexManager::readAttribute(FileHandle &/*fileHandle*/, const vector<Attribute> &/*recordDescriptor*/, const RID &/*rid*/, const string /*attributeName*/, void * /*data*/)
@@ -62,13 +348,14 @@ RC IndexManager::readAttribute(FileHandle &/*fileHandle*/, const vector<Attribut
 	return rc::FEATURE_NOT_YET_IMPLEMENTED;
 }
 
-RC IndexManager::reorganizePage(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const unsigned pageNumber)
+RC IndexManager::reorganizePage(FileHandle &fileHandle, const vector<Attribute> &/*recordDescriptor*/, const unsigned pageNumber)
 {
     unsigned char pageBuffer[PAGE_SIZE] = {0};
     RC ret = fileHandle.readPage(pageNumber, pageBuffer);
     RETURN_ON_ERR(ret);
 
-	return reorganizeBufferedPage(fileHandle, sizeof(IX_PageIndexFooter), recordDescriptor, pageNumber, pageBuffer);
+	compactPage(pageBuffer);
+	return fileHandle.writePage(pageNumber, pageBuffer);
 }
 
 RC IndexManager::openFile(const string &fileName, FileHandle &fileHandle)
@@ -82,13 +369,41 @@ RC IndexManager::openFile(const string &fileName, FileHandle &fileHandle)
 	ret = fileHandle.readPage(0, pageBuffer);
 	RETURN_ON_ERR(ret);
 
-	// Cache the value
+	// Cache the values, a file written before the split fill factor was kept there has 0 in its place
 	unsigned* rootPage = (unsigned*)((char*)pageBuffer + PAGE_SIZE - sizeof(unsigned));
-	IndexManager::instance()->_rootPageMap[fileHandle.getFilename()] = *rootPage;
+	float* splitFillFactor = (float*)((char*)pageBuffer + PAGE_SIZE - 2 * sizeof(unsigned) - sizeof(float));
+	std::lock_guard<std::mutex> guard(_headerMutex);
+	getIndexFile(fileHandle).setRootPage(*rootPage);
+	getIndexFile(fileHandle).setSplitFillFactor(*splitFillFactor > 0.0f ? *splitFillFactor : IX_DEFAULT_SPLIT_FILL_FACTOR);
+
+	return rc::OK;
+}
+
+RC IndexManager::setSplitFillFactor(FileHandle& fileHandle, float splitFillFactor)
+{
+	if (!fileHandle.hasFile())
+		return rc::FILE_HANDLE_NOT_INITIALIZED;
+
+	splitFillFactor = std::min(std::max(splitFillFactor, IX_MIN_SPLIT_FILL_FACTOR), 1.0f);
+
+	std::lock_guard<std::mutex> guard(_headerMutex);
+	unsigned char pageBuffer[PAGE_SIZE];
+	RC ret = fileHandle.readPage(0, pageBuffer);
+	RETURN_ON_ERR(ret);
+
+	memcpy((char*)pageBuffer + PAGE_SIZE - 2 * sizeof(unsigned) - sizeof(float), &splitFillFactor, sizeof(float));
+	ret = fileHandle.writePage(0, pageBuffer);
+	RETURN_ON_ERR(ret);
 
+	getIndexFile(fileHandle).setSplitFillFactor(splitFillFactor);
 	return rc::OK;
 }
 
+float IndexManager::getSplitFillFactor(FileHandle& fileHandle)
+{
+	return getIndexFile(fileHandle).getSplitFillFactor();
+}
+
 RC IndexManager::createFile(const string &fileName)
 {
 	RC ret = PagedFileManager::instance()->createFile(fileName.c_str());
@@ -97,6 +412,9 @@ RC IndexManager::createFile(const string &fileName)
 		return ret;
 	}
 
+	// Anything we remember about an older file by the same name is no good now
+	getIndexFile(fileName).clearNodeCache();
+
 	// Open up the file so we can initialize it with some data
 	FileHandle fileHandle;
 	ret = openFile(fileName, fileHandle);
@@ -131,6 +449,9 @@ RC IndexManager::createFile(const string &fileName)
 
 RC IndexManager::updateRootPage(FileHandle& fileHandle, unsigned newRootPage)
 {
+	IndexManager& im = *IndexManager::instance();
+	std::lock_guard<std::mutex> guard(im._headerMutex);
+
 	// Read in the reserved page
 	unsigned char pageBuffer[PAGE_SIZE];
 	RC ret = fileHandle.readPage(0, pageBuffer);
@@ -145,7 +466,7 @@ RC IndexManager::updateRootPage(FileHandle& fileHandle, unsigned newRootPage)
 	RETURN_ON_ERR(ret);
 
 	// Cache the value
-	IndexManager::instance()->_rootPageMap[fileHandle.getFilename()] = newRootPage;
+	im.getIndexFile(fileHandle).setRootPage(newRootPage);
 
 	return rc::OK;
 }
@@ -153,42 +474,21 @@ RC IndexManager::updateRootPage(FileHandle& fileHandle, unsigned newRootPage)
 RC IndexManager::newPage(FileHandle& fileHandle, PageNum pageNum, bool isLeaf, PageNum nextLeafPage, PageNum leftChild)
 {
 	const unsigned currentNumPages = fileHandle.getNumberOfPages();
-	IX_PageIndexFooter footerTemplate;
-	footerTemplate.isLeafPage = isLeaf; 
-	footerTemplate.firstRecord.pageNum = pageNum;
-	footerTemplate.firstRecord.slotNum = 0;
-	footerTemplate.nextLeafPage = isLeaf ? nextLeafPage : 0;
-	footerTemplate.freespacePrevPage = 0;
-	footerTemplate.freespaceNextPage = 0;
-	footerTemplate.freeSpaceOffset = 0;
-	footerTemplate.numSlots = 0;
-	footerTemplate.gapSize = 0;
-	footerTemplate.pageNumber = pageNum;
-	footerTemplate.leftChild = leftChild;
-	footerTemplate.freespaceList = NUM_FREESPACE_LISTS - 1;
-
 	unsigned char pageBuffer[PAGE_SIZE];
-	IX_PageIndexFooter* footer = getIXPageIndexFooter(pageBuffer);
+	initPage(pageBuffer, pageNum, isLeaf, nextLeafPage, leftChild);
 
-	// If we are 'new'ing a previously allocated page, just zero out the data there
+	// If we are 'new'ing a previously allocated page, just overwrite the data there
 	if (pageNum < currentNumPages)
 	{
-		memset(pageBuffer, 0, PAGE_SIZE);
-		memcpy(footer, &footerTemplate, sizeof(footerTemplate));
-
 		RC ret = fileHandle.writePage(pageNum, pageBuffer);
 		RETURN_ON_ERR(ret);
 	}
 	else
 	{
-		// TODO: Check freespace list to see if there's a completely empty page available
 		// Append as many pages as needed (should be only 1)
 		unsigned requiredPages = pageNum - currentNumPages + 1;
 		for (unsigned i = 0; i < requiredPages; i++)
 		{
-			memset(pageBuffer, 0, PAGE_SIZE);
-			memcpy(footer, &footerTemplate, sizeof(footerTemplate));
-
 			RC ret = fileHandle.appendPage(pageBuffer);
 			RETURN_ON_ERR(ret);
 		}
@@ -197,1395 +497,3149 @@ RC IndexManager::newPage(FileHandle& fileHandle, PageNum pageNum, bool isLeaf, P
 	return rc::OK;
 }
 
-RC IndexManager::insertEntry(FileHandle &fileHandle, const Attribute &attribute, const void *key, const RID &rid)
+// The head of the free page list lives in the reserved page, just before the root page number
+static PageNum* getFreePageHead(void* headerPage)
 {
-	// Pull in the root page
-	unsigned char pageBuffer[PAGE_SIZE] = {0};
-	RC ret = readRootPage(fileHandle, pageBuffer);
-	RETURN_ON_ERR(ret);
+	return (PageNum*)((char*)headerPage + PAGE_SIZE - 2 * sizeof(unsigned));
+}
 
-	// Build the key struct for the index 
-	KeyValueData keyData;
-	ret = keyData.init(attribute.type, key);
+RC IndexManager::allocatePage(FileHandle& fileHandle, PageNum& pageNum)
+{
+	std::lock_guard<std::mutex> guard(_headerMutex);
+	unsigned char headerPage[PAGE_SIZE];
+	RC ret = fileHandle.readPage(0, headerPage);
 	RETURN_ON_ERR(ret);
 
-	// Extract the header
-	IX_PageIndexFooter* footer = getIXPageIndexFooter(pageBuffer);
-	const PageNum rootPage = footer->pageNumber;
-
-	// Keep track of pages we've traversed so we can find parent pointers
-	std::vector<PageNum> parents;
-
-	// Traverse down the tree to the leaf, using non-leaves along the way
-	PageNum insertDestination = rootPage;
-	while (footer->isLeafPage == false)
-	{
-		parents.push_back(insertDestination);
-
-		ret = findNonLeafIndexEntry(fileHandle, footer, attribute, &keyData, insertDestination);
-		RETURN_ON_ERR(ret);
-
-		// Pull the designated page into memory and refresh the footer
-		memset(pageBuffer, 0, PAGE_SIZE);
-		ret = fileHandle.readPage(insertDestination, pageBuffer);
-		RETURN_ON_ERR(ret);
-	}
-
-	// We're at a leaf now...
-	assert(footer->isLeafPage);
-
-	// Determine what type of record descriptor we need
-	const std::vector<Attribute>& recordDescriptor = getIndexRecordDescriptor(attribute.type);
-
-	// Try to insert into the leaf
-	ret = insertIntoLeaf(fileHandle, insertDestination, attribute, keyData, rid);
-	if (ret != rc::OK && ret != rc::BTREE_INDEX_PAGE_FULL)
+	// Reuse a page freed by a merge if there is one, otherwise append a blank page so nobody else can take it
+	unsigned char pageBuffer[PAGE_SIZE];
+	PageNum* freeHead = getFreePageHead(headerPage);
+	if (*freeHead == 0)
 	{
-		RETURN_ON_ERR(ret);
-		assert(false);
+		pageNum = fileHandle.getNumberOfPages();
+		initPage(pageBuffer, pageNum, true, 0, 0);
+		return fileHandle.appendPage(pageBuffer);
 	}
-	else
-	{
-		bool needsToInsertOriginal = ret != rc::OK;
-		PageNum nextPage = insertDestination;
-		insertDestination = 0;
-
-		PageNum postSplitIndexPage = 0;
-		RID postSplitIndexRid;
-		KeyValueData postSplitKey;
 
-		// Handle cascading splits
-		while (ret == rc::BTREE_INDEX_PAGE_FULL && nextPage != 0)
-		{
-			// Split the page (no difference between leaves and non-leaves)
-			PageNum parent = parents.empty() ? 0 : parents.back();
-			PageNum leftPage = nextPage;
-			PageNum rightPage;
-			KeyValueData rightKey;
-			RID rightRid;
-			int compareResult = 0;
-
-			ret = deletelessSplit(fileHandle, recordDescriptor, leftPage, rightPage, rightRid, rightKey);
-			RETURN_ON_ERR(ret);			
-
-			// Save the result of the first split so that we can insert after initial cascading is done
-			if (postSplitIndexPage == 0)
-			{
-				postSplitIndexPage = rightPage;
-				postSplitIndexRid = rightRid;
-				postSplitKey = rightKey;
-			} 
-			else
-			{
-				// Determine which page we should actually insert into...
-				PageNum targetCascadePage = leftPage;
-				ret = postSplitKey.compare(attribute.type, rightKey, compareResult);
-				RETURN_ON_ERR(ret);
+	ret = fileHandle.readPage(*freeHead, pageBuffer);
+	RETURN_ON_ERR(ret);
 
-				if (compareResult >= 0)
-				{
-					targetCascadePage = rightPage;
-				}
+	pageNum = *freeHead;
+	*freeHead = getIXPageIndexFooter(pageBuffer)->leftChild;
+	return fileHandle.writePage(0, headerPage);
+}
 
-				ret = insertIntoNonLeaf(fileHandle, targetCascadePage, attribute, postSplitKey, postSplitIndexRid);
-				RETURN_ON_ERR(ret); // split just occurred, so this insertion should always postSplitIndexRid
+RC IndexManager::freePage(FileHandle& fileHandle, PageNum pageNum, PageNum mergedInto, unsigned mergedSlot)
+{
+	std::lock_guard<std::mutex> guard(_headerMutex);
+	unsigned char headerPage[PAGE_SIZE];
+	RC ret = fileHandle.readPage(0, headerPage);
+	RETURN_ON_ERR(ret);
 
-				// Reset the split flags in case we need to cascade upwards
-				postSplitIndexPage = rightPage;
-				postSplitIndexRid = rightRid;
-				postSplitKey = rightKey;
-			}
+	PageNum* freeHead = getFreePageHead(headerPage);
 
-			// Our first split will tell us where to put or original value
-			ret = keyData.compare(attribute.type, rightKey, compareResult);
-			RETURN_ON_ERR(ret);
+	unsigned char pageBuffer[PAGE_SIZE];
+	initPage(pageBuffer, pageNum, true, mergedInto, 0);
 
-			// Check to see if we need to grow by one level, and if so, add a new page with enough space to 
-			// hold the new index entry
-			if (nextPage == rootPage)
-			{
-				PageNum newRootPage = fileHandle.getNumberOfPages();
-				ret = updateRootPage(fileHandle, newRootPage);
-				RETURN_ON_ERR(ret);
+	IX_PageIndexFooter* footer = getIXPageIndexFooter(pageBuffer);
+	footer->isFreePage = true;
+	footer->mergedSlot = mergedSlot;
+	footer->leftChild = *freeHead;
 
-				ret = newPage(fileHandle, newRootPage, false, 0, leftPage);
-				RETURN_ON_ERR(ret);
+	ret = fileHandle.writePage(pageNum, pageBuffer);
+	RETURN_ON_ERR(ret);
 
-				// Update the parent since we just increased the size of the tree
-				parents.push_back(newRootPage);
-				parent = newRootPage;
-			}
+	*freeHead = pageNum;
+	return fileHandle.writePage(0, headerPage);
+}
 
-			// Insert the right child into the parent of the left
-			ret = insertIntoNonLeaf(fileHandle, parent, attribute, rightKey, rightRid);
-			if (ret != rc::OK && ret != rc::BTREE_INDEX_PAGE_FULL)
-			{
-				RETURN_ON_ERR(ret);
-			}
+RC IndexManager::resetFreePageList(FileHandle& fileHandle)
+{
+	std::lock_guard<std::mutex> guard(_headerMutex);
+	unsigned char headerPage[PAGE_SIZE];
+	RC ret = fileHandle.readPage(0, headerPage);
+	RETURN_ON_ERR(ret);
 
-			// Recurse up the tree!
-			if (!parents.empty())
-			{
-				parents.pop_back();
-			}
+	*getFreePageHead(headerPage) = 0;
+	return fileHandle.writePage(0, headerPage);
+}
 
-			nextPage = parent;
-		}
+void IndexManager::initPage(void* pageBuffer, PageNum pageNum, bool isLeaf, PageNum nextLeafPage, PageNum leftChild)
+{
+	memset(pageBuffer, 0, PAGE_SIZE);
 
-		// Don't forget to insert the actual item we were trying to insert in the first place!
-		if (needsToInsertOriginal)
-		{
-			ret = insertEntry(fileHandle, attribute, key, rid);
-			RETURN_ON_ERR(ret);
-		}
-	}
-	
-	return rc::OK;
+	IX_PageIndexFooter* footer = getIXPageIndexFooter(pageBuffer);
+	footer->isLeafPage = isLeaf;
+	footer->nextLeafPage = isLeaf ? nextLeafPage : 0;
+	footer->leftChild = isLeaf ? 0 : leftChild;
+	footer->pageNumber = pageNum;
+	footer->freespaceList = NUM_FREESPACE_LISTS - 1;
 }
 
-RC IndexManager::deleteEntry(FileHandle &fileHandle, const Attribute &attribute, const void *key, const RID &/*rid*/)
+RC IndexManager::deleteRecords(FileHandle &fileHandle)
 {
-    // Pull in the root page
-	unsigned char pageBuffer[PAGE_SIZE] = {0};
-	RC ret = readRootPage(fileHandle, pageBuffer);
+	// Nobody gets into the tree while we throw it away
+	IX_LatchSet latches;
+	latches.acquire(fileHandle, 0, true);
+
+	// Start over from an empty root leaf, every other page goes on the free list. Each page is latched while
+	// we rewrite it so readers already past the reserved page see it change
+	latches.acquire(fileHandle, 1, true);
+	RC ret = newPage(fileHandle, 1, true, 0, 0);
 	RETURN_ON_ERR(ret);
+	latches.releaseLast();
 
-	// Extract the header
-	IX_PageIndexFooter* footer = getIXPageIndexFooter(pageBuffer);
-	const PageNum rootPageNum = footer->pageNumber;
-
-	// Build the key struct for the index 
-	KeyValueData keyData;
-	ret = keyData.init(attribute.type, key);
+	ret = updateRootPage(fileHandle, 1);
 	RETURN_ON_ERR(ret);
 
-	// Determine what type of record descriptor we need
-	const std::vector<Attribute>& recordDescriptor = getIndexRecordDescriptor(attribute.type);
+	ret = resetFreePageList(fileHandle);
+	RETURN_ON_ERR(ret);
 
-	// Traverse down the tree to the leaf, using non-leaves along the way
-	PageNum nextPage = rootPageNum;
-	while (footer->isLeafPage == false)
+	for (PageNum page = fileHandle.getNumberOfPages() - 1; page > 1; --page)
 	{
-		ret = findNonLeafIndexEntry(fileHandle, footer, attribute, &keyData, nextPage);
-		RETURN_ON_ERR(ret);
-
-		// Pull the designated page into memory
-		memset(pageBuffer, 0, PAGE_SIZE);
-		ret = fileHandle.readPage(nextPage, pageBuffer);
+		latches.acquire(fileHandle, page, true);
+		ret = freePage(fileHandle, page, 0, 0);
 		RETURN_ON_ERR(ret);
+		latches.releaseLast();
 	}
 
-	// Now search along the leaf page
-	assert(footer->isLeafPage);
-	RID entryRid, prevEntryRid, nextEntryRid, dataRid;
-	ret = findLeafIndexEntry(fileHandle, footer, attribute, &keyData, entryRid, prevEntryRid, nextEntryRid, dataRid);
-	if (ret != rc::OK)
+	return rc::OK;
+}
+
+// Largest entry we accept, small enough that any split can always place every entry on one of two pages
+static const unsigned IX_MAX_ENTRY_SIZE = (PAGE_SIZE - sizeof(IX_PageIndexFooter)) / 3 - sizeof(IX_EntrySlot);
+
+static unsigned entryHeaderSize(bool isLeaf)
+{
+	return isLeaf ? sizeof(RID) : sizeof(PageNum);
+}
+
+static int compareBytes(const char* lhs, unsigned lhsSize, const char* rhs, unsigned rhsSize)
+{
+	int result = memcmp(lhs, rhs, std::min(lhsSize, rhsSize));
+	if (result == 0)
 	{
-		return ret;
+		result = (lhsSize < rhsSize) ? -1 : (lhsSize > rhsSize ? 1 : 0);
 	}
 
-	// If we delete the first RID on the page, be sure to update the footer pointer to the "new" first RID
-	IndexRecord record;
-	if (entryRid.slotNum == footer->firstRecord.slotNum)
-	{
-		ret = IndexManager::instance()->readRecord(fileHandle, recordDescriptor, footer->firstRecord, &record);
-		RETURN_ON_ERR(ret);
-		footer->firstRecord = record.nextSlot;
+	return result;
+}
 
-		memcpy(pageBuffer + PAGE_SIZE - sizeof(IX_PageIndexFooter), footer, sizeof(IX_PageIndexFooter));
-		ret = fileHandle.writePage(nextPage, pageBuffer);
-		RETURN_ON_ERR(ret);
-	}
+// Number of leading characters two varchar keys have in common
+static unsigned commonPrefixLength(const void* lhs, const void* rhs)
+{
+	unsigned leftSize, rightSize;
+	memcpy(&leftSize, lhs, sizeof(unsigned));
+	memcpy(&rightSize, rhs, sizeof(unsigned));
 
-	// Update the next pointer of our previous record if it exists
-	if (prevEntryRid.pageNum != 0)
+	const char* left = (const char*)lhs + sizeof(unsigned);
+	const char* right = (const char*)rhs + sizeof(unsigned);
+	const unsigned maxLength = std::min(leftSize, rightSize);
+
+	unsigned length = 0;
+	while (length < maxLength && left[length] == right[length])
 	{
-		ret = IndexManager::instance()->readRecord(fileHandle, recordDescriptor, prevEntryRid, &record);
-		RETURN_ON_ERR(ret);
+		++length;
+	}
 
-		record.nextSlot = nextEntryRid;
+	return length;
+}
 
-		ret = IndexManager::instance()->updateRecord(fileHandle, recordDescriptor, &record, prevEntryRid);
-		RETURN_ON_ERR(ret);
+// Number of leading characters of a varchar key that match the page prefix
+static unsigned matchPagePrefix(void* pageBuffer, const void* key)
+{
+	const unsigned prefixLength = IndexManager::getIXPageIndexFooter(pageBuffer)->prefixLength;
+	unsigned keySize;
+	memcpy(&keySize, key, sizeof(unsigned));
+
+	const char* prefix = (const char*)pageBuffer;
+	const char* characters = (const char*)key + sizeof(unsigned);
+	const unsigned maxLength = std::min(prefixLength, keySize);
+
+	unsigned length = 0;
+	while (length < maxLength && prefix[length] == characters[length])
+	{
+		++length;
 	}
 
-    // Delete the entry from the index now
-    ret = deleteRecord(fileHandle, recordDescriptor, entryRid);
-    RETURN_ON_ERR(ret);
+	return length;
+}
 
-    ret = reorganizePage(fileHandle, recordDescriptor, entryRid.pageNum);
+// How every entry on the page compares to key from the page prefix alone, 0 if key starts with the prefix
+static int comparePagePrefix(void* pageBuffer, const void* key)
+{
+	const unsigned prefixLength = IndexManager::getIXPageIndexFooter(pageBuffer)->prefixLength;
+	if (prefixLength == 0)
+	{
+		return 0;
+	}
 
-	// Check if the page has become completely empty
-	ret = fileHandle.readPage(entryRid.pageNum, pageBuffer);
-	RETURN_ON_ERR(ret);
+	const unsigned matched = matchPagePrefix(pageBuffer, key);
+	if (matched == prefixLength)
+	{
+		return 0;
+	}
 
-	// Reset the page if so
-	if (footer->numSlots == 0)
+	unsigned keySize;
+	memcpy(&keySize, key, sizeof(unsigned));
+	if (matched == keySize)
 	{
-		ret = reorganizePage(fileHandle, recordDescriptor, entryRid.pageNum);
+		return 1;
 	}
 
-    return rc::OK;
+	const unsigned char prefixChar = ((const unsigned char*)pageBuffer)[matched];
+	const unsigned char keyChar = ((const unsigned char*)key)[sizeof(unsigned) + matched];
+	return prefixChar < keyChar ? -1 : 1;
 }
 
-RC IndexManager::insertIntoNonLeaf(FileHandle& fileHandle, PageNum& page, const Attribute &attribute, KeyValueData keyData, RID rid)
+// Key types for the templated search code below. Each one compares two keys of its type, and says whether
+// its pages can carry a shared prefix, so the hot loops are compiled per type instead of switching per compare
+struct IX_IntKey
 {
-	// Pull in the root page and then extract the header
-	unsigned char pageBuffer[PAGE_SIZE] = {0};
-	RC ret = fileHandle.readPage(page, pageBuffer);
-	RETURN_ON_ERR(ret);
+	static const bool hasPrefix = false;
 
-	IX_PageIndexFooter* footer = getIXPageIndexFooter(pageBuffer);
+	static int compare(const void* lhs, const void* rhs)
+	{
+		int left, right;
+		memcpy(&left, lhs, sizeof(int));
+		memcpy(&right, rhs, sizeof(int));
+		return (left > right) - (left < right);
+	}
+};
 
-	// Create the new entry to add
-	IndexRecord entry;
-	entry.rid = rid;
-	entry.nextSlot.pageNum = 0;
-	entry.nextSlot.slotNum = 0;
-	entry.key = keyData;
-
-	// Determine what type of record descriptor we need
-	const std::vector<Attribute>& recordDescriptor = getIndexRecordDescriptor(attribute.type);
-
-	// Compute the record length
-	unsigned recLength = 0;
-    unsigned recHeaderSize = 0;
-    unsigned* recHeader = NULL;
-    ret = generateRecordHeader(recordDescriptor, &entry, recHeader, recLength, recHeaderSize);
-	free(recHeader);
-	RETURN_ON_ERR(ret);
+struct IX_RealKey
+{
+	static const bool hasPrefix = false;
 
-	// Determine if we can fit on this page
-	unsigned targetFreeSpace = calculateFreespace(footer->freeSpaceOffset, footer->numSlots);
-	if ((recLength + sizeof(PageIndexSlot)) >= targetFreeSpace)
+	static int compare(const void* lhs, const void* rhs)
 	{
-		if (footer->numSlots == 0)
-			return rc::BTREE_KEY_TOO_LARGE;
-
-		return rc::BTREE_INDEX_PAGE_FULL;
+		float left, right;
+		memcpy(&left, lhs, sizeof(float));
+		memcpy(&right, rhs, sizeof(float));
+		return (left > right) - (left < right);
 	}
+};
 
-	if (footer->numSlots == 0)
+struct IX_VarCharKey
+{
+	static const bool hasPrefix = true;
+
+	static int compare(const void* lhs, const void* rhs)
 	{
-		// Insert the new record into the root
-		RID newEntry;
-		ret = insertRecordToPage(fileHandle, recordDescriptor, &entry, page, newEntry);
-		RETURN_ON_ERR(ret);
+		unsigned leftSize, rightSize;
+		memcpy(&leftSize, lhs, sizeof(unsigned));
+		memcpy(&rightSize, rhs, sizeof(unsigned));
+		return compareBytes((const char*)lhs + sizeof(unsigned), leftSize, (const char*)rhs + sizeof(unsigned), rightSize);
+	}
+};
 
-		// Pull in the updated footer
-		ret = fileHandle.readPage(page, pageBuffer);
-		RETURN_ON_ERR(ret);
+// Compare a stored key to a key which is known to start with the page prefix, so only the rest needs looking at
+template <typename Key>
+static int compareStoredKey(const char* storedKey, unsigned prefixLength, const void* key)
+{
+	if (!Key::hasPrefix || prefixLength == 0)
+	{
+		return Key::compare(storedKey, key);
+	}
 
-		footer = getIXPageIndexFooter(pageBuffer);
-		
-		// Update the header of the page to point to this new entry
-		footer->firstRecord = newEntry;
-		memcpy(pageBuffer + PAGE_SIZE - sizeof(IX_PageIndexFooter), footer, sizeof(IX_PageIndexFooter));
+	unsigned storedSize, keySize;
+	memcpy(&storedSize, storedKey, sizeof(unsigned));
+	memcpy(&keySize, key, sizeof(unsigned));
+	return compareBytes(storedKey + sizeof(unsigned), storedSize, (const char*)key + sizeof(unsigned) + prefixLength, keySize - prefixLength);
+}
 
-		// Write the new page information to disk
-		ret = fileHandle.writePage(page, pageBuffer);
-		RETURN_ON_ERR(ret);
-	}
-	else // if we can fit, find the spot in the list where the new record will go
+template <typename Key>
+static int compareEntryKeyOf(void* pageBuffer, unsigned position, const void* key)
+{
+	if (Key::hasPrefix)
 	{
-		RID currRid = footer->firstRecord;
-		RID prevRid;
-		IndexRecord currEntry;
-		IndexRecord prevEntry;
-		RID targetPrevRid;
-		RID targetRid = footer->firstRecord;
-		IndexRecord targetPrevEntry;
-		IndexRecord targetEntry;
-
-		int numEntries = 0;
-		int target = 0;
-		while (currRid.pageNum > 0) // second condition implies the end of the chain
+		const int prefixResult = comparePagePrefix(pageBuffer, key);
+		if (prefixResult != 0)
 		{
-			// Pull in the next entry
-			ret = readRecord(fileHandle, recordDescriptor, currRid, &currEntry);
-			RETURN_ON_ERR(ret);
-
-			int compareResult = 0;
-			ret = keyData.compare(attribute.type, currEntry.key, compareResult);
-			RETURN_ON_ERR(ret);
+			return prefixResult;
+		}
+	}
 
-			numEntries++;
-			if (compareResult >= 0)
-			{
-				target = numEntries;
-				targetPrevRid = prevRid;
-				targetRid = currRid;
-				targetEntry = currEntry;
-				targetPrevEntry = prevEntry;
-			}
+	const unsigned prefixLength = IndexManager::getIXPageIndexFooter(pageBuffer)->prefixLength;
+	return compareStoredKey<Key>((const char*)IndexManager::getEntryKey(pageBuffer, position), prefixLength, key);
+}
 
-            // Update for next iteration
-            prevRid = currRid;
-            prevEntry = currEntry;
-            currRid = currEntry.nextSlot;
-		}
+template <typename Key>
+static unsigned findEntryPositionOf(void* pageBuffer, const void* key, bool upperBound)
+{
+	IX_PageIndexFooter* footer = IndexManager::getIXPageIndexFooter(pageBuffer);
+	if (!key)
+	{
+		return 0;
+	}
 
-		// Drop the record into the right spot in the on-page list
-		bool atEnd = target == numEntries;
-		bool atStart = target == 0;
-		if (!atEnd && !atStart) // middle of list
+	// A key outside the page prefix sorts before or after the whole page
+	if (Key::hasPrefix)
+	{
+		const int prefixResult = comparePagePrefix(pageBuffer, key);
+		if (prefixResult != 0)
 		{
-			// Insert the new record into the root, and make it point to the current RID
-			entry.nextSlot = targetEntry.nextSlot;
-			RID newEntry;
-			ret = insertRecordToPage(fileHandle, recordDescriptor, &entry, page, newEntry);
-			RETURN_ON_ERR(ret);
-
-			// Update the previous entry to point to the new entry (it's in the middle now)
-			targetEntry.nextSlot = newEntry;
-			ret = updateRecord(fileHandle, recordDescriptor, &targetEntry, targetRid);
-			RETURN_ON_ERR(ret);
+			return prefixResult < 0 ? footer->numSlots : 0;
 		}
-		else if (atStart) // start
-		{
-			// Insert the new record into the root, and make it point to the current RID
-			entry.nextSlot = footer->firstRecord;
-			RID newEntry;
-			ret = insertRecordToPage(fileHandle, recordDescriptor, &entry, page, newEntry);
-			RETURN_ON_ERR(ret);
+	}
 
-			// We are the beginning of the list, update the firstRecord slot to point here
-			ret = fileHandle.readPage(footer->pageNumber, pageBuffer);
-			RETURN_ON_ERR(ret);
+	// Everything that is the same for each probe is worked out once, the slots sit just below the footer
+	const char* keys = (const char*)pageBuffer + entryHeaderSize(footer->isLeafPage);
+	const IX_EntrySlot* slots = (const IX_EntrySlot*)footer;
+	const unsigned prefixLength = footer->prefixLength;
 
-			footer->firstRecord = newEntry;
-			ret = fileHandle.writePage(footer->pageNumber, pageBuffer);
-			RETURN_ON_ERR(ret);
+	unsigned low = 0;
+	unsigned high = footer->numSlots;
+	while (low < high)
+	{
+		const unsigned middle = low + (high - low) / 2;
+		const int compareResult = compareStoredKey<Key>(keys + slots[-(int)middle - 1].offset, prefixLength, key);
+		if (compareResult < 0 || (upperBound && compareResult == 0))
+		{
+			low = middle + 1;
 		}
-		else // append the RID to the end of the on-page list 
+		else
 		{
-			// Insert the new record into the root
-			RID newEntry;
-			ret = insertRecordToPage(fileHandle, recordDescriptor, &entry, page, newEntry);
-			RETURN_ON_ERR(ret);
-
-			// Update the previous entry to point to the new entry
-			targetEntry.nextSlot = newEntry;
-			ret = updateRecord(fileHandle, recordDescriptor, &targetEntry, targetRid);
-			RETURN_ON_ERR(ret);
+			high = middle;
 		}
 	}
 
-	return rc::OK;
+	return low;
 }
 
-RC IndexManager::insertIntoLeaf(FileHandle& fileHandle, PageNum& page, const Attribute &attribute, KeyValueData keyData, RID rid)
+// Shortest key above leftKey and no higher than rightKey, the least a parent has to store to tell two
+// neighbouring children apart. Only varchars can be shortened, and equal keys keep the whole key
+static unsigned makeSeparator(AttrType type, const void* leftKey, const void* rightKey, void* separator)
 {
-	// Pull in the page and then extract the header
-	unsigned char pageBuffer[PAGE_SIZE] = {0};
-	RC ret = fileHandle.readPage(page, pageBuffer);
-	RETURN_ON_ERR(ret);
-
-	IX_PageIndexFooter* footer = getIXPageIndexFooter(pageBuffer);
-
-	// Determine what type of record descriptor we need
-	const std::vector<Attribute>& recordDescriptor = getIndexRecordDescriptor(attribute.type);
-
-	// Set up the leaf data struct
-	IndexRecord leaf;
-	leaf.rid = rid;
-	leaf.nextSlot.pageNum = 0;
-	leaf.nextSlot.slotNum = 0;
-	leaf.key = keyData;
-
-	// Compute the record length
-	unsigned recLength = 0;
-	unsigned recHeaderSize = 0;
-	unsigned* recHeader = NULL;
-	ret = generateRecordHeader(recordDescriptor, &leaf, recHeader, recLength, recHeaderSize);
-	free(recHeader);
-	RETURN_ON_ERR(ret);
-
-	// Determine if we can fit on this page
-	unsigned targetFreeSpace = calculateFreespace(footer->freeSpaceOffset, footer->numSlots);
-	if ((recLength + sizeof(PageIndexSlot)) > targetFreeSpace)
+	if (type == TypeVarChar)
 	{
-		if (footer->numSlots == 0)
-			return rc::BTREE_KEY_TOO_LARGE;
+		unsigned rightSize;
+		memcpy(&rightSize, rightKey, sizeof(unsigned));
 
-		return rc::BTREE_INDEX_PAGE_FULL;
+		const unsigned length = commonPrefixLength(leftKey, rightKey) + 1;
+		if (length <= rightSize)
+		{
+			memcpy(separator, &length, sizeof(unsigned));
+			memcpy((char*)separator + sizeof(unsigned), (const char*)rightKey + sizeof(unsigned), length);
+			return sizeof(unsigned) + length;
+		}
 	}
 
-	// Special case if the leaf is empty
-	if (footer->numSlots == 0)
-	{
-		// Insert the new record into the root
-		RID newEntry;
-		ret = insertRecordToPage(fileHandle, recordDescriptor, &leaf, page, newEntry);
-		RETURN_ON_ERR(ret);
+	const unsigned separatorSize = Attribute::sizeInBytes(type, rightKey);
+	memcpy(separator, rightKey, separatorSize);
+	return separatorSize;
+}
 
-		// Pull in the updated footer
-		ret = fileHandle.readPage(page, pageBuffer);
-		RETURN_ON_ERR(ret);
-		
-		// Update the header of the page to point to this new entry
-		footer->firstRecord = newEntry;
-		memcpy(pageBuffer + PAGE_SIZE - sizeof(IX_PageIndexFooter), footer, sizeof(IX_PageIndexFooter));
+// Full copies of a page's entries in key order, used while a page is being split or given a new prefix
+struct IX_EntryList
+{
+	std::vector<char> data;
+	std::vector<unsigned> offsets;
+	std::vector<unsigned> lengths;
 
-		// Write the new page information to disk
-		ret = fileHandle.writePage(page, pageBuffer);
-		RETURN_ON_ERR(ret);
-	}
-	else
+	void add(const void* entry, unsigned length)
 	{
-		RID currRid = footer->firstRecord;
-		RID prevRid;
-		RID targetPrevRid;
-		RID targetRid = footer->firstRecord;
-		IndexRecord targetPrevEntry;
-		IndexRecord targetEntry;
-		IndexRecord currEntry;
-		IndexRecord prevEntry;
-
-		int numEntries = 0;
-		int target = 0;
-		while (currRid.pageNum > 0) 
-		{
-			// Pull in the next entry
-			ret = readRecord(fileHandle, recordDescriptor, currRid, &currEntry);
-			RETURN_ON_ERR(ret);
-
-			int compareResult = 0;
-			ret = keyData.compare(attribute.type, currEntry.key, compareResult);
-			RETURN_ON_ERR(ret);
-
-			numEntries++;
-            if (compareResult >= 0)
-			{
-				target = numEntries;
-				targetPrevRid = prevRid;
-				targetRid = currRid;
-				targetEntry = currEntry;
-				targetPrevEntry = prevEntry;
-			}
+		offsets.push_back(data.size());
+		lengths.push_back(length);
+		data.insert(data.end(), (const char*)entry, (const char*)entry + length);
+	}
 
-            // Update for next iteration
-            prevRid = currRid;
-            prevEntry = currEntry;
-            currRid = currEntry.nextSlot;
-		}
+	unsigned size() const { return offsets.size(); }
+	const char* get(unsigned i) const { return &data[offsets[i]]; }
+};
 
-		// Drop the record into the right spot in the on-page list
-		// atEnd = (target + 1) == numEntries;
-		bool atEnd = target == numEntries;
-		bool atStart = target == 0;
-		if (!atEnd && !atStart) // middle of list
+// Expand every entry on the page back out to its full key, with a new entry placed at position
+static void collectEntries(void* pageBuffer, unsigned position, const void* entry, unsigned entryLength, IX_EntryList& entries)
+{
+	const unsigned numSlots = IndexManager::getIXPageIndexFooter(pageBuffer)->numSlots;
+	char fullEntry[PAGE_SIZE];
+	for (unsigned i = 0; i <= numSlots; ++i)
+	{
+		if (i == position)
 		{
-			// Insert the new record into the root, and make it point to the current RID
-			leaf.nextSlot = targetEntry.nextSlot;
-			RID newEntry;
-			ret = insertRecordToPage(fileHandle, recordDescriptor, &leaf, page, newEntry);
-			RETURN_ON_ERR(ret);
-
-			// Update the previous entry to point to the new entry (it's in the middle now)
-			targetEntry.nextSlot = newEntry;
-			ret = updateRecord(fileHandle, recordDescriptor, &targetEntry, targetRid);
-			RETURN_ON_ERR(ret);
+			entries.add(entry, entryLength);
 		}
-		else if (atStart) // start of the list
-		{
-			// Insert the new record into the root, and make it point to the current RID
-			leaf.nextSlot = footer->firstRecord;
-			RID newEntry;
-			ret = insertRecordToPage(fileHandle, recordDescriptor, &leaf, page, newEntry);
-			RETURN_ON_ERR(ret);
-
-			// We are the beginning of the list, update the firstRecord slot to point here
-			ret = fileHandle.readPage(footer->pageNumber, pageBuffer);
-			RETURN_ON_ERR(ret);
 
-			// Update the header
-			footer->firstRecord = newEntry;
-			ret = fileHandle.writePage(footer->pageNumber, pageBuffer);
-			RETURN_ON_ERR(ret);
-		}
-		else // end of the list 
+		if (i < numSlots)
 		{
-			// Insert the new record into the root
-			RID newEntry;
-			ret = insertRecordToPage(fileHandle, recordDescriptor, &leaf, page, newEntry);
-			RETURN_ON_ERR(ret);
-
-			// Update the previous entry to point to the new entry
-			targetEntry.nextSlot = newEntry;
-			ret = updateRecord(fileHandle, recordDescriptor, &targetEntry, targetRid);
-			RETURN_ON_ERR(ret);
+			const unsigned length = IndexManager::readEntry(pageBuffer, i, fullEntry);
+			entries.add(fullEntry, length);
 		}
 	}
-
-	return rc::OK;
 }
 
-RC IndexManager::findNonLeafIndexEntry(FileHandle& fileHandle, IX_PageIndexFooter* footer, const Attribute &attribute, KeyValueData* key, PageNum& pageNum)
+// The prefix entries [begin, end) share, they are sorted so it is whatever the first and last have in common
+static unsigned sharedPrefixLength(AttrType type, const IX_EntryList& entries, unsigned headerSize, unsigned begin, unsigned end)
 {
-	RID targetRid, previousRid;
-	RC ret = findNonLeafIndexEntry(fileHandle, footer, attribute, key, targetRid, previousRid);
-	RETURN_ON_ERR(ret);
-
-	if (targetRid.pageNum == 0)
-	{
-		pageNum = footer->leftChild;
-	}
-	else
+	if (type != TypeVarChar || begin == end)
 	{
-		pageNum = targetRid.pageNum;
+		return 0;
 	}
 
-	return rc::OK;
+	return commonPrefixLength(entries.get(begin) + headerSize, entries.get(end - 1) + headerSize);
 }
 
-RC IndexManager::findNonLeafIndexEntry(FileHandle& fileHandle, IX_PageIndexFooter* footer, const Attribute &attribute, KeyValueData* key, RID& targetRid, RID& prevRid)
+// Bytes numEntries entries taking entriesSize with their slots use once the prefixLength they share is stored once
+static unsigned packedSize(unsigned entriesSize, unsigned numEntries, unsigned prefixLength)
 {
-	int compareResult = 1;
-	prevRid.slotNum = prevRid.pageNum = 0;
-	targetRid.slotNum = prevRid.slotNum = 0;
+	return entriesSize - numEntries * prefixLength + prefixLength;
+}
 
-	// Extract the first record
-	RID currRid = footer->firstRecord;
-	IndexRecord currEntry;
+// Bytes entries [begin, end) use on a page of their own, with their shared prefix stored once
+static unsigned packedSize(AttrType type, const IX_EntryList& entries, unsigned headerSize, unsigned begin, unsigned end)
+{
+	unsigned entriesSize = 0;
+	for (unsigned i = begin; i < end; ++i)
+	{
+		entriesSize += entries.lengths[i] + sizeof(IX_EntrySlot);
+	}
 
-	// Determine what type of record descriptor we need
-	const std::vector<Attribute>& recordDescriptor = getIndexRecordDescriptor(attribute.type);
+	return packedSize(entriesSize, end - begin, sharedPrefixLength(type, entries, headerSize, begin, end));
+}
 
-	// Is our comparision value less than all of the keys on this page?
-	assert(footer->numSlots >= 1);
-	RC ret = IndexManager::instance()->readRecord(fileHandle, recordDescriptor, currRid, &currEntry);
-	RETURN_ON_ERR(ret);
+// The split of entries where both halves fit on a page, each under its own prefix, and the left one holds as
+// close to leftFraction of the bytes as we can get, or -1 if there is none. 0.5 evens them out. For a non-leaf
+// the entry at the split goes up to the parent and is on neither page
+static int findSplit(AttrType type, const IX_EntryList& entries, bool isLeaf, float leftFraction)
+{
+	const unsigned headerSize = entryHeaderSize(isLeaf);
+	const unsigned numEntries = entries.size();
+	const int usableSpace = PAGE_SIZE - sizeof(IX_PageIndexFooter);
 
-	if (key)
+	unsigned totalSize = 0;
+	for (unsigned i = 0; i < numEntries; ++i)
 	{
-		ret = key->compare(attribute.type, currEntry.key, compareResult);
-		RETURN_ON_ERR(ret);
+		totalSize += entries.lengths[i] + sizeof(IX_EntrySlot);
 	}
 
-	if (compareResult < 0)
-	{
-		targetRid.pageNum = footer->leftChild;
-		targetRid.slotNum = 0;
-	}
-	else
+	// Keep a running sum of the left side so each candidate is sized in O(1), the shared prefixes only
+	// depend on the first and last entry of each side
+	int bestSplit = -1;
+	float bestBalance = 0;
+	unsigned leftEntriesSize = 0;
+	for (unsigned split = 1; split + (isLeaf ? 0 : 1) < numEntries; ++split)
 	{
-		// Traverse the list of index entries on this non-leaf page
-		while (currRid.pageNum > 0)
-		{
-			// Pull in the new entry and perform the comparison
-			RC ret = IndexManager::instance()->readRecord(fileHandle, recordDescriptor, currRid, &currEntry);
-			RETURN_ON_ERR(ret);
+		leftEntriesSize += entries.lengths[split - 1] + sizeof(IX_EntrySlot);
 
-			if (key)
-			{
-				ret = key->compare(attribute.type, currEntry.key, compareResult);
-				RETURN_ON_ERR(ret);
-			}
+		const unsigned rightBegin = isLeaf ? split : split + 1;
+		const unsigned rightEntriesSize = totalSize - leftEntriesSize - (isLeaf ? 0 : entries.lengths[split] + sizeof(IX_EntrySlot));
 
-			if (compareResult >= 0)
-			{
-				targetRid = currEntry.rid;
-			}
-			
-			currRid = currEntry.nextSlot;
+		const int leftSize = packedSize(leftEntriesSize, split, sharedPrefixLength(type, entries, headerSize, 0, split));
+		const int rightSize = packedSize(rightEntriesSize, numEntries - rightBegin, sharedPrefixLength(type, entries, headerSize, rightBegin, numEntries));
+
+		const float balance = fabs(leftSize - leftFraction * (leftSize + rightSize));
+		if (leftSize <= usableSpace && rightSize <= usableSpace && (bestSplit < 0 || balance < bestBalance))
+		{
+			bestSplit = split;
+			bestBalance = balance;
 		}
 	}
 
-	prevRid = currRid;
-	return rc::OK;
+	return bestSplit;
 }
 
-RC IndexManager::readRootPage(FileHandle& fileHandle, void* pageBuffer)
+// Strip the page prefix off a full entry, returns the length of what is left
+static unsigned packEntry(const void* entry, unsigned entryLength, unsigned headerSize, unsigned prefixLength, void* packed)
 {
-	IndexManager& im = *IndexManager::instance();
-	const std::string& filename = fileHandle.getFilename();
-	PageNum rootPage = 1;
-
-	// Do we have the root page number cached?
-	std::map<std::string, PageNum>::const_iterator finder = im._rootPageMap.find(filename);
-	if (finder == im._rootPageMap.end())
-	{
-		// We need to pull in the reserved page and read in the root
-		RC ret = fileHandle.readPage(0, pageBuffer);
-		RETURN_ON_ERR(ret);
-
-		// Place the root page data at the very end of the page
-		rootPage = *(unsigned*)((char*)pageBuffer + PAGE_SIZE - sizeof(unsigned));
-
-		// Save it to our cache for later
-		im._rootPageMap[filename] = rootPage;
-	}
-	else
+	if (prefixLength == 0)
 	{
-		// We had the value cached, use that
-		rootPage = finder->second;
+		memcpy(packed, entry, entryLength);
+		return entryLength;
 	}
-	
-	// Read in the root page to the given buffer
-	RC ret = fileHandle.readPage(rootPage, pageBuffer);
-	RETURN_ON_ERR(ret);
 
-	return rc::OK;
+	unsigned keySize;
+	memcpy(&keySize, (const char*)entry + headerSize, sizeof(unsigned));
+	keySize -= prefixLength;
+
+	// Anything after the key, the rest of a posting list, comes along as it is
+	memcpy(packed, entry, headerSize);
+	memcpy((char*)packed + headerSize, &keySize, sizeof(unsigned));
+	memcpy((char*)packed + headerSize + sizeof(unsigned), (const char*)entry + headerSize + sizeof(unsigned) + prefixLength, entryLength - headerSize - sizeof(unsigned) - prefixLength);
+	return entryLength - prefixLength;
 }
 
-RC IndexManager::findLargestLeafIndexEntry(FileHandle& fileHandle, const Attribute& attribute, RID& rid)
+// Put an already packed entry at position, the caller has made sure there is room past freeSpaceOffset
+static void placeEntry(void* pageBuffer, unsigned position, const void* entry, unsigned entryLength)
 {
-	// Pull in the root page
-	unsigned char pageBuffer[PAGE_SIZE] = {0};
-	RC ret = readRootPage(fileHandle, pageBuffer);
-	RETURN_ON_ERR(ret);
+	IX_PageIndexFooter* footer = IndexManager::getIXPageIndexFooter(pageBuffer);
 
-	// Extract the header
-	IX_PageIndexFooter* footer = getIXPageIndexFooter(pageBuffer);
-	const PageNum rootPageNum = footer->pageNumber;
+	// Shift the slots at and after our position down by one to open up the sorted position
+	assert(position <= footer->numSlots);
+	if (position < footer->numSlots)
+	{
+		memmove(IndexManager::getEntrySlot(pageBuffer, footer->numSlots), IndexManager::getEntrySlot(pageBuffer, footer->numSlots - 1), (footer->numSlots - position) * sizeof(IX_EntrySlot));
+	}
 
-	// Extract the first record
-	RID currRid = footer->firstRecord;
-	IndexRecord currEntry;
+	memcpy((char*)pageBuffer + footer->freeSpaceOffset, entry, entryLength);
 
-	// Determine what type of record descriptor we need
-	const std::vector<Attribute>& recordDescriptor = getIndexRecordDescriptor(attribute.type);
+	IX_EntrySlot* slot = IndexManager::getEntrySlot(pageBuffer, position);
+	slot->offset = footer->freeSpaceOffset;
+	slot->length = entryLength;
 
-	// Traverse down the tree to the rightmost leaf, using non-leaves along the way
-	PageNum currentPage = rootPageNum;
-	while (footer->isLeafPage == false)
-	{
-		ret = findNonLeafIndexEntry(fileHandle, footer, attribute, NULL, currentPage);
-		RETURN_ON_ERR(ret);
+	footer->freeSpaceOffset += entryLength;
+	footer->numSlots++;
+}
 
-		// Pull the designated page into memory and refresh the footer
-		memset(pageBuffer, 0, PAGE_SIZE);
-		ret = fileHandle.readPage(currentPage, pageBuffer);
-		RETURN_ON_ERR(ret);
-	}
+// Replace the page's entries with entries [begin, end), stored under the longest prefix they share.
+// The page is left alone if they don't fit
+static RC fillPage(void* pageBuffer, AttrType type, const IX_EntryList& entries, unsigned begin, unsigned end)
+{
+	unsigned char newPage[PAGE_SIZE] = {0};
+	IX_PageIndexFooter* footer = IndexManager::getIXPageIndexFooter(newPage);
+	*footer = *IndexManager::getIXPageIndexFooter(pageBuffer);
 
-	// We're at a leaf now...
-	assert(footer->isLeafPage);
+	const unsigned headerSize = entryHeaderSize(footer->isLeafPage);
+	if (packedSize(type, entries, headerSize, begin, end) > PAGE_SIZE - sizeof(IX_PageIndexFooter))
+	{
+		return rc::BTREE_INDEX_PAGE_FULL;
+	}
 
-	// Find the largest record on this leaf
-	currRid = footer->firstRecord;
-	RID largestRid = currRid;
+	footer->prefixLength = sharedPrefixLength(type, entries, headerSize, begin, end);
+	footer->freeSpaceOffset = footer->prefixLength;
+	footer->numSlots = 0;
+	footer->gapSize = 0;
+	if (footer->prefixLength > 0)
+	{
+		memcpy(newPage, entries.get(begin) + headerSize + sizeof(unsigned), footer->prefixLength);
+	}
 
-	while(currRid.pageNum != 0)
+	char packed[PAGE_SIZE];
+	for (unsigned i = begin; i < end; ++i)
 	{
-		largestRid = currRid;
+		const unsigned packedLength = packEntry(entries.get(i), entries.lengths[i], headerSize, footer->prefixLength, packed);
+		placeEntry(newPage, footer->numSlots, packed, packedLength);
+	}
 
-		// Pull in the record
-		RC ret = IndexManager::instance()->readRecord(fileHandle, recordDescriptor, currRid, &currEntry);
-		RETURN_ON_ERR(ret);
+	memcpy(pageBuffer, newPage, PAGE_SIZE);
+	return rc::OK;
+}
 
-		// Advance to the next record
-		currRid = currEntry.nextSlot;
+// Bytes the page would use with a new entry on it, after trimming the page prefix back to what the entry shares
+static unsigned usedSpaceWithEntry(void* pageBuffer, AttrType type, const void* entry, unsigned entryLength)
+{
+	IX_PageIndexFooter* footer = IndexManager::getIXPageIndexFooter(pageBuffer);
+	const unsigned usedSpace = PAGE_SIZE - sizeof(IX_PageIndexFooter) - IndexManager::getPageFreeSpace(pageBuffer);
+	if (type != TypeVarChar || footer->numSlots == 0)
+	{
+		return usedSpace + entryLength + sizeof(IX_EntrySlot);
 	}
 
-	// Return the largest record we found
-	rid = largestRid;
-
-	return rc::OK;
+	// Each entry gets back the characters the prefix loses, and the new entry drops the ones it keeps
+	const unsigned newPrefixLength = matchPagePrefix(pageBuffer, (const char*)entry + entryHeaderSize(footer->isLeafPage));
+	const unsigned lostLength = footer->prefixLength - newPrefixLength;
+	return usedSpace - lostLength + footer->numSlots * lostLength + entryLength - newPrefixLength + sizeof(IX_EntrySlot);
 }
 
-RC IndexManager::findSmallestLeafIndexEntry(FileHandle& fileHandle, RID& rid)
+static bool lessRid(const RID& lhs, const RID& rhs)
 {
-	// Begin at the root
-	char pageBuffer[PAGE_SIZE] = {0};
-	RC ret = readRootPage(fileHandle, pageBuffer);
-	RETURN_ON_ERR(ret);
+	return lhs.pageNum < rhs.pageNum || (lhs.pageNum == rhs.pageNum && lhs.slotNum < rhs.slotNum);
+}
 
-	// Extract the first record's leftChild
-	IX_PageIndexFooter* footer = IndexManager::getIXPageIndexFooter(pageBuffer);
-	PageNum leftChild = footer->leftChild;
+// Most bytes one RID after the first takes in a posting list, two varints of up to 5 bytes
+static const unsigned IX_MAX_RID_DELTA_SIZE = 10;
 
-	// Continue down all leftChild pointers until we hit a leaf
-	while(leftChild != 0 && !footer->isLeafPage)
+static unsigned writeVarint(unsigned value, unsigned char* out)
+{
+	unsigned length = 0;
+	while (value >= 0x80)
 	{
-		// Load in the next page
-		ret = fileHandle.readPage(leftChild, pageBuffer);
-		RETURN_ON_ERR(ret);
-
-		leftChild = footer->leftChild;
+		out[length++] = (value & 0x7f) | 0x80;
+		value >>= 7;
 	}
 
-	// If we didn't find a leaf, our BTree was corrupted
-	if (!footer->isLeafPage)
+	out[length++] = value;
+	return length;
+}
+
+static unsigned readVarint(const unsigned char* in, unsigned& value)
+{
+	unsigned length = 0;
+	value = 0;
+	do
 	{
-		return rc::BTREE_CANNOT_FIND_LEAF;
-	}
+		value |= (in[length] & 0x7f) << (7 * length);
+	} while (in[length++] & 0x80);
 
-	// Walk the leaf list until we hit a non-deleted item
-	rid = footer->firstRecord;
-	if (rid.pageNum == 0) return -1; // this should be removed
+	return length;
+}
 
-	// @TAMIR
-	// while (rid.pageNum == 0)
-	// {
-		// TODO: we need to walk the entire list here, which means we need the index attribute type passed in
-		// TODO: if we walk every leaf and don't find an entry, then we return an error
-	// }
+// A RID after the one before it in a posting list is the page difference, then the slot difference on the
+// same page or the slot itself on a later page
+static unsigned writeRidDelta(const RID& previous, const RID& rid, unsigned char* out)
+{
+	const unsigned pageDelta = rid.pageNum - previous.pageNum;
+	const unsigned length = writeVarint(pageDelta, out);
+	return length + writeVarint(pageDelta == 0 ? rid.slotNum - previous.slotNum : rid.slotNum, out + length);
+}
 
-	return rc::OK;
+// Where the RIDs after the first start in a full leaf entry
+static unsigned postingOffset(AttrType type, const void* entry)
+{
+	return sizeof(RID) + Attribute::sizeInBytes(type, (const char*)entry + sizeof(RID));
 }
 
-RC IndexManager::findIndexEntry(FileHandle& fileHandle, const Attribute &attribute, KeyValueData* keyData, RID& entryRid, RID& prevEntryRid, RID& nextEntryRid, RID& dataRid)
+void IndexManager::decodePosting(AttrType type, const void* entry, unsigned entryLength, std::vector<RID>& rids)
 {
-	// Pull in the root page
-	unsigned char pageBuffer[PAGE_SIZE] = {0};
-	RC ret = readRootPage(fileHandle, pageBuffer);
-	RETURN_ON_ERR(ret);
+	RID rid;
+	memcpy(&rid, entry, sizeof(RID));
+	rids.assign(1, rid);
 
-	// Extract the header
-	IX_PageIndexFooter* footer = getIXPageIndexFooter(pageBuffer);
-	const PageNum rootPageNum = footer->pageNumber;
-	
-	// Traverse down the tree to the leaf, using non-leaves along the way
-	PageNum nextPage = rootPageNum;
-	while (footer->isLeafPage == false)
+	const unsigned char* in = (const unsigned char*)entry + postingOffset(type, entry);
+	const unsigned char* end = (const unsigned char*)entry + entryLength;
+	while (in < end)
 	{
-		ret = findNonLeafIndexEntry(fileHandle, footer, attribute, keyData, nextPage);
-		RETURN_ON_ERR(ret);
+		unsigned pageDelta, slot;
+		in += readVarint(in, pageDelta);
+		in += readVarint(in, slot);
 
-		// Pull the designated page into memory
-		memset(pageBuffer, 0, PAGE_SIZE);
-		ret = fileHandle.readPage(nextPage, pageBuffer);
-		RETURN_ON_ERR(ret);
+		rid.slotNum = (pageDelta == 0) ? rid.slotNum + slot : slot;
+		rid.pageNum += pageDelta;
+		rids.push_back(rid);
 	}
-
-	// Now search along the leaf page
-	assert(footer->isLeafPage);
-	ret = findLeafIndexEntry(fileHandle, footer, attribute, keyData, entryRid, prevEntryRid, nextEntryRid, dataRid);
-	
-	// Allow this find to fail, this just means we will return the closest entry
-	return ret;
 }
 
-RC IndexManager::findLeafIndexEntry(FileHandle& fileHandle, IX_PageIndexFooter* footer, const Attribute &attribute, KeyValueData* key, RID& entryRid, RID& dataRid)
+unsigned IndexManager::encodePosting(AttrType type, const std::vector<RID>& rids, void* entry)
 {
-	RID nextEntryRid;
-	RID prevEntryRid;
-	return findLeafIndexEntry(fileHandle, footer, attribute, key, entryRid, prevEntryRid, nextEntryRid, dataRid);
-}
+	memcpy(entry, &rids.front(), sizeof(RID));
 
-RC IndexManager::findLeafIndexEntry(FileHandle& fileHandle, const Attribute &attribute, KeyValueData* key, RID& entryRid, RID& prevEntryRid, RID& nextEntryRid, RID& dataRid)
-{
-	// Begin at the root
-	char pageBuffer[PAGE_SIZE] = {0};
-	RC ret = readRootPage(fileHandle, pageBuffer);
-	RETURN_ON_ERR(ret);
+	unsigned length = postingOffset(type, entry);
+	for (unsigned i = 1; i < rids.size(); ++i)
+	{
+		length += writeRidDelta(rids[i - 1], rids[i], (unsigned char*)entry + length);
+	}
 
-	IX_PageIndexFooter* footer = IndexManager::getIXPageIndexFooter(pageBuffer);
-	return findLeafIndexEntry(fileHandle, footer, attribute, key, entryRid, prevEntryRid, nextEntryRid, dataRid);
+	return length;
 }
 
-RC IndexManager::findLeafIndexEntry(FileHandle& fileHandle, IX_PageIndexFooter* footer, const Attribute &attribute, KeyValueData* key, RID& entryRid, RID& prevEntryRid, RID& nextEntryRid, RID& dataRid)
+// If the entry before position holds key and has room for one more RID, leave it in entry with rid added.
+// The caller takes the old entry off the page, and puts the new one in its place
+static bool mergeIntoPosting(void* pageBuffer, AttrType type, const IX_KeyOps& keyOps, const void* key, const RID& rid, unsigned position, void* entry, unsigned& entryLength)
 {
-	assert(&entryRid != &prevEntryRid);
-	assert(&entryRid != &nextEntryRid);
-	assert(&nextEntryRid != &prevEntryRid);
-
-	int compareResult = -1;
+	if (position == 0 || keyOps.compareEntryKey(pageBuffer, position - 1, key) != 0)
+	{
+		return false;
+	}
 
-	// zero out RID data 
-	entryRid.pageNum = entryRid.slotNum = 0;
-	prevEntryRid.pageNum = prevEntryRid.slotNum = 0;
-	nextEntryRid.pageNum = nextEntryRid.slotNum = 0;
-	dataRid.pageNum = dataRid.slotNum = 0;
+	char posting[PAGE_SIZE];
+	const unsigned postingLength = IndexManager::readEntry(pageBuffer, position - 1, posting);
+	if (postingLength + IX_MAX_RID_DELTA_SIZE > IX_MAX_ENTRY_SIZE)
+	{
+		return false;
+	}
 
-	// Extract the first record
-	RID currRid = footer->firstRecord;
-	IndexRecord currEntry;
+	std::vector<RID> rids;
+	IndexManager::decodePosting(type, posting, postingLength, rids);
+	rids.insert(std::upper_bound(rids.begin(), rids.end(), rid, lessRid), rid);
+	entryLength = IndexManager::encodePosting(type, rids, posting);
+	memcpy(entry, posting, entryLength);
+	return true;
+}
 
-	// Determine what type of record descriptor we need
-	const std::vector<Attribute>& recordDescriptor = getIndexRecordDescriptor(attribute.type);
+RC IndexManager::insertEntry(FileHandle &fileHandle, const Attribute &attribute, const void *key, const RID &rid)
+{
+	const unsigned keySize = Attribute::sizeInBytes(attribute.type, key);
+	if (keySize == 0)
+	{
+		return rc::ATTRIBUTE_INVALID_TYPE;
+	}
 
-	// Traverse the list of index entries on this leaf page
-	while (currRid.pageNum > 0)
+	if (sizeof(RID) + keySize > IX_MAX_ENTRY_SIZE)
 	{
-		// Pull in the new entry and perform the comparison
-		RC ret = IndexManager::instance()->readRecord(fileHandle, recordDescriptor, currRid, &currEntry);
-		RETURN_ON_ERR(ret);
+		return rc::BTREE_KEY_TOO_LARGE;
+	}
 
-		ret = key->compare(attribute.type, currEntry.key, compareResult);
-		RETURN_ON_ERR(ret);
+	// Build the leaf entry
+	char entry[PAGE_SIZE];
+	unsigned entryLength = sizeof(RID) + keySize;
+	memcpy(entry, &rid, sizeof(RID));
+	memcpy(entry + sizeof(RID), key, keySize);
 
-		// If we have a match, save it and return OK, otherwise keep traversing the entries on the leaf page
-		if (compareResult == 0)
-		{
-			entryRid = currRid;
-			dataRid = currEntry.rid;
-			break;
-		}
-		else if (compareResult < 0)
+	unsigned char pageBuffer[PAGE_SIZE] = {0};
+	IX_PageIndexFooter* footer = getIXPageIndexFooter(pageBuffer);
+	const IX_KeyOps& keyOps = getKeyOps(attribute.type);
+	IX_IndexFile& indexFile = getIndexFile(fileHandle);
+
+	// Keys that keep going up land on the rightmost leaf every time, so while they do we latch that leaf
+	// without coming down from the root. Any key at or past its first entry belongs there
+	bool appendLeafFull = false;
+	const PageNum appendLeaf = indexFile.getAppendLeaf();
+	if (appendLeaf != 0)
+	{
+		IX_LatchSet latches;
+		latches.acquire(fileHandle, appendLeaf, true);
+		RC ret = fileHandle.readPage(appendLeaf, pageBuffer);
+		if (ret == rc::OK && footer->isLeafPage && !footer->isFreePage && footer->nextLeafPage == 0 &&
+			footer->numSlots > 0 && keyOps.compareEntryKey(pageBuffer, 0, key) <= 0)
 		{
-			// We are searching for something that is smaller than anything on this leaf, return the current and error out
-			entryRid = currRid;
-			dataRid = currEntry.rid;
+			unsigned position = keyOps.findEntryPosition(pageBuffer, key, true);
+			if (mergeIntoPosting(pageBuffer, attribute.type, keyOps, key, rid, position, entry, entryLength))
+				removeFromPage(pageBuffer, --position);
 
-			currRid.pageNum = 0;
-			break;
+			ret = insertIntoPage(pageBuffer, attribute.type, position, entry, entryLength);
+			if (ret == rc::OK)
+			{
+				return fileHandle.writePage(appendLeaf, pageBuffer);
+			}
+			else if (ret != rc::BTREE_INDEX_PAGE_FULL)
+			{
+				return ret;
+			}
+
+			// It has to split, which the optimistic descent can't do either
+			appendLeafFull = true;
 		}
 		else
 		{
-			prevEntryRid = currRid;
-			currRid = currEntry.nextSlot;
+			indexFile.setAppendLeaf(0);
 		}
 	}
 
-	// Check to see if we traverse the list entirely, in which case the last index entry 
-	// contains the page pointer to which we point
-	if (currRid.pageNum == 0)
-	{
-		cout << "currRid pageNum == 0" << endl;
-		return rc::BTREE_INDEX_LEAF_ENTRY_NOT_FOUND;
-	}
-	else
+	// Most inserts fit on their leaf, so first go down under shared latches and only write latch the leaf.
+	// A key already on the leaf takes the RID into its last posting list, rather than a new entry
+	if (!appendLeafFull)
 	{
-		// Pull in the next RID after our current one
-		nextEntryRid = currEntry.nextSlot;
+		entryLength = sizeof(RID) + keySize;
+		memcpy(entry, &rid, sizeof(RID));
+		memcpy(entry + sizeof(RID), key, keySize);
 
-		return rc::OK;
+		IX_LatchSet latches;
+		std::vector<IX_PathEntry> parents;
+		RC ret = descendToLeaf(fileHandle, attribute, key, true, IX_DESCENT_OPTIMISTIC, pageBuffer, parents, latches);
+		RETURN_ON_ERR(ret);
+
+		unsigned position = keyOps.findEntryPosition(pageBuffer, key, true);
+		if (mergeIntoPosting(pageBuffer, attribute.type, keyOps, key, rid, position, entry, entryLength))
+			removeFromPage(pageBuffer, --position);
+
+		ret = insertIntoPage(pageBuffer, attribute.type, position, entry, entryLength);
+		if (ret == rc::OK)
+		{
+			indexFile.setAppendLeaf(footer->nextLeafPage == 0 ? footer->pageNumber : 0);
+			return fileHandle.writePage(footer->pageNumber, pageBuffer);
+		}
+		else if (ret != rc::BTREE_INDEX_PAGE_FULL)
+		{
+			return ret;
+		}
 	}
-}
 
-RC IndexManager::deletelessSplit(FileHandle& fileHandle, const std::vector<Attribute>& recordDescriptor, PageNum& targetPageNum, PageNum& newPageNum, RID& rightRid, KeyValueData& rightKey)
-{
-	// Read in the page to be split
-	unsigned char inputBuffer[PAGE_SIZE] = {0};
-	RC ret = fileHandle.readPage(targetPageNum, inputBuffer);
-	IX_PageIndexFooter* inputFooter = getIXPageIndexFooter(inputBuffer);
-	const bool isLeaf = inputFooter->isLeafPage;
+	// The leaf has to split, so go down again holding every page the split could reach, keeping track
+	// of the path so the splits can be pushed back up
+	IX_LatchSet latches;
+	std::vector<IX_PathEntry> parents;
+	RC ret = descendToLeaf(fileHandle, attribute, key, true, IX_DESCENT_INSERT, pageBuffer, parents, latches);
 	RETURN_ON_ERR(ret);
 
-	// Allocate the new page and save its reference
-	newPageNum = fileHandle.getNumberOfPages();
-	rightRid.pageNum = newPageNum;
-	ret = newPage(fileHandle, newPageNum, isLeaf, inputFooter->nextLeafPage, 0);
-	RETURN_ON_ERR(ret);
+	entryLength = sizeof(RID) + keySize;
+	memcpy(entry, &rid, sizeof(RID));
+	memcpy(entry + sizeof(RID), key, keySize);
 
-	// Clear out the old page data
-	ret = newPage(fileHandle, targetPageNum, isLeaf, newPageNum, inputFooter->leftChild);
-	RETURN_ON_ERR(ret);
+	unsigned position = keyOps.findEntryPosition(pageBuffer, key, true);
+	if (mergeIntoPosting(pageBuffer, attribute.type, keyOps, key, rid, position, entry, entryLength))
+		removeFromPage(pageBuffer, --position);
 
-	// Setup buffers for left/right page outputs
-	unsigned char leftBuffer[PAGE_SIZE] = {0};
-	unsigned char rightBuffer[PAGE_SIZE] = {0};
-	IX_PageIndexFooter* leftFooter = getIXPageIndexFooter(leftBuffer);
-	IX_PageIndexFooter* rightFooter = getIXPageIndexFooter(rightBuffer);
+	const float splitFillFactor = indexFile.getSplitFillFactor();
+	while (true)
+	{
+		ret = insertIntoPage(pageBuffer, attribute.type, position, entry, entryLength);
+		if (ret == rc::OK)
+		{
+			if (footer->isLeafPage)
+				indexFile.setAppendLeaf(footer->nextLeafPage == 0 ? footer->pageNumber : 0);
 
-	ret = fileHandle.readPage(targetPageNum, leftBuffer);
-	RETURN_ON_ERR(ret);
+			return fileHandle.writePage(footer->pageNumber, pageBuffer);
+		}
+		else if (ret != rc::BTREE_INDEX_PAGE_FULL)
+		{
+			return ret;
+		}
 
-	ret = fileHandle.readPage(newPageNum, rightBuffer);
-	RETURN_ON_ERR(ret);
+		// No room, split the page with the new entry in it and push the separator up a level. Appending to
+		// the right edge of the tree leaves the left page full, nothing will be inserted into it again
+		bool rightEdge = position == footer->numSlots;
+		for (unsigned i = 0; i < parents.size(); ++i)
+		{
+			rightEdge = rightEdge && parents[i].lastChild;
+		}
 
-	// sanity check...
-	if (isLeaf)
-	{
-		assert(leftFooter->nextLeafPage == newPageNum);
-		assert(rightFooter->nextLeafPage == inputFooter->nextLeafPage);
-		assert(leftFooter->isLeafPage == true);
-		assert(rightFooter->isLeafPage == true);
-		leftFooter->nextLeafPage = newPageNum;
-		rightFooter->nextLeafPage = inputFooter->nextLeafPage;
-		leftFooter->isLeafPage = true;
-		rightFooter->isLeafPage = true; 
+		const bool isLeaf = footer->isLeafPage;
+		const PageNum leftPage = footer->pageNumber;
+		PageNum rightPage = 0;
+		char separator[PAGE_SIZE];
+		unsigned separatorLength = 0;
+		ret = splitPage(fileHandle, pageBuffer, attribute.type, position, entry, entryLength, rightEdge ? 1.0f : splitFillFactor, rightPage, separator, separatorLength);
+		RETURN_ON_ERR(ret);
+
+		if (isLeaf)
+			indexFile.setAppendLeaf(rightEdge ? rightPage : 0);
+
+		entryLength = sizeof(PageNum) + separatorLength;
+		memcpy(entry, &rightPage, sizeof(PageNum));
+		memcpy(entry + sizeof(PageNum), separator, separatorLength);
+
+		if (parents.empty())
+		{
+			// We split the root, so grow by one level
+			PageNum newRootPage = 0;
+			ret = allocatePage(fileHandle, newRootPage);
+			RETURN_ON_ERR(ret);
+
+			ret = newPage(fileHandle, newRootPage, false, 0, leftPage);
+			RETURN_ON_ERR(ret);
+
+			ret = updateRootPage(fileHandle, newRootPage);
+			RETURN_ON_ERR(ret);
+
+			initPage(pageBuffer, newRootPage, false, 0, leftPage);
+			position = 0;
+		}
+		else
+		{
+			// The new right page goes directly after the child we came down through
+			ret = fileHandle.readPage(parents.back().pageNum, pageBuffer);
+			RETURN_ON_ERR(ret);
+
+			position = parents.back().childIndex;
+			parents.pop_back();
+		}
+	}
+}
+
+static bool isUnderfull(void* pageBuffer)
+{
+	const unsigned usableSpace = PAGE_SIZE - sizeof(IX_PageIndexFooter);
+	const unsigned usedSpace = usableSpace - IndexManager::getPageFreeSpace(pageBuffer) - IndexManager::getIXPageIndexFooter(pageBuffer)->gapSize;
+	return usedSpace < usableSpace * IX_MIN_FILL_FACTOR;
+}
+
+RC IndexManager::deleteEntry(FileHandle &fileHandle, const Attribute &attribute, const void *key, const RID &rid)
+{
+	// Shared latches and a write latch on the leaf do unless the leaf underflows. Rebalancing needs the
+	// pages above it that could underflow too, and following duplicates on to later leaves needs the whole path
+	const IX_DescentMode modes[] = { IX_DESCENT_OPTIMISTIC, IX_DESCENT_DELETE, IX_DESCENT_EXCLUSIVE };
+	for (unsigned i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i)
+	{
+		bool retry = false;
+		RC ret = removeEntry(fileHandle, attribute, key, rid, modes[i], retry);
+		if (!retry)
+		{
+			return ret;
+		}
 	}
 
-	// Verify new pages are correct with leaf status
-	assert(rightFooter->isLeafPage == isLeaf && leftFooter->isLeafPage == isLeaf);
+	assert(false);
+	return rc::BTREE_INDEX_LEAF_ENTRY_NOT_FOUND;
+}
+
+RC IndexManager::removeEntry(FileHandle& fileHandle, const Attribute& attribute, const void* key, const RID& rid, IX_DescentMode mode, bool& retry)
+{
+	retry = false;
+
+	// Find the first leaf which might hold the key, remembering the way down in case it needs rebalancing
+	IX_LatchSet latches;
+	unsigned char pageBuffer[PAGE_SIZE] = {0};
+	std::vector<IX_PathEntry> parents;
+	RC ret = descendToLeaf(fileHandle, attribute, key, false, mode, pageBuffer, parents, latches);
+	RETURN_ON_ERR(ret);
 
-	// Determine how many to move...
-	IndexRecord tempRecord;
-	RID curRid = inputFooter->firstRecord;
-	int totalSize = 0;
-	int totalEntries = 0;
-	while (curRid.pageNum > 0)
+	IX_PageIndexFooter* footer = getIXPageIndexFooter(pageBuffer);
+
+	// Duplicates may run across several posting lists and leaves, so walk right until we pass the key
+	const IX_KeyOps& keyOps = getKeyOps(attribute.type);
+	unsigned position = keyOps.findEntryPosition(pageBuffer, key, false);
+	char entry[PAGE_SIZE];
+	std::vector<RID> rids;
+	while (true)
 	{
-		ret = readRecord(fileHandle, recordDescriptor, curRid, &tempRecord, inputBuffer);
-		RETURN_ON_ERR(ret);
-		totalSize += calcRecordSize((unsigned char*)(&tempRecord));
-		curRid = tempRecord.nextSlot;
-		totalEntries++;
-	}
-
-	// Read in records and write to the left page until we hit half of the page full
-	// IndexRecord tempRecord;
-	unsigned currentSize = sizeof(IX_PageIndexFooter);
-	unsigned slotNum = 0;
-	RID lastLeftRid, prevRid = inputFooter->firstRecord;
-	curRid = inputFooter->firstRecord;
-	int skipped = 0;
-	const int maxNumToSkip = totalEntries - 1;
-	bool done = false;
-
-	while (!done)
-	{
-		// Read in the record from our input buffer
-		prevRid = curRid;
-		ret = readRecord(fileHandle, recordDescriptor, curRid, &tempRecord, inputBuffer);
-		RETURN_ON_ERR(ret);
-		skipped++;
-
-		// Compute the record length and add it to the running total
-		unsigned recLength = 0;
-		unsigned recHeaderSize = 0;
-		unsigned* recHeader = NULL;
-		ret = generateRecordHeader(recordDescriptor, &tempRecord, recHeader, recLength, recHeaderSize);
-		free(recHeader);
-		RETURN_ON_ERR(ret);
+		for (; position < footer->numSlots; ++position)
+		{
+			if (keyOps.compareEntryKey(pageBuffer, position, key) != 0)
+			{
+				return rc::BTREE_INDEX_LEAF_ENTRY_NOT_FOUND;
+			}
+
+			unsigned entryLength = readEntry(pageBuffer, position, entry);
+			decodePosting(attribute.type, entry, entryLength, rids);
+			std::vector<RID>::iterator found = std::lower_bound(rids.begin(), rids.end(), rid, lessRid);
+			if (found != rids.end() && found->pageNum == rid.pageNum && found->slotNum == rid.slotNum)
+			{
+				// The last RID takes the entry with it, otherwise the smaller entry always fits back where it was
+				removeFromPage(pageBuffer, position);
+				rids.erase(found);
+				if (!rids.empty())
+				{
+					entryLength = encodePosting(attribute.type, rids, entry);
+					ret = insertIntoPage(pageBuffer, attribute.type, position, entry, entryLength);
+					RETURN_ON_ERR(ret);
+				}
 
-		currentSize += recLength + sizeof(PageIndexSlot);
+				if (mode == IX_DESCENT_OPTIMISTIC)
+				{
+					if (!parents.empty() && isUnderfull(pageBuffer))
+					{
+						retry = true;
+						return rc::OK;
+					}
 
-		// Advance to next record
-		curRid = tempRecord.nextSlot;
-		++slotNum;
+					return fileHandle.writePage(footer->pageNumber, pageBuffer);
+				}
 
-		if (currentSize >= PAGE_SIZE/2)
-			done = true;
-		else if (skipped >= maxNumToSkip)
-			done = true;
+				return rebalance(fileHandle, attribute.type, pageBuffer, parents, latches);
+			}
+		}
 
-		// We know what the slot numbers will be because the page is empty initially
-		if (done || curRid.pageNum == 0)
+		if (footer->nextLeafPage == 0)
 		{
-			tempRecord.nextSlot.pageNum = 0;
-			tempRecord.nextSlot.slotNum = 0;
+			return rc::BTREE_INDEX_LEAF_ENTRY_NOT_FOUND;
 		}
-		else
+
+		if (mode != IX_DESCENT_EXCLUSIVE)
 		{
-			tempRecord.nextSlot.pageNum = leftFooter->pageNumber;
-			tempRecord.nextSlot.slotNum = slotNum;
+			retry = true;
+			return rc::OK;
 		}
 
-		// Copy over the record to the new left page buffer
-		ret = insertRecordInplace(recordDescriptor, &tempRecord, leftFooter->pageNumber, leftBuffer, lastLeftRid);
+		ret = nextLeafPath(fileHandle, pageBuffer, parents, latches);
 		RETURN_ON_ERR(ret);
+		position = 0;
+	}
+}
+
+// Whether a page on the way down can absorb whatever the operation does below it, so the latches above it can go
+static bool isSafe(IX_DescentMode mode, void* pageBuffer, bool isRoot)
+{
+	IX_PageIndexFooter* footer = IndexManager::getIXPageIndexFooter(pageBuffer);
+	switch (mode)
+	{
+		case IX_DESCENT_OPTIMISTIC:
+			return true;
+
+		case IX_DESCENT_INSERT:
+		{
+			// Room for the largest entry, even if its key trims the page prefix and spreads every entry back out
+			const unsigned available = IndexManager::getPageFreeSpace(pageBuffer) + footer->gapSize;
+			return available >= IX_MAX_ENTRY_SIZE + sizeof(IX_EntrySlot) + (footer->numSlots + 1) * footer->prefixLength;
+		}
+
+		case IX_DESCENT_DELETE:
+		{
+			// The root can lose anything but its last separator, any other page must stay above the fill floor
+			if (isRoot)
+			{
+				return footer->isLeafPage || footer->numSlots > 1;
+			}
+
+			const unsigned usableSpace = PAGE_SIZE - sizeof(IX_PageIndexFooter);
+			const unsigned usedSpace = usableSpace - IndexManager::getPageFreeSpace(pageBuffer) - footer->gapSize;
+			return usedSpace >= usableSpace * IX_MIN_FILL_FACTOR + IX_MAX_ENTRY_SIZE + sizeof(IX_EntrySlot);
+		}
+
+		case IX_DESCENT_EXCLUSIVE:
+			return false;
 	}
 
-	// Save the 1st key that will be on the right page for later
-	const RID firstRightPageRid = curRid;
+	return false;
+}
+
+RC IndexManager::descendToLeaf(FileHandle& fileHandle, const Attribute& attribute, const void* key, bool upperBound, IX_DescentMode mode, void* pageBuffer, std::vector<IX_PathEntry>& parents, IX_LatchSet& latches)
+{
+	// The reserved page latch guards the root page number, so we hold it until the root is latched
+	const bool exclusive = mode >= IX_DESCENT_INSERT;
+	latches.acquire(fileHandle, 0, exclusive);
 
-	ret = readRecord(fileHandle, recordDescriptor, firstRightPageRid, &tempRecord, inputBuffer);
+	PageNum pageNum = 0;
+	RC ret = getRootPage(fileHandle, pageNum);
 	RETURN_ON_ERR(ret);
-	memcpy(&rightKey, &tempRecord.key, sizeof(rightKey));
 
-	// Read in the first entry in the second half - this entry now points to the left
-	if (!isLeaf)
+	IX_IndexFile& indexFile = getIndexFile(fileHandle);
+	IX_PageIndexFooter* footer = getIXPageIndexFooter(pageBuffer);
+	const IX_KeyOps& keyOps = getKeyOps(attribute.type);
+	while (true)
+	{
+		// Nobody can be writing a page we hold shared, so the node cache is good for it
+		latches.acquire(fileHandle, pageNum, exclusive);
+		IX_Latch* latch = indexFile.getLatch(pageNum);
+		const unsigned version = exclusive ? 0 : latch->readVersion();
+		ret = exclusive ? fileHandle.readPage(pageNum, pageBuffer) : readNodePage(fileHandle, indexFile, pageNum, version, pageBuffer);
+		RETURN_ON_ERR(ret);
+
+		if (mode == IX_DESCENT_OPTIMISTIC && footer->isLeafPage)
+		{
+			// Our shared latch on the parent keeps the leaf from splitting or merging while we trade up.
+			// What we read is still good unless another writer got to the leaf in between
+			latches.releaseLast();
+			latches.acquire(fileHandle, pageNum, true);
+			if (!latch->validate(version + 1))
+			{
+				ret = fileHandle.readPage(pageNum, pageBuffer);
+				RETURN_ON_ERR(ret);
+			}
+		}
+
+		if (isSafe(mode, pageBuffer, parents.empty()))
+		{
+			latches.releaseAncestors();
+		}
+
+		if (footer->isLeafPage)
+		{
+			return rc::OK;
+		}
+
+		IX_PathEntry step;
+		step.pageNum = pageNum;
+		step.childIndex = keyOps.findEntryPosition(pageBuffer, key, upperBound);
+		step.lastChild = step.childIndex == footer->numSlots;
+		parents.push_back(step);
+
+		pageNum = getChildPage(pageBuffer, step.childIndex);
+	}
+}
+
+RC IndexManager::nextLeafPath(FileHandle& fileHandle, void* pageBuffer, std::vector<IX_PathEntry>& parents, IX_LatchSet& latches)
+{
+	// Climb until a parent has another child to the right of the one we came down through
+	unsigned char parentBuffer[PAGE_SIZE];
+	while (true)
 	{
-		// Load in the entry
-		ret = readRecord(fileHandle, recordDescriptor, curRid, &tempRecord, inputBuffer);
+		if (parents.empty())
+		{
+			return rc::BTREE_CANNOT_FIND_LEAF;
+		}
+
+		RC ret = fileHandle.readPage(parents.back().pageNum, parentBuffer);
 		RETURN_ON_ERR(ret);
 
-		// Copy over the page pointer into the footer
-		rightFooter->leftChild = tempRecord.rid.pageNum;
-		curRid = tempRecord.nextSlot;
+		if (parents.back().childIndex < getIXPageIndexFooter(parentBuffer)->numSlots)
+			break;
+
+		parents.pop_back();
 	}
 
-	// The currRid variable now points to the correct spot in the list from which we should start moving
-	// Move the rest over to the new page
-	currentSize = sizeof(IX_PageIndexFooter);
-	slotNum = 0;
-	RID lastRightRid;
-	while (curRid.pageNum > 0)
+	// Then take that child and follow the left edge down from it, we already hold every page above it
+	++parents.back().childIndex;
+	parents.back().lastChild = parents.back().childIndex == getIXPageIndexFooter(parentBuffer)->numSlots;
+	PageNum pageNum = getChildPage(parentBuffer, parents.back().childIndex);
+	IX_PageIndexFooter* footer = getIXPageIndexFooter(pageBuffer);
+	while (true)
 	{
-		prevRid = curRid;
+		latches.acquire(fileHandle, pageNum, true);
+		RC ret = fileHandle.readPage(pageNum, pageBuffer);
+		RETURN_ON_ERR(ret);
 
-		// Read in the record from our input buffer
-		ret = readRecord(fileHandle, recordDescriptor, curRid, &tempRecord, inputBuffer);
+		if (footer->isLeafPage)
+			break;
+
+		IX_PathEntry step;
+		step.pageNum = pageNum;
+		step.childIndex = 0;
+		step.lastChild = footer->numSlots == 0;
+		parents.push_back(step);
+		pageNum = footer->leftChild;
+	}
+
+	return rc::OK;
+}
+
+RC IndexManager::rebalance(FileHandle& fileHandle, AttrType type, void* pageBuffer, std::vector<IX_PathEntry>& parents, IX_LatchSet& latches)
+{
+	// pageBuffer always holds a changed page that still needs writing, starting with the leaf we deleted from
+	IX_PageIndexFooter* footer = getIXPageIndexFooter(pageBuffer);
+	RC ret = rc::OK;
+	while (!parents.empty() && isUnderfull(pageBuffer))
+	{
+		const IX_PathEntry step = parents.back();
+		unsigned char parentBuffer[PAGE_SIZE];
+		ret = fileHandle.readPage(step.pageNum, parentBuffer);
 		RETURN_ON_ERR(ret);
 
-		// Compute the record length and add it to the running total
-		unsigned recLength = 0;
-		unsigned recHeaderSize = 0;
-		unsigned* recHeader = NULL;
-		ret = generateRecordHeader(recordDescriptor, &tempRecord, recHeader, recLength, recHeaderSize);
-		free(recHeader);
+		IX_PageIndexFooter* parentFooter = getIXPageIndexFooter(parentBuffer);
+		if (parentFooter->numSlots == 0)
+		{
+			break;
+		}
+
+		// Pair up with the right sibling when there is one, so our page keeps its entries where they are
+		const bool isLeft = step.childIndex < parentFooter->numSlots;
+		const unsigned separatorPosition = isLeft ? step.childIndex : step.childIndex - 1;
+
+		// We hold the parent, so the only others on the sibling are scans passing through
+		const PageNum siblingPage = getChildPage(parentBuffer, isLeft ? step.childIndex + 1 : step.childIndex - 1);
+		latches.acquire(fileHandle, siblingPage, true);
+
+		unsigned char siblingBuffer[PAGE_SIZE];
+		ret = fileHandle.readPage(siblingPage, siblingBuffer);
 		RETURN_ON_ERR(ret);
 
-		currentSize += recLength + sizeof(PageIndexSlot);
+		void* leftBuffer = isLeft ? pageBuffer : (void*)siblingBuffer;
+		void* rightBuffer = isLeft ? (void*)siblingBuffer : pageBuffer;
+		IX_PageIndexFooter* leftFooter = getIXPageIndexFooter(leftBuffer);
+		IX_PageIndexFooter* rightFooter = getIXPageIndexFooter(rightBuffer);
+		const bool isLeaf = leftFooter->isLeafPage;
+		const PageNum rightPage = rightFooter->pageNumber;
+		const unsigned leftCount = leftFooter->numSlots;
+
+		// Everything under both pages in key order, a non-leaf also pulls down the separator between them
+		IX_EntryList entries;
+		char entry[PAGE_SIZE];
+		for (unsigned i = 0; i < leftFooter->numSlots; ++i)
+		{
+			entries.add(entry, readEntry(leftBuffer, i, entry));
+		}
+
+		if (!isLeaf)
+		{
+			memcpy(entry, &rightFooter->leftChild, sizeof(PageNum));
+			entries.add(entry, sizeof(PageNum) + readEntryKey(parentBuffer, separatorPosition, entry + sizeof(PageNum)));
+		}
+
+		for (unsigned i = 0; i < rightFooter->numSlots; ++i)
+		{
+			entries.add(entry, readEntry(rightBuffer, i, entry));
+		}
+
+		// Merge the right page into the left one when they fit on one page, and drop its separator
+		const PageNum rightNextLeaf = rightFooter->nextLeafPage;
+		if (fillPage(leftBuffer, type, entries, 0, entries.size()) == rc::OK)
+		{
+			if (isLeaf)
+			{
+				leftFooter->nextLeafPage = rightNextLeaf;
+			}
+
+			ret = fileHandle.writePage(leftFooter->pageNumber, leftBuffer);
+			RETURN_ON_ERR(ret);
+
+			// A scan standing on the right leaf follows its entries over to the left one
+			ret = freePage(fileHandle, rightPage, isLeaf ? leftFooter->pageNumber : 0, leftCount);
+			RETURN_ON_ERR(ret);
+
+			removeFromPage(parentBuffer, separatorPosition);
+			memcpy(pageBuffer, parentBuffer, PAGE_SIZE);
+			parents.pop_back();
+			continue;
+		}
+
+		// Otherwise even the two pages out. A scan on a leaf expects the entries ahead of it to stay in
+		// their slots, so a leaf only ever takes entries from its right sibling
+		if (isLeaf && !isLeft)
+		{
+			break;
+		}
 
-		// Advance to next record
-		curRid = tempRecord.nextSlot;
-		++slotNum;
+		const int split = findSplit(type, entries, isLeaf, 0.5f);
+		if (split < 0)
+		{
+			break;
+		}
 
-		// We know what the slot numbers will be because the page is empty initially
-		if (curRid.pageNum == 0)
+		const unsigned headerSize = entryHeaderSize(isLeaf);
+		unsigned separatorLength = 0;
+		if (isLeaf)
 		{
-			tempRecord.nextSlot.pageNum = 0;
-			tempRecord.nextSlot.slotNum = 0;
+			separatorLength = makeSeparator(type, entries.get(split - 1) + headerSize, entries.get(split) + headerSize, entry + sizeof(PageNum));
 		}
 		else
 		{
-			tempRecord.nextSlot.pageNum = rightFooter->pageNumber;
-			tempRecord.nextSlot.slotNum = slotNum;
+			separatorLength = entries.lengths[split] - headerSize;
+			memcpy(entry + sizeof(PageNum), entries.get(split) + headerSize, separatorLength);
+		}
+
+		// The new separator may be longer than the old one, if the parent can't take it we leave things be
+		unsigned char newParentBuffer[PAGE_SIZE];
+		memcpy(newParentBuffer, parentBuffer, PAGE_SIZE);
+		removeFromPage(newParentBuffer, separatorPosition);
+		memcpy(entry, &rightPage, sizeof(PageNum));
+		ret = insertIntoPage(newParentBuffer, type, separatorPosition, entry, sizeof(PageNum) + separatorLength);
+		if (ret == rc::BTREE_INDEX_PAGE_FULL)
+		{
+			break;
+		}
+		RETURN_ON_ERR(ret);
+
+		if (!isLeaf)
+		{
+			memcpy(&rightFooter->leftChild, entries.get(split), sizeof(PageNum));
 		}
 
-		// Copy over the record to the new right page buffer
-		ret = insertRecordInplace(recordDescriptor, &tempRecord, rightFooter->pageNumber, rightBuffer, lastRightRid);
+		ret = fillPage(leftBuffer, type, entries, 0, split);
+		RETURN_ON_ERR(ret);
+
+		ret = fillPage(rightBuffer, type, entries, isLeaf ? split : split + 1, entries.size());
+		RETURN_ON_ERR(ret);
+
+		ret = fileHandle.writePage(leftFooter->pageNumber, leftBuffer);
 		RETURN_ON_ERR(ret);
+
+		ret = fileHandle.writePage(rightFooter->pageNumber, rightBuffer);
+		RETURN_ON_ERR(ret);
+
+		return fileHandle.writePage(step.pageNum, newParentBuffer);
 	}
 
-	// Write out the new page buffers
-	ret = fileHandle.writePage(targetPageNum, leftBuffer);
-	RETURN_ON_ERR(ret);
-	ret = fileHandle.writePage(newPageNum, rightBuffer);
+	ret = fileHandle.writePage(footer->pageNumber, pageBuffer);
 	RETURN_ON_ERR(ret);
 
+	// A root left with a single child hands the job over to it, and the tree gets one level shorter
+	if (parents.empty() && !footer->isLeafPage && footer->numSlots == 0)
+	{
+		const PageNum oldRootPage = footer->pageNumber;
+		ret = updateRootPage(fileHandle, footer->leftChild);
+		RETURN_ON_ERR(ret);
+
+		return freePage(fileHandle, oldRootPage, 0, 0);
+	}
+
 	return rc::OK;
 }
 
-RC IndexManager::getNextRecord(FileHandle& fileHandle, const std::vector<Attribute>& recordDescriptor, const Attribute& /*attribute*/, RID& rid)
+RC IndexManager::bulkLoad(FileHandle &fileHandle, const Attribute &attribute, IX_BulkLoader &loader, float fillFactor)
 {
-	if (rid.pageNum == 0)
-		return IX_EOF;
+	// We only build from nothing, merging into an existing tree is what insertEntry() is for.
+	// The build holds the reserved page and the root, so nobody else gets into the tree until it is done.
+	// It writes pages without latching them, so cached copies of whatever they held before have to go
+	IX_LatchSet latches;
+	latches.acquire(fileHandle, 0, true);
+	getIndexFile(fileHandle).clearNodeCache();
+
+	PageNum rootPageNum = 0;
+	RC ret = getRootPage(fileHandle, rootPageNum);
+	RETURN_ON_ERR(ret);
 
-	// Read in the page with current record
+	latches.acquire(fileHandle, rootPageNum, true);
 	unsigned char pageBuffer[PAGE_SIZE] = {0};
-	RC ret = fileHandle.readPage(rid.pageNum, pageBuffer);
+	ret = fileHandle.readPage(rootPageNum, pageBuffer);
 	RETURN_ON_ERR(ret);
 
 	IX_PageIndexFooter* footer = getIXPageIndexFooter(pageBuffer);
-	if (!footer->isLeafPage)
-		return rc::BTREE_ITERATOR_ILLEGAL_NON_LEAF_RECORD;
-	if (footer->numSlots <= rid.slotNum)
+	if (!footer->isLeafPage || footer->numSlots > 0)
+	{
+		return rc::BTREE_INDEX_NOT_EMPTY;
+	}
+
+	ret = loader.sort();
+	RETURN_ON_ERR(ret);
+
+	// Every page but the root is unused in an empty tree, so we are free to number pages from the start.
+	// Whatever the free list held is rebuilt from the pages left over at the end
+	const PageNum rootPage = footer->pageNumber;
+	const PageNum numOldPages = fileHandle.getNumberOfPages();
+	ret = resetFreePageList(fileHandle);
+	RETURN_ON_ERR(ret);
+
+	const unsigned usableSpace = PAGE_SIZE - sizeof(IX_PageIndexFooter);
+	fillFactor = std::min(std::max(fillFactor, 0.0f), 1.0f);
+	const unsigned fillLimit = (unsigned)(usableSpace * fillFactor);
+	PageNum nextPage = (rootPage == 1) ? 2 : 1;
+
+	// Fill leaves left to right, handing each one to its parent level as soon as it is full
+	std::vector<IX_BulkLoadNode> levels;
+	PageNum leafPage = rootPage;
+	KeyValueData leafSeparator;
+	char previousKey[PAGE_SIZE];
+	bool hasPreviousKey = false;
+	initPage(pageBuffer, leafPage, true, 0, 0);
+
+	// Equal keys come out of the loader together and in RID order, so each posting list is built up as they
+	// come and only placed once the next key differs or the list is as large as an entry gets
+	char entry[PAGE_SIZE];
+	unsigned entryLength = 0;
+	char nextEntry[PAGE_SIZE];
+	unsigned nextEntryLength = 0;
+	RID lastRid;
+	bool hasEntry = false;
+	while (true)
+	{
+		ret = loader.getNextEntry(nextEntry, nextEntryLength);
+		if (ret != rc::OK && ret != IX_EOF)
+		{
+			return ret;
+		}
+
+		const bool done = ret == IX_EOF;
+		if (!done && hasEntry && entryLength + IX_MAX_RID_DELTA_SIZE <= IX_MAX_ENTRY_SIZE
+			&& compareKeys(attribute.type, entry + sizeof(RID), nextEntry + sizeof(RID)) == 0)
+		{
+			const RID rid = *(const RID*)nextEntry;
+			entryLength += writeRidDelta(lastRid, rid, (unsigned char*)entry + entryLength);
+			lastRid = rid;
+			continue;
+		}
+
+		if (hasEntry)
+		{
+			ret = bulkLoadPlace(fileHandle, attribute, levels, pageBuffer, entry, entryLength, leafPage, leafSeparator, previousKey, hasPreviousKey, fillLimit, nextPage, rootPage);
+			RETURN_ON_ERR(ret);
+		}
+
+		if (done)
+		{
+			break;
+		}
+
+		memcpy(entry, nextEntry, nextEntryLength);
+		entryLength = nextEntryLength;
+		lastRid = *(const RID*)entry;
+		hasEntry = true;
+	}
+
+	ret = writeNodePage(fileHandle, leafPage, pageBuffer);
+	RETURN_ON_ERR(ret);
+
+	if (levels.empty())
 	{
-		return rc::BTREE_INDEX_LEAF_ENTRY_NOT_FOUND;
+		// Everything fit on one leaf, which is already the root
+		return freeUnusedPages(fileHandle, nextPage, numOldPages, rootPage);
 	}
 
-	IndexRecord record;
-	ret = readRecord(fileHandle, recordDescriptor, rid, &record, pageBuffer);
+	ret = bulkLoadPushUp(fileHandle, attribute, levels, 0, leafSeparator.data(), leafPage, fillLimit, nextPage, rootPage);
 	RETURN_ON_ERR(ret);
 
-	// We have a valid next slot, use it and return
-	if (record.nextSlot.pageNum != 0)
+	// Close off the last node on each level from the bottom up, the top one becomes the root
+	PageNum newRootPage = 0;
+	for (unsigned level = 0; level < levels.size(); ++level)
 	{
-		rid = record.nextSlot;
-		return rc::OK;
+		IX_PageIndexFooter* nodeFooter = getIXPageIndexFooter(levels[level].pageBuffer);
+		const bool isTop = level + 1 == levels.size();
+		if (isTop && nodeFooter->numSlots == 0)
+		{
+			newRootPage = nodeFooter->leftChild;
+			break;
+		}
+
+		const PageNum nodePage = nextPage++;
+		if (nextPage == rootPage) ++nextPage;
+		nodeFooter->pageNumber = nodePage;
+		ret = writeNodePage(fileHandle, nodePage, levels[level].pageBuffer);
+		RETURN_ON_ERR(ret);
+
+		if (isTop)
+		{
+			newRootPage = nodePage;
+		}
+		else
+		{
+			ret = bulkLoadPushUp(fileHandle, attribute, levels, level + 1, levels[level].firstKey.data(), nodePage, fillLimit, nextPage, rootPage);
+			RETURN_ON_ERR(ret);
+		}
 	}
 
-	// We need to load in a new page
-	ret = fileHandle.readPage(footer->nextLeafPage, pageBuffer);
+	ret = updateRootPage(fileHandle, newRootPage);
 	RETURN_ON_ERR(ret);
 
-	if (footer->firstRecord.pageNum == 0)
+	return freeUnusedPages(fileHandle, nextPage, numOldPages, rootPage);
+}
+
+// Put the next entry on the leaf being filled, first moving on to a new leaf if this one is full
+RC IndexManager::bulkLoadPlace(FileHandle& fileHandle, const Attribute& attribute, std::vector<IX_BulkLoadNode>& levels, void* pageBuffer, const void* entry, unsigned entryLength, PageNum& leafPage, KeyValueData& leafSeparator, void* previousKey, bool& hasPreviousKey, unsigned fillLimit, PageNum& nextPage, PageNum rootPage)
+{
+	IX_PageIndexFooter* footer = getIXPageIndexFooter(pageBuffer);
+	RC ret = rc::OK;
+	if (footer->numSlots > 0 && usedSpaceWithEntry(pageBuffer, attribute.type, entry, entryLength) > fillLimit)
+	{
+		const PageNum nextLeafPage = nextPage++;
+		if (nextPage == rootPage) ++nextPage;
+		footer->nextLeafPage = nextLeafPage;
+		ret = writeNodePage(fileHandle, leafPage, pageBuffer);
+		RETURN_ON_ERR(ret);
+
+		ret = bulkLoadPushUp(fileHandle, attribute, levels, 0, leafSeparator.data(), leafPage, fillLimit, nextPage, rootPage);
+		RETURN_ON_ERR(ret);
+
+		readEntryKey(pageBuffer, footer->numSlots - 1, previousKey);
+		hasPreviousKey = true;
+
+		leafPage = nextLeafPage;
+		initPage(pageBuffer, leafPage, true, 0, 0);
+	}
+
+	// Each leaf goes up under the shortest key that splits it from the one before
+	if (footer->numSlots == 0)
 	{
-		return rc::BTREE_INDEX_LEAF_ENTRY_NOT_FOUND;
+		char separator[PAGE_SIZE];
+		const void* key = (const char*)entry + sizeof(RID);
+		if (hasPreviousKey)
+		{
+			makeSeparator(attribute.type, previousKey, key, separator);
+			key = separator;
+		}
+
+		ret = leafSeparator.init(attribute.type, key);
+		RETURN_ON_ERR(ret);
 	}
 
-	// Our first record on the next leaf page is the next record
-	rid = footer->firstRecord;
-	return rc::OK;
+	return insertIntoPage(pageBuffer, attribute.type, footer->numSlots, entry, entryLength);
 }
 
-RC IndexManager::scan(FileHandle &fileHandle,
-    const Attribute &attribute,
-    const void      *lowKey,
-    const void      *highKey,
-    bool			lowKeyInclusive,
-    bool        	highKeyInclusive,
-    IX_ScanIterator &ix_ScanIterator)
+RC IndexManager::freeUnusedPages(FileHandle& fileHandle, PageNum firstPage, PageNum endPage, PageNum rootPage)
 {
-	return ix_ScanIterator.init(&fileHandle, attribute, lowKey, highKey, lowKeyInclusive, highKeyInclusive);
+	for (PageNum page = firstPage; page < endPage; ++page)
+	{
+		if (page != rootPage)
+		{
+			RC ret = freePage(fileHandle, page, 0, 0);
+			RETURN_ON_ERR(ret);
+		}
+	}
+
+	return rc::OK;
 }
 
-IX_PageIndexFooter* IndexManager::getIXPageIndexFooter(void* pageBuffer)
+RC IndexManager::bulkLoadPushUp(FileHandle& fileHandle, const Attribute& attribute, std::vector<IX_BulkLoadNode>& levels, unsigned level, const void* key, PageNum child, unsigned fillLimit, PageNum& nextPage, PageNum rootPage)
+{
+	KeyValueData carryKey;
+	RC ret = carryKey.init(attribute.type, key);
+	RETURN_ON_ERR(ret);
+
+	for (; ; ++level)
+	{
+		// The first child of a brand new level becomes its leftChild, and its key is the level's low key
+		if (level == levels.size())
+		{
+			levels.push_back(IX_BulkLoadNode());
+			initPage(levels[level].pageBuffer, 0, false, 0, child);
+			levels[level].firstKey = std::move(carryKey);
+			return rc::OK;
+		}
+
+		IX_BulkLoadNode& node = levels[level];
+		IX_PageIndexFooter* footer = getIXPageIndexFooter(node.pageBuffer);
+
+		char entry[PAGE_SIZE];
+		const unsigned keySize = Attribute::sizeInBytes(attribute.type, carryKey.data());
+		const unsigned entryLength = sizeof(PageNum) + keySize;
+		memcpy(entry, &child, sizeof(PageNum));
+		memcpy(entry + sizeof(PageNum), carryKey.data(), keySize);
+
+		// Always take at least one key so every node we close has two children
+		if (footer->numSlots == 0 || usedSpaceWithEntry(node.pageBuffer, attribute.type, entry, entryLength) <= fillLimit)
+		{
+			return insertIntoPage(node.pageBuffer, attribute.type, footer->numSlots, entry, entryLength);
+		}
+
+		// This node is full, write it out and start a new one with the child, then carry the old node up a level
+		const PageNum nodePage = nextPage++;
+		if (nextPage == rootPage) ++nextPage;
+		footer->pageNumber = nodePage;
+		ret = writeNodePage(fileHandle, nodePage, node.pageBuffer);
+		RETURN_ON_ERR(ret);
+
+		KeyValueData nodeFirstKey(std::move(node.firstKey));
+		initPage(node.pageBuffer, 0, false, 0, child);
+		node.firstKey = std::move(carryKey);
+
+		carryKey = std::move(nodeFirstKey);
+		child = nodePage;
+	}
+}
+
+RC IndexManager::writeNodePage(FileHandle& fileHandle, PageNum pageNum, const void* pageBuffer)
+{
+	// Pages can be numbered before earlier numbers are written, so pad the file out with empty pages
+	unsigned char emptyPage[PAGE_SIZE];
+	while (fileHandle.getNumberOfPages() < pageNum)
+	{
+		initPage(emptyPage, fileHandle.getNumberOfPages(), true, 0, 0);
+		RC ret = fileHandle.appendPage(emptyPage);
+		RETURN_ON_ERR(ret);
+	}
+
+	if (fileHandle.getNumberOfPages() == pageNum)
+	{
+		return fileHandle.appendPage(pageBuffer);
+	}
+
+	return fileHandle.writePage(pageNum, pageBuffer);
+}
+
+RC IndexManager::splitPage(FileHandle& fileHandle, void* pageBuffer, AttrType type, unsigned position, const void* entry, unsigned entryLength, float leftFraction, PageNum& rightPageNum, void* separator, unsigned& separatorLength)
+{
+	IX_PageIndexFooter* footer = getIXPageIndexFooter(pageBuffer);
+	const bool isLeaf = footer->isLeafPage;
+	const unsigned headerSize = entryHeaderSize(isLeaf);
+
+	// Copy every entry, including the new one, out in key order with their prefixes put back
+	IX_EntryList entries;
+	collectEntries(pageBuffer, position, entry, entryLength, entries);
+	const unsigned numEntries = entries.size();
+
+	// For a leaf, the entry at the split starts the right page and the shortest key between the two pages goes
+	// up. For a non-leaf, the entry at the split goes up on its own and its child becomes the right leftChild
+	const int bestSplit = findSplit(type, entries, isLeaf, leftFraction);
+	if (bestSplit < 0)
+	{
+		return rc::BTREE_KEY_TOO_LARGE;
+	}
+
+	const unsigned split = bestSplit;
+	const char* splitEntry = entries.get(split);
+	if (isLeaf)
+	{
+		separatorLength = makeSeparator(type, entries.get(split - 1) + headerSize, splitEntry + headerSize, separator);
+	}
+	else
+	{
+		separatorLength = entries.lengths[split] - headerSize;
+		memcpy(separator, splitEntry + headerSize, separatorLength);
+	}
+
+	// Lay out the two pages, the right page is always new and is linked in after the left
+	RC ret = allocatePage(fileHandle, rightPageNum);
+	RETURN_ON_ERR(ret);
+
+	const PageNum leftPageNum = footer->pageNumber;
+	const PageNum nextLeafPage = footer->nextLeafPage;
+	const PageNum leftChild = footer->leftChild;
+
+	unsigned char rightBuffer[PAGE_SIZE];
+	PageNum rightLeftChild = 0;
+	if (!isLeaf)
+	{
+		memcpy(&rightLeftChild, splitEntry, sizeof(PageNum));
+	}
+
+	initPage(rightBuffer, rightPageNum, isLeaf, nextLeafPage, rightLeftChild);
+	initPage(pageBuffer, leftPageNum, isLeaf, rightPageNum, leftChild);
+
+	ret = fillPage(pageBuffer, type, entries, 0, split);
+	RETURN_ON_ERR(ret);
+
+	ret = fillPage(rightBuffer, type, entries, isLeaf ? split : split + 1, numEntries);
+	RETURN_ON_ERR(ret);
+
+	ret = writeNodePage(fileHandle, rightPageNum, rightBuffer);
+	RETURN_ON_ERR(ret);
+
+	return fileHandle.writePage(leftPageNum, pageBuffer);
+}
+
+RC IndexManager::insertIntoPage(void* pageBuffer, AttrType type, unsigned position, const void* entry, unsigned entryLength)
+{
+	IX_PageIndexFooter* footer = getIXPageIndexFooter(pageBuffer);
+	const unsigned headerSize = entryHeaderSize(footer->isLeafPage);
+
+	char packed[PAGE_SIZE];
+	if (type == TypeVarChar)
+	{
+		// An empty page takes the whole key as its prefix, and a key outside the prefix trims it back
+		// to what they share, which means spreading the entries already here back out
+		const void* key = (const char*)entry + headerSize;
+		if (footer->numSlots == 0 || comparePagePrefix(pageBuffer, key) != 0)
+		{
+			IX_EntryList entries;
+			collectEntries(pageBuffer, position, entry, entryLength, entries);
+
+			RC ret = fillPage(pageBuffer, type, entries, 0, entries.size());
+			if (ret == rc::BTREE_INDEX_PAGE_FULL && footer->numSlots == 0)
+				return rc::BTREE_KEY_TOO_LARGE;
+
+			return ret;
+		}
+
+		entryLength = packEntry(entry, entryLength, headerSize, footer->prefixLength, packed);
+		entry = packed;
+	}
+
+	const unsigned requiredSpace = entryLength + sizeof(IX_EntrySlot);
+	if (getPageFreeSpace(pageBuffer) < requiredSpace)
+	{
+		// Deleted entries leave holes behind, see if squeezing them out makes enough room
+		if (getPageFreeSpace(pageBuffer) + footer->gapSize < requiredSpace)
+		{
+			if (footer->numSlots == 0)
+				return rc::BTREE_KEY_TOO_LARGE;
+
+			return rc::BTREE_INDEX_PAGE_FULL;
+		}
+
+		compactPage(pageBuffer);
+	}
+
+	placeEntry(pageBuffer, position, entry, entryLength);
+	return rc::OK;
+}
+
+void IndexManager::removeFromPage(void* pageBuffer, unsigned position)
+{
+	IX_PageIndexFooter* footer = getIXPageIndexFooter(pageBuffer);
+	assert(position < footer->numSlots);
+
+	// Space at the end of the entry data can be reused right away, anything else becomes a gap
+	const IX_EntrySlot removed = *getEntrySlot(pageBuffer, position);
+	if (removed.offset + removed.length == footer->freeSpaceOffset)
+	{
+		footer->freeSpaceOffset -= removed.length;
+	}
+	else
+	{
+		footer->gapSize += removed.length;
+	}
+
+	// Shift the slots after our position up by one to close the hole
+	if (position + 1 < footer->numSlots)
+	{
+		memmove(getEntrySlot(pageBuffer, footer->numSlots - 2), getEntrySlot(pageBuffer, footer->numSlots - 1), (footer->numSlots - position - 1) * sizeof(IX_EntrySlot));
+	}
+
+	footer->numSlots--;
+	if (footer->numSlots == 0)
+	{
+		footer->freeSpaceOffset = 0;
+		footer->gapSize = 0;
+		footer->prefixLength = 0;
+	}
+}
+
+void IndexManager::compactPage(void* pageBuffer)
+{
+	IX_PageIndexFooter* footer = getIXPageIndexFooter(pageBuffer);
+
+	// Rewrite the entries back to back in key order, just after the page prefix
+	char entries[PAGE_SIZE];
+	unsigned length = 0;
+	for (unsigned i = 0; i < footer->numSlots; ++i)
+	{
+		IX_EntrySlot* slot = getEntrySlot(pageBuffer, i);
+		memcpy(entries + length, (char*)pageBuffer + slot->offset, slot->length);
+		slot->offset = footer->prefixLength + length;
+		length += slot->length;
+	}
+
+	memcpy((char*)pageBuffer + footer->prefixLength, entries, length);
+	footer->freeSpaceOffset = footer->prefixLength + length;
+	footer->gapSize = 0;
+}
+
+IX_EntrySlot* IndexManager::getEntrySlot(void* pageBuffer, unsigned position)
+{
+	return (IX_EntrySlot*)((char*)getIXPageIndexFooter(pageBuffer) - (position + 1) * sizeof(IX_EntrySlot));
+}
+
+const void* IndexManager::getEntryKey(void* pageBuffer, unsigned position)
+{
+	const IX_EntrySlot* slot = getEntrySlot(pageBuffer, position);
+	return (char*)pageBuffer + slot->offset + entryHeaderSize(getIXPageIndexFooter(pageBuffer)->isLeafPage);
+}
+
+unsigned IndexManager::readEntryKey(void* pageBuffer, unsigned position, void* key)
+{
+	const IX_EntrySlot* slot = getEntrySlot(pageBuffer, position);
+	const char* storedKey = (const char*)getEntryKey(pageBuffer, position);
+	const unsigned storedSize = slot->length - entryHeaderSize(getIXPageIndexFooter(pageBuffer)->isLeafPage);
+	const unsigned prefixLength = getIXPageIndexFooter(pageBuffer)->prefixLength;
+	if (prefixLength == 0)
+	{
+		memcpy(key, storedKey, storedSize);
+		return storedSize;
+	}
+
+	// Put the page prefix back in front of the stored characters, and whatever follows them after
+	unsigned keySize;
+	memcpy(&keySize, storedKey, sizeof(unsigned));
+	keySize += prefixLength;
+
+	memcpy(key, &keySize, sizeof(unsigned));
+	memcpy((char*)key + sizeof(unsigned), pageBuffer, prefixLength);
+	memcpy((char*)key + sizeof(unsigned) + prefixLength, storedKey + sizeof(unsigned), storedSize - sizeof(unsigned));
+	return storedSize + prefixLength;
+}
+
+unsigned IndexManager::readEntry(void* pageBuffer, unsigned position, void* entry)
+{
+	const unsigned headerSize = entryHeaderSize(getIXPageIndexFooter(pageBuffer)->isLeafPage);
+	memcpy(entry, (char*)pageBuffer + getEntrySlot(pageBuffer, position)->offset, headerSize);
+	return headerSize + readEntryKey(pageBuffer, position, (char*)entry + headerSize);
+}
+
+RID IndexManager::getEntryRid(void* pageBuffer, unsigned position)
+{
+	RID rid;
+	memcpy(&rid, (char*)pageBuffer + getEntrySlot(pageBuffer, position)->offset, sizeof(RID));
+	return rid;
+}
+
+PageNum IndexManager::getChildPage(void* pageBuffer, unsigned childIndex)
+{
+	// Child 0 is the leftChild, child i lives in entry i-1
+	if (childIndex == 0)
+	{
+		return getIXPageIndexFooter(pageBuffer)->leftChild;
+	}
+
+	PageNum child = 0;
+	memcpy(&child, (char*)pageBuffer + getEntrySlot(pageBuffer, childIndex - 1)->offset, sizeof(PageNum));
+	return child;
+}
+
+unsigned IndexManager::getPageFreeSpace(void* pageBuffer)
+{
+	IX_PageIndexFooter* footer = getIXPageIndexFooter(pageBuffer);
+	return PAGE_SIZE - sizeof(IX_PageIndexFooter) - footer->numSlots * sizeof(IX_EntrySlot) - footer->freeSpaceOffset;
+}
+
+const IX_KeyOps& IndexManager::getKeyOps(AttrType type)
+{
+	static const IX_KeyOps intOps = { IX_IntKey::compare, compareEntryKeyOf<IX_IntKey>, findEntryPositionOf<IX_IntKey> };
+	static const IX_KeyOps realOps = { IX_RealKey::compare, compareEntryKeyOf<IX_RealKey>, findEntryPositionOf<IX_RealKey> };
+	static const IX_KeyOps varCharOps = { IX_VarCharKey::compare, compareEntryKeyOf<IX_VarCharKey>, findEntryPositionOf<IX_VarCharKey> };
+
+	switch (type)
+	{
+		case TypeInt: return intOps;
+		case TypeReal: return realOps;
+		case TypeVarChar: return varCharOps;
+	}
+
+	assert(false);
+	return intOps;
+}
+
+unsigned IndexManager::findEntryPosition(void* pageBuffer, AttrType type, const void* key, bool upperBound)
+{
+	return getKeyOps(type).findEntryPosition(pageBuffer, key, upperBound);
+}
+
+int IndexManager::compareKeys(AttrType type, const void* lhs, const void* rhs)
+{
+	return getKeyOps(type).compareKeys(lhs, rhs);
+}
+
+int IndexManager::compareEntryKey(void* pageBuffer, AttrType type, unsigned position, const void* key)
+{
+	return getKeyOps(type).compareEntryKey(pageBuffer, position, key);
+}
+
+// After a leaf changed under an optimistic reader, work out from the leaves alone whether it is still the leftmost
+// one which could hold key, following the links right past any splits. False means only a new descent can tell
+static bool relocateLeaf(FileHandle& fileHandle, IX_IndexFile& indexFile, const IX_KeyOps& keyOps, const void* key, PageNum pageNum, void* pageBuffer, unsigned& leafVersion)
+{
+	IX_PageIndexFooter* footer = IndexManager::getIXPageIndexFooter(pageBuffer);
+	IX_Latch* previousLatch = NULL;
+	unsigned previousVersion = 0;
+	while (true)
+	{
+		// The leaf we came from has to be unchanged once we know this one's version, or its link may be stale
+		IX_Latch* latch = indexFile.getLatch(pageNum);
+		const unsigned version = latch->readVersion();
+		if (previousLatch && !previousLatch->validate(previousVersion))
+			return false;
+
+		if (fileHandle.readPage(pageNum, pageBuffer) != rc::OK || !latch->validate(version))
+			return false;
+
+		if (!footer->isLeafPage || footer->isFreePage)
+			return false;
+
+		// Nothing to the left can hold the key once the first leaf holds something below it
+		if (!previousLatch && (key == NULL || footer->numSlots == 0 || keyOps.compareEntryKey(pageBuffer, 0, key) >= 0))
+			return false;
+
+		if (footer->nextLeafPage == 0 || (footer->numSlots > 0 && keyOps.compareEntryKey(pageBuffer, footer->numSlots - 1, key) >= 0))
+		{
+			leafVersion = version;
+			return true;
+		}
+
+		previousLatch = latch;
+		previousVersion = version;
+		pageNum = footer->nextLeafPage;
+	}
+}
+
+RC IndexManager::findLeafPage(FileHandle& fileHandle, const Attribute& attribute, const void* key, void* pageBuffer)
+{
+	unsigned version = 0;
+	return findLeafPage(fileHandle, attribute, key, pageBuffer, version);
+}
+
+RC IndexManager::findLeafPage(FileHandle& fileHandle, const Attribute& attribute, const void* key, void* pageBuffer, unsigned& version)
+{
+	// Readers take no latches. Each page is read between two looks at its latch version, and the parent's version
+	// is checked again once we know the child's, so a writer getting in the way sends us back to the root.
+	// Go left of any separator equal to the key, duplicates may have been split across both sides of it
+	IX_IndexFile& indexFile = IndexManager::instance()->getIndexFile(fileHandle);
+	IX_PageIndexFooter* footer = getIXPageIndexFooter(pageBuffer);
+	const IX_KeyOps& keyOps = getKeyOps(attribute.type);
+	while (true)
+	{
+		// The reserved page's version covers the root page number
+		IX_Latch* parentLatch = indexFile.getLatch(0);
+		unsigned parentVersion = parentLatch->readVersion();
+
+		PageNum pageNum = 0;
+		RC ret = getRootPage(fileHandle, pageNum);
+		RETURN_ON_ERR(ret);
+
+		while (true)
+		{
+			IX_Latch* latch = indexFile.getLatch(pageNum);
+			version = latch->readVersion();
+			if (!parentLatch->validate(parentVersion))
+				break;
+
+			ret = readNodePage(fileHandle, indexFile, pageNum, version, pageBuffer);
+			RETURN_ON_ERR(ret);
+
+			if (!latch->validate(version))
+			{
+				// Writers mostly change a leaf without moving our key off it, so try not to start over
+				if (footer->isLeafPage && relocateLeaf(fileHandle, indexFile, keyOps, key, pageNum, pageBuffer, version))
+					return rc::OK;
+
+				break;
+			}
+
+			if (footer->isLeafPage)
+				return rc::OK;
+
+			parentLatch = latch;
+			parentVersion = version;
+			pageNum = getChildPage(pageBuffer, keyOps.findEntryPosition(pageBuffer, key, false));
+		}
+	}
+}
+
+RC IndexManager::getRootPage(FileHandle& fileHandle, PageNum& rootPage)
+{
+	IndexManager& im = *IndexManager::instance();
+	IX_IndexFile& indexFile = im.getIndexFile(fileHandle);
+
+	// Do we have the root page number cached?
+	rootPage = indexFile.getRootPage();
+	if (rootPage != 0)
+	{
+		return rc::OK;
+	}
+
+	// We need to pull in the reserved page and read in the root, which lives at the very end of it
+	std::lock_guard<std::mutex> guard(im._headerMutex);
+	unsigned char pageBuffer[PAGE_SIZE];
+	RC ret = fileHandle.readPage(0, pageBuffer);
+	RETURN_ON_ERR(ret);
+
+	rootPage = *(unsigned*)((char*)pageBuffer + PAGE_SIZE - sizeof(unsigned));
+
+	// Save it to our cache for later
+	indexFile.setRootPage(rootPage);
+	return rc::OK;
+}
+
+RC IndexManager::readNodePage(FileHandle& fileHandle, IX_IndexFile& indexFile, PageNum pageNum, unsigned version, void* pageBuffer)
+{
+	// Non-leaf pages come from the node cache when it has them at the version the caller saw on the latch, and
+	// go into it otherwise, so a lookup with a warm cache only reads its leaf from the file
+	if (indexFile.readCachedNode(pageNum, version, pageBuffer))
+		return rc::OK;
+
+	RC ret = fileHandle.readPage(pageNum, pageBuffer);
+	RETURN_ON_ERR(ret);
+
+	// Only a copy read while nobody was writing the page is worth keeping
+	if (!getIXPageIndexFooter(pageBuffer)->isLeafPage && indexFile.getLatch(pageNum)->validate(version))
+	{
+		indexFile.cacheNode(pageNum, version, pageBuffer);
+	}
+
+	return rc::OK;
+}
+
+// Where lookupMany() is in the tree: the non-leaf pages its last descent read, root first, and the leaf it holds
+struct IX_LookupState
+{
+	IX_LookupState() : rootVersion(0), hasLeaf(false), leafVersion(0) {}
+
+	std::vector<IX_LookupLevel> path;
+	unsigned rootVersion; // the reserved page's version when the root page number was read
+	bool hasLeaf;
+	unsigned leafVersion;
+	unsigned char leaf[PAGE_SIZE];
+};
+
+// Find the leftmost leaf which could hold key, starting below the deepest page on the path that is unchanged and
+// sends key the same way the last key went. The leaf we already hold is not read again if the descent ends there
+static RC lookupDescend(FileHandle& fileHandle, IX_IndexFile& indexFile, const IX_KeyOps& keyOps, const void* key, IX_LookupState& state)
+{
+	IX_PageIndexFooter* leafFooter = IndexManager::getIXPageIndexFooter(state.leaf);
+	unsigned char pageBuffer[PAGE_SIZE];
+	while (true)
+	{
+		IX_Latch* parentLatch = indexFile.getLatch(0);
+		unsigned parentVersion = state.rootVersion;
+		PageNum pageNum = 0;
+
+		// Keep every level whose copy is still good, up to the first one where key takes another child
+		unsigned keep = 0;
+		if (!state.path.empty() && parentLatch->validate(parentVersion))
+		{
+			for (; keep < state.path.size(); ++keep)
+			{
+				IX_LookupLevel& level = state.path[keep];
+				if (!indexFile.getLatch(level.pageNum)->validate(level.version))
+					break;
+
+				parentLatch = indexFile.getLatch(level.pageNum);
+				parentVersion = level.version;
+				const unsigned childIndex = keyOps.findEntryPosition(level.page, key, false);
+				if (childIndex != level.childIndex)
+				{
+					level.childIndex = childIndex;
+					++keep;
+					break;
+				}
+			}
+		}
+
+		if (keep == 0)
+		{
+			parentVersion = parentLatch->readVersion();
+			RC ret = IndexManager::getRootPage(fileHandle, pageNum);
+			RETURN_ON_ERR(ret);
+
+			state.rootVersion = parentVersion;
+		}
+		else
+		{
+			pageNum = IndexManager::getChildPage(state.path[keep - 1].page, state.path[keep - 1].childIndex);
+		}
+		state.path.resize(keep);
+
+		while (true)
+		{
+			IX_Latch* latch = indexFile.getLatch(pageNum);
+			const unsigned version = latch->readVersion();
+			if (!parentLatch->validate(parentVersion))
+				break;
+
+			// Our leaf is still current, nothing to read
+			if (state.hasLeaf && leafFooter->pageNumber == pageNum && version == state.leafVersion)
+				return rc::OK;
+
+			RC ret = IndexManager::readNodePage(fileHandle, indexFile, pageNum, version, pageBuffer);
+			RETURN_ON_ERR(ret);
+
+			if (!latch->validate(version))
+				break;
+
+			if (IndexManager::getIXPageIndexFooter(pageBuffer)->isLeafPage)
+			{
+				memcpy(state.leaf, pageBuffer, PAGE_SIZE);
+				state.hasLeaf = true;
+				state.leafVersion = version;
+				return rc::OK;
+			}
+
+			state.path.push_back(IX_LookupLevel());
+			IX_LookupLevel& level = state.path.back();
+			level.pageNum = pageNum;
+			level.version = version;
+			level.childIndex = keyOps.findEntryPosition(pageBuffer, key, false);
+			memcpy(level.page, pageBuffer, PAGE_SIZE);
+
+			parentLatch = latch;
+			parentVersion = version;
+			pageNum = IndexManager::getChildPage(pageBuffer, level.childIndex);
+		}
+
+		// A writer got in the way, start again from the root
+		state.path.clear();
+		state.hasLeaf = false;
+	}
+}
+
+// Gather key's RIDs starting from the leaf we hold, following the leaf links while its entries run on. False if a
+// writer changed the leaves under us, the caller then descends again and starts over
+static bool lookupCollect(FileHandle& fileHandle, IX_IndexFile& indexFile, const IX_KeyOps& keyOps, AttrType type, const void* key, IX_LookupState& state, std::vector<RID>& rids)
+{
+	IX_PageIndexFooter* footer = IndexManager::getIXPageIndexFooter(state.leaf);
+	char entry[PAGE_SIZE];
+	std::vector<RID> postingRids;
+	unsigned position = keyOps.findEntryPosition(state.leaf, key, false);
+	while (true)
+	{
+		for (; position < footer->numSlots && keyOps.compareEntryKey(state.leaf, position, key) == 0; ++position)
+		{
+			const unsigned entryLength = IndexManager::readEntry(state.leaf, position, entry);
+			IndexManager::decodePosting(type, entry, entryLength, postingRids);
+			rids.insert(rids.end(), postingRids.begin(), postingRids.end());
+		}
+
+		if (position < footer->numSlots || footer->nextLeafPage == 0)
+			return true;
+
+		// The key's entries may carry on in the next leaf, which is where the next keys start looking anyway
+		IX_Latch* latch = indexFile.getLatch(footer->nextLeafPage);
+		const unsigned version = latch->readVersion();
+		if (!indexFile.getLatch(footer->pageNumber)->validate(state.leafVersion))
+			return false;
+
+		unsigned char pageBuffer[PAGE_SIZE];
+		if (fileHandle.readPage(footer->nextLeafPage, pageBuffer) != rc::OK || !latch->validate(version))
+			return false;
+
+		if (IndexManager::getIXPageIndexFooter(pageBuffer)->isFreePage)
+			return false;
+
+		memcpy(state.leaf, pageBuffer, PAGE_SIZE);
+		state.leafVersion = version;
+		position = 0;
+	}
+}
+
+RC IndexManager::lookupMany(FileHandle &fileHandle, const Attribute &attribute, const std::vector<const void*> &sortedKeys, std::vector<std::vector<RID> > &rids)
+{
+	if (!fileHandle.hasFile())
+		return rc::FILE_HANDLE_NOT_INITIALIZED;
+
+	const IX_KeyOps& keyOps = getKeyOps(attribute.type);
+	for (unsigned i = 1; i < sortedKeys.size(); ++i)
+	{
+		if (keyOps.compareKeys(sortedKeys[i - 1], sortedKeys[i]) > 0)
+			return rc::BTREE_KEYS_NOT_SORTED;
+	}
+
+	rids.assign(sortedKeys.size(), std::vector<RID>());
+	IX_IndexFile& indexFile = getIndexFile(fileHandle);
+	IX_LookupState state;
+	IX_PageIndexFooter* leafFooter = getIXPageIndexFooter(state.leaf);
+	for (unsigned i = 0; i < sortedKeys.size(); ++i)
+	{
+		const void* key = sortedKeys[i];
+		if (i > 0 && keyOps.compareKeys(sortedKeys[i - 1], key) == 0)
+		{
+			rids[i] = rids[i - 1];
+			continue;
+		}
+
+		// Keys are ascending, so the leaf we hold covers this one too unless it ends below it
+		bool covered = state.hasLeaf && (leafFooter->nextLeafPage == 0 ||
+			(leafFooter->numSlots > 0 && keyOps.compareEntryKey(state.leaf, leafFooter->numSlots - 1, key) >= 0));
+		while (true)
+		{
+			if (!covered)
+			{
+				RC ret = lookupDescend(fileHandle, indexFile, keyOps, key, state);
+				RETURN_ON_ERR(ret);
+			}
+
+			if (lookupCollect(fileHandle, indexFile, keyOps, attribute.type, key, state, rids[i]))
+				break;
+
+			rids[i].clear();
+			state.path.clear();
+			state.hasLeaf = false;
+			covered = false;
+		}
+	}
+
+	return rc::OK;
+}
+
+RC IndexManager::readRootPage(FileHandle& fileHandle, void* pageBuffer)
+{
+	PageNum rootPage = 0;
+	RC ret = getRootPage(fileHandle, rootPage);
+	RETURN_ON_ERR(ret);
+
+	return fileHandle.readPage(rootPage, pageBuffer);
+}
+
+RC IndexManager::scan(FileHandle &fileHandle,
+    const Attribute &attribute,
+    const void      *lowKey,
+    const void      *highKey,
+    bool			lowKeyInclusive,
+    bool        	highKeyInclusive,
+    IX_ScanIterator &ix_ScanIterator)
+{
+	return ix_ScanIterator.init(&fileHandle, attribute, lowKey, highKey, lowKeyInclusive, highKeyInclusive);
+}
+
+RC IndexManager::scan(FileHandle &fileHandle,
+    const Attribute &attribute,
+    const void      *lowKey,
+    const void      *highKey,
+    bool			lowKeyInclusive,
+    bool        	highKeyInclusive,
+    IX_ScanOrder	order,
+    IX_ScanIterator &ix_ScanIterator)
+{
+	return ix_ScanIterator.init(&fileHandle, attribute, lowKey, highKey, lowKeyInclusive, highKeyInclusive, order);
+}
+
+RC IndexManager::insertEntry(FileHandle &fileHandle, const vector<Attribute> &attributes, const void *key, const RID &rid)
+{
+	char compositeKey[sizeof(unsigned) + MAX_KEY_SIZE];
+	RC ret = encodeCompositeKey(attributes, key, attributes.size(), compositeKey);
+	RETURN_ON_ERR(ret);
+
+	return insertEntry(fileHandle, getCompositeAttribute(attributes), compositeKey, rid);
+}
+
+RC IndexManager::deleteEntry(FileHandle &fileHandle, const vector<Attribute> &attributes, const void *key, const RID &rid)
+{
+	char compositeKey[sizeof(unsigned) + MAX_KEY_SIZE];
+	RC ret = encodeCompositeKey(attributes, key, attributes.size(), compositeKey);
+	RETURN_ON_ERR(ret);
+
+	return deleteEntry(fileHandle, getCompositeAttribute(attributes), compositeKey, rid);
+}
+
+// The smallest key greater than every key starting with key: drop the trailing 0xff bytes and add one to
+// the last byte left. False if key is all 0xff bytes, which nothing comes after
+static bool prefixSuccessor(void* key)
+{
+	unsigned length = 0;
+	memcpy(&length, key, sizeof(unsigned));
+	unsigned char* bytes = (unsigned char*)key + sizeof(unsigned);
+	while (length > 0 && bytes[length - 1] == 0xff)
+	{
+		--length;
+	}
+
+	if (length == 0)
+		return false;
+
+	++bytes[length - 1];
+	memcpy(key, &length, sizeof(unsigned));
+	return true;
+}
+
+RC IndexManager::scan(FileHandle &fileHandle,
+    const vector<Attribute> &attributes,
+    const void      *lowKey,
+    unsigned        lowKeyValues,
+    const void      *highKey,
+    unsigned        highKeyValues,
+    bool			lowKeyInclusive,
+    bool        	highKeyInclusive,
+    IX_ScanIterator &ix_ScanIterator)
+{
+	// A partial key is a prefix of every full key starting with the same values, and sorts before all of them
+	char low[sizeof(unsigned) + MAX_KEY_SIZE];
+	char high[sizeof(unsigned) + MAX_KEY_SIZE];
+	const void* lowBound = NULL;
+	const void* highBound = NULL;
+	if (lowKey)
+	{
+		RC ret = encodeCompositeKey(attributes, lowKey, lowKeyValues, low);
+		RETURN_ON_ERR(ret);
+
+		// Only an exclusive bound has to be moved past the keys starting with it, if nothing is past them the scan is empty
+		if (!lowKeyInclusive && !prefixSuccessor(low))
+			return ix_ScanIterator.init(&fileHandle, attributes, low, low, false, false);
+
+		lowBound = low;
+		lowKeyInclusive = true;
+	}
+
+	if (highKey)
+	{
+		RC ret = encodeCompositeKey(attributes, highKey, highKeyValues, high);
+		RETURN_ON_ERR(ret);
+
+		// Keys starting with an inclusive bound come before its successor, without one there is no upper bound
+		highBound = high;
+		if (highKeyInclusive)
+		{
+			highBound = prefixSuccessor(high) ? high : NULL;
+			highKeyInclusive = false;
+		}
+	}
+
+	return ix_ScanIterator.init(&fileHandle, attributes, lowBound, highBound, lowKeyInclusive, highKeyInclusive);
+}
+
+Attribute IndexManager::getCompositeAttribute(const vector<Attribute>& attributes)
+{
+	Attribute attribute;
+	attribute.type = TypeVarChar;
+	attribute.length = MAX_KEY_SIZE;
+	for (unsigned i = 0; i < attributes.size(); ++i)
+	{
+		attribute.name += (i > 0 ? "," : "") + attributes[i].name;
+	}
+
+	return attribute;
+}
+
+// Values are written big-endian with the sign bit flipped, so that memcmp() orders them like numbers
+static void encodeOrderedInt(unsigned bits, unsigned char* out)
+{
+	bits ^= 0x80000000u;
+	out[0] = bits >> 24;
+	out[1] = bits >> 16;
+	out[2] = bits >> 8;
+	out[3] = bits;
+}
+
+static unsigned decodeOrderedInt(const unsigned char* in)
+{
+	unsigned bits = ((unsigned)in[0] << 24) | ((unsigned)in[1] << 16) | ((unsigned)in[2] << 8) | (unsigned)in[3];
+	return bits ^ 0x80000000u;
+}
+
+RC IndexManager::encodeCompositeKey(const vector<Attribute>& attributes, const void* values, unsigned numValues, void* key)
+{
+	if (numValues > attributes.size())
+		return rc::ATTRIBUTE_COUNT_MISMATCH;
+
+	const unsigned char* in = (const unsigned char*)values;
+	unsigned char* out = (unsigned char*)key + sizeof(unsigned);
+	unsigned length = 0;
+	for (unsigned i = 0; i < numValues; ++i)
+	{
+		switch (attributes[i].type)
+		{
+			case TypeInt:
+			{
+				if (length + sizeof(unsigned) > MAX_KEY_SIZE)
+					return rc::BTREE_KEY_TOO_LARGE;
+
+				unsigned bits = 0;
+				memcpy(&bits, in, sizeof(unsigned));
+				encodeOrderedInt(bits, out + length);
+				length += sizeof(unsigned);
+				in += sizeof(unsigned);
+				break;
+			}
+
+			case TypeReal:
+			{
+				if (length + sizeof(unsigned) > MAX_KEY_SIZE)
+					return rc::BTREE_KEY_TOO_LARGE;
+
+				// Negative reals sort backwards by their bits, so flip all of them, and -0.0 is the same key as 0.0
+				float value = 0;
+				unsigned bits = 0;
+				memcpy(&value, in, sizeof(float));
+				if (value != 0.0f)
+					memcpy(&bits, &value, sizeof(unsigned));
+				if (bits & 0x80000000u)
+					bits = ~bits ^ 0x80000000u;
+
+				encodeOrderedInt(bits, out + length);
+				length += sizeof(unsigned);
+				in += sizeof(unsigned);
+				break;
+			}
+
+			case TypeVarChar:
+			{
+				// Characters are copied with any zero byte escaped as 0x00 0xff and the value ends with 0x00 0x00,
+				// which sorts before any character so a shorter value sorts before a longer one it starts
+				unsigned valueLength = 0;
+				memcpy(&valueLength, in, sizeof(unsigned));
+				in += sizeof(unsigned);
+				for (unsigned c = 0; c < valueLength; ++c)
+				{
+					if (length + 2 > MAX_KEY_SIZE)
+						return rc::BTREE_KEY_TOO_LARGE;
+
+					out[length++] = in[c];
+					if (in[c] == 0)
+						out[length++] = 0xff;
+				}
+
+				if (length + 2 > MAX_KEY_SIZE)
+					return rc::BTREE_KEY_TOO_LARGE;
+
+				out[length++] = 0;
+				out[length++] = 0;
+				in += valueLength;
+				break;
+			}
+
+			default:
+				return rc::ATTRIBUTE_INVALID_TYPE;
+		}
+	}
+
+	memcpy(key, &length, sizeof(unsigned));
+	return rc::OK;
+}
+
+RC IndexManager::decodeCompositeKey(const vector<Attribute>& attributes, const void* key, void* values)
+{
+	unsigned length = 0;
+	memcpy(&length, key, sizeof(unsigned));
+	const unsigned char* in = (const unsigned char*)key + sizeof(unsigned);
+	const unsigned char* end = in + length;
+	unsigned char* out = (unsigned char*)values;
+	for (unsigned i = 0; i < attributes.size(); ++i)
+	{
+		switch (attributes[i].type)
+		{
+			case TypeInt:
+			case TypeReal:
+			{
+				if (in + sizeof(unsigned) > end)
+					return rc::RECORD_CORRUPT;
+
+				unsigned bits = decodeOrderedInt(in);
+				if (attributes[i].type == TypeReal && (bits & 0x80000000u))
+					bits = ~bits ^ 0x80000000u;
+
+				memcpy(out, &bits, sizeof(unsigned));
+				out += sizeof(unsigned);
+				in += sizeof(unsigned);
+				break;
+			}
+
+			case TypeVarChar:
+			{
+				unsigned char* valueLength = out;
+				unsigned characters = 0;
+				out += sizeof(unsigned);
+				while (in + 1 < end && !(in[0] == 0 && in[1] == 0))
+				{
+					*out++ = *in;
+					++characters;
+					in += (in[0] == 0) ? 2 : 1;
+				}
+
+				if (in + 1 >= end)
+					return rc::RECORD_CORRUPT;
+
+				memcpy(valueLength, &characters, sizeof(unsigned));
+				in += 2;
+				break;
+			}
+
+			default:
+				return rc::ATTRIBUTE_INVALID_TYPE;
+		}
+	}
+
+	return rc::OK;
+}
+
+IX_PageIndexFooter* IndexManager::getIXPageIndexFooter(void* pageBuffer)
+{
+	return (IX_PageIndexFooter*)getPageIndexFooter(pageBuffer, sizeof(IX_PageIndexFooter));
+}
+
+IX_ScanIterator::IX_ScanIterator()
+    :
+    _fileHandle(NULL),
+	_attribute(),
+	_hasLowKey(false),
+	_hasHighKey(false),
+	_lowKeyInclusive(false), 
+	_highKeyInclusive(false),
+	_keyOps(NULL),
+	_currentPage(0),
+	_descending(false),
+	_rootVersion(0),
+	_batchPosition(0),
+	_hasLastEntry(false),
+	_indexFile(NULL),
+	_previousPage(0),
+	_previousVersion(0)
+{
+}
+
+IX_ScanIterator::~IX_ScanIterator()
+{
+	close();
+}
+
+RC IX_ScanIterator::init(FileHandle* fileHandle, const Attribute &attribute, const void *lowKey, const void *highKey, bool lowKeyInclusive, bool highKeyInclusive, IX_ScanOrder order)
+{
+	if (!fileHandle || !fileHandle->hasFile())
+		return rc::FILE_HANDLE_NOT_INITIALIZED;
+
+	if (attribute.length == 0)
+		return rc::ATTRIBUTE_LENGTH_INVALID;
+
+	RC ret = rc::OK;
+
+	_fileHandle = fileHandle;
+	_attribute = attribute;
+	_hasLowKey = lowKey != NULL;
+	_hasHighKey = highKey != NULL;
+	_lowKeyInclusive = lowKeyInclusive;
+	_highKeyInclusive = highKeyInclusive;
+	_hasLastEntry = false;
+	_lastKeyRids.clear();
+	_keyOps = &IndexManager::getKeyOps(attribute.type);
+	_indexFile = &IndexManager::instance()->getIndexFile(*fileHandle);
+	_previousPage = 0;
+	_batch.clear();
+	_batchOffsets.assign(1, 0);
+	_batchPosition = 0;
+	_keyAttributes.clear();
+	_descending = order == IX_SCAN_DESCENDING;
+	_path.clear();
+
+	// Copy over the key values to local memory
+	if (lowKey)
+	{
+		ret = _lowKey.init(attribute.type, lowKey);
+		RETURN_ON_ERR(ret);
+	}
+
+	if (highKey)
+	{
+		ret = _highKey.init(attribute.type, highKey);
+		RETURN_ON_ERR(ret);
+	}
+
+	// One descent to the first leaf that could hold the low key, everything after that walks the leaf links
+	unsigned char pageBuffer[PAGE_SIZE] = {0};
+	if (_descending)
+	{
+		ret = findLastLeaf(highKey, pageBuffer);
+		RETURN_ON_ERR(ret);
+
+		decodeLeafDescending(pageBuffer);
+		return rc::OK;
+	}
+
+	unsigned version = 0;
+	ret = IndexManager::findLeafPage(*_fileHandle, attribute, lowKey, pageBuffer, version);
+	RETURN_ON_ERR(ret);
+
+	return decodeLeaf(pageBuffer, version);
+}
+
+RC IX_ScanIterator::init(FileHandle* fileHandle, const vector<Attribute> &keyAttributes, const void *lowKey, const void *highKey, bool lowKeyInclusive, bool highKeyInclusive, IX_ScanOrder order)
+{
+	RC ret = init(fileHandle, IndexManager::getCompositeAttribute(keyAttributes), lowKey, highKey, lowKeyInclusive, highKeyInclusive, order);
+	RETURN_ON_ERR(ret);
+
+	_keyAttributes = keyAttributes;
+	return rc::OK;
+}
+
+RC IX_ScanIterator::getNextEntry(RID &rid, void *key)
+{
+	if (!_fileHandle)
+		return IX_EOF;
+
+	while (_batchPosition + 1 >= _batchOffsets.size())
+	{
+		if (_currentPage == 0)
+			return IX_EOF;
+
+		RC ret = readLeaf();
+		RETURN_ON_ERR(ret);
+	}
+
+	// Hand out the next entry of the batch
+	const char* entry = &_batch[_batchOffsets[_batchPosition]];
+	const unsigned entryLength = _batchOffsets[_batchPosition + 1] - _batchOffsets[_batchPosition];
+	memcpy(&rid, entry, sizeof(RID));
+	++_batchPosition;
+
+	if (!_keyAttributes.empty())
+	{
+		return IndexManager::decodeCompositeKey(_keyAttributes, entry + sizeof(RID), key);
+	}
+
+	memcpy(key, entry + sizeof(RID), entryLength - sizeof(RID));
+	return rc::OK;
+}
+
+RC IX_ScanIterator::retireBatch()
+{
+	// Note the entries we handed out at the end of the batch that share the last key. If every entry handed
+	// out shares it, it may carry on a run of that key from earlier batches too
+	if (_batchPosition > 0)
+	{
+		const char* lastEntry = &_batch[_batchOffsets[_batchPosition - 1]];
+		unsigned runStart = _batchPosition - 1;
+		while (runStart > 0 && _keyOps->compareKeys(&_batch[_batchOffsets[runStart - 1]] + sizeof(RID), lastEntry + sizeof(RID)) == 0)
+		{
+			--runStart;
+		}
+
+		if (runStart > 0 || !_hasLastEntry || _keyOps->compareKeys(_lastKey.data(), lastEntry + sizeof(RID)) != 0)
+		{
+			_lastKeyRids.clear();
+		}
+
+		for (unsigned i = runStart; i < _batchPosition; ++i)
+		{
+			_lastKeyRids.push_back(*(const RID*)&_batch[_batchOffsets[i]]);
+		}
+		std::sort(_lastKeyRids.begin(), _lastKeyRids.end(), lessRid);
+
+		_hasLastEntry = true;
+		RC ret = _lastKey.init(_attribute.type, lastEntry + sizeof(RID));
+		RETURN_ON_ERR(ret);
+	}
+
+	_batch.clear();
+	_batchOffsets.assign(1, 0);
+	_batchPosition = 0;
+	return rc::OK;
+}
+
+RC IX_ScanIterator::readLeaf()
+{
+	if (_descending)
+		return readPreviousLeaf();
+
+	RC ret = retireBatch();
+	RETURN_ON_ERR(ret);
+
+	unsigned char pageBuffer[PAGE_SIZE] = {0};
+	IX_PageIndexFooter* footer = IndexManager::getIXPageIndexFooter(pageBuffer);
+	while (_currentPage != 0)
+	{
+		// Each leaf is read whole without latching it, and read again if a writer got to it while we were reading.
+		// If the leaf we came from changed since we read it, its link may no longer lead here, so go back to it
+		IX_Latch* latch = _indexFile->getLatch(_currentPage);
+		const unsigned version = latch->readVersion();
+		if (_previousPage != 0 && !_indexFile->getLatch(_previousPage)->validate(_previousVersion))
+		{
+			_currentPage = _previousPage;
+			_previousPage = 0;
+			continue;
+		}
+
+		ret = _fileHandle->readPage(_currentPage, pageBuffer);
+		RETURN_ON_ERR(ret);
+
+		if (!latch->validate(version))
+			continue;
+
+		// If deletes merged the leaf into its left sibling, its entries are over there now
+		if (footer->isFreePage)
+		{
+			_previousPage = _currentPage;
+			_previousVersion = version;
+			_currentPage = footer->nextLeafPage;
+			continue;
+		}
+
+		return decodeLeaf(pageBuffer, version);
+	}
+
+	return rc::OK;
+}
+
+RC IX_ScanIterator::decodeLeaf(void* pageBuffer, unsigned version)
+{
+	IX_PageIndexFooter* footer = IndexManager::getIXPageIndexFooter(pageBuffer);
+	_previousPage = footer->pageNumber;
+	_previousVersion = version;
+	_currentPage = footer->nextLeafPage;
+
+	// Skip anything below the range, and anything we already handed out
+	unsigned position = 0;
+	if (_hasLowKey)
+	{
+		position = _keyOps->findEntryPosition(pageBuffer, _lowKey.data(), !_lowKeyInclusive);
+	}
+
+	if (_hasLastEntry)
+	{
+		position = std::max(position, _keyOps->findEntryPosition(pageBuffer, _lastKey.data(), false));
+	}
+
+	char entry[PAGE_SIZE];
+	std::vector<RID> rids;
+	for (; position < footer->numSlots; ++position)
+	{
+		// Anything above the range means we are done after this batch
+		if (_hasHighKey)
+		{
+			const int compareResult = _keyOps->compareEntryKey(pageBuffer, position, _highKey.data());
+			if (compareResult > 0 || (compareResult == 0 && !_highKeyInclusive))
+			{
+				_currentPage = 0;
+				break;
+			}
+		}
+
+		// Posting lists are spread out into one [RID][key] entry per RID
+		const unsigned entryLength = IndexManager::readEntry(pageBuffer, position, entry);
+		const unsigned keySize = Attribute::sizeInBytes(_attribute.type, entry + sizeof(RID));
+		const bool isLastKey = _hasLastEntry && _keyOps->compareEntryKey(pageBuffer, position, _lastKey.data()) == 0;
+		IndexManager::decodePosting(_attribute.type, entry, entryLength, rids);
+		for (std::vector<RID>::const_iterator rid = rids.begin(); rid != rids.end(); ++rid)
+		{
+			if (isLastKey && std::binary_search(_lastKeyRids.begin(), _lastKeyRids.end(), *rid, lessRid))
+				continue;
+
+			_batch.insert(_batch.end(), (const char*)&*rid, (const char*)&*rid + sizeof(RID));
+			_batch.insert(_batch.end(), entry + sizeof(RID), entry + sizeof(RID) + keySize);
+			_batchOffsets.push_back(_batch.size());
+		}
+	}
+
+	return rc::OK;
+}
+
+RC IX_ScanIterator::findLastLeaf(const void* key, void* pageBuffer)
+{
+	// Like IndexManager::findLeafPage(), but to the rightmost leaf which could hold key (the last leaf when
+	// there is no key), and keeping a copy of every page on the way
+	IX_PageIndexFooter* footer = IndexManager::getIXPageIndexFooter(pageBuffer);
+	while (true)
+	{
+		_path.clear();
+		IX_Latch* parentLatch = _indexFile->getLatch(0);
+		unsigned parentVersion = parentLatch->readVersion();
+		_rootVersion = parentVersion;
+
+		PageNum pageNum = 0;
+		RC ret = IndexManager::getRootPage(*_fileHandle, pageNum);
+		RETURN_ON_ERR(ret);
+
+		while (true)
+		{
+			IX_Latch* latch = _indexFile->getLatch(pageNum);
+			const unsigned version = latch->readVersion();
+			if (!parentLatch->validate(parentVersion))
+				break;
+
+			ret = IndexManager::readNodePage(*_fileHandle, *_indexFile, pageNum, version, pageBuffer);
+			RETURN_ON_ERR(ret);
+
+			if (!latch->validate(version))
+				break;
+
+			if (footer->isLeafPage)
+				return rc::OK;
+
+			_path.push_back(IX_LookupLevel());
+			IX_LookupLevel& level = _path.back();
+			level.pageNum = pageNum;
+			level.version = version;
+			level.childIndex = key ? _keyOps->findEntryPosition(pageBuffer, key, true) : footer->numSlots;
+			memcpy(level.page, pageBuffer, PAGE_SIZE);
+
+			parentLatch = latch;
+			parentVersion = version;
+			pageNum = IndexManager::getChildPage(pageBuffer, level.childIndex);
+		}
+	}
+}
+
+RC IX_ScanIterator::readPreviousLeaf()
+{
+	RC ret = retireBatch();
+	RETURN_ON_ERR(ret);
+
+	unsigned char pageBuffer[PAGE_SIZE] = {0};
+	IX_PageIndexFooter* footer = IndexManager::getIXPageIndexFooter(pageBuffer);
+	if (_currentPage == 0)
+		return rc::OK;
+
+	// Climb to the nearest page with a child left of the one we came down through, we are done at the left edge
+	while (!_path.empty() && _path.back().childIndex == 0)
+	{
+		_path.pop_back();
+	}
+
+	if (_path.empty())
+	{
+		_currentPage = 0;
+		return rc::OK;
+	}
+
+	// Our copies are only good while nobody has changed the pages, then take the right edge down from the
+	// child to the left
+	bool valid = _indexFile->getLatch(0)->validate(_rootVersion);
+	for (unsigned i = 0; valid && i < _path.size(); ++i)
+	{
+		valid = _indexFile->getLatch(_path[i].pageNum)->validate(_path[i].version);
+	}
+
+	if (valid)
+	{
+		IX_LookupLevel* parent = &_path.back();
+		--parent->childIndex;
+		PageNum pageNum = IndexManager::getChildPage(parent->page, parent->childIndex);
+		while (valid)
+		{
+			IX_Latch* latch = _indexFile->getLatch(pageNum);
+			const unsigned version = latch->readVersion();
+			if (!_indexFile->getLatch(parent->pageNum)->validate(parent->version))
+				break;
+
+			ret = IndexManager::readNodePage(*_fileHandle, *_indexFile, pageNum, version, pageBuffer);
+			RETURN_ON_ERR(ret);
+
+			if (!latch->validate(version))
+				break;
+
+			if (footer->isLeafPage)
+			{
+				decodeLeafDescending(pageBuffer);
+				return rc::OK;
+			}
+
+			_path.push_back(IX_LookupLevel());
+			parent = &_path.back();
+			parent->pageNum = pageNum;
+			parent->version = version;
+			parent->childIndex = footer->numSlots;
+			memcpy(parent->page, pageBuffer, PAGE_SIZE);
+			pageNum = IndexManager::getChildPage(pageBuffer, parent->childIndex);
+		}
+	}
+
+	// A writer changed the way here, go down again to the last key we handed out. Whatever we already returned
+	// from its leaf is skipped
+	ret = findLastLeaf(_hasLastEntry ? _lastKey.data() : (_hasHighKey ? _highKey.data() : NULL), pageBuffer);
+	RETURN_ON_ERR(ret);
+
+	decodeLeafDescending(pageBuffer);
+	return rc::OK;
+}
+
+void IX_ScanIterator::decodeLeafDescending(void* pageBuffer)
+{
+	IX_PageIndexFooter* footer = IndexManager::getIXPageIndexFooter(pageBuffer);
+	_currentPage = footer->pageNumber;
+
+	// Skip anything above the range, and anything after what we already handed out
+	unsigned end = footer->numSlots;
+	if (_hasHighKey)
+	{
+		end = _keyOps->findEntryPosition(pageBuffer, _highKey.data(), _highKeyInclusive);
+	}
+
+	if (_hasLastEntry)
+	{
+		end = std::min(end, _keyOps->findEntryPosition(pageBuffer, _lastKey.data(), true));
+	}
+
+	char entry[PAGE_SIZE];
+	std::vector<RID> rids;
+	for (unsigned position = end; position > 0; --position)
+	{
+		// Anything below the range means we are done after this batch
+		if (_hasLowKey)
+		{
+			const int compareResult = _keyOps->compareEntryKey(pageBuffer, position - 1, _lowKey.data());
+			if (compareResult < 0 || (compareResult == 0 && !_lowKeyInclusive))
+			{
+				_currentPage = 0;
+				break;
+			}
+		}
+
+		const unsigned entryLength = IndexManager::readEntry(pageBuffer, position - 1, entry);
+		const unsigned keySize = Attribute::sizeInBytes(_attribute.type, entry + sizeof(RID));
+		const bool isLastKey = _hasLastEntry && _keyOps->compareEntryKey(pageBuffer, position - 1, _lastKey.data()) == 0;
+		IndexManager::decodePosting(_attribute.type, entry, entryLength, rids);
+		for (std::vector<RID>::const_reverse_iterator rid = rids.rbegin(); rid != rids.rend(); ++rid)
+		{
+			if (isLastKey && std::binary_search(_lastKeyRids.begin(), _lastKeyRids.end(), *rid, lessRid))
+				continue;
+
+			_batch.insert(_batch.end(), (const char*)&*rid, (const char*)&*rid + sizeof(RID));
+			_batch.insert(_batch.end(), entry + sizeof(RID), entry + sizeof(RID) + keySize);
+			_batchOffsets.push_back(_batch.size());
+		}
+	}
+}
+
+RC IX_ScanIterator::close()
+{
+	_fileHandle = NULL;
+	_path.clear();
+
+	return rc::OK;
+}
+
+// Orders [RID][key] entries with equal keys by RID, so a bulk load lays duplicates out in a fixed order
+static int compareEntryRids(const char* lhs, const char* rhs)
+{
+	const RID* leftRid = (const RID*)lhs;
+	const RID* rightRid = (const RID*)rhs;
+	if (leftRid->pageNum != rightRid->pageNum)
+		return leftRid->pageNum < rightRid->pageNum ? -1 : 1;
+	if (leftRid->slotNum != rightRid->slotNum)
+		return leftRid->slotNum < rightRid->slotNum ? -1 : 1;
+	return 0;
+}
+
+template <typename Key>
+struct IX_BulkEntryLess
+{
+	const char* buffer;
+
+	bool operator()(unsigned lhs, unsigned rhs) const
+	{
+		const char* left = buffer + lhs;
+		const char* right = buffer + rhs;
+		const int result = Key::compare(left + sizeof(RID), right + sizeof(RID));
+		return (result != 0 ? result : compareEntryRids(left, right)) < 0;
+	}
+};
+
+template <typename Key>
+static void sortEntriesOf(const char* buffer, std::vector<unsigned>& offsets)
 {
-	return (IX_PageIndexFooter*)getPageIndexFooter(pageBuffer, sizeof(IX_PageIndexFooter));
+	IX_BulkEntryLess<Key> less;
+	less.buffer = buffer;
+	std::sort(offsets.begin(), offsets.end(), less);
 }
 
-const std::vector<Attribute>& IndexManager::getIndexRecordDescriptor(AttrType type)
+// Sort entry offsets by key then RID, with the comparison compiled for the key type
+static void sortEntries(AttrType type, const char* buffer, std::vector<unsigned>& offsets)
 {
-	switch(type)
+	switch (type)
 	{
-	case TypeInt:		return instance()->_indexIntRecordDescriptor;
-	case TypeReal:		return instance()->_indexRealRecordDescriptor;
-	case TypeVarChar:	return instance()->_indexVarCharRecordDescriptor;
-
-	default:			assert(false); return instance()->_indexIntRecordDescriptor;
+		case TypeInt: sortEntriesOf<IX_IntKey>(buffer, offsets); break;
+		case TypeReal: sortEntriesOf<IX_RealKey>(buffer, offsets); break;
+		case TypeVarChar: sortEntriesOf<IX_VarCharKey>(buffer, offsets); break;
 	}
 }
 
-IX_ScanIterator::IX_ScanIterator()
-    :
-    _im(*IndexManager::instance()),
-    _fileHandle(NULL),
-	_attribute(),
-	_lowKeyInclusive(false), 
-	_highKeyInclusive(false),
-	_pastLastRecord(false),
-	_beginRecordRid(),
-	_endRecordRid(),
-    _currentRecordRid(),
-    _nextRecordRid()
+IX_BulkLoader::IX_BulkLoader(const Attribute &attribute, unsigned memoryLimit)
+	: _attribute(attribute), _memoryLimit(memoryLimit), _sorted(false), _nextOffset(0)
 {
 }
 
-IX_ScanIterator::~IX_ScanIterator()
+IX_BulkLoader::~IX_BulkLoader()
 {
-	close();
+	// Temporary files are removed by the system once closed
+	for (unsigned i = 0; i < _runs.size(); ++i)
+	{
+		if (_runs[i].file)
+			fclose(_runs[i].file);
+	}
 }
 
-RC IX_ScanIterator::init(FileHandle* fileHandle, const Attribute &attribute, const void *lowKey, const void *highKey, bool lowKeyInclusive, bool highKeyInclusive)
+RC IX_BulkLoader::addEntry(const void *key, const RID &rid)
 {
-	if (!fileHandle || !fileHandle->hasFile())
-		return rc::FILE_HANDLE_NOT_INITIALIZED;
+	if (_sorted)
+	{
+		return rc::ITERATOR_NEVER_CALLED;
+	}
 
-	if (attribute.length == 0)
-		return rc::ATTRIBUTE_LENGTH_INVALID;
+	const unsigned keySize = Attribute::sizeInBytes(_attribute.type, key);
+	if (keySize == 0)
+	{
+		return rc::ATTRIBUTE_INVALID_TYPE;
+	}
 
-	RC ret = rc::OK;
+	if (sizeof(RID) + keySize > IX_MAX_ENTRY_SIZE)
+	{
+		return rc::BTREE_KEY_TOO_LARGE;
+	}
 
-	_pastLastRecord = false;
-	_fileHandle = fileHandle;
-	_attribute = attribute;
-	_lowKeyInclusive = lowKeyInclusive;
-	_highKeyInclusive = highKeyInclusive;
+	// Spill what we have so far before going over our memory budget
+	if (!_buffer.empty() && _buffer.size() + sizeof(RID) + keySize > _memoryLimit)
+	{
+		RC ret = spillRun();
+		RETURN_ON_ERR(ret);
+	}
 
-	_recordDescriptor = _im.getIndexRecordDescriptor(attribute.type);
-	RETURN_ON_ERR(ret);
+	_offsets.push_back(_buffer.size());
+	_buffer.insert(_buffer.end(), (const char*)&rid, (const char*)&rid + sizeof(RID));
+	_buffer.insert(_buffer.end(), (const char*)key, (const char*)key + keySize);
 
-	// Traverse down the left pointers to find the lowest RID
-	RID lowestPossibleRid;
-	ret = IndexManager::findSmallestLeafIndexEntry(*_fileHandle, lowestPossibleRid);
-	if (ret != rc::OK)
+	return rc::OK;
+}
+
+RC IX_BulkLoader::spillRun()
+{
+	sortEntries(_attribute.type, &_buffer[0], _offsets);
+
+	SortedRun run;
+	run.file = tmpfile();
+	run.memory = NULL;
+	run.nextOffset = 0;
+	run.done = false;
+	if (!run.file)
 	{
-		// Do not error out if the index is empty, simply set up for getNextEntry to fail immediately
-		lowestPossibleRid.pageNum = lowestPossibleRid.slotNum = 0;
+		return rc::FILE_COULD_NOT_OPEN;
 	}
 
-	// Copy over the key values to local memory
-	if (lowKey)
-	{
-		KeyValueData lowKeyValue;
+	_runs.push_back(run);
 
-		// Copy over the key that we will be comparing against on the low end
-		ret = lowKeyValue.init(attribute.type, lowKey);
-		if (ret != rc::OK)
+	// Each entry is written as [length][entry]
+	for (unsigned i = 0; i < _offsets.size(); ++i)
+	{
+		const char* entry = &_buffer[_offsets[i]];
+		const unsigned entryLength = sizeof(RID) + Attribute::sizeInBytes(_attribute.type, entry + sizeof(RID));
+		if (fwrite(&entryLength, sizeof(unsigned), 1, run.file) != 1 || fwrite(entry, entryLength, 1, run.file) != 1)
 		{
-			RETURN_ON_ERR(ret);
-			assert(false);
+			return rc::FILE_CORRUPT;
 		}
+	}
 
-		// Look for something that matches our low end
-		RID entryRid, prevEntryRid, nextEntryRid, dataRid;
-		ret = IndexManager::findIndexEntry(*fileHandle, attribute, &lowKeyValue, entryRid, prevEntryRid, nextEntryRid, dataRid);
-		if (ret != rc::OK)
-		{
-			if (ret != rc::BTREE_INDEX_LEAF_ENTRY_NOT_FOUND && ret != rc::BTREE_CANNOT_FIND_LEAF)
-			{
-				RETURN_ON_ERR(ret);
-				assert(false);
-			}
+	_buffer.clear();
+	_offsets.clear();
+	return rc::OK;
+}
 
-			// We did not find the exact value, so our closest value must be "inclusive"
-			_lowKeyInclusive = true;
-		}
+RC IX_BulkLoader::sort()
+{
+	if (_sorted)
+	{
+		return rc::OK;
+	}
 
-		if (entryRid.pageNum == 0)
-		{
-			// TODO: When is this true?
-			_beginRecordRid = lowestPossibleRid;
-		}
-		else
+	_sorted = true;
+	if (_runs.empty())
+	{
+		// Everything fit in memory, just sort it in place
+		if (!_offsets.empty())
 		{
-			_beginRecordRid = entryRid;
+			sortEntries(_attribute.type, &_buffer[0], _offsets);
 		}
+
+		return rc::OK;
 	}
-	else
+
+	// Otherwise the tail becomes one last run, and we merge all of them
+	if (!_offsets.empty())
 	{
-		_beginRecordRid = lowestPossibleRid;
+		RC ret = spillRun();
+		RETURN_ON_ERR(ret);
 	}
 
-	if (highKey)
+	// Runs handed over by addSortedRuns() already hold their first entry
+	for (unsigned i = 0; i < _runs.size(); ++i)
 	{
-		KeyValueData highKeyValue;
+		if (!_runs[i].entry.empty() || _runs[i].done)
+			continue;
 
-		ret = highKeyValue.init(attribute.type, highKey);
-		if (ret != rc::OK)
-		{
-			RETURN_ON_ERR(ret);
-			assert(false);
-		}
+		rewind(_runs[i].file);
+		RC ret = readRunEntry(_runs[i]);
+		RETURN_ON_ERR(ret);
+	}
 
-		// Look for something that matches our high end
-		RID entryRid, prevEntryRid, nextEntryRid, dataRid;
-		ret = IndexManager::findIndexEntry(*fileHandle, attribute, &highKeyValue, entryRid, prevEntryRid, nextEntryRid, dataRid);
-		if (ret != rc::OK)
-		{
-			if (ret != rc::BTREE_INDEX_LEAF_ENTRY_NOT_FOUND && ret != rc::BTREE_CANNOT_FIND_LEAF)
-			{
-				RETURN_ON_ERR(ret);
-				assert(false);
-			}
+	return rc::OK;
+}
 
-			// We did not find the exact value, current entry is pointing to a value larger than we want
-			_highKeyInclusive = false;
-		}
+RC IX_BulkLoader::addSortedRuns(IX_BulkLoader& part)
+{
+	if (_sorted)
+	{
+		return rc::ITERATOR_NEVER_CALLED;
+	}
 
-		if (entryRid.pageNum == 0)
-		{
-			// TODO: When is this true?
-			ret = IndexManager::findLargestLeafIndexEntry(*fileHandle, attribute, _endRecordRid);
-			RETURN_ON_ERR(ret);
-		}
-		else
-		{
-			_endRecordRid = entryRid;
-		}
+	if (part._attribute.type != _attribute.type)
+	{
+		return rc::ATTRIBUTE_INVALID_TYPE;
 	}
-	else
+
+	RC ret = part.sort();
+	RETURN_ON_ERR(ret);
+
+	// Spilled runs change hands, so only we close their files
+	if (!part._runs.empty())
+	{
+		_runs.insert(_runs.end(), part._runs.begin(), part._runs.end());
+		part._runs.clear();
+		return rc::OK;
+	}
+
+	if (part._offsets.empty())
+	{
+		return rc::OK;
+	}
+
+	SortedRun run;
+	run.file = NULL;
+	run.memory = &part;
+	run.nextOffset = 0;
+	run.done = false;
+	_runs.push_back(run);
+	return readRunEntry(_runs.back());
+}
+
+RC IX_BulkLoader::readRunEntry(SortedRun& run)
+{
+	if (run.memory)
 	{
-		ret = IndexManager::findLargestLeafIndexEntry(*fileHandle, attribute, _endRecordRid);
-		if (ret != rc::OK)
+		if (run.nextOffset >= run.memory->_offsets.size())
 		{
-			// If we cannot find the largest, that means we have no entries at all
-			_beginRecordRid.pageNum = _beginRecordRid.slotNum = 0;
-			_endRecordRid.pageNum = _endRecordRid.slotNum = 0;
+			run.done = true;
+			return rc::OK;
 		}
+
+		const char* source = &run.memory->_buffer[run.memory->_offsets[run.nextOffset++]];
+		run.entry.assign(source, source + sizeof(RID) + Attribute::sizeInBytes(_attribute.type, source + sizeof(RID)));
+		return rc::OK;
 	}
 
-	// Start at the beginning RID (keep track of beginRecordRid just for debug purposes for now)
-	_currentRecordRid = _beginRecordRid;
+	unsigned entryLength = 0;
+	if (fread(&entryLength, sizeof(unsigned), 1, run.file) != 1)
+	{
+		run.done = true;
+		return rc::OK;
+	}
 
-	// Get the next RID also
-	if (_currentRecordRid.pageNum != 0)
+	run.entry.resize(entryLength);
+	if (fread(&run.entry[0], entryLength, 1, run.file) != 1)
 	{
-		_nextRecordRid = _currentRecordRid;
-		ret = _im.getNextRecord(*_fileHandle, _recordDescriptor, _attribute, _nextRecordRid);
-		RETURN_ON_ERR(ret);
+		return rc::FILE_CORRUPT;
 	}
 
 	return rc::OK;
 }
 
-RC IX_ScanIterator::getNextEntry(RID &rid, void *key)
+RC IX_BulkLoader::getNextEntry(void *entry, unsigned &entryLength)
 {
-	RC ret = rc::OK;
-	if (_currentRecordRid.pageNum == 0)
-		return IX_EOF;
-	
-	// Check to see if we're at the beginning
-	if (_currentRecordRid.pageNum == _beginRecordRid.pageNum && _currentRecordRid.slotNum == _beginRecordRid.slotNum)
+	if (!_sorted)
 	{
-		// If we are not inclusive, skip the 1st record
-		if (!_lowKeyInclusive)
-		{
-			ret = advance();
-			RETURN_ON_ERR(ret);
-		}
+		return rc::ITERATOR_NEVER_CALLED;
 	}
 
-	// Check to see if we're at the end
-	if (_pastLastRecord)
+	if (_runs.empty())
 	{
-		_currentRecordRid.pageNum = 0;
+		if (_nextOffset >= _offsets.size())
+		{
+			return IX_EOF;
+		}
+
+		const char* source = &_buffer[_offsets[_nextOffset++]];
+		entryLength = sizeof(RID) + Attribute::sizeInBytes(_attribute.type, source + sizeof(RID));
+		memcpy(entry, source, entryLength);
+		return rc::OK;
 	}
-	else if (_currentRecordRid.pageNum == _endRecordRid.pageNum && _currentRecordRid.slotNum == _endRecordRid.slotNum)
+
+	// Take the smallest head out of all the runs
+	const IX_KeyOps& keyOps = IndexManager::getKeyOps(_attribute.type);
+	SortedRun* smallest = NULL;
+	for (unsigned i = 0; i < _runs.size(); ++i)
 	{
-		// If we are not inclusive, skip the record
-		if (_highKeyInclusive)
+		if (_runs[i].done)
 		{
-			_pastLastRecord = true;
+			continue;
 		}
-		else
+
+		int result = -1;
+		if (smallest)
+		{
+			const char* head = &_runs[i].entry[0];
+			result = keyOps.compareKeys(head + sizeof(RID), &smallest->entry[sizeof(RID)]);
+			if (result == 0)
+				result = compareEntryRids(head, &smallest->entry[0]);
+		}
+
+		if (result < 0)
 		{
-			_currentRecordRid.pageNum = 0;
+			smallest = &_runs[i];
 		}
 	}
 
-	// Make sure we support very small ranges, of size 1 or 2 with all types of inclusivity
-	if (_currentRecordRid.pageNum == 0)
+	if (!smallest)
 	{
 		return IX_EOF;
 	}
 
-	// We have a valid record, pull the data RID and key value and return it
-	IndexRecord record;
-	ret = _im.readRecord(*_fileHandle, _recordDescriptor, _currentRecordRid, &record);
-	rid = record.rid;
-	switch (_attribute.type)
-	{
-		case TypeInt:
-			memcpy(key, &record.key.integer, sizeof(unsigned));
-			break;
-		case TypeReal:
-			memcpy(key, &record.key.real, sizeof(float));
-			break;
-		case TypeVarChar:
-			int size = 0;
-			memcpy(&size, record.key.varchar, sizeof(unsigned));
-			memcpy(key, record.key.varchar, sizeof(unsigned) + size);
-	}
+	entryLength = smallest->entry.size();
+	memcpy(entry, &smallest->entry[0], entryLength);
+	return readRunEntry(*smallest);
+}
 
-	// Advance to the next record
-	ret = advance();
-	RETURN_ON_ERR(ret);
+void IX_PrintError (RC rc)
+{
+    std::cout << rc::rcToString(rc);
+}
+
+KeyValueData::KeyValueData()
+	: _size(0), _capacity(IX_INLINE_KEY_SIZE), _data(_inline)
+{
+}
+
+KeyValueData::KeyValueData(const KeyValueData& that)
+	: _size(0), _capacity(IX_INLINE_KEY_SIZE), _data(_inline)
+{
+	assign(that._data, that._size);
+}
 
-    return rc::OK;
+KeyValueData::KeyValueData(KeyValueData&& that)
+	: _size(0), _capacity(IX_INLINE_KEY_SIZE), _data(_inline)
+{
+	*this = std::move(that);
+}
+
+KeyValueData::~KeyValueData()
+{
+	release();
 }
 
-RC IX_ScanIterator::advance()
+KeyValueData& KeyValueData::operator=(const KeyValueData& that)
 {
-	RC ret = _im.getNextRecord(*_fileHandle, _recordDescriptor, _attribute, _currentRecordRid);
-	
-	// If we are off the edge, our scan is done
-	if (ret != rc::OK && ret == rc::BTREE_INDEX_LEAF_ENTRY_NOT_FOUND)
+	if (this != &that)
 	{
-		_currentRecordRid.pageNum = _currentRecordRid.slotNum = 0;
-		_nextRecordRid.pageNum = _nextRecordRid.slotNum = 0;
-		return rc::OK;
+		assign(that._data, that._size);
 	}
 
-	RETURN_ON_ERR(ret);
+	return *this;
+}
+
+KeyValueData& KeyValueData::operator=(KeyValueData&& that)
+{
+	if (this == &that)
+	{
+		return *this;
+	}
 
-	if (_currentRecordRid.pageNum == 0)
+	if (that._data == that._inline)
 	{
-		_nextRecordRid.pageNum = 0;
+		assign(that._data, that._size);
 	}
 	else
 	{
-		_nextRecordRid = _currentRecordRid;
-		ret = _im.getNextRecord(*_fileHandle, _recordDescriptor, _attribute, _nextRecordRid);
+		// Steal the heap buffer instead of copying it
+		release();
+		_data = that._data;
+		_size = that._size;
+		_capacity = that._capacity;
 
-		// nextRecord will go off the edge before we are done scanning, so allow it to fail
-		if (ret != rc::OK && ret != rc::BTREE_INDEX_LEAF_ENTRY_NOT_FOUND)
-		{
-			RETURN_ON_ERR(ret);
-		}
+		that._data = that._inline;
+		that._capacity = IX_INLINE_KEY_SIZE;
 	}
 
-	return rc::OK;
+	that._size = 0;
+	return *this;
 }
 
-RC IX_ScanIterator::close()
+void KeyValueData::assign(const void* key, unsigned size)
 {
-	_fileHandle = NULL;
+	if (size > _capacity)
+	{
+		release();
+		_data = (char*)malloc(size);
+		_capacity = size;
+	}
 
-	return rc::OK;
+	memcpy(_data, key, size);
+	_size = size;
 }
 
-void IX_PrintError (RC rc)
+void KeyValueData::release()
 {
-    std::cout << rc::rcToString(rc);
+	if (_data != _inline)
+	{
+		free(_data);
+		_data = _inline;
+		_capacity = IX_INLINE_KEY_SIZE;
+	}
+
+	_size = 0;
 }
 
 RC KeyValueData::init(AttrType type, const void* key)
 {
-	// Build the key struct for the index 
 	switch (type)
 	{
 		case TypeInt:
-			size = sizeof(unsigned);
-			memcpy(&integer, key, sizeof(unsigned));
-
 		case TypeReal:
-			size = sizeof(float);
-			memcpy(&real, key, sizeof(float));
+			assign(key, sizeof(unsigned));
 			break;
 
 		case TypeVarChar:
-			size = *((unsigned*)(key));
-			memcpy(&size, key, sizeof(unsigned));
-			memcpy(varchar, key, size + sizeof(unsigned));
+		{
+			unsigned length = 0;
+			memcpy(&length, key, sizeof(unsigned));
+			if (length > MAX_KEY_SIZE)
+				return rc::BTREE_KEY_TOO_LARGE;
+
+			assign(key, sizeof(unsigned) + length);
+		}
 		break;
 
 		default:
@@ -1595,60 +3649,31 @@ RC KeyValueData::init(AttrType type, const void* key)
 	return rc::OK;
 }
 
-RC KeyValueData::compare(AttrType type, const KeyValueData& that, int& result)
+RC KeyValueData::compare(AttrType type, const KeyValueData& that, int& result) const
 {
-	switch (type)
-	{
-		case TypeInt:
-			result = integer - that.integer;
-			break;
-
-		case TypeReal:
-			if (real < that.real)
-				result = -1;
-			else if (real == that.real)
-				result = 0;
-			else
-				result = 1;
-			break;
-
-		case TypeVarChar:
-			result = strncmp(varchar + sizeof(unsigned), that.varchar + sizeof(unsigned), std::min(size, that.size));
-			if (result == 0)
-			{
-				if (size < that.size)
-					result = -1;
-				else if (size > that.size)
-					result = 1;
-				else
-					return 0;
-			}
-			break;
-
-		default:
-			return rc::ATTRIBUTE_INVALID_TYPE;
-	}
+	if (type != TypeInt && type != TypeReal && type != TypeVarChar)
+		return rc::ATTRIBUTE_INVALID_TYPE;
 
+	result = IndexManager::compareKeys(type, _data, that._data);
 	return rc::OK;
 }
 
-void KeyValueData::print(AttrType type)
+void KeyValueData::print(AttrType type) const
 {
 	switch (type)
 	{
 		case TypeInt:
-			std::cout << integer;
+			std::cout << *(const int*)_data;
 			break;
 
 		case TypeReal:
-			std::cout << real;
+			std::cout << *(const float*)_data;
 			break;
 
 		case TypeVarChar:
 			{
-				char stringBuffer[MAX_KEY_SIZE+1] = {0};
-				memcpy(stringBuffer, varchar+4, size);
-				std::string s(stringBuffer);
+				const unsigned size = _size - sizeof(unsigned);
+				std::string s(_data + sizeof(unsigned), size);
 
 				if (size==1)
 				{
@@ -1665,7 +3690,6 @@ void KeyValueData::print(AttrType type)
 				{
 					std::cout << "(" << size << ")'" << s << "'";
 				}
-				
 			}
 			break;
 
@@ -1676,34 +3700,27 @@ void KeyValueData::print(AttrType type)
 
 std::ostream& operator<<(std::ostream& os, const IX_PageIndexFooter& f)
 {
-	if (f.isLeafPage)
+	const unsigned freeSpace = PAGE_SIZE - sizeof(IX_PageIndexFooter) - f.numSlots * sizeof(IX_EntrySlot) - f.freeSpaceOffset;
+	if (f.isFreePage)
+	{
+		os << "Free Page: ";
+		os << "nextFreePage=" << f.leftChild;
+	}
+	else if (f.isLeafPage)
 	{
 		os << "Leaf Page: ";
-		os << "firstRecord: " << f.firstRecord;
-		os << " leftChild=" << f.leftChild << " nextLeafPage=" << f.nextLeafPage;
-		os << " gap=" << f.gapSize << " free=" << IndexManager::instance()->calculateFreespace(f.freeSpaceOffset, f.numSlots, sizeof(IX_PageIndexFooter)) << " slots=" << f.numSlots;
+		os << "nextLeafPage=" << f.nextLeafPage;
 	}
 	else
 	{
 		os << "Non-Leaf Page: ";
-		os << "firstRecord=" << f.firstRecord;
-		os << " leftChild=" << f.leftChild;
-		os << " gap=" << f.gapSize << " free=" << IndexManager::instance()->calculateFreespace(f.freeSpaceOffset, f.numSlots, sizeof(IX_PageIndexFooter)) << " slots=" << f.numSlots;
+		os << "leftChild=" << f.leftChild;
 	}
 
+	os << " gap=" << f.gapSize << " free=" << freeSpace << " slots=" << f.numSlots << " prefix=" << f.prefixLength;
 	return os;
 }
 
-void IndexRecord::print(AttrType type, bool isLeaf)
-{
-	key.print(type);
-	std::cout << "\tnext=" << nextSlot << " ";
-	if (isLeaf)
-		std::cout << "\tdata=" << rid;
-	else
-		std::cout << "\tpage=" << rid;
-}
-
 RC IndexManager::printIndex(FileHandle& fileHandle, const Attribute& attribute, bool extended)
 {
 	return printIndex(fileHandle, attribute, extended, false, 0);
@@ -1712,61 +3729,73 @@ RC IndexManager::printIndex(FileHandle& fileHandle, const Attribute& attribute,
 RC IndexManager::validateIndex(FileHandle& fileHandle, const Attribute& attribute)
 {
 	bool ok = true;
-	IndexManager* im = IndexManager::instance();
-	const std::vector<Attribute>& recordDescriptor = getIndexRecordDescriptor(attribute.type);
-	
-	PageNum currentPage = 1;
-	IndexRecord currEntry;
 	unsigned char pageBuffer[PAGE_SIZE] = {0};
 	IX_PageIndexFooter* footer = getIXPageIndexFooter(pageBuffer);
 
-	// Loop through all pages and print a summary of the data
-	while(currentPage < fileHandle.getNumberOfPages())
+	// Every page must have its slots in key order
+	for (PageNum page = 1; page < fileHandle.getNumberOfPages(); ++page)
 	{
-		RC ret = fileHandle.readPage(currentPage, pageBuffer);
+		RC ret = fileHandle.readPage(page, pageBuffer);
 		RETURN_ON_ERR(ret);
 
-		// Iterate through all slots on the page
-		RID curRid;
-		curRid.pageNum = footer->pageNumber;
-		curRid.slotNum = 0;
-		bool foundLastSlot = false;
+		if (footer->isFreePage)
+			continue;
 
-		while(curRid.slotNum < footer->numSlots)
+		char previousKey[PAGE_SIZE];
+		char key[PAGE_SIZE];
+		for (unsigned i = 1; i < footer->numSlots; ++i)
 		{
-			ret = im->readRecord(fileHandle, recordDescriptor, curRid, &currEntry, pageBuffer);
-			if (ret != rc::OK)
+			readEntryKey(pageBuffer, i - 1, previousKey);
+			readEntryKey(pageBuffer, i, key);
+			if (compareKeys(attribute.type, previousKey, key) > 0)
 			{
-				if (ret == rc::RECORD_DELETED)
-				{
-					std::cout << "s=" << curRid.slotNum << "\tDELETED\n";
-					curRid.slotNum++;
-					continue;
-				}
-				else
-				{
-					RETURN_ON_ERR(ret);
-				}
+				std::cout << "Page " << page << " has slot " << i << " out of order\n";
+				ok = false;
 			}
+		}
 
-			if (currEntry.nextSlot.pageNum == 0)
+		// And every posting list must have its RIDs in order
+		std::vector<RID> rids;
+		for (unsigned i = 0; i < footer->numSlots && footer->isLeafPage; ++i)
+		{
+			char entry[PAGE_SIZE];
+			decodePosting(attribute.type, entry, readEntry(pageBuffer, i, entry), rids);
+			for (unsigned r = 1; r < rids.size(); ++r)
 			{
-				if (foundLastSlot)
+				if (lessRid(rids[r], rids[r - 1]))
 				{
-					std::cout << "Found slot that is past the end!\n";
-					std::cout << "s=" << curRid.slotNum << "\tkey=";
-					currEntry.print(attribute.type, footer->isLeafPage);
-					std::cout << "\n";
+					std::cout << "Page " << page << " has slot " << i << " with RIDs out of order\n";
 					ok = false;
 				}
+			}
+		}
+	}
+
+	// And the leaf chain must be in key order from one page to the next
+	RC ret = findLeafPage(fileHandle, attribute, NULL, pageBuffer);
+	RETURN_ON_ERR(ret);
 
-				foundLastSlot = true;
+	char lastKey[PAGE_SIZE];
+	bool hasLastKey = false;
+	while (true)
+	{
+		if (footer->numSlots > 0)
+		{
+			if (hasLastKey && compareEntryKey(pageBuffer, attribute.type, 0, lastKey) < 0)
+			{
+				std::cout << "Leaf " << footer->pageNumber << " starts below the end of the previous leaf\n";
+				ok = false;
 			}
 
-			curRid.slotNum++;
+			readEntryKey(pageBuffer, footer->numSlots - 1, lastKey);
+			hasLastKey = true;
 		}
-		
-		++currentPage;
+
+		if (footer->nextLeafPage == 0)
+			break;
+
+		ret = fileHandle.readPage(footer->nextLeafPage, pageBuffer);
+		RETURN_ON_ERR(ret);
 	}
 
 	return ok ? rc::OK : rc::FILE_CORRUPT;
@@ -1774,108 +3803,60 @@ RC IndexManager::validateIndex(FileHandle& fileHandle, const Attribute& attribut
 
 RC IndexManager::printIndex(FileHandle& fileHandle, const Attribute& attribute, bool extended, bool restrictToPage, PageNum restrictPage)
 {
-	IndexManager* im = IndexManager::instance();
-
 	std::cout << "BEGIN==============" << fileHandle.getFilename() << "==============" << "\n";
-	
-	const std::vector<Attribute>& recordDescriptor = getIndexRecordDescriptor(attribute.type);
-	std::cout << "RecordDescriptor: [ ";
-	for (std::vector<Attribute>::const_iterator it=recordDescriptor.begin(); it!=recordDescriptor.end(); ++it)
-	{
-		std::cout << (*it) << " ";
-	}
-	std::cout << "]" << "\n";
-	
 	std::cout << "Pages: " << fileHandle.getNumberOfPages();
 
-	PageNum currentPage = 1;
-	IndexRecord currEntry;
 	unsigned char pageBuffer[PAGE_SIZE] = {0};
 	IX_PageIndexFooter* footer = getIXPageIndexFooter(pageBuffer);
 
+	RC ret = readRootPage(fileHandle, pageBuffer);
+	RETURN_ON_ERR(ret);
 	std::cout << "\tRoot: " << footer->pageNumber << "\n" << std::endl;
 
 	// Loop through all pages and print a summary of the data
-	while(currentPage < fileHandle.getNumberOfPages())
+	for (PageNum currentPage = 1; currentPage < fileHandle.getNumberOfPages(); ++currentPage)
 	{
 		if (restrictToPage && currentPage != restrictPage)
 		{
-			++currentPage;
 			continue;
 		}
 
-		RC ret = fileHandle.readPage(currentPage, pageBuffer);
+		ret = fileHandle.readPage(currentPage, pageBuffer);
 		RETURN_ON_ERR(ret);
 
 		// Print out page basics
-		std::cout << "---Page: " << currentPage << "  " << *footer;
-		std::cout << "\n";
-
-		std::cout << "Record List: ";
-		{
-			// Print out all records pointed to on this page
-			RID curRid = footer->firstRecord;
-			while (curRid.pageNum > 0)
-			{
-				ret = im->readRecord(fileHandle, recordDescriptor, curRid, &currEntry, pageBuffer);
-				// RETURN_ON_ERR(ret);
-
-				std::cout << curRid.slotNum << " > ";
-				curRid = currEntry.nextSlot;
-			}
-		}
+		std::cout << "---Page: " << currentPage << "  " << *footer << "\n";
 
-		std::cout << "x" << "\n";
 		if (extended)
 		{
-			// Print out all the slots on this page
-			RID curRid;
-			curRid.pageNum = footer->pageNumber;
-			curRid.slotNum = 0;
-
-			while(curRid.slotNum < footer->numSlots)
+			// Print out every entry in key order
+			for (unsigned i = 0; i < footer->numSlots; ++i)
 			{
-				ret = im->readRecord(fileHandle, recordDescriptor, curRid, &currEntry, pageBuffer);
-				if (ret != rc::OK)
-				{
-					if (ret == rc::RECORD_DELETED)
-					{
-						std::cout << "s=" << curRid.slotNum << "\tDELETED\n";
-						curRid.slotNum++;
-						continue;
-					}
-					else
-					{
-						RETURN_ON_ERR(ret);
-					}
-				}
-
-				std::cout << "s=" << curRid.slotNum << "\tkey=";
-				currEntry.print(attribute.type, footer->isLeafPage);
-				std::cout << "\n";
+				char keyBuffer[PAGE_SIZE];
+				readEntryKey(pageBuffer, i, keyBuffer);
 
-				curRid.slotNum++;
-			}
-		}
-		else
-		{
-			// Print out all records pointed to on this page
-			RID curRid = footer->firstRecord;
-			while (curRid.pageNum > 0)
-			{
-				ret = im->readRecord(fileHandle, recordDescriptor, curRid, &currEntry, pageBuffer);
+				KeyValueData key;
+				ret = key.init(attribute.type, keyBuffer);
 				RETURN_ON_ERR(ret);
 
-				std::cout << "s=" << curRid.slotNum << "\tkey=";
-				currEntry.print(attribute.type, footer->isLeafPage);
+				std::cout << "s=" << i << "\tkey=";
+				key.print(attribute.type);
+				if (footer->isLeafPage)
+				{
+					char entry[PAGE_SIZE];
+					std::vector<RID> rids;
+					decodePosting(attribute.type, entry, readEntry(pageBuffer, i, entry), rids);
+					std::cout << "\tdata=";
+					for (unsigned r = 0; r < rids.size(); ++r)
+						std::cout << (r > 0 ? "," : "") << rids[r];
+				}
+				else
+					std::cout << "\tpage=" << getChildPage(pageBuffer, i + 1);
 				std::cout << "\n";
-
-				curRid = currEntry.nextSlot;
 			}
 		}
 
 		std::cout << "\n";
-		++currentPage;
 	}
 
 	std::cout << "==============" << fileHandle.getFilename() << "==============END" << std::endl;
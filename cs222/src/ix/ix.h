@@ -5,6 +5,11 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <map>
+#include <cstdio>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 #include "../rbf/rbcm.h"
 
@@ -12,45 +17,304 @@
 
 #define MAX_KEY_SIZE 2048
 
+// Keys this size or smaller are held without a heap allocation, room for any int, real or short varchar
+#define IX_INLINE_KEY_SIZE 16
+
+// Default fraction of each page a bulk load fills, the rest is left free for later inserts
+#define IX_DEFAULT_FILL_FACTOR 0.9f
+
+// Default fraction of the entries an insert that splits a page leaves on the left. A split at the right edge
+// of the tree with the new entry at the end leaves the left page full instead, keys that only ever go up
+// will never come back to it
+#define IX_DEFAULT_SPLIT_FILL_FACTOR 0.5f
+
+// Smallest split fill factor a file keeps, a stored 0 is taken for a file written before the factor was kept
+#define IX_MIN_SPLIT_FILL_FACTOR 0.01f
+
+// Pages using less than this fraction of their space after a delete are merged with or topped up from a sibling
+#define IX_MIN_FILL_FACTOR 0.25f
+
+// Bytes of entries a bulk load sorts in memory before spilling a sorted run to disk
+#define IX_BULK_LOAD_MEMORY (16 * 1024 * 1024)
+
+// Page latches are made a chunk at a time, and the directory of chunks covers this many pages without locking
+#define IX_LATCH_CHUNK_SIZE 1024
+#define IX_LATCH_CHUNKS 4096
+
+// B+tree page layout
+/*
+Entries are packed from the start of the page, and a directory of slots grows down from the footer.
+The slots are kept in key order, so slot i always names the i-th smallest key on the page, which
+lets us binary search a node with a single page read and insert by shifting slots instead of entries.
+Leaf entries are [data RID][key][more data RIDs], non-leaf entries are [child PageNum][key]
+A leaf entry is a posting list, it holds one key with the RIDs stored under it in RID order. The first
+RID is kept whole and each one after the key as varints of its difference from the one before, and once
+an entry reaches the largest entry size further RIDs for its key start another entry beside it
+On varchar pages the characters every key on the page starts with are stored once as the page prefix,
+and each entry only keeps the rest of its key as [length][characters]
+The reserved page ends with the split fill factor, the head of the free page list and the root page number
+/-----------------------------------------\
+| Page N                                  |
+| --------------------------------------- |
+| [Prefix][Entry][Entry][Entry][Entry]... |
+|               <free space>              |
+|                                         |
+| [IX_EntrySlot_K] ... [IX_EntrySlot_0]   |
+| [IX_PageIndexFooter]                    |
+\-----------------------------------------/
+*/
+struct IX_EntrySlot
+{
+	unsigned short offset;
+	unsigned short length;
+};
+
 struct IX_PageIndexFooter : CorePageIndexFooter
 {
 	bool isLeafPage;
-	RID firstRecord;
+
+	// A free page links to the next free page through leftChild. If it was a leaf merged into its left
+	// sibling, nextLeafPage names that sibling and mergedSlot is where its first entry ended up there
+	bool isFreePage;
+	unsigned mergedSlot;
 
 	// Tree pointers
 	PageNum nextLeafPage; // ignored by non-leaf pages
-	PageNum leftChild; // ignored by leaf pages
+	PageNum leftChild; // ignored by leaf pages, holds every key smaller than the first entry
+	unsigned prefixLength; // key characters shared by every entry, stored at the start of the page
 
 	friend std::ostream& operator<<(std::ostream& os, const IX_PageIndexFooter& f);
 };
 
-struct KeyValueData
+// An index key in the same format as insertEntry() takes it. Keys up to IX_INLINE_KEY_SIZE bytes are kept
+// inline and only long varchars go to the heap, so int and real keys copy just their 4 bytes
+class KeyValueData
 {
-	int size;
+public:
+	KeyValueData();
+	KeyValueData(const KeyValueData& that);
+	KeyValueData(KeyValueData&& that);
+	~KeyValueData();
+
+	KeyValueData& operator=(const KeyValueData& that);
+	KeyValueData& operator=(KeyValueData&& that);
+
+	RC init(AttrType type, const void* key);
+	RC compare(AttrType type, const KeyValueData& that, int& result) const;
+	void print(AttrType type) const;
 
-	// This is a super lazy way to not have to dynamically allocate based on the size every time
-	// Values in unions 'overlap' so we only use MAX_KEY_SIZE bytes, but we can index into the data as an int or float
-	union
+	const void* data() const { return _data; }
+	unsigned size() const { return _size; }
+
+private:
+	void assign(const void* key, unsigned size);
+	void release();
+
+	unsigned _size;
+	unsigned _capacity;
+	char* _data;
+	char _inline[IX_INLINE_KEY_SIZE];
+};
+
+// Collects (key, RID) pairs for IndexManager::bulkLoad() and hands them back sorted by key then RID.
+// Entries are sorted in memory, once they outgrow the memory budget each sorted run is spilled to a
+// temporary file and the runs are merged as the entries are read back out
+class IX_BulkLoader
+{
+public:
+	IX_BulkLoader(const Attribute &attribute, unsigned memoryLimit = IX_BULK_LOAD_MEMORY);
+	~IX_BulkLoader();
+
+	RC addEntry(const void *key, const RID &rid);
+	RC sort();
+
+	// Entries come back as [RID][key], the same as a leaf page stores them
+	RC getNextEntry(void *entry, unsigned &entryLength);
+
+	// Merge everything part collected as more runs of ours. Loaders filled and sorted on their own threads come
+	// together like this, part hands over its spilled runs but has to outlive us if its entries stayed in memory
+	RC addSortedRuns(IX_BulkLoader& part);
+
+private:
+	// A run is either spilled to a file, or the in-memory entries of another sorted loader
+	struct SortedRun
 	{
-		int integer;
-		float real;
-		char varchar[MAX_KEY_SIZE+sizeof(unsigned)];
+		FILE* file;
+		const IX_BulkLoader* memory;
+		unsigned nextOffset;
+		std::vector<char> entry;
+		bool done;
 	};
 
-	RC init(AttrType type, const void* key);
-	RC compare(AttrType type, const KeyValueData& that, int& result);
-	void print(AttrType type);
+	RC spillRun();
+	RC readRunEntry(SortedRun& run);
+
+	Attribute _attribute;
+	unsigned _memoryLimit;
+	bool _sorted;
+
+	std::vector<char> _buffer;
+	std::vector<unsigned> _offsets;
+	unsigned _nextOffset;
+	std::vector<SortedRun> _runs;
+};
+
+// A non-leaf node that a bulk load is still filling, one per level of the tree
+struct IX_BulkLoadNode
+{
+	unsigned char pageBuffer[PAGE_SIZE];
+	KeyValueData firstKey; // separator below every key under this node, it goes into the parent with it
+};
+
+// Key comparison and page search for one key type. Each set is instantiated from templates specialised
+// for that type, so the search loops never switch on it. Look one up once per call with getKeyOps()
+struct IX_KeyOps
+{
+	int (*compareKeys)(const void* lhs, const void* rhs);
+	int (*compareEntryKey)(void* pageBuffer, unsigned position, const void* key);
+	unsigned (*findEntryPosition)(void* pageBuffer, const void* key, bool upperBound);
+};
+
+// A reader/writer latch on one index page. Latches are only held while an operation works on the page,
+// never across calls, and writers go ahead of readers that arrive after them.
+// The version goes up when a writer takes the latch and again when it lets go, so it is odd while the page
+// may be changing. Optimistic readers take no latch at all, they note the version before reading the page
+// and check it is still the same afterwards
+class IX_Latch
+{
+public:
+	IX_Latch();
+
+	void lockShared();
+	void unlockShared();
+	void lock();
+	void unlock();
+
+	unsigned readVersion(); // waits out any writer
+	bool validate(unsigned version) const { return _version.load() == version; }
+
+private:
+	std::mutex _mutex;
+	std::condition_variable _changed;
+	unsigned _readers;
+	unsigned _waitingWriters;
+	bool _writer;
+	std::atomic<unsigned> _version;
+};
+
+// A copy of a non-leaf page, good for as long as the page's latch stays at the version it was taken at.
+// The sequence is odd while the copy is being replaced, readers check it is even and unchanged around their copy
+struct IX_CachedNode
+{
+	std::atomic<unsigned> sequence;
+	std::atomic<unsigned> version;
+	unsigned char page[PAGE_SIZE];
+};
+
+// Everything we keep in memory for one page
+struct IX_PageState
+{
+	IX_PageState();
+	~IX_PageState();
+
+	IX_Latch latch;
+	std::atomic<IX_CachedNode*> node;
+};
+
+// What every handle open on one index file shares in memory: a latch per page, copies of the non-leaf
+// pages and the root page number. Looking any of them up never takes a lock, so readers on different
+// threads do not contend for anything, and a lookup only has to read its leaf from the file
+class IX_IndexFile
+{
+public:
+	IX_IndexFile();
+	~IX_IndexFile();
+
+	IX_Latch* getLatch(PageNum pageNum);
+
+	PageNum getRootPage() const { return _rootPage.load(); } // 0 until it is read from the reserved page
+	void setRootPage(PageNum rootPage) { _rootPage.store(rootPage); }
+
+	float getSplitFillFactor() const { return _splitFillFactor.load(); }
+	void setSplitFillFactor(float splitFillFactor) { _splitFillFactor.store(splitFillFactor); }
+
+	// The rightmost leaf while inserts keep landing on it, 0 once one goes anywhere else. Only a hint, an
+	// insert checks the page is still the rightmost leaf under its latch before using it
+	PageNum getAppendLeaf() const { return _appendLeaf.load(); }
+	void setAppendLeaf(PageNum appendLeaf) { _appendLeaf.store(appendLeaf); }
+
+	bool readCachedNode(PageNum pageNum, unsigned version, void* pageBuffer);
+	void cacheNode(PageNum pageNum, unsigned version, const void* pageBuffer);
+	void clearNodeCache(); // for pages rewritten without latching them, when the file is rebuilt or recreated, also forgets the append leaf
+
+private:
+	IX_PageState* getPageState(PageNum pageNum);
+
+	std::atomic<IX_PageState*> _chunks[IX_LATCH_CHUNKS];
+	std::atomic<PageNum> _rootPage;
+	std::atomic<float> _splitFillFactor;
+	std::atomic<PageNum> _appendLeaf;
+
+	// Pages past what the chunks cover, which only huge indexes reach
+	std::mutex _overflowMutex;
+	std::map<PageNum, IX_PageState*> _overflow;
 };
 
-struct IndexRecord
+// The latches one operation holds, in the order it took them. Whatever is still held goes on destruction
+class IX_LatchSet
 {
-	RID nextSlot;
-	RID rid; // Leaf==dataRid, Non-Leaf==pageRid
-	KeyValueData key;
+public:
+	~IX_LatchSet();
+
+	void acquire(FileHandle& fileHandle, PageNum pageNum, bool exclusive);
+	void releaseLast();
+	void releaseAncestors(); // everything but the latch taken last
+	void releaseAll();
+
+private:
+	struct HeldLatch
+	{
+		IX_Latch* latch;
+		bool exclusive;
+	};
+
+	void release(const HeldLatch& held);
 
-	void print(AttrType type, bool isLeaf);
+	std::vector<HeldLatch> _held;
 };
 
+// How a writer's descent latches the pages on its way down to a leaf (readers use findLeafPage(), which
+// latches nothing). Every mode couples latches, the child is latched before the parent is let go, and the
+// reserved page stands in as the parent of the root
+enum IX_DescentMode
+{
+	IX_DESCENT_OPTIMISTIC, // shared latches, but the leaf is latched for writing
+	IX_DESCENT_INSERT,     // exclusive latches, let go above any page that can take an entry without splitting
+	IX_DESCENT_DELETE,     // exclusive latches, let go above any page that can lose an entry without underflowing
+	IX_DESCENT_EXCLUSIVE   // exclusive latches on the whole path, held until the operation is done
+};
+
+// A non-leaf page and the child we followed out of it, used to walk back up the tree on a split or merge
+struct IX_PathEntry
+{
+	PageNum pageNum;
+	unsigned childIndex;
+	bool lastChild; // childIndex is the page's rightmost child
+};
+
+// A copy of a non-leaf page a reader came down through and the child it took, good while the page's latch stays
+// at version. Keeping the path lets a reader move to a neighbouring subtree without starting from the root
+struct IX_LookupLevel
+{
+	PageNum pageNum;
+	unsigned version;
+	unsigned childIndex;
+	unsigned char page[PAGE_SIZE];
+};
+
+// Which way a scan hands out its range
+typedef enum { IX_SCAN_ASCENDING = 0, IX_SCAN_DESCENDING } IX_ScanOrder;
+
 class IX_ScanIterator;
 class IndexManager : public RecordBasedCoreManager {
  public:
@@ -59,9 +323,9 @@ class IndexManager : public RecordBasedCoreManager {
   // Override parent createFile
   virtual RC createFile(const string &fileName);
   virtual RC openFile(const string &fileName, FileHandle &fileHandle);
+  virtual RC deleteRecords(FileHandle &fileHandle);
 
 	// From RecordBasedCoreManager
-	// virtual RC updateRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, const RID &rid);
 	virtual RC readAttribute(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid, const string attributeName, void *data);
 	virtual RC reorganizePage(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const unsigned pageNumber);
 
@@ -72,6 +336,19 @@ class IndexManager : public RecordBasedCoreManager {
   RC insertEntry(FileHandle &fileHandle, const Attribute &attribute, const void *key, const RID &rid);  // Insert new index entry
   RC deleteEntry(FileHandle &fileHandle, const Attribute &attribute, const void *key, const RID &rid);  // Delete index entry
 
+  // Composite keys over an ordered list of attributes, passed as the concatenation of their values. They are stored
+  // as a single varchar key whose bytes sort the way the values do, attribute by attribute
+  RC insertEntry(FileHandle &fileHandle, const vector<Attribute> &attributes, const void *key, const RID &rid);
+  RC deleteEntry(FileHandle &fileHandle, const vector<Attribute> &attributes, const void *key, const RID &rid);
+
+  // Fraction of the entries a split leaves on the left page, kept in the index file. Splits at the right edge
+  // of the tree that are appending leave the left page full whatever it is. Clamped to [IX_MIN_SPLIT_FILL_FACTOR, 1]
+  RC setSplitFillFactor(FileHandle &fileHandle, float splitFillFactor);
+  float getSplitFillFactor(FileHandle &fileHandle);
+
+  // Build an empty index bottom-up from the loader's sorted entries, filling each page to fillFactor
+  RC bulkLoad(FileHandle &fileHandle, const Attribute &attribute, IX_BulkLoader &loader, float fillFactor = IX_DEFAULT_FILL_FACTOR);
+
   // scan() returns an iterator to allow the caller to go through the results
   // one by one in the range(lowKey, highKey).
   // For the format of "lowKey" and "highKey", please see insertEntry()
@@ -87,42 +364,107 @@ class IndexManager : public RecordBasedCoreManager {
       bool        highKeyInclusive,
       IX_ScanIterator &ix_ScanIterator);
 
+  // The same range handed out from the high key down, duplicates of a key come out in the reverse of their scan order
+  RC scan(FileHandle &fileHandle,
+      const Attribute &attribute,
+      const void        *lowKey,
+      const void        *highKey,
+      bool        lowKeyInclusive,
+      bool        highKeyInclusive,
+      IX_ScanOrder order,
+      IX_ScanIterator &ix_ScanIterator);
+
+  // Composite keys may give just their first lowKeyValues (or highKeyValues) values, which bound every key that
+  // starts with them. The iterator hands keys back as the concatenation of all of their values
+  RC scan(FileHandle &fileHandle,
+      const vector<Attribute> &attributes,
+      const void        *lowKey,
+      unsigned          lowKeyValues,
+      const void        *highKey,
+      unsigned          highKeyValues,
+      bool        lowKeyInclusive,
+      bool        highKeyInclusive,
+      IX_ScanIterator &ix_ScanIterator);
+
+  // Every RID stored under each of sortedKeys (ascending, in insertEntry() format), rids[i] for sortedKeys[i].
+  // The keys share one walk down the tree: a key only re-reads the non-leaf pages below where its path leaves
+  // the previous key's, and each leaf is read once for all the keys on it
+  RC lookupMany(FileHandle &fileHandle, const Attribute &attribute, const std::vector<const void*> &sortedKeys, std::vector<std::vector<RID> > &rids);
+
+  static Attribute getCompositeAttribute(const vector<Attribute>& attributes); // what the tree stores composite keys as
+  static RC encodeCompositeKey(const vector<Attribute>& attributes, const void* values, unsigned numValues, void* key);
+  static RC decodeCompositeKey(const vector<Attribute>& attributes, const void* key, void* values);
+
   static IX_PageIndexFooter* getIXPageIndexFooter(void* pageBuffer);
-  static const std::vector<Attribute>& getIndexRecordDescriptor(AttrType type);
-  static RC findNonLeafIndexEntry(FileHandle& fileHandle, IX_PageIndexFooter* footer, const Attribute &attribute, KeyValueData* key, RID& targetRid, RID& prevRid);
-  static RC findNonLeafIndexEntry(FileHandle& fileHandle, IX_PageIndexFooter* footer, const Attribute &attribute, KeyValueData* key, PageNum& pageNum);
-  static RC findLeafIndexEntry(FileHandle& fileHandle, const Attribute &attribute, KeyValueData* key, RID& entryRid, RID& prevEntryRid, RID& nextEntryRid, RID& dataRid);
-  static RC findLeafIndexEntry(FileHandle& fileHandle, IX_PageIndexFooter* footer, const Attribute &attribute, KeyValueData* key, RID& entryRid, RID& prevEntryRid, RID& nextEntryRid, RID& dataRid);
-  static RC findLeafIndexEntry(FileHandle& fileHandle, IX_PageIndexFooter* footer, const Attribute &attribute, KeyValueData* key, RID& entryRid, RID& dataRid);
-  static RC findIndexEntry(FileHandle& fileHandle, const Attribute &attribute, KeyValueData* keyData, RID& entryRid, RID& prevEntryRid, RID& nextEntryRid, RID& dataRid);
-  static RC findSmallestLeafIndexEntry(FileHandle& fileHandle, RID& rid);
+  static IX_EntrySlot* getEntrySlot(void* pageBuffer, unsigned position);
+  static const void* getEntryKey(void* pageBuffer, unsigned position); // as stored, without the page prefix
+  static unsigned readEntryKey(void* pageBuffer, unsigned position, void* key); // the full key and any RIDs after it, returns their size
+  static unsigned readEntry(void* pageBuffer, unsigned position, void* entry); // the full entry, returns its size
+  static RID getEntryRid(void* pageBuffer, unsigned position); // the first RID of a leaf entry
+
+  // The RIDs of a full leaf entry, and the reverse for an entry whose key is already in place
+  static void decodePosting(AttrType type, const void* entry, unsigned entryLength, std::vector<RID>& rids);
+  static unsigned encodePosting(AttrType type, const std::vector<RID>& rids, void* entry);
+  static PageNum getChildPage(void* pageBuffer, unsigned childIndex);
+  static unsigned getPageFreeSpace(void* pageBuffer);
+
+  static const IX_KeyOps& getKeyOps(AttrType type);
+
+  // Binary search for the first entry >= key (or > key if upperBound), a NULL key sorts before everything
+  static unsigned findEntryPosition(void* pageBuffer, AttrType type, const void* key, bool upperBound);
+  static int compareKeys(AttrType type, const void* lhs, const void* rhs);
+  static int compareEntryKey(void* pageBuffer, AttrType type, unsigned position, const void* key);
+
+  // Walk down to the leftmost leaf which could hold key, leaving it in pageBuffer
+  static RC findLeafPage(FileHandle& fileHandle, const Attribute& attribute, const void* key, void* pageBuffer);
+  static RC findLeafPage(FileHandle& fileHandle, const Attribute& attribute, const void* key, void* pageBuffer, unsigned& version);
   static RC readRootPage(FileHandle& fileHandle, void* pageBuffer);
-  static RC findLargestLeafIndexEntry(FileHandle& fileHandle, const Attribute& attribute, RID& rid);
+  static RC readNodePage(FileHandle& fileHandle, IX_IndexFile& indexFile, PageNum pageNum, unsigned version, void* pageBuffer);
   static RC validateIndex(FileHandle& fileHandle, const Attribute& attribute);
   static RC printIndex(FileHandle& fileHandle, const Attribute& attribute, bool extended);
   static RC printIndex(FileHandle& fileHandle, const Attribute& attribute, bool extended, bool restrictToPage, PageNum restrictPage);
   static RC updateRootPage(FileHandle& fileHandle, unsigned newRootPage);
+  static RC getRootPage(FileHandle& fileHandle, PageNum& rootPage);
+
+  IX_IndexFile& getIndexFile(FileHandle& fileHandle);
+  IX_IndexFile& getIndexFile(const std::string& fileName);
+  IX_Latch* getLatch(FileHandle& fileHandle, PageNum pageNum);
 
-  RC getNextRecord(FileHandle& fileHandle, const std::vector<Attribute>& recordDescriptor, const Attribute& attribute, RID& rid);
-  
  protected:
   IndexManager   ();                            // Constructor
   virtual ~IndexManager  ();                    // Destructor
 
   RC newPage(FileHandle& fileHandle, PageNum pageNum, bool isLeaf, PageNum nextLeafPage, PageNum leftChild);
-  RC split(FileHandle& fileHandle, const std::vector<Attribute>& recordDescriptor, PageNum& targetPageNum, PageNum& newPageNum, RID& rightRid, KeyValueData& rightKey);
-  RC deletelessSplit(FileHandle& fileHandle, const std::vector<Attribute>& recordDescriptor, PageNum& targetPageNum, PageNum& newPageNum, RID& rightRid, KeyValueData& rightKey);
-  RC insertIntoNonLeaf(FileHandle& fileHandle, PageNum& page, const Attribute &attribute, KeyValueData keyData, RID rid);
-  RC insertIntoLeaf(FileHandle& fileHandle, PageNum& page, const Attribute &attribute, KeyValueData keyData, RID rid);
+  RC allocatePage(FileHandle& fileHandle, PageNum& pageNum);
+  RC freePage(FileHandle& fileHandle, PageNum pageNum, PageNum mergedInto, unsigned mergedSlot);
+  RC resetFreePageList(FileHandle& fileHandle);
+  RC descendToLeaf(FileHandle& fileHandle, const Attribute& attribute, const void* key, bool upperBound, IX_DescentMode mode, void* pageBuffer, std::vector<IX_PathEntry>& parents, IX_LatchSet& latches);
+  RC nextLeafPath(FileHandle& fileHandle, void* pageBuffer, std::vector<IX_PathEntry>& parents, IX_LatchSet& latches);
+  RC rebalance(FileHandle& fileHandle, AttrType type, void* pageBuffer, std::vector<IX_PathEntry>& parents, IX_LatchSet& latches);
+  RC removeEntry(FileHandle& fileHandle, const Attribute& attribute, const void* key, const RID& rid, IX_DescentMode mode, bool& retry);
+  RC splitPage(FileHandle& fileHandle, void* pageBuffer, AttrType type, unsigned position, const void* entry, unsigned entryLength, float leftFraction, PageNum& rightPageNum, void* separator, unsigned& separatorLength);
+  RC writeNodePage(FileHandle& fileHandle, PageNum pageNum, const void* pageBuffer);
+  RC freeUnusedPages(FileHandle& fileHandle, PageNum firstPage, PageNum endPage, PageNum rootPage);
+  RC bulkLoadPushUp(FileHandle& fileHandle, const Attribute& attribute, std::vector<IX_BulkLoadNode>& levels, unsigned level, const void* key, PageNum child, unsigned fillLimit, PageNum& nextPage, PageNum rootPage);
+  RC bulkLoadPlace(FileHandle& fileHandle, const Attribute& attribute, std::vector<IX_BulkLoadNode>& levels, void* pageBuffer, const void* entry, unsigned entryLength, PageNum& leafPage, KeyValueData& leafSeparator, void* previousKey, bool& hasPreviousKey, unsigned fillLimit, PageNum& nextPage, PageNum rootPage);
+
+  static void initPage(void* pageBuffer, PageNum pageNum, bool isLeaf, PageNum nextLeafPage, PageNum leftChild);
+  static RC insertIntoPage(void* pageBuffer, AttrType type, unsigned position, const void* entry, unsigned entryLength);
+  static void removeFromPage(void* pageBuffer, unsigned position);
+  static void compactPage(void* pageBuffer);
 
  private:
 	static IndexManager *_index_manager;
 	
-	std::map<std::string, PageNum> _rootPageMap;
+	// Guards the reserved page of every index
+	std::mutex _headerMutex;
 
-	std::vector<Attribute> _indexIntRecordDescriptor;
-	std::vector<Attribute> _indexRealRecordDescriptor;
-	std::vector<Attribute> _indexVarCharRecordDescriptor;
+	// Never changed in place, a new file gets a new map so lookups need no lock. Old maps are kept
+	// until we go away since a reader may still be looking through one
+	typedef std::map<std::string, IX_IndexFile*> IX_IndexFileMap;
+	std::atomic<const IX_IndexFileMap*> _indexFiles;
+	std::vector<const IX_IndexFileMap*> _retiredIndexFileMaps;
+	std::mutex _indexFileMutex;
 };
 
 class IX_ScanIterator {
@@ -132,24 +474,54 @@ public:
 
   RC getNextEntry(RID &rid, void *key);  		// Get next matching entry
   RC close();             						// Terminate index scan
-  RC init(FileHandle* fileHandle, const Attribute &attribute, const void *lowKey, const void *highKey, bool lowKeyInclusive, bool highKeyInclusive);
+  RC init(FileHandle* fileHandle, const Attribute &attribute, const void *lowKey, const void *highKey, bool lowKeyInclusive, bool highKeyInclusive, IX_ScanOrder order = IX_SCAN_ASCENDING);
+
+  // Over composite keys, the bounds are already encoded and keys are decoded into their values as they are handed out
+  RC init(FileHandle* fileHandle, const vector<Attribute> &keyAttributes, const void *lowKey, const void *highKey, bool lowKeyInclusive, bool highKeyInclusive, IX_ScanOrder order = IX_SCAN_ASCENDING);
 
 private:
-	RC advance();
+	RC readLeaf();
+	RC decodeLeaf(void* pageBuffer, unsigned version);
+	RC retireBatch();
 
-	IndexManager& _im;
+	// Descending scans have no links to follow, they keep the path to their leaf and step left through it
+	RC findLastLeaf(const void* key, void* pageBuffer);
+	RC readPreviousLeaf();
+	void decodeLeafDescending(void* pageBuffer);
 
 	FileHandle* _fileHandle;
 	Attribute _attribute;
-	std::vector<Attribute> _recordDescriptor;
+	bool _hasLowKey;
+	bool _hasHighKey;
 	bool _lowKeyInclusive;
 	bool _highKeyInclusive;
-	bool _pastLastRecord;
-	
-	RID _beginRecordRid;
-	RID _endRecordRid;
-	RID _currentRecordRid;
-	RID _nextRecordRid;
+	KeyValueData _lowKey;
+	KeyValueData _highKey;
+	const IX_KeyOps* _keyOps;
+	std::vector<Attribute> _keyAttributes; // empty unless the keys are composite
+
+	// The next leaf to read, 0 once we have passed the high key or the last leaf. Going down, the leaf we read last
+	// until we pass the low key or the first leaf
+	PageNum _currentPage;
+	bool _descending;
+	std::vector<IX_LookupLevel> _path;
+	unsigned _rootVersion;
+
+	// Every entry of the last leaf we read that is in range, as [RID][key] entries, handed out one at a time
+	std::vector<char> _batch;
+	std::vector<unsigned> _batchOffsets; // where each entry starts, and one past the last
+	unsigned _batchPosition;
+
+	// The last key we handed out and every RID we handed out with it, so whatever we already returned is
+	// skipped when we read a leaf again or find entries moved onto another leaf
+	bool _hasLastEntry;
+	KeyValueData _lastKey;
+	std::vector<RID> _lastKeyRids; // sorted
+
+	// The leaf whose link brought us to the current page, until we have read the current page
+	IX_IndexFile* _indexFile;
+	PageNum _previousPage;
+	unsigned _previousVersion;
 };
 
 // print out the error message for a given return code
@@ -1,14 +1,20 @@
 #include <iostream>
 #include <algorithm>
 #include <vector>
+#include <thread>
+#include <set>
 
 #include <assert.h>
 #include <cstdlib>
 #include <cstdio>
 #include <cstring>
+#include <climits>
 #include <cstdlib>
 
 #include "ix.h"
+#include "hx.h"
+#include "lx.h"
+#include "ax.h"
 #include "ixtest_util.h"
 #include "../util/returncodes.h"
 
@@ -24,6 +30,22 @@ int g_nUndergradExtraPoint;
 void test1();
 void test2();
 void testCustom();
+void testSortedInsertAndScan(const int numKeys);
+void testBulkLoad(const int numKeys);
+void testKeyValueData();
+void testPrefixCompression(const int numKeys);
+void testDeleteMerge(const int numKeys);
+void testConcurrentAccess(const int numKeys, const int numThreads);
+void testNodeCache(const int numKeys);
+void testScanDuplicateDeletes(const int numDuplicates);
+void testHashIndex(const int numKeys);
+void testCompositeKeys(const int numCustomers);
+void testPostingLists(const int numEntries);
+void testLookupMany(const int numEntries);
+void testAppendInserts(const int numEntries);
+void testReverseScan(const int numKeys);
+void testLsmIndex(const int numKeys);
+void testArtIndex(const int numKeys);
 
 int main()
 {
@@ -37,7 +59,7 @@ int main()
 	g_nTotalGradPoint = 0;
 
 	ASSERT_ON_BAD_RETURN = true;
-	// testCustom();
+	testCustom();
 
 	// Cleanup from old tests previously run
 	ASSERT_ON_BAD_RETURN = false;
@@ -2600,6 +2622,54 @@ void testCustom()
 
 	testRandomAddDelete(500, false);
 
+	std::cout << "====Testing sorted pages with duplicates across leaves====" << std::endl;
+	testSortedInsertAndScan(5000);
+
+	std::cout << "====Testing bulk load with spilled sort runs====" << std::endl;
+	testBulkLoad(20000);
+
+	std::cout << "====Testing inline and heap keys====" << std::endl;
+	testKeyValueData();
+
+	std::cout << "====Testing prefix compressed varchar keys====" << std::endl;
+	testPrefixCompression(5000);
+
+	std::cout << "====Testing merges on delete====" << std::endl;
+	testDeleteMerge(20000);
+
+	std::cout << "====Testing concurrent inserts, deletes and scans====" << std::endl;
+	testConcurrentAccess(20000, 4);
+
+	std::cout << "====Testing cached inner pages after rebuilds====" << std::endl;
+	testNodeCache(20000);
+
+	std::cout << "====Testing scans deleting some duplicates as they go====" << std::endl;
+	testScanDuplicateDeletes(5000);
+
+	std::cout << "====Testing extendible hash index lookups====" << std::endl;
+	testHashIndex(20000);
+
+	std::cout << "====Testing composite keys and prefix scans====" << std::endl;
+	testCompositeKeys(400);
+
+	std::cout << "====Testing duplicate keys in posting lists====" << std::endl;
+	testPostingLists(20000);
+
+	std::cout << "====Testing batched multi-key lookups====" << std::endl;
+	testLookupMany(20000);
+
+	std::cout << "====Testing rightmost appends and split fill factors====" << std::endl;
+	testAppendInserts(30000);
+
+	std::cout << "====Testing descending range scans====" << std::endl;
+	testReverseScan(20000);
+
+	std::cout << "====Testing LSM-tree index flushes and compaction====" << std::endl;
+	testLsmIndex(40000);
+
+	std::cout << "====Testing adaptive radix tree index====" << std::endl;
+	testArtIndex(30000);
+
 	std::cout << "====Testing single insert/delete on integers====" << std::endl;
     testSimpleAddDeleteIndex(50, false);
 	std::cout << "====Testing single insert/delete on strings====" << std::endl;
@@ -2615,3 +2685,2125 @@ void testCustom()
 	std::cout << "====Testing multi-level split insert/delete on strings====" << std::endl;
 	testSimpleAddDeleteIndex(250, true);
 }
+
+void testSortedInsertAndScan(const int numKeys)
+{
+	const string filename = "testSortedScan_IntegerIndex";
+	Attribute attr;
+	attr.length = 4;
+	attr.name = "IntegerValue";
+	attr.type = TypeInt;
+
+	RC ret;
+	FileHandle fileHandle;
+
+	indexManager->destroyFile(filename);
+	ret = indexManager->createFile(filename);
+	assert(ret == success);
+
+	ret = indexManager->openFile(filename, fileHandle);
+	assert(ret == success);
+
+	// Insert every key twice in a scrambled order, so pages split in the middle and duplicates straddle leaves
+	RID rid;
+	for (int i = 0; i < numKeys; ++i)
+	{
+		int key = (int)(((long long)i * 7919) % numKeys);
+		for (int copy = 0; copy < 2; ++copy)
+		{
+			rid.pageNum = key + 1;
+			rid.slotNum = copy;
+			ret = indexManager->insertEntry(fileHandle, attr, &key, rid);
+			assert(ret == success);
+		}
+	}
+
+	ret = indexManager->validateIndex(fileHandle, attr);
+	assert(ret == success);
+
+	// A full scan must come back in key order
+	IX_ScanIterator iter;
+	RID scannedRid;
+	int key = 0;
+	int lastKey = -1;
+	int count = 0;
+	ret = indexManager->scan(fileHandle, attr, NULL, NULL, true, true, iter);
+	assert(ret == success);
+	while (iter.getNextEntry(scannedRid, &key) == success)
+	{
+		assert(key >= lastKey);
+		assert(scannedRid.pageNum == (unsigned)key + 1);
+		lastKey = key;
+		++count;
+	}
+	iter.close();
+	assert(count == 2 * numKeys);
+
+	// Ranges only return their own keys, with both copies of each
+	int lowKey = 10;
+	int highKey = 20;
+	count = 0;
+	ret = indexManager->scan(fileHandle, attr, &lowKey, &highKey, false, true, iter);
+	assert(ret == success);
+	while (iter.getNextEntry(scannedRid, &key) == success)
+	{
+		assert(key > lowKey && key <= highKey);
+		++count;
+	}
+	iter.close();
+	assert(count == 2 * (highKey - lowKey));
+
+	// Delete the second copy of every even key, and a second delete must fail
+	for (key = 0; key < numKeys; key += 2)
+	{
+		rid.pageNum = key + 1;
+		rid.slotNum = 1;
+		ret = indexManager->deleteEntry(fileHandle, attr, &key, rid);
+		assert(ret == success);
+	}
+
+	key = 0;
+	rid.pageNum = 1;
+	rid.slotNum = 1;
+	ret = indexManager->deleteEntry(fileHandle, attr, &key, rid);
+	assert(ret != success);
+
+	count = 0;
+	ret = indexManager->scan(fileHandle, attr, NULL, NULL, true, true, iter);
+	assert(ret == success);
+	while (iter.getNextEntry(scannedRid, &key) == success)
+	{
+		assert(key % 2 == 1 || scannedRid.slotNum == 0);
+		++count;
+	}
+	iter.close();
+	assert(count == 2 * numKeys - (numKeys + 1) / 2);
+
+	ret = indexManager->closeFile(fileHandle);
+	assert(ret == success);
+
+	ret = indexManager->destroyFile(filename);
+	assert(ret == success);
+}
+
+void testBulkLoad(const int numKeys)
+{
+	const string filename = "testBulkLoad_IntegerIndex";
+	Attribute attr;
+	attr.length = 4;
+	attr.name = "IntegerValue";
+	attr.type = TypeInt;
+
+	RC ret;
+	FileHandle fileHandle;
+
+	indexManager->destroyFile(filename);
+	ret = indexManager->createFile(filename);
+	assert(ret == success);
+
+	ret = indexManager->openFile(filename, fileHandle);
+	assert(ret == success);
+
+	// A tiny memory budget forces the sort to spill and merge several runs
+	IX_BulkLoader loader(attr, 32 * PAGE_SIZE);
+	RID rid;
+	for (int i = 0; i < numKeys; ++i)
+	{
+		int key = (int)(((long long)i * 7919) % numKeys) / 2;
+		rid.pageNum = i + 1;
+		rid.slotNum = 0;
+		ret = loader.addEntry(&key, rid);
+		assert(ret == success);
+	}
+
+	ret = indexManager->bulkLoad(fileHandle, attr, loader, 0.7f);
+	assert(ret == success);
+
+	ret = indexManager->validateIndex(fileHandle, attr);
+	assert(ret == success);
+
+	// A second bulk load has nothing to build on
+	IX_BulkLoader emptyLoader(attr);
+	ret = indexManager->bulkLoad(fileHandle, attr, emptyLoader);
+	assert(ret == rc::BTREE_INDEX_NOT_EMPTY);
+
+	// Everything comes back in order, each key twice
+	IX_ScanIterator iter;
+	RID scannedRid;
+	int key = 0;
+	int lastKey = -1;
+	int count = 0;
+	ret = indexManager->scan(fileHandle, attr, NULL, NULL, true, true, iter);
+	assert(ret == success);
+	while (iter.getNextEntry(scannedRid, &key) == success)
+	{
+		assert(key >= lastKey);
+		lastKey = key;
+		++count;
+	}
+	iter.close();
+	assert(count == numKeys);
+
+	// The loaded tree keeps working with regular inserts and deletes
+	for (int i = 0; i < numKeys; ++i)
+	{
+		key = numKeys + i;
+		rid.pageNum = numKeys + i + 1;
+		ret = indexManager->insertEntry(fileHandle, attr, &key, rid);
+		assert(ret == success);
+	}
+
+	for (int i = 0; i < numKeys; i += 2)
+	{
+		key = (int)(((long long)i * 7919) % numKeys) / 2;
+		rid.pageNum = i + 1;
+		ret = indexManager->deleteEntry(fileHandle, attr, &key, rid);
+		assert(ret == success);
+	}
+
+	ret = indexManager->validateIndex(fileHandle, attr);
+	assert(ret == success);
+
+	count = 0;
+	ret = indexManager->scan(fileHandle, attr, NULL, NULL, true, true, iter);
+	assert(ret == success);
+	while (iter.getNextEntry(scannedRid, &key) == success)
+	{
+		++count;
+	}
+	iter.close();
+	assert(count == numKeys + numKeys / 2);
+
+	ret = indexManager->closeFile(fileHandle);
+	assert(ret == success);
+
+	ret = indexManager->destroyFile(filename);
+	assert(ret == success);
+}
+
+void testKeyValueData()
+{
+	RC ret;
+	int compareResult = 0;
+
+	// Int keys stay at 4 bytes
+	int lowInt = -5;
+	int highInt = 7;
+	KeyValueData lowKey, highKey;
+	ret = lowKey.init(TypeInt, &lowInt);
+	assert(ret == success);
+	ret = highKey.init(TypeInt, &highInt);
+	assert(ret == success);
+	assert(lowKey.size() == sizeof(int));
+
+	ret = lowKey.compare(TypeInt, highKey, compareResult);
+	assert(ret == success && compareResult < 0);
+
+	// A long varchar spills to the heap, and survives being copied and moved
+	char stringBuffer[sizeof(int) + 100];
+	int length = 100;
+	memcpy(stringBuffer, &length, sizeof(int));
+	memset(stringBuffer + sizeof(int), 'q', length);
+
+	KeyValueData longKey;
+	ret = longKey.init(TypeVarChar, stringBuffer);
+	assert(ret == success);
+	assert(longKey.size() == sizeof(int) + length);
+
+	KeyValueData copiedKey(longKey);
+	KeyValueData movedKey(std::move(longKey));
+	assert(longKey.size() == 0);
+	assert(memcmp(copiedKey.data(), stringBuffer, copiedKey.size()) == 0);
+	assert(memcmp(movedKey.data(), stringBuffer, movedKey.size()) == 0);
+
+	// A shorter string with the same prefix sorts first
+	length = 3;
+	memcpy(stringBuffer, &length, sizeof(int));
+	KeyValueData shortKey;
+	ret = shortKey.init(TypeVarChar, stringBuffer);
+	assert(ret == success);
+
+	ret = shortKey.compare(TypeVarChar, movedKey, compareResult);
+	assert(ret == success && compareResult < 0);
+
+	movedKey = shortKey;
+	ret = shortKey.compare(TypeVarChar, movedKey, compareResult);
+	assert(ret == success && compareResult == 0);
+}
+
+static void makeUrlKey(int id, char* key)
+{
+	char url[64];
+	int length = sprintf(url, "http://www.example.com/users/%06d", id);
+	memcpy(key, &length, sizeof(int));
+	memcpy(key + sizeof(int), url, length);
+}
+
+void testPrefixCompression(const int numKeys)
+{
+	const string filename = "testPrefix_VarCharIndex";
+	Attribute attr;
+	attr.length = 64;
+	attr.name = "Url";
+	attr.type = TypeVarChar;
+
+	RC ret;
+	FileHandle fileHandle;
+
+	indexManager->destroyFile(filename);
+	ret = indexManager->createFile(filename);
+	assert(ret == success);
+
+	ret = indexManager->openFile(filename, fileHandle);
+	assert(ret == success);
+
+	// Every key shares a long prefix, inserted scrambled so pages split and their prefixes get trimmed
+	char key[64];
+	RID rid;
+	for (int i = 0; i < numKeys; ++i)
+	{
+		int id = (int)(((long long)i * 7919) % numKeys);
+		makeUrlKey(id, key);
+		rid.pageNum = id + 1;
+		rid.slotNum = 0;
+		ret = indexManager->insertEntry(fileHandle, attr, key, rid);
+		assert(ret == success);
+	}
+
+	ret = indexManager->validateIndex(fileHandle, attr);
+	assert(ret == success);
+
+	// Storing the prefix once must beat even perfectly packed full keys
+	const unsigned fullEntrySize = sizeof(RID) + sizeof(int) + 35 + 4;
+	assert(fileHandle.getNumberOfPages() < numKeys * fullEntrySize / PAGE_SIZE);
+
+	// A full scan gives back every whole key in order
+	IX_ScanIterator iter;
+	RID scannedRid;
+	char scannedKey[64];
+	char expectedKey[64];
+	int count = 0;
+	ret = indexManager->scan(fileHandle, attr, NULL, NULL, true, true, iter);
+	assert(ret == success);
+	while (iter.getNextEntry(scannedRid, scannedKey) == success)
+	{
+		makeUrlKey(count, expectedKey);
+		assert(memcmp(scannedKey, expectedKey, sizeof(int) + 35) == 0);
+		assert(scannedRid.pageNum == (unsigned)count + 1);
+		++count;
+	}
+	iter.close();
+	assert(count == numKeys);
+
+	// Range bounds inside the prefix, and ones that fall outside it on either side
+	char lowKey[64];
+	char highKey[64];
+	makeUrlKey(100, lowKey);
+	makeUrlKey(200, highKey);
+	count = 0;
+	ret = indexManager->scan(fileHandle, attr, lowKey, highKey, true, false, iter);
+	assert(ret == success);
+	while (iter.getNextEntry(scannedRid, scannedKey) == success)
+	{
+		++count;
+	}
+	iter.close();
+	assert(count == 100);
+
+	int length = 4;
+	memcpy(lowKey, &length, sizeof(int));
+	memcpy(lowKey + sizeof(int), "http", length);
+	memcpy(highKey, &length, sizeof(int));
+	memcpy(highKey + sizeof(int), "zzzz", length);
+	count = 0;
+	ret = indexManager->scan(fileHandle, attr, lowKey, highKey, false, false, iter);
+	assert(ret == success);
+	while (iter.getNextEntry(scannedRid, scannedKey) == success)
+	{
+		++count;
+	}
+	iter.close();
+	assert(count == numKeys);
+
+	// Delete every odd key through the compressed pages, then put a key outside the prefix back in
+	for (int id = 1; id < numKeys; id += 2)
+	{
+		makeUrlKey(id, key);
+		rid.pageNum = id + 1;
+		rid.slotNum = 0;
+		ret = indexManager->deleteEntry(fileHandle, attr, key, rid);
+		assert(ret == success);
+	}
+
+	memcpy(key, &length, sizeof(int));
+	memcpy(key + sizeof(int), "mail", length);
+	ret = indexManager->insertEntry(fileHandle, attr, key, rid);
+	assert(ret == success);
+
+	ret = indexManager->validateIndex(fileHandle, attr);
+	assert(ret == success);
+
+	count = 0;
+	ret = indexManager->scan(fileHandle, attr, NULL, NULL, true, true, iter);
+	assert(ret == success);
+	while (iter.getNextEntry(scannedRid, scannedKey) == success)
+	{
+		++count;
+	}
+	iter.close();
+	assert(count == numKeys / 2 + 1);
+
+	ret = indexManager->closeFile(fileHandle);
+	assert(ret == success);
+
+	// A bulk load packs leaves by their prefixed size and pushes up shortened separators
+	ret = indexManager->destroyFile(filename);
+	assert(ret == success);
+	ret = indexManager->createFile(filename);
+	assert(ret == success);
+	ret = indexManager->openFile(filename, fileHandle);
+	assert(ret == success);
+
+	IX_BulkLoader loader(attr);
+	for (int id = 0; id < numKeys; ++id)
+	{
+		makeUrlKey(id, key);
+		rid.pageNum = id + 1;
+		rid.slotNum = 0;
+		ret = loader.addEntry(key, rid);
+		assert(ret == success);
+	}
+
+	ret = indexManager->bulkLoad(fileHandle, attr, loader, 1.0f);
+	assert(ret == success);
+
+	ret = indexManager->validateIndex(fileHandle, attr);
+	assert(ret == success);
+	assert(fileHandle.getNumberOfPages() < numKeys * fullEntrySize / PAGE_SIZE / 2);
+
+	makeUrlKey(numKeys / 2, lowKey);
+	count = 0;
+	ret = indexManager->scan(fileHandle, attr, lowKey, NULL, true, true, iter);
+	assert(ret == success);
+	while (iter.getNextEntry(scannedRid, scannedKey) == success)
+	{
+		makeUrlKey(numKeys / 2 + count, expectedKey);
+		assert(memcmp(scannedKey, expectedKey, sizeof(int) + 35) == 0);
+		++count;
+	}
+	iter.close();
+	assert(count == numKeys - numKeys / 2);
+
+	ret = indexManager->closeFile(fileHandle);
+	assert(ret == success);
+
+	ret = indexManager->destroyFile(filename);
+	assert(ret == success);
+}
+
+void testDeleteMerge(const int numKeys)
+{
+	const string filename = "testDeleteMerge_IntegerIndex";
+	Attribute attr;
+	attr.length = 4;
+	attr.name = "IntegerValue";
+	attr.type = TypeInt;
+
+	RC ret;
+	FileHandle fileHandle;
+
+	indexManager->destroyFile(filename);
+	ret = indexManager->createFile(filename);
+	assert(ret == success);
+
+	ret = indexManager->openFile(filename, fileHandle);
+	assert(ret == success);
+
+	RID rid;
+	for (int i = 0; i < numKeys; ++i)
+	{
+		int key = (int)(((long long)i * 7919) % numKeys);
+		rid.pageNum = key + 1;
+		rid.slotNum = 0;
+		ret = indexManager->insertEntry(fileHandle, attr, &key, rid);
+		assert(ret == success);
+	}
+
+	const unsigned fullPages = fileHandle.getNumberOfPages();
+
+	// Delete all but a handful of keys in a scrambled order, the tree has to shrink back down to one leaf
+	for (int i = 0; i < numKeys; ++i)
+	{
+		int key = (int)(((long long)i * 104729) % numKeys);
+		if (key % 1000 == 0)
+			continue;
+
+		rid.pageNum = key + 1;
+		rid.slotNum = 0;
+		ret = indexManager->deleteEntry(fileHandle, attr, &key, rid);
+		assert(ret == success);
+	}
+
+	ret = indexManager->validateIndex(fileHandle, attr);
+	assert(ret == success);
+
+	unsigned char pageBuffer[PAGE_SIZE];
+	ret = IndexManager::readRootPage(fileHandle, pageBuffer);
+	assert(ret == success);
+	assert(IndexManager::getIXPageIndexFooter(pageBuffer)->isLeafPage);
+	assert(IndexManager::getIXPageIndexFooter(pageBuffer)->numSlots == (unsigned)numKeys / 1000);
+
+	// Filling it back up the same way reuses the freed pages instead of growing the file
+	for (int i = 0; i < numKeys; ++i)
+	{
+		int key = (int)(((long long)i * 7919) % numKeys);
+		if (key % 1000 == 0)
+			continue;
+
+		rid.pageNum = key + 1;
+		rid.slotNum = 0;
+		ret = indexManager->insertEntry(fileHandle, attr, &key, rid);
+		assert(ret == success);
+	}
+
+	assert(fileHandle.getNumberOfPages() <= fullPages);
+
+	// Delete everything from inside a scan, which merges leaves out from under the iterator
+	IX_ScanIterator iter;
+	RID scannedRid;
+	int key = 0;
+	int lowKey = numKeys / 4;
+	int count = 0;
+	ret = indexManager->scan(fileHandle, attr, &lowKey, NULL, true, true, iter);
+	assert(ret == success);
+	while (iter.getNextEntry(scannedRid, &key) == success)
+	{
+		assert(key == lowKey + count);
+		ret = indexManager->deleteEntry(fileHandle, attr, &key, scannedRid);
+		assert(ret == success);
+		++count;
+	}
+	iter.close();
+	assert(count == numKeys - lowKey);
+
+	ret = indexManager->validateIndex(fileHandle, attr);
+	assert(ret == success);
+
+	count = 0;
+	ret = indexManager->scan(fileHandle, attr, NULL, NULL, true, true, iter);
+	assert(ret == success);
+	while (iter.getNextEntry(scannedRid, &key) == success)
+	{
+		assert(key == count);
+		++count;
+	}
+	iter.close();
+	assert(count == lowKey);
+
+	ret = indexManager->closeFile(fileHandle);
+	assert(ret == success);
+
+	ret = indexManager->destroyFile(filename);
+	assert(ret == success);
+}
+
+// Each writer owns the keys equal to its number mod numThreads, and goes through them in a scrambled order
+static void concurrentWriter(FileHandle* fileHandle, const Attribute* attr, int numKeys, int numThreads, int thread, bool insert)
+{
+	RID rid;
+	for (int i = 0; i < numKeys; ++i)
+	{
+		int key = (int)(((long long)i * 7919) % numKeys);
+		if (key % numThreads != thread)
+			continue;
+
+		// Leave every tenth key behind when deleting
+		if (!insert && key % 10 == 0)
+			continue;
+
+		rid.pageNum = key + 1;
+		rid.slotNum = 0;
+		RC ret = insert ? indexManager->insertEntry(*fileHandle, *attr, &key, rid) : indexManager->deleteEntry(*fileHandle, *attr, &key, rid);
+		assert(ret == success);
+	}
+}
+
+// Scans alongside the writers only ever see keys in order, whatever the writers split or merge underneath them
+static void concurrentScanner(FileHandle* fileHandle, const Attribute* attr, int numScans)
+{
+	for (int scan = 0; scan < numScans; ++scan)
+	{
+		IX_ScanIterator iter;
+		RID rid;
+		int key = 0;
+		int lastKey = -1;
+		RC ret = indexManager->scan(*fileHandle, *attr, NULL, NULL, true, true, iter);
+		assert(ret == success);
+		while (iter.getNextEntry(rid, &key) == success)
+		{
+			assert(key > lastKey);
+			assert(rid.pageNum == (unsigned)key + 1);
+			lastKey = key;
+		}
+		iter.close();
+	}
+}
+
+// Point lookups through equality scans, which read without latching. With mustFind every key has to be there
+static void concurrentLookups(FileHandle* fileHandle, const Attribute* attr, int numKeys, int thread, int numThreads, bool mustFind)
+{
+	for (int key = thread; key < numKeys; key += numThreads)
+	{
+		IX_ScanIterator iter;
+		RID rid;
+		int foundKey = 0;
+		int found = 0;
+		RC ret = indexManager->scan(*fileHandle, *attr, &key, &key, true, true, iter);
+		assert(ret == success);
+		while (iter.getNextEntry(rid, &foundKey) == success)
+		{
+			assert(foundKey == key);
+			assert(rid.pageNum == (unsigned)key + 1);
+			++found;
+		}
+		iter.close();
+		assert(found <= 1);
+		assert(found == 1 || !mustFind);
+	}
+}
+
+void testConcurrentAccess(const int numKeys, const int numThreads)
+{
+	const string filename = "testConcurrentAccess_IntegerIndex";
+	Attribute attr;
+	attr.length = 4;
+	attr.name = "IntegerValue";
+	attr.type = TypeInt;
+
+	RC ret;
+	FileHandle fileHandle;
+
+	indexManager->destroyFile(filename);
+	ret = indexManager->createFile(filename);
+	assert(ret == success);
+
+	ret = indexManager->openFile(filename, fileHandle);
+	assert(ret == success);
+
+	// Fill the tree from every thread at once while others scan it and look keys up
+	vector<thread> threads;
+	for (int t = 0; t < numThreads; ++t)
+	{
+		threads.push_back(thread(concurrentWriter, &fileHandle, &attr, numKeys, numThreads, t, true));
+	}
+	threads.push_back(thread(concurrentScanner, &fileHandle, &attr, 10));
+	threads.push_back(thread(concurrentLookups, &fileHandle, &attr, numKeys, 0, 1, false));
+	for (unsigned t = 0; t < threads.size(); ++t)
+	{
+		threads[t].join();
+	}
+	threads.clear();
+
+	// Readers alone never wait on each other
+	for (int t = 0; t < numThreads; ++t)
+	{
+		threads.push_back(thread(concurrentLookups, &fileHandle, &attr, numKeys, t, numThreads, true));
+	}
+	for (unsigned t = 0; t < threads.size(); ++t)
+	{
+		threads[t].join();
+	}
+	threads.clear();
+
+	ret = indexManager->validateIndex(fileHandle, attr);
+	assert(ret == success);
+
+	IX_ScanIterator iter;
+	RID rid;
+	int key = 0;
+	int count = 0;
+	ret = indexManager->scan(fileHandle, attr, NULL, NULL, true, true, iter);
+	assert(ret == success);
+	while (iter.getNextEntry(rid, &key) == success)
+	{
+		assert(key == count);
+		++count;
+	}
+	iter.close();
+	assert(count == numKeys);
+
+	// Then empty most of it back out the same way, merging pages while the scanner walks across them
+	for (int t = 0; t < numThreads; ++t)
+	{
+		threads.push_back(thread(concurrentWriter, &fileHandle, &attr, numKeys, numThreads, t, false));
+	}
+	threads.push_back(thread(concurrentScanner, &fileHandle, &attr, 10));
+	for (unsigned t = 0; t < threads.size(); ++t)
+	{
+		threads[t].join();
+	}
+
+	ret = indexManager->validateIndex(fileHandle, attr);
+	assert(ret == success);
+
+	count = 0;
+	ret = indexManager->scan(fileHandle, attr, NULL, NULL, true, true, iter);
+	assert(ret == success);
+	while (iter.getNextEntry(rid, &key) == success)
+	{
+		assert(key == count * 10);
+		++count;
+	}
+	iter.close();
+	assert(count == numKeys / 10);
+
+	ret = indexManager->closeFile(fileHandle);
+	assert(ret == success);
+
+	ret = indexManager->destroyFile(filename);
+	assert(ret == success);
+}
+
+// How many entries an equality scan finds for key, checking each has the RID key + ridOffset
+static int countNodeCacheLookup(FileHandle& fileHandle, const Attribute& attr, int key, unsigned ridOffset)
+{
+	IX_ScanIterator iter;
+	RID rid;
+	int foundKey = 0;
+	int found = 0;
+	RC ret = indexManager->scan(fileHandle, attr, &key, &key, true, true, iter);
+	assert(ret == success);
+	while (iter.getNextEntry(rid, &foundKey) == success)
+	{
+		assert(foundKey == key);
+		assert(rid.pageNum == (unsigned)key + ridOffset);
+		++found;
+	}
+	iter.close();
+	return found;
+}
+
+// Every key in [0, numKeys) with key % stride == offset has to be found once, and no other key
+static void checkNodeCacheLookups(FileHandle& fileHandle, const Attribute& attr, int numKeys, int stride, int offset, unsigned ridOffset)
+{
+	for (int key = 0; key < numKeys; ++key)
+	{
+		assert(countNodeCacheLookup(fileHandle, attr, key, ridOffset) == (key % stride == offset ? 1 : 0));
+	}
+}
+
+void testNodeCache(const int numKeys)
+{
+	const string filename = "testNodeCache_IntegerIndex";
+	Attribute attr;
+	attr.length = 4;
+	attr.name = "IntegerValue";
+	attr.type = TypeInt;
+
+	RC ret;
+	FileHandle fileHandle;
+
+	indexManager->destroyFile(filename);
+	ret = indexManager->createFile(filename);
+	assert(ret == success);
+
+	ret = indexManager->openFile(filename, fileHandle);
+	assert(ret == success);
+
+	// Splits rewrite inner pages the lookups have cached along the way
+	RID rid;
+	for (int i = 0; i < numKeys; ++i)
+	{
+		int key = (int)(((long long)i * 7919) % numKeys);
+		rid.pageNum = key + 1;
+		rid.slotNum = 0;
+		ret = indexManager->insertEntry(fileHandle, attr, &key, rid);
+		assert(ret == success);
+
+		// Look up a few keys we already have, going through whatever the splits left behind
+		for (int j = 0; j <= i; j += i / 8 + 1)
+		{
+			int insertedKey = (int)(((long long)j * 7919) % numKeys);
+			assert(countNodeCacheLookup(fileHandle, attr, insertedKey, 1) == 1);
+		}
+	}
+	checkNodeCacheLookups(fileHandle, attr, numKeys, 1, 0, 1);
+
+	// A bulk load lays new inner pages over the old ones
+	ret = indexManager->deleteRecords(fileHandle);
+	assert(ret == success);
+
+	IX_BulkLoader loader(attr);
+	for (int key = 0; key < numKeys; key += 2)
+	{
+		rid.pageNum = key + 2;
+		rid.slotNum = 0;
+		ret = loader.addEntry(&key, rid);
+		assert(ret == success);
+	}
+
+	ret = indexManager->bulkLoad(fileHandle, attr, loader, 0.5f);
+	assert(ret == success);
+	checkNodeCacheLookups(fileHandle, attr, numKeys, 2, 0, 2);
+
+	// And so does a new file by the same name
+	ret = indexManager->closeFile(fileHandle);
+	assert(ret == success);
+
+	ret = indexManager->destroyFile(filename);
+	assert(ret == success);
+
+	ret = indexManager->createFile(filename);
+	assert(ret == success);
+
+	ret = indexManager->openFile(filename, fileHandle);
+	assert(ret == success);
+
+	for (int key = 1; key < numKeys; key += 2)
+	{
+		rid.pageNum = key + 3;
+		rid.slotNum = 0;
+		ret = indexManager->insertEntry(fileHandle, attr, &key, rid);
+		assert(ret == success);
+	}
+	checkNodeCacheLookups(fileHandle, attr, numKeys, 2, 1, 3);
+
+	ret = indexManager->validateIndex(fileHandle, attr);
+	assert(ret == success);
+
+	ret = indexManager->closeFile(fileHandle);
+	assert(ret == success);
+
+	ret = indexManager->destroyFile(filename);
+	assert(ret == success);
+}
+
+void testScanDuplicateDeletes(const int numDuplicates)
+{
+	const string filename = "testScanDuplicateDeletes_IntegerIndex";
+	Attribute attr;
+	attr.length = 4;
+	attr.name = "IntegerValue";
+	attr.type = TypeInt;
+
+	RC ret;
+	FileHandle fileHandle;
+
+	indexManager->destroyFile(filename);
+	ret = indexManager->createFile(filename);
+	assert(ret == success);
+
+	ret = indexManager->openFile(filename, fileHandle);
+	assert(ret == success);
+
+	// A run of duplicates spread over many leaves, with a few other keys either side
+	RID rid;
+	for (int i = 0; i < numDuplicates + 20; ++i)
+	{
+		int key = (i < 10) ? i : (i < numDuplicates + 10 ? 10 : i - numDuplicates);
+		rid.pageNum = i + 1;
+		rid.slotNum = 0;
+		ret = indexManager->insertEntry(fileHandle, attr, &key, rid);
+		assert(ret == success);
+	}
+
+	// Deleting every other entry merges leaves under the scan, each entry still has to come back exactly once
+	vector<bool> seen(numDuplicates + 20, false);
+	IX_ScanIterator iter;
+	int key = 0;
+	int count = 0;
+	ret = indexManager->scan(fileHandle, attr, NULL, NULL, true, true, iter);
+	assert(ret == success);
+	while (iter.getNextEntry(rid, &key) == success)
+	{
+		assert(!seen[rid.pageNum - 1]);
+		seen[rid.pageNum - 1] = true;
+		if (count % 2 == 0)
+		{
+			ret = indexManager->deleteEntry(fileHandle, attr, &key, rid);
+			assert(ret == success);
+		}
+		++count;
+	}
+	iter.close();
+	assert(count == numDuplicates + 20);
+
+	ret = indexManager->validateIndex(fileHandle, attr);
+	assert(ret == success);
+
+	count = 0;
+	ret = indexManager->scan(fileHandle, attr, NULL, NULL, true, true, iter);
+	assert(ret == success);
+	while (iter.getNextEntry(rid, &key) == success)
+	{
+		++count;
+	}
+	iter.close();
+	assert(count == (numDuplicates + 20) / 2);
+
+	ret = indexManager->closeFile(fileHandle);
+	assert(ret == success);
+
+	ret = indexManager->destroyFile(filename);
+	assert(ret == success);
+}
+
+// Count the entries a hash lookup finds for key, checking each one carries key
+static int countHashLookup(HashIndexManager* hashManager, FileHandle& fileHandle, const Attribute& attr, const void* key, RID* firstRid)
+{
+	HX_ScanIterator iter;
+	RC ret = hashManager->scan(fileHandle, attr, key, iter);
+	assert(ret == success);
+
+	RID rid;
+	char foundKey[PAGE_SIZE];
+	int count = 0;
+	while (iter.getNextEntry(rid, foundKey) == success)
+	{
+		assert(IndexManager::compareKeys(attr.type, foundKey, key) == 0);
+		if (count == 0 && firstRid)
+			*firstRid = rid;
+		++count;
+	}
+
+	iter.close();
+	return count;
+}
+
+void testHashIndex(const int numKeys)
+{
+	HashIndexManager* hashManager = HashIndexManager::instance();
+	const string filename = "testHashIndex_IntegerIndex";
+	Attribute attr;
+	attr.length = 4;
+	attr.name = "IntegerValue";
+	attr.type = TypeInt;
+
+	RC ret;
+	FileHandle fileHandle;
+
+	hashManager->destroyFile(filename);
+	ret = hashManager->createFile(filename);
+	assert(ret == success);
+
+	ret = hashManager->openFile(filename, fileHandle);
+	assert(ret == success);
+
+	// Distinct keys in scrambled order split buckets and double the directory, one key repeated enough
+	// to fill several pages can only be chained
+	const int numDuplicates = 2000;
+	const int duplicateKey = -1;
+	RID rid;
+	for (int i = 0; i < numKeys; ++i)
+	{
+		int key = (i * 7919) % numKeys;
+		rid.pageNum = key + 1;
+		rid.slotNum = 1;
+		ret = hashManager->insertEntry(fileHandle, attr, &key, rid);
+		assert(ret == success);
+
+		if (i % (numKeys / numDuplicates) == 0)
+		{
+			rid.pageNum = i + 1;
+			rid.slotNum = 2;
+			ret = hashManager->insertEntry(fileHandle, attr, &duplicateKey, rid);
+			assert(ret == success);
+		}
+	}
+
+	RID foundRid;
+	for (int key = 0; key < numKeys; ++key)
+	{
+		assert(countHashLookup(hashManager, fileHandle, attr, &key, &foundRid) == 1);
+		assert(foundRid.pageNum == (unsigned)key + 1 && foundRid.slotNum == 1);
+	}
+	assert(countHashLookup(hashManager, fileHandle, attr, &duplicateKey, NULL) == numDuplicates);
+
+	int missingKey = numKeys;
+	assert(countHashLookup(hashManager, fileHandle, attr, &missingKey, NULL) == 0);
+
+	// Drop the odd keys and half of the duplicates, deleting something that is not there is an error
+	for (int key = 1; key < numKeys; key += 2)
+	{
+		rid.pageNum = key + 1;
+		rid.slotNum = 1;
+		ret = hashManager->deleteEntry(fileHandle, attr, &key, rid);
+		assert(ret == success);
+	}
+	for (int i = 0; i < numKeys; i += 2 * (numKeys / numDuplicates))
+	{
+		rid.pageNum = i + 1;
+		rid.slotNum = 2;
+		ret = hashManager->deleteEntry(fileHandle, attr, &duplicateKey, rid);
+		assert(ret == success);
+	}
+
+	rid.pageNum = 2;
+	rid.slotNum = 1;
+	missingKey = 1;
+	assert(hashManager->deleteEntry(fileHandle, attr, &missingKey, rid) == rc::HASH_INDEX_ENTRY_NOT_FOUND);
+
+	for (int key = 0; key < numKeys; ++key)
+	{
+		assert(countHashLookup(hashManager, fileHandle, attr, &key, NULL) == (key % 2 == 0 ? 1 : 0));
+	}
+	assert(countHashLookup(hashManager, fileHandle, attr, &duplicateKey, NULL) == numDuplicates / 2);
+
+	// Emptying the index leaves it usable, and the freed pages are taken again before the file grows
+	const unsigned numPages = fileHandle.getNumberOfPages();
+	ret = hashManager->deleteRecords(fileHandle);
+	assert(ret == success);
+
+	for (int key = 0; key < numKeys; ++key)
+	{
+		assert(countHashLookup(hashManager, fileHandle, attr, &key, NULL) == 0);
+
+		rid.pageNum = key + 1;
+		rid.slotNum = 3;
+		ret = hashManager->insertEntry(fileHandle, attr, &key, rid);
+		assert(ret == success);
+	}
+	assert(fileHandle.getNumberOfPages() <= numPages);
+
+	for (int key = 0; key < numKeys; ++key)
+	{
+		assert(countHashLookup(hashManager, fileHandle, attr, &key, &foundRid) == 1);
+		assert(foundRid.slotNum == 3);
+	}
+
+	ret = hashManager->closeFile(fileHandle);
+	assert(ret == success);
+
+	ret = hashManager->destroyFile(filename);
+	assert(ret == success);
+
+	// Varchar keys which only differ in the order of their characters, and 0.0 against -0.0
+	const string varcharFilename = "testHashIndex_VarCharIndex";
+	attr.length = 16;
+	attr.name = "VarCharValue";
+	attr.type = TypeVarChar;
+
+	hashManager->destroyFile(varcharFilename);
+	ret = hashManager->createFile(varcharFilename);
+	assert(ret == success);
+
+	ret = hashManager->openFile(varcharFilename, fileHandle);
+	assert(ret == success);
+
+	char key[PAGE_SIZE];
+	for (int i = 0; i < numKeys; ++i)
+	{
+		int length = sprintf(key + sizeof(int), "%04dabcd%d", i % 1000, i);
+		memcpy(key, &length, sizeof(int));
+		rid.pageNum = i + 1;
+		rid.slotNum = 0;
+		ret = hashManager->insertEntry(fileHandle, attr, key, rid);
+		assert(ret == success);
+	}
+
+	for (int i = 0; i < numKeys; ++i)
+	{
+		int length = sprintf(key + sizeof(int), "%04dabcd%d", i % 1000, i);
+		memcpy(key, &length, sizeof(int));
+		assert(countHashLookup(hashManager, fileHandle, attr, key, &foundRid) == 1);
+		assert(foundRid.pageNum == (unsigned)i + 1);
+
+		length = sprintf(key + sizeof(int), "abcd%04d%d", i % 1000, i);
+		memcpy(key, &length, sizeof(int));
+		assert(countHashLookup(hashManager, fileHandle, attr, key, NULL) == 0);
+	}
+
+	ret = hashManager->closeFile(fileHandle);
+	assert(ret == success);
+
+	ret = hashManager->destroyFile(varcharFilename);
+	assert(ret == success);
+
+	const string realFilename = "testHashIndex_RealIndex";
+	attr.length = 4;
+	attr.name = "RealValue";
+	attr.type = TypeReal;
+
+	hashManager->destroyFile(realFilename);
+	ret = hashManager->createFile(realFilename);
+	assert(ret == success);
+
+	ret = hashManager->openFile(realFilename, fileHandle);
+	assert(ret == success);
+
+	float zero = 0.0f;
+	float negativeZero = -0.0f;
+	rid.pageNum = 1;
+	rid.slotNum = 0;
+	ret = hashManager->insertEntry(fileHandle, attr, &negativeZero, rid);
+	assert(ret == success);
+	assert(countHashLookup(hashManager, fileHandle, attr, &zero, NULL) == 1);
+
+	ret = hashManager->deleteEntry(fileHandle, attr, &zero, rid);
+	assert(ret == success);
+	assert(countHashLookup(hashManager, fileHandle, attr, &negativeZero, NULL) == 0);
+
+	ret = hashManager->closeFile(fileHandle);
+	assert(ret == success);
+
+	ret = hashManager->destroyFile(realFilename);
+	assert(ret == success);
+}
+
+// A composite test key is (customer, region, amount), laid out the way the index takes them
+static unsigned makeCompositeKey(char* key, int customer, const string& region, float amount)
+{
+	unsigned offset = 0;
+	unsigned length = region.size();
+	memcpy(key + offset, &customer, sizeof(int));
+	offset += sizeof(int);
+	memcpy(key + offset, &length, sizeof(unsigned));
+	offset += sizeof(unsigned);
+	memcpy(key + offset, region.c_str(), length);
+	offset += length;
+	memcpy(key + offset, &amount, sizeof(float));
+	return offset + sizeof(float);
+}
+
+static void readCompositeKey(const char* key, int& customer, string& region, float& amount)
+{
+	unsigned length = 0;
+	memcpy(&customer, key, sizeof(int));
+	memcpy(&length, key + sizeof(int), sizeof(unsigned));
+	region.assign(key + sizeof(int) + sizeof(unsigned), length);
+	memcpy(&amount, key + sizeof(int) + sizeof(unsigned) + length, sizeof(float));
+}
+
+// Count the entries in a composite scan, checking they come back in order
+static int countCompositeScan(FileHandle& fileHandle, const vector<Attribute>& attrs, const void* lowKey, unsigned lowKeyValues, const void* highKey, unsigned highKeyValues, bool lowKeyInclusive, bool highKeyInclusive)
+{
+	IX_ScanIterator iter;
+	RC ret = indexManager->scan(fileHandle, attrs, lowKey, lowKeyValues, highKey, highKeyValues, lowKeyInclusive, highKeyInclusive, iter);
+	assert(ret == success);
+
+	RID rid;
+	char key[PAGE_SIZE];
+	int count = 0;
+	int lastCustomer = 0;
+	string lastRegion;
+	float lastAmount = 0;
+	while (iter.getNextEntry(rid, key) == success)
+	{
+		int customer;
+		string region;
+		float amount;
+		readCompositeKey(key, customer, region, amount);
+		assert(rid.pageNum == (unsigned)(customer + 100000) && rid.slotNum == (unsigned)(amount * 2 + 100));
+
+		if (count > 0)
+		{
+			assert(lastCustomer < customer
+				|| (lastCustomer == customer && lastRegion < region)
+				|| (lastCustomer == customer && lastRegion == region && lastAmount < amount));
+		}
+
+		lastCustomer = customer;
+		lastRegion = region;
+		lastAmount = amount;
+		++count;
+	}
+
+	iter.close();
+	return count;
+}
+
+void testCompositeKeys(const int numCustomers)
+{
+	const string filename = "testCompositeKeys_Index";
+	vector<Attribute> attrs;
+	Attribute attr;
+	attr.name = "Customer";
+	attr.type = TypeInt;
+	attr.length = 4;
+	attrs.push_back(attr);
+	attr.name = "Region";
+	attr.type = TypeVarChar;
+	attr.length = 16;
+	attrs.push_back(attr);
+	attr.name = "Amount";
+	attr.type = TypeReal;
+	attr.length = 4;
+	attrs.push_back(attr);
+
+	RC ret;
+	FileHandle fileHandle;
+
+	indexManager->destroyFile(filename);
+	ret = indexManager->createFile(filename);
+	assert(ret == success);
+
+	ret = indexManager->openFile(filename, fileHandle);
+	assert(ret == success);
+
+	// Negative customers and amounts, and regions which are prefixes of one another, all have to sort by value
+	const char* regions[] = { "east", "east", "eastern", "", "west", "w" };
+	const int numRegions = sizeof(regions) / sizeof(regions[0]);
+	const int numAmounts = 8;
+	char key[PAGE_SIZE];
+	RID rid;
+	for (int i = 0; i < numCustomers; ++i)
+	{
+		int customer = (int)(((long long)i * 7919) % numCustomers) - numCustomers / 2;
+		for (int r = 1; r < numRegions; ++r)
+		{
+			for (int a = 0; a < numAmounts; ++a)
+			{
+				float amount = (a - numAmounts / 2) * 1.5f;
+				makeCompositeKey(key, customer, regions[r], amount);
+				rid.pageNum = customer + 100000;
+				rid.slotNum = amount * 2 + 100;
+				ret = indexManager->insertEntry(fileHandle, attrs, key, rid);
+				assert(ret == success);
+			}
+		}
+	}
+
+	const int perCustomer = (numRegions - 1) * numAmounts;
+	assert(countCompositeScan(fileHandle, attrs, NULL, 0, NULL, 0, true, true) == numCustomers * perCustomer);
+
+	// A leading customer bounds all of its entries, inclusive or not
+	char lowKey[PAGE_SIZE];
+	char highKey[PAGE_SIZE];
+	int customer = 7;
+	makeCompositeKey(lowKey, customer, "", 0);
+	assert(countCompositeScan(fileHandle, attrs, lowKey, 1, lowKey, 1, true, true) == perCustomer);
+	assert(countCompositeScan(fileHandle, attrs, lowKey, 1, lowKey, 1, false, true) == 0);
+	assert(countCompositeScan(fileHandle, attrs, lowKey, 1, NULL, 0, false, true) == (numCustomers / 2 - customer - 1) * perCustomer);
+	assert(countCompositeScan(fileHandle, attrs, NULL, 0, lowKey, 1, true, false) == (numCustomers / 2 + customer) * perCustomer);
+
+	customer = -3;
+	makeCompositeKey(highKey, customer + 2, "", 0);
+	makeCompositeKey(lowKey, customer, "", 0);
+	assert(countCompositeScan(fileHandle, attrs, lowKey, 1, highKey, 1, true, true) == 3 * perCustomer);
+
+	// Two leading values, "east" does not take in "eastern" and the empty region sorts first
+	makeCompositeKey(lowKey, customer, "east", 0);
+	assert(countCompositeScan(fileHandle, attrs, lowKey, 2, lowKey, 2, true, true) == numAmounts);
+	makeCompositeKey(highKey, customer, "eastern", 0);
+	assert(countCompositeScan(fileHandle, attrs, lowKey, 2, highKey, 2, false, true) == numAmounts);
+	makeCompositeKey(lowKey, customer, "", 0);
+	assert(countCompositeScan(fileHandle, attrs, lowKey, 2, lowKey, 2, true, true) == numAmounts);
+	assert(countCompositeScan(fileHandle, attrs, lowKey, 1, lowKey, 2, true, false) == 0);
+
+	// Full keys bound a range of amounts, negative ones included
+	makeCompositeKey(lowKey, customer, "west", -3.0f);
+	makeCompositeKey(highKey, customer, "west", 1.5f);
+	assert(countCompositeScan(fileHandle, attrs, lowKey, 3, highKey, 3, true, true) == 4);
+	assert(countCompositeScan(fileHandle, attrs, lowKey, 3, highKey, 3, false, false) == 2);
+
+	// Keys are deleted by their values like any other
+	makeCompositeKey(key, customer, "west", -3.0f);
+	rid.pageNum = customer + 100000;
+	rid.slotNum = -3.0f * 2 + 100;
+	ret = indexManager->deleteEntry(fileHandle, attrs, key, rid);
+	assert(ret == success);
+	assert(countCompositeScan(fileHandle, attrs, lowKey, 3, highKey, 3, true, true) == 3);
+
+	ret = indexManager->validateIndex(fileHandle, IndexManager::getCompositeAttribute(attrs));
+	assert(ret == success);
+
+	ret = indexManager->closeFile(fileHandle);
+	assert(ret == success);
+
+	ret = indexManager->destroyFile(filename);
+	assert(ret == success);
+}
+
+// Count the entries a scan finds for key. A bulk load lays each key's RIDs out in order, inserts only keep
+// them in order within each posting list
+static int countPostingScan(FileHandle& fileHandle, const Attribute& attr, const void* key, bool ordered)
+{
+	IX_ScanIterator iter;
+	RC ret = indexManager->scan(fileHandle, attr, key, key, true, true, iter);
+	assert(ret == success);
+
+	RID rid;
+	RID lastRid;
+	char foundKey[PAGE_SIZE];
+	int count = 0;
+	while (iter.getNextEntry(rid, foundKey) == success)
+	{
+		assert(IndexManager::compareKeys(attr.type, foundKey, key) == 0);
+		assert(!ordered || count == 0 || lastRid.pageNum < rid.pageNum || (lastRid.pageNum == rid.pageNum && lastRid.slotNum < rid.slotNum));
+		lastRid = rid;
+		++count;
+	}
+
+	iter.close();
+	return count;
+}
+
+void testPostingLists(const int numEntries)
+{
+	const string filename = "testPostingLists_VarCharIndex";
+	Attribute attr;
+	attr.length = 16;
+	attr.name = "Status";
+	attr.type = TypeVarChar;
+
+	RC ret;
+	FileHandle fileHandle;
+
+	// A handful of distinct keys over many rows, inserted one at a time and then bulk loaded
+	const char* statuses[] = { "active", "closed", "pending", "suspended" };
+	const int numStatuses = sizeof(statuses) / sizeof(statuses[0]);
+	char keys[numStatuses][PAGE_SIZE];
+	for (int s = 0; s < numStatuses; ++s)
+	{
+		const unsigned length = strlen(statuses[s]);
+		memcpy(keys[s], &length, sizeof(unsigned));
+		memcpy(keys[s] + sizeof(unsigned), statuses[s], length);
+	}
+
+	for (int bulk = 0; bulk < 2; ++bulk)
+	{
+		indexManager->destroyFile(filename);
+		ret = indexManager->createFile(filename);
+		assert(ret == success);
+
+		ret = indexManager->openFile(filename, fileHandle);
+		assert(ret == success);
+
+		// RIDs are scrambled so posting lists are built out of order, with several rows to a heap page
+		IX_BulkLoader loader(attr);
+		RID rid;
+		for (int i = 0; i < numEntries; ++i)
+		{
+			const int row = (int)(((long long)i * 7919) % numEntries);
+			rid.pageNum = row / 50 + 1;
+			rid.slotNum = row % 50;
+			if (bulk)
+				ret = loader.addEntry(keys[row % numStatuses], rid);
+			else
+				ret = indexManager->insertEntry(fileHandle, attr, keys[row % numStatuses], rid);
+			assert(ret == success);
+		}
+
+		if (bulk)
+		{
+			ret = indexManager->bulkLoad(fileHandle, attr, loader);
+			assert(ret == success);
+		}
+
+		// Storing each key once and its RIDs as small differences takes less room than the RIDs alone would
+		assert(fileHandle.getNumberOfPages() < numEntries * sizeof(RID) / PAGE_SIZE);
+		ret = indexManager->validateIndex(fileHandle, attr);
+		assert(ret == success);
+
+		for (int s = 0; s < numStatuses; ++s)
+		{
+			assert(countPostingScan(fileHandle, attr, keys[s], bulk) == numEntries / numStatuses);
+		}
+
+		// Delete every other row, deleting one that is not there is still an error
+		for (int row = 0; row < numEntries; row += 2)
+		{
+			rid.pageNum = row / 50 + 1;
+			rid.slotNum = row % 50;
+			ret = indexManager->deleteEntry(fileHandle, attr, keys[row % numStatuses], rid);
+			assert(ret == success);
+		}
+
+		rid.pageNum = 1;
+		rid.slotNum = 0;
+		assert(indexManager->deleteEntry(fileHandle, attr, keys[0], rid) == rc::BTREE_INDEX_LEAF_ENTRY_NOT_FOUND);
+
+		for (int s = 0; s < numStatuses; ++s)
+		{
+			assert(countPostingScan(fileHandle, attr, keys[s], bulk) == (s % 2 == 0 ? 0 : numEntries / numStatuses));
+		}
+
+		ret = indexManager->validateIndex(fileHandle, attr);
+		assert(ret == success);
+
+		ret = indexManager->closeFile(fileHandle);
+		assert(ret == success);
+	}
+
+	ret = indexManager->destroyFile(filename);
+	assert(ret == success);
+}
+
+static bool ridLess(const RID& lhs, const RID& rhs)
+{
+	return lhs.pageNum < rhs.pageNum || (lhs.pageNum == rhs.pageNum && lhs.slotNum < rhs.slotNum);
+}
+
+void testLookupMany(const int numEntries)
+{
+	const string filename = "testLookupMany_IntIndex";
+	Attribute attr;
+	attr.length = 4;
+	attr.name = "Age";
+	attr.type = TypeInt;
+
+	RC ret;
+	FileHandle fileHandle;
+
+	indexManager->destroyFile(filename);
+	ret = indexManager->createFile(filename);
+	assert(ret == success);
+
+	ret = indexManager->openFile(filename, fileHandle);
+	assert(ret == success);
+
+	// Even keys only, a few rows each, and one key with enough rows to run over several leaves
+	const int numKeys = numEntries / 3;
+	const int hotKey = numKeys;
+	RID rid;
+	for (int i = 0; i < numEntries; ++i)
+	{
+		const int key = (i % numKeys) * 2;
+		rid.pageNum = i / 50 + 1;
+		rid.slotNum = i % 50;
+		ret = indexManager->insertEntry(fileHandle, attr, &key, rid);
+		assert(ret == success);
+	}
+
+	for (int i = 0; i < numEntries / 4; ++i)
+	{
+		rid.pageNum = numEntries + i / 50;
+		rid.slotNum = i % 50;
+		ret = indexManager->insertEntry(fileHandle, attr, &hotKey, rid);
+		assert(ret == success);
+	}
+
+	// Probe every key in range plus the odd ones in between, some below and above, and one twice
+	std::vector<int> probeValues;
+	for (int key = -10; key < numKeys * 2 + 10; ++key)
+	{
+		probeValues.push_back(key);
+		if (key == hotKey)
+			probeValues.push_back(key);
+	}
+
+	std::vector<const void*> probes;
+	for (unsigned i = 0; i < probeValues.size(); ++i)
+	{
+		probes.push_back(&probeValues[i]);
+	}
+
+	std::vector<std::vector<RID> > rids;
+	ret = indexManager->lookupMany(fileHandle, attr, probes, rids);
+	assert(ret == success);
+	assert(rids.size() == probes.size());
+
+	// Each key finds the same RIDs a scan of just that key does
+	IX_ScanIterator ix_ScanIterator;
+	int found = 0;
+	for (unsigned i = 0; i < probes.size(); ++i)
+	{
+		std::vector<RID> expected;
+		ret = indexManager->scan(fileHandle, attr, probes[i], probes[i], true, true, ix_ScanIterator);
+		assert(ret == success);
+
+		int key;
+		while (ix_ScanIterator.getNextEntry(rid, &key) == success)
+		{
+			expected.push_back(rid);
+		}
+		ix_ScanIterator.close();
+
+		std::sort(expected.begin(), expected.end(), ridLess);
+		std::sort(rids[i].begin(), rids[i].end(), ridLess);
+		assert(rids[i].size() == expected.size());
+		for (unsigned r = 0; r < expected.size(); ++r)
+		{
+			assert(rids[i][r].pageNum == expected[r].pageNum && rids[i][r].slotNum == expected[r].slotNum);
+		}
+		if (i == 0 || probeValues[i] != probeValues[i - 1])
+			found += rids[i].size();
+	}
+	assert(found == numEntries + numEntries / 4);
+
+	// Keys out of order are refused
+	std::swap(probes[0], probes[1]);
+	assert(indexManager->lookupMany(fileHandle, attr, probes, rids) == rc::BTREE_KEYS_NOT_SORTED);
+
+	ret = indexManager->closeFile(fileHandle);
+	assert(ret == success);
+
+	ret = indexManager->destroyFile(filename);
+	assert(ret == success);
+}
+
+// Insert the keys in the order given, check they all scan back in order and return the file's size
+static unsigned buildAppendIndex(const string& filename, const Attribute& attr, const std::vector<int>& keys, float splitFillFactor)
+{
+	FileHandle fileHandle;
+	indexManager->destroyFile(filename);
+	RC ret = indexManager->createFile(filename);
+	assert(ret == success);
+
+	ret = indexManager->openFile(filename, fileHandle);
+	assert(ret == success);
+
+	ret = indexManager->setSplitFillFactor(fileHandle, splitFillFactor);
+	assert(ret == success);
+
+	RID rid;
+	for (unsigned i = 0; i < keys.size(); ++i)
+	{
+		rid.pageNum = i / 50 + 1;
+		rid.slotNum = i % 50;
+		ret = indexManager->insertEntry(fileHandle, attr, &keys[i], rid);
+		assert(ret == success);
+	}
+
+	ret = indexManager->validateIndex(fileHandle, attr);
+	assert(ret == success);
+
+	std::vector<int> sortedKeys(keys);
+	std::sort(sortedKeys.begin(), sortedKeys.end());
+
+	IX_ScanIterator ix_ScanIterator;
+	ret = indexManager->scan(fileHandle, attr, NULL, NULL, true, true, ix_ScanIterator);
+	assert(ret == success);
+
+	unsigned count = 0;
+	int key;
+	while (ix_ScanIterator.getNextEntry(rid, &key) == success)
+	{
+		assert(count < sortedKeys.size() && key == sortedKeys[count]);
+		++count;
+	}
+	assert(count == sortedKeys.size());
+	ix_ScanIterator.close();
+
+	const unsigned numPages = fileHandle.getNumberOfPages();
+	ret = indexManager->closeFile(fileHandle);
+	assert(ret == success);
+	return numPages;
+}
+
+void testAppendInserts(const int numEntries)
+{
+	const string filename = "testAppendInserts_IntIndex";
+	Attribute attr;
+	attr.length = 4;
+	attr.name = "Age";
+	attr.type = TypeInt;
+
+	std::vector<int> keys;
+	for (int i = 0; i < numEntries; ++i)
+	{
+		keys.push_back(i);
+	}
+
+	// Increasing keys fill each leaf before moving on, shuffled ones leave pages part empty after they split
+	const unsigned sequentialPages = buildAppendIndex(filename, attr, keys, IX_DEFAULT_SPLIT_FILL_FACTOR);
+
+	std::vector<int> shuffledKeys(keys);
+	std::srand(numEntries);
+	std::random_shuffle(shuffledKeys.begin(), shuffledKeys.end());
+	const unsigned shuffledPages = buildAppendIndex(filename, attr, shuffledKeys, IX_DEFAULT_SPLIT_FILL_FACTOR);
+	assert(sequentialPages * 5 < shuffledPages * 4);
+
+	// Below a larger key the splits are not at the right edge, so the fill factor decides how full they leave
+	// the pages behind them
+	keys.insert(keys.begin(), numEntries * 2);
+	const unsigned halfPages = buildAppendIndex(filename, attr, keys, IX_DEFAULT_SPLIT_FILL_FACTOR);
+	const unsigned packedPages = buildAppendIndex(filename, attr, keys, 0.9f);
+	assert(packedPages * 10 < halfPages * 7);
+
+	// The fill factor is kept with the file
+	FileHandle fileHandle;
+	RC ret = indexManager->openFile(filename, fileHandle);
+	assert(ret == success);
+	assert(indexManager->getSplitFillFactor(fileHandle) == 0.9f);
+
+	ret = indexManager->setSplitFillFactor(fileHandle, 2.0f);
+	assert(ret == success);
+	assert(indexManager->getSplitFillFactor(fileHandle) == 1.0f);
+
+	// A factor of 0 is kept as the smallest one, and survives opening the file again rather than reading as unset
+	ret = indexManager->setSplitFillFactor(fileHandle, 0.0f);
+	assert(ret == success);
+	assert(indexManager->getSplitFillFactor(fileHandle) == IX_MIN_SPLIT_FILL_FACTOR);
+
+	ret = indexManager->closeFile(fileHandle);
+	assert(ret == success);
+
+	ret = indexManager->openFile(filename, fileHandle);
+	assert(ret == success);
+	assert(indexManager->getSplitFillFactor(fileHandle) == IX_MIN_SPLIT_FILL_FACTOR);
+
+	ret = indexManager->closeFile(fileHandle);
+	assert(ret == success);
+
+	ret = indexManager->destroyFile(filename);
+	assert(ret == success);
+}
+
+// Scan [lowKey, highKey] in the given order, keeping every key and RID that comes back
+static void collectScan(FileHandle& fileHandle, const Attribute& attr, const int* lowKey, const int* highKey, bool lowKeyInclusive, bool highKeyInclusive, IX_ScanOrder order, std::vector<std::pair<int, RID> >& entries)
+{
+	entries.clear();
+
+	IX_ScanIterator iter;
+	RC ret = indexManager->scan(fileHandle, attr, lowKey, highKey, lowKeyInclusive, highKeyInclusive, order, iter);
+	assert(ret == success);
+
+	RID rid;
+	int key = 0;
+	while (iter.getNextEntry(rid, &key) == success)
+	{
+		entries.push_back(std::make_pair(key, rid));
+	}
+	iter.close();
+}
+
+static bool sameEntries(const std::vector<std::pair<int, RID> >& lhs, const std::vector<std::pair<int, RID> >& rhs)
+{
+	if (lhs.size() != rhs.size())
+		return false;
+
+	for (unsigned i = 0; i < lhs.size(); ++i)
+	{
+		if (lhs[i].first != rhs[i].first || lhs[i].second.pageNum != rhs[i].second.pageNum || lhs[i].second.slotNum != rhs[i].second.slotNum)
+			return false;
+	}
+
+	return true;
+}
+
+void testReverseScan(const int numKeys)
+{
+	const string filename = "testReverseScan_IntIndex";
+	Attribute attr;
+	attr.length = 4;
+	attr.name = "Age";
+	attr.type = TypeInt;
+
+	RC ret;
+	FileHandle fileHandle;
+
+	indexManager->destroyFile(filename);
+	ret = indexManager->createFile(filename);
+	assert(ret == success);
+
+	ret = indexManager->openFile(filename, fileHandle);
+	assert(ret == success);
+
+	// Shuffled keys, every tenth one with a few duplicates
+	std::vector<int> keys;
+	for (int i = 0; i < numKeys; ++i)
+	{
+		keys.push_back(i);
+		if (i % 10 == 0)
+		{
+			keys.push_back(i);
+			keys.push_back(i);
+		}
+	}
+	std::srand(numKeys);
+	std::random_shuffle(keys.begin(), keys.end());
+
+	RID rid;
+	for (unsigned i = 0; i < keys.size(); ++i)
+	{
+		rid.pageNum = i + 1;
+		rid.slotNum = keys[i] % 50;
+		ret = indexManager->insertEntry(fileHandle, attr, &keys[i], rid);
+		assert(ret == success);
+	}
+
+	// Every range descending gives back exactly what it does ascending, the other way round
+	const int low = 100;
+	const int high = 5000;
+	const int middle = 770;
+	const int* lowKeys[] = { NULL, &low, &low, NULL, &middle, &high, &middle };
+	const int* highKeys[] = { NULL, &high, &high, &middle, NULL, &low, &middle };
+	const bool inclusive[] = { true, true, false, false, true, true, true };
+	std::vector<std::pair<int, RID> > ascending;
+	std::vector<std::pair<int, RID> > descending;
+	for (unsigned i = 0; i < sizeof(inclusive) / sizeof(inclusive[0]); ++i)
+	{
+		collectScan(fileHandle, attr, lowKeys[i], highKeys[i], inclusive[i], inclusive[i], IX_SCAN_ASCENDING, ascending);
+		collectScan(fileHandle, attr, lowKeys[i], highKeys[i], inclusive[i], inclusive[i], IX_SCAN_DESCENDING, descending);
+		std::reverse(descending.begin(), descending.end());
+		assert(sameEntries(ascending, descending));
+	}
+
+	collectScan(fileHandle, attr, NULL, NULL, true, true, IX_SCAN_DESCENDING, descending);
+	assert(descending.size() == keys.size());
+	assert(descending.front().first == numKeys - 1 && descending.back().first == 0);
+
+	collectScan(fileHandle, attr, &middle, &middle, true, true, IX_SCAN_DESCENDING, descending);
+	assert(descending.size() == 3);
+
+	collectScan(fileHandle, attr, &high, &low, true, true, IX_SCAN_DESCENDING, descending);
+	assert(descending.empty());
+
+	// Deleting as we go merges leaves on the path the scan keeps, each entry still has to come back exactly once
+	vector<bool> seen(keys.size(), false);
+	IX_ScanIterator iter;
+	int key = 0;
+	int lastKey = numKeys;
+	unsigned count = 0;
+	ret = indexManager->scan(fileHandle, attr, NULL, NULL, true, true, IX_SCAN_DESCENDING, iter);
+	assert(ret == success);
+	while (iter.getNextEntry(rid, &key) == success)
+	{
+		assert(key <= lastKey);
+		assert(!seen[rid.pageNum - 1]);
+		seen[rid.pageNum - 1] = true;
+		lastKey = key;
+		if (count % 3 != 0)
+		{
+			ret = indexManager->deleteEntry(fileHandle, attr, &key, rid);
+			assert(ret == success);
+		}
+		++count;
+	}
+	iter.close();
+	assert(count == keys.size());
+
+	ret = indexManager->validateIndex(fileHandle, attr);
+	assert(ret == success);
+
+	collectScan(fileHandle, attr, NULL, NULL, true, true, IX_SCAN_ASCENDING, ascending);
+	collectScan(fileHandle, attr, NULL, NULL, true, true, IX_SCAN_DESCENDING, descending);
+	assert(ascending.size() == (keys.size() + 2) / 3);
+	std::reverse(descending.begin(), descending.end());
+	assert(sameEntries(ascending, descending));
+
+	ret = indexManager->closeFile(fileHandle);
+	assert(ret == success);
+
+	ret = indexManager->destroyFile(filename);
+	assert(ret == success);
+}
+
+typedef std::set<std::pair<int, std::pair<unsigned, unsigned> > > LsmModel;
+
+static void collectLsmScan(FileHandle& fileHandle, const Attribute& attr, const int* lowKey, const int* highKey, bool lowKeyInclusive, bool highKeyInclusive, LsmModel& entries)
+{
+	entries.clear();
+
+	LX_ScanIterator iter;
+	RC ret = LsmIndexManager::instance()->scan(fileHandle, attr, lowKey, highKey, lowKeyInclusive, highKeyInclusive, iter);
+	assert(ret == success);
+
+	RID rid;
+	int key = 0;
+	int lastKey = INT_MIN;
+	while (iter.getNextEntry(rid, &key) == success)
+	{
+		assert(key >= lastKey);
+		assert(entries.insert(std::make_pair(key, std::make_pair(rid.pageNum, rid.slotNum))).second);
+		lastKey = key;
+	}
+	iter.close();
+}
+
+// What the model holds in the range, the way a scan would return it
+static void modelRange(const LsmModel& model, int lowKey, int highKey, bool inclusive, LsmModel& entries)
+{
+	entries.clear();
+	for (LsmModel::const_iterator it = model.begin(); it != model.end(); ++it)
+	{
+		if (it->first > lowKey - (inclusive ? 1 : 0) && it->first < highKey + (inclusive ? 1 : 0))
+			entries.insert(*it);
+	}
+}
+
+void testLsmIndex(const int numKeys)
+{
+	LsmIndexManager* lsmManager = LsmIndexManager::instance();
+	const string filename = "testLsmIndex_IntIndex";
+	Attribute attr;
+	attr.length = 4;
+	attr.name = "Age";
+	attr.type = TypeInt;
+
+	RC ret;
+	FileHandle fileHandle;
+
+	// A small memtable so the keys below make a few levels of runs
+	lsmManager->setMemtableSize(64 * 1024);
+	lsmManager->destroyFile(filename);
+	ret = lsmManager->createFile(filename);
+	assert(ret == success);
+
+	ret = lsmManager->openFile(filename, fileHandle);
+	assert(ret == success);
+
+	// Shuffled even keys, every tenth one twice, and every fifth entry deleted again a little later
+	std::vector<int> keys;
+	for (int i = 0; i < numKeys; ++i)
+	{
+		keys.push_back(2 * i);
+		if (i % 10 == 0)
+			keys.push_back(2 * i);
+	}
+	std::srand(numKeys);
+	std::random_shuffle(keys.begin(), keys.end());
+
+	LsmModel model;
+	RID rid;
+	for (unsigned i = 0; i < keys.size(); ++i)
+	{
+		rid.pageNum = i + 1;
+		rid.slotNum = keys[i] % 7;
+		ret = lsmManager->insertEntry(fileHandle, attr, &keys[i], rid);
+		assert(ret == success);
+		model.insert(std::make_pair(keys[i], std::make_pair(rid.pageNum, rid.slotNum)));
+
+		if (i >= 1000 && i % 5 == 0)
+		{
+			rid.pageNum = i - 999;
+			rid.slotNum = keys[i - 1000] % 7;
+			ret = lsmManager->deleteEntry(fileHandle, attr, &keys[i - 1000], rid);
+			assert(ret == success);
+			model.erase(std::make_pair(keys[i - 1000], std::make_pair(rid.pageNum, rid.slotNum)));
+		}
+	}
+
+	// Once compaction settles no level is left with enough runs to merge
+	ret = lsmManager->flush(fileHandle, attr);
+	assert(ret == success);
+
+	std::vector<unsigned> levels;
+	ret = lsmManager->getRunLevels(fileHandle, attr, levels);
+	assert(ret == success);
+	assert(!levels.empty() && levels.back() > 0);
+	for (unsigned i = 0; i < levels.size(); ++i)
+	{
+		assert(i == 0 || levels[i] >= levels[i - 1]);
+		assert(std::count(levels.begin(), levels.end(), levels[i]) < LX_RUNS_PER_LEVEL);
+	}
+
+	// Leave some changes in the memtable as well
+	for (int i = 0; i < 500; ++i)
+	{
+		int key = 2 * i + 1;
+		rid.pageNum = keys.size() + i + 1;
+		rid.slotNum = 0;
+		ret = lsmManager->insertEntry(fileHandle, attr, &key, rid);
+		assert(ret == success);
+		model.insert(std::make_pair(key, std::make_pair(rid.pageNum, rid.slotNum)));
+	}
+
+	LsmModel scanned;
+	LsmModel expected;
+	collectLsmScan(fileHandle, attr, NULL, NULL, true, true, scanned);
+	assert(scanned == model);
+
+	const int lowKeys[] = { 0, 100, 777, 2 * numKeys - 50, -10 };
+	const int highKeys[] = { 40, 5000, 777, 2 * numKeys + 50, -1 };
+	for (unsigned i = 0; i < sizeof(lowKeys) / sizeof(lowKeys[0]); ++i)
+	{
+		for (int inclusive = 0; inclusive < 2; ++inclusive)
+		{
+			collectLsmScan(fileHandle, attr, &lowKeys[i], &highKeys[i], inclusive, inclusive, scanned);
+			modelRange(model, lowKeys[i], highKeys[i], inclusive, expected);
+			assert(scanned == expected);
+		}
+	}
+
+	// Equality scans, the Bloom filters keep most runs out of lookups for keys nobody inserted
+	for (int key = 0; key < 2000; ++key)
+	{
+		collectLsmScan(fileHandle, attr, &key, &key, true, true, scanned);
+		modelRange(model, key, key, true, expected);
+		assert(scanned == expected);
+	}
+
+	// Closing lets go of the memtable, opening again replays the log
+	ret = lsmManager->closeFile(fileHandle);
+	assert(ret == success);
+
+	ret = lsmManager->openFile(filename, fileHandle);
+	assert(ret == success);
+
+	collectLsmScan(fileHandle, attr, NULL, NULL, true, true, scanned);
+	assert(scanned == model);
+
+	ret = lsmManager->getRunLevels(fileHandle, attr, levels);
+	assert(ret == success);
+	assert(!levels.empty());
+
+	// Deleting everything ever inserted leaves nothing, even before compaction drops the tombstones
+	for (LsmModel::const_iterator it = model.begin(); it != model.end(); ++it)
+	{
+		rid.pageNum = it->second.first;
+		rid.slotNum = it->second.second;
+		ret = lsmManager->deleteEntry(fileHandle, attr, &it->first, rid);
+		assert(ret == success);
+	}
+
+	collectLsmScan(fileHandle, attr, NULL, NULL, true, true, scanned);
+	assert(scanned.empty());
+
+	ret = lsmManager->deleteRecords(fileHandle);
+	assert(ret == success);
+
+	ret = lsmManager->getRunLevels(fileHandle, attr, levels);
+	assert(ret == success);
+	assert(levels.empty());
+
+	ret = lsmManager->closeFile(fileHandle);
+	assert(ret == success);
+
+	ret = lsmManager->destroyFile(filename);
+	assert(ret == success);
+
+	lsmManager->setMemtableSize(LX_DEFAULT_MEMTABLE_SIZE);
+}
+
+static void collectArtScan(ArtIndex& index, const int* lowKey, const int* highKey, bool lowKeyInclusive, bool highKeyInclusive, LsmModel& entries)
+{
+	entries.clear();
+
+	AX_ScanIterator iter;
+	RC ret = index.scan(lowKey, highKey, lowKeyInclusive, highKeyInclusive, iter);
+	assert(ret == success);
+
+	RID rid;
+	int key = 0;
+	int lastKey = INT_MIN;
+	while (iter.getNextEntry(rid, &key) == success)
+	{
+		assert(key >= lastKey);
+		assert(entries.insert(std::make_pair(key, std::make_pair(rid.pageNum, rid.slotNum))).second);
+		lastKey = key;
+	}
+	iter.close();
+}
+
+void testArtIndex(const int numKeys)
+{
+	Attribute attr;
+	attr.length = 4;
+	attr.name = "Age";
+	attr.type = TypeInt;
+
+	RC ret;
+	ArtIndex index(attr);
+
+	// Shuffled keys on both sides of zero, every tenth one twice, so nodes fill up to 256 children
+	std::vector<int> keys;
+	for (int i = 0; i < numKeys; ++i)
+	{
+		keys.push_back(3 * i - numKeys);
+		if (i % 10 == 0)
+			keys.push_back(3 * i - numKeys);
+	}
+	std::srand(numKeys);
+	std::random_shuffle(keys.begin(), keys.end());
+
+	LsmModel model;
+	RID rid;
+	for (unsigned i = 0; i < keys.size(); ++i)
+	{
+		rid.pageNum = i + 1;
+		rid.slotNum = i % 7;
+		ret = index.insertEntry(&keys[i], rid);
+		assert(ret == success);
+		model.insert(std::make_pair(keys[i], std::make_pair(rid.pageNum, rid.slotNum)));
+	}
+	assert(index.getNumEntries() == model.size());
+
+	// The same entry twice is refused, a missing one cannot be deleted
+	rid.pageNum = 1;
+	rid.slotNum = 0;
+	ret = index.insertEntry(&keys[0], rid);
+	assert(ret == rc::ART_INDEX_DUPLICATE_ENTRY);
+
+	rid.pageNum = keys.size() + 1;
+	ret = index.deleteEntry(&keys[0], rid);
+	assert(ret == rc::ART_INDEX_ENTRY_NOT_FOUND);
+
+	unsigned counts[AX_NODE_TYPES];
+	index.getNodeCounts(counts);
+	assert(counts[AX_LEAF] == model.size());
+	assert(counts[AX_NODE256] > 0);
+	const unsigned fullNodes = counts[AX_NODE256];
+
+	LsmModel scanned;
+	LsmModel expected;
+	collectArtScan(index, NULL, NULL, true, true, scanned);
+	assert(scanned == model);
+
+	const int lowKeys[] = { -numKeys, -100, 0, 777, 2 * numKeys - 50, 5 * numKeys };
+	const int highKeys[] = { -numKeys + 40, 100, 0, 777, 2 * numKeys + 50, 6 * numKeys };
+	for (unsigned i = 0; i < sizeof(lowKeys) / sizeof(lowKeys[0]); ++i)
+	{
+		for (int inclusive = 0; inclusive < 2; ++inclusive)
+		{
+			collectArtScan(index, &lowKeys[i], &highKeys[i], inclusive, inclusive, scanned);
+			modelRange(model, lowKeys[i], highKeys[i], inclusive, expected);
+			assert(scanned == expected);
+		}
+	}
+
+	// Open ended ranges
+	collectArtScan(index, &lowKeys[2], NULL, false, true, scanned);
+	modelRange(model, lowKeys[2], INT_MAX, false, expected);
+	assert(scanned == expected);
+
+	collectArtScan(index, NULL, &highKeys[1], true, true, scanned);
+	modelRange(model, INT_MIN + 1, highKeys[1], true, expected);
+	assert(scanned == expected);
+
+	// Equality lookups, hits and misses
+	for (int key = -300; key < 300; ++key)
+	{
+		collectArtScan(index, &key, &key, true, true, scanned);
+		modelRange(model, key, key, true, expected);
+		assert(scanned == expected);
+	}
+
+	// Deleting while a scan is open, the scan carries on after the last entry it returned
+	{
+		AX_ScanIterator iter;
+		ret = index.scan(NULL, NULL, true, true, iter);
+		assert(ret == success);
+
+		int key = 0;
+		LsmModel::iterator next = model.begin();
+		while (iter.getNextEntry(rid, &key) == success)
+		{
+			assert(next != model.end() && next->first == key && next->second.first == rid.pageNum);
+			if (std::rand() % 3 != 0)
+			{
+				ret = index.deleteEntry(&key, rid);
+				assert(ret == success);
+				model.erase(next++);
+			}
+			else
+			{
+				++next;
+			}
+		}
+		assert(next == model.end());
+		iter.close();
+	}
+	assert(index.getNumEntries() == model.size());
+
+	collectArtScan(index, NULL, NULL, true, true, scanned);
+	assert(scanned == model);
+
+	// With most entries gone the nodes shrink back
+	index.getNodeCounts(counts);
+	assert(counts[AX_LEAF] == model.size());
+	assert(counts[AX_NODE256] < fullNodes);
+
+	for (LsmModel::const_iterator it = model.begin(); it != model.end(); ++it)
+	{
+		rid.pageNum = it->second.first;
+		rid.slotNum = it->second.second;
+		ret = index.deleteEntry(&it->first, rid);
+		assert(ret == success);
+	}
+	assert(index.getNumEntries() == 0);
+
+	index.getNodeCounts(counts);
+	for (unsigned i = 0; i < AX_NODE_TYPES; ++i)
+		assert(counts[i] == 0);
+
+	collectArtScan(index, NULL, NULL, true, true, scanned);
+	assert(scanned.empty());
+
+	// Reals order the same as compareKeys(), negative zero included
+	Attribute realAttr;
+	realAttr.length = 4;
+	realAttr.name = "Height";
+	realAttr.type = TypeReal;
+
+	ArtIndex realIndex(realAttr);
+	const float reals[] = { 3.5f, -0.0f, -2.25f, 0.0f, 1e-6f, -1e9f, 7.0f, -1e-6f };
+	const unsigned numReals = sizeof(reals) / sizeof(reals[0]);
+	for (unsigned i = 0; i < numReals; ++i)
+	{
+		rid.pageNum = i + 1;
+		rid.slotNum = 0;
+		ret = realIndex.insertEntry(&reals[i], rid);
+		assert(ret == success);
+	}
+
+	{
+		AX_ScanIterator iter;
+		const float zero = 0.0f;
+		ret = realIndex.scan(&zero, &zero, true, true, iter);
+		assert(ret == success);
+
+		float value = 1;
+		unsigned zeros = 0;
+		while (iter.getNextEntry(rid, &value) == success)
+		{
+			assert(value == 0.0f);
+			++zeros;
+		}
+		assert(zeros == 2);
+
+		ret = realIndex.scan(NULL, NULL, true, true, iter);
+		assert(ret == success);
+
+		float lastValue = -1e10f;
+		unsigned count = 0;
+		while (iter.getNextEntry(rid, &value) == success)
+		{
+			assert(value >= lastValue);
+			lastValue = value;
+			++count;
+		}
+		assert(count == numReals);
+	}
+
+	// Varchars, one a prefix of another and one holding a zero byte
+	Attribute nameAttr;
+	nameAttr.length = 32;
+	nameAttr.name = "Name";
+	nameAttr.type = TypeVarChar;
+
+	ArtIndex nameIndex(nameAttr);
+	const char* names[] = { "ab", "a", "abc", "b", "", "a\0b", "abd", "aa" };
+	const unsigned nameLengths[] = { 2, 1, 3, 1, 0, 3, 3, 2 };
+	const unsigned numNames = sizeof(names) / sizeof(names[0]);
+	char nameKey[64];
+	for (unsigned i = 0; i < numNames; ++i)
+	{
+		memcpy(nameKey, &nameLengths[i], sizeof(unsigned));
+		memcpy(nameKey + sizeof(unsigned), names[i], nameLengths[i]);
+		rid.pageNum = i + 1;
+		rid.slotNum = 0;
+		ret = nameIndex.insertEntry(nameKey, rid);
+		assert(ret == success);
+	}
+
+	{
+		// Everything after "a" up to "abc", the order compareKeys() gives them
+		memcpy(nameKey, &nameLengths[1], sizeof(unsigned));
+		memcpy(nameKey + sizeof(unsigned), names[1], nameLengths[1]);
+		char highKey[64];
+		memcpy(highKey, &nameLengths[2], sizeof(unsigned));
+		memcpy(highKey + sizeof(unsigned), names[2], nameLengths[2]);
+
+		AX_ScanIterator iter;
+		ret = nameIndex.scan(nameKey, highKey, false, true, iter);
+		assert(ret == success);
+
+		char value[64];
+		char lastValue[64];
+		unsigned count = 0;
+		while (iter.getNextEntry(rid, value) == success)
+		{
+			assert(IndexManager::compareKeys(TypeVarChar, value, nameKey) > 0);
+			assert(IndexManager::compareKeys(TypeVarChar, value, highKey) <= 0);
+			assert(count == 0 || IndexManager::compareKeys(TypeVarChar, lastValue, value) < 0);
+			memcpy(lastValue, value, sizeof(value));
+			++count;
+		}
+		assert(count == 4);
+	}
+
+	nameIndex.clear();
+	assert(nameIndex.getNumEntries() == 0);
+}
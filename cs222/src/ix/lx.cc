@@ -0,0 +1,1262 @@
+#include "lx.h"
+#include "hx.h"
+#include "../rbf/pfm.h"
+#include "../util/returncodes.h"
+#include "../util/dbgout.h"
+#include "../util/hash.h"
+
+#include <assert.h>
+#include <cstring>
+#include <sstream>
+#include <algorithm>
+
+LsmIndexManager* LsmIndexManager::_lsm_index_manager = 0;
+
+LsmIndexManager* LsmIndexManager::instance()
+{
+    if(!_lsm_index_manager)
+        _lsm_index_manager = new LsmIndexManager();
+
+    return _lsm_index_manager;
+}
+
+LsmIndexManager::LsmIndexManager()
+	: RecordBasedCoreManager(sizeof(LX_PageFooter)), _memtableSize(LX_DEFAULT_MEMTABLE_SIZE)
+{
+}
+
+LsmIndexManager::~LsmIndexManager()
+{
+    // We don't want our static pointer to be pointing to deleted data in case the object is ever deleted!
+    _lsm_index_manager = NULL;
+}
+
+RC LsmIndexManager::readAttribute(FileHandle &/*fileHandle*/, const vector<Attribute> &/*recordDescriptor*/, const RID &/*rid*/, const string /*attributeName*/, void * /*data*/)
+{
+	return rc::FEATURE_NOT_YET_IMPLEMENTED;
+}
+
+RC LsmIndexManager::reorganizePage(FileHandle &/*fileHandle*/, const vector<Attribute> &/*recordDescriptor*/, const unsigned /*pageNumber*/)
+{
+	// Run pages are written packed and never change
+	return rc::OK;
+}
+
+LX_Header* LsmIndexManager::getHeader(void* headerPage)
+{
+	return (LX_Header*)((char*)headerPage + PAGE_SIZE - sizeof(LX_Header));
+}
+
+LX_PageFooter* LsmIndexManager::getPageFooter(void* pageBuffer)
+{
+	return (LX_PageFooter*)((char*)pageBuffer + PAGE_SIZE - sizeof(LX_PageFooter));
+}
+
+std::string LsmIndexManager::getRunFileName(const std::string& fileName, unsigned runId)
+{
+	std::ostringstream name;
+	name << fileName << ".run" << runId;
+	return name.str();
+}
+
+void LsmIndexManager::setMemtableSize(unsigned bytes)
+{
+	_memtableSize = std::max(bytes, (unsigned)PAGE_SIZE);
+}
+
+static unsigned getEntryLength(AttrType type, const char* entry)
+{
+	return sizeof(RID) + Attribute::sizeInBytes(type, entry + sizeof(RID));
+}
+
+static int compareEntries(AttrType type, const char* lhs, const char* rhs)
+{
+	int result = IndexManager::compareKeys(type, lhs + sizeof(RID), rhs + sizeof(RID));
+	if (result != 0)
+		return result;
+
+	RID left, right;
+	memcpy(&left, lhs, sizeof(RID));
+	memcpy(&right, rhs, sizeof(RID));
+	if (left.pageNum != right.pageNum)
+		return left.pageNum < right.pageNum ? -1 : 1;
+
+	if (left.slotNum != right.slotNum)
+		return left.slotNum < right.slotNum ? -1 : 1;
+
+	return 0;
+}
+
+static void makeEntry(AttrType type, const void* key, const RID& rid, std::vector<char>& entry)
+{
+	const unsigned keySize = Attribute::sizeInBytes(type, key);
+	entry.resize(sizeof(RID) + keySize);
+	memcpy(&entry[0], &rid, sizeof(RID));
+	memcpy(&entry[sizeof(RID)], key, keySize);
+}
+
+// The Bloom filter probes h1 + i * h2, two hashes standing in for LX_BLOOM_HASHES of them
+static void getBloomHashes(AttrType type, const void* key, unsigned& h1, unsigned& h2)
+{
+	h1 = HashIndexManager::hashKey(type, key);
+	h2 = util::jenkins(h1) | 1;
+}
+
+bool LX_EntryLess::operator()(const std::vector<char>& lhs, const std::vector<char>& rhs) const
+{
+	return compareEntries(type, &lhs[0], &rhs[0]) < 0;
+}
+
+bool LX_Run::mayContain(AttrType type, const void* key) const
+{
+	if (header.bloomBits == 0)
+		return true;
+
+	unsigned h1 = 0, h2 = 0;
+	getBloomHashes(type, key, h1, h2);
+	for (unsigned i = 0; i < LX_BLOOM_HASHES; ++i)
+	{
+		const unsigned bit = (h1 + i * h2) % header.bloomBits;
+		if (!(bloom[bit / 8] & (1 << (bit % 8))))
+			return false;
+	}
+
+	return true;
+}
+
+PageNum LX_Run::findFirstPage(AttrType type, const void* key) const
+{
+	// Find the first page starting at or after key, the page before it may still end with key
+	unsigned low = 0;
+	unsigned high = fenceOffsets.size();
+	while (low < high)
+	{
+		const unsigned middle = (low + high) / 2;
+		if (IndexManager::compareKeys(type, getFence(middle), key) < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	return low > 0 ? low - 1 : 0;
+}
+
+LX_Index::LX_Index(const std::string& fileName, AttrType type)
+	: fileName(fileName), type(type), memtable(LX_EntryLess(type)), memtableBytes(0), nextRunId(0), logPages(0), compacting(false), stopping(false)
+{
+	memset(logPage, 0, PAGE_SIZE);
+}
+
+// Writes a run file front to back: a placeholder header page, the data pages, then the Bloom filter and
+// fence keys once every entry has been seen, and the real header last
+class LX_RunWriter
+{
+public:
+	LX_RunWriter(AttrType type) : _type(type), _bytes(0) { memset(&_header, 0, sizeof(_header)); memset(_pageBuffer, 0, PAGE_SIZE); }
+	~LX_RunWriter() { abandon(); }
+
+	RC open(const std::string& fileName);
+	RC add(const char* entry, unsigned entryLength, bool tombstone);
+	RC finish();
+	void abandon();
+
+	unsigned numEntries() const { return _header.numEntries; }
+	unsigned long long bytes() const { return _bytes; }
+
+private:
+	RC writeDataPage();
+
+	AttrType _type;
+	std::string _fileName;
+	FileHandle _fileHandle;
+	LX_RunHeader _header;
+	unsigned char _pageBuffer[PAGE_SIZE];
+	unsigned long long _bytes;
+
+	std::vector<unsigned> _hashes;
+	std::vector<char> _fenceKeys;
+};
+
+RC LX_RunWriter::open(const std::string& fileName)
+{
+	// A run id handed out before a crash may have left a file no header names, it is ours to write over
+	PagedFileManager* pfm = PagedFileManager::instance();
+	pfm->destroyFile(fileName.c_str());
+
+	RC ret = pfm->createFile(fileName.c_str());
+	RETURN_ON_ERR(ret);
+
+	_fileName = fileName;
+	ret = pfm->openFile(fileName.c_str(), _fileHandle);
+	RETURN_ON_ERR(ret);
+
+	unsigned char headerPage[PAGE_SIZE] = {0};
+	return _fileHandle.appendPage(headerPage);
+}
+
+RC LX_RunWriter::writeDataPage()
+{
+	RC ret = _fileHandle.appendPage(_pageBuffer);
+	RETURN_ON_ERR(ret);
+
+	++_header.numDataPages;
+	memset(_pageBuffer, 0, PAGE_SIZE);
+	return rc::OK;
+}
+
+RC LX_RunWriter::add(const char* entry, unsigned entryLength, bool tombstone)
+{
+	LX_PageFooter* footer = LsmIndexManager::getPageFooter(_pageBuffer);
+	if (footer->freeSpaceOffset + entryLength + 1 > PAGE_SIZE - sizeof(LX_PageFooter))
+	{
+		RC ret = writeDataPage();
+		RETURN_ON_ERR(ret);
+	}
+
+	// The first key on each page is its fence
+	const char* key = entry + sizeof(RID);
+	if (footer->numEntries == 0)
+	{
+		_fenceKeys.insert(_fenceKeys.end(), key, entry + entryLength);
+	}
+
+	unsigned h1 = 0, h2 = 0;
+	getBloomHashes(_type, key, h1, h2);
+	_hashes.push_back(h1);
+
+	memcpy(_pageBuffer + footer->freeSpaceOffset, entry, entryLength);
+	_pageBuffer[footer->freeSpaceOffset + entryLength] = tombstone ? 1 : 0;
+	footer->freeSpaceOffset += entryLength + 1;
+	++footer->numEntries;
+	++_header.numEntries;
+	_bytes += entryLength + 1;
+
+	return rc::OK;
+}
+
+RC LX_RunWriter::finish()
+{
+	RC ret = rc::OK;
+	if (LsmIndexManager::getPageFooter(_pageBuffer)->numEntries > 0)
+	{
+		ret = writeDataPage();
+		RETURN_ON_ERR(ret);
+	}
+
+	// Set every key's bits, the filter is sized by the number of entries we ended up with
+	_header.bloomBits = std::max(8u, (_header.numEntries * LX_BLOOM_BITS_PER_KEY + 7) / 8 * 8);
+	std::vector<unsigned char> bloom(_header.bloomBits / 8, 0);
+	for (unsigned i = 0; i < _hashes.size(); ++i)
+	{
+		const unsigned h2 = util::jenkins(_hashes[i]) | 1;
+		for (unsigned j = 0; j < LX_BLOOM_HASHES; ++j)
+		{
+			const unsigned bit = (_hashes[i] + j * h2) % _header.bloomBits;
+			bloom[bit / 8] |= (1 << (bit % 8));
+		}
+	}
+
+	for (unsigned offset = 0; offset < bloom.size(); offset += PAGE_SIZE)
+	{
+		memset(_pageBuffer, 0, PAGE_SIZE);
+		memcpy(_pageBuffer, &bloom[offset], std::min<unsigned>(PAGE_SIZE, bloom.size() - offset));
+		ret = _fileHandle.appendPage(_pageBuffer);
+		RETURN_ON_ERR(ret);
+
+		++_header.numBloomPages;
+	}
+
+	// Pack the fence keys the same way entries are packed
+	memset(_pageBuffer, 0, PAGE_SIZE);
+	LX_PageFooter* footer = LsmIndexManager::getPageFooter(_pageBuffer);
+	for (unsigned offset = 0; offset < _fenceKeys.size(); )
+	{
+		const unsigned keySize = Attribute::sizeInBytes(_type, &_fenceKeys[offset]);
+		if (footer->freeSpaceOffset + keySize > PAGE_SIZE - sizeof(LX_PageFooter))
+		{
+			ret = _fileHandle.appendPage(_pageBuffer);
+			RETURN_ON_ERR(ret);
+
+			++_header.numFencePages;
+			memset(_pageBuffer, 0, PAGE_SIZE);
+		}
+
+		memcpy(_pageBuffer + footer->freeSpaceOffset, &_fenceKeys[offset], keySize);
+		footer->freeSpaceOffset += keySize;
+		++footer->numEntries;
+		offset += keySize;
+	}
+
+	if (footer->numEntries > 0)
+	{
+		ret = _fileHandle.appendPage(_pageBuffer);
+		RETURN_ON_ERR(ret);
+
+		++_header.numFencePages;
+	}
+
+	memset(_pageBuffer, 0, PAGE_SIZE);
+	memcpy(_pageBuffer, &_header, sizeof(LX_RunHeader));
+	ret = _fileHandle.writePage(0, _pageBuffer);
+	RETURN_ON_ERR(ret);
+
+	ret = PagedFileManager::instance()->closeFile(_fileHandle);
+	RETURN_ON_ERR(ret);
+
+	// The run is complete and the file belongs to whoever opens it now
+	_fileName.clear();
+	return rc::OK;
+}
+
+void LX_RunWriter::abandon()
+{
+	if (_fileName.empty())
+		return;
+
+	if (_fileHandle.hasFile())
+		PagedFileManager::instance()->closeFile(_fileHandle);
+
+	PagedFileManager::instance()->destroyFile(_fileName.c_str());
+	_fileName.clear();
+}
+
+RC LsmIndexManager::createFile(const string &fileName)
+{
+	// Forget anything we kept about an index that had this name before, its files are gone already
+	LX_Index* stale = NULL;
+	{
+		std::lock_guard<std::mutex> lock(_indexesMutex);
+		std::map<std::string, LX_Index*>::iterator it = _indexes.find(fileName);
+		if (it != _indexes.end())
+		{
+			stale = it->second;
+			_indexes.erase(it);
+		}
+
+		_openCounts.erase(fileName);
+	}
+
+	if (stale)
+	{
+		unloadIndex(stale, false);
+	}
+
+	RC ret = PagedFileManager::instance()->createFile(fileName.c_str());
+	if (ret != rc::OK)
+	{
+		return ret;
+	}
+
+	// Opening the file writes the file header to the reserved page
+	FileHandle fileHandle;
+	ret = RecordBasedCoreManager::openFile(fileName, fileHandle);
+	RETURN_ON_ERR(ret);
+
+	unsigned char headerPage[PAGE_SIZE];
+	ret = fileHandle.readPage(0, headerPage);
+	RETURN_ON_ERR(ret);
+
+	// No runs and an empty log
+	memset(getHeader(headerPage), 0, sizeof(LX_Header));
+	ret = fileHandle.writePage(0, headerPage);
+	RETURN_ON_ERR(ret);
+
+	// We're done, leave the file closed
+	return RecordBasedCoreManager::closeFile(fileHandle);
+}
+
+RC LsmIndexManager::destroyFile(const string &fileName)
+{
+	LX_Index* index = NULL;
+	{
+		std::lock_guard<std::mutex> lock(_indexesMutex);
+		std::map<std::string, LX_Index*>::iterator it = _indexes.find(fileName);
+		if (it != _indexes.end())
+		{
+			index = it->second;
+			_indexes.erase(it);
+		}
+
+		_openCounts.erase(fileName);
+	}
+
+	// Every run named by the header goes with the index
+	if (index)
+	{
+		unloadIndex(index, true);
+	}
+	else
+	{
+		FileHandle fileHandle;
+		if (RecordBasedCoreManager::openFile(fileName, fileHandle) == rc::OK)
+		{
+			dropRuns(fileHandle);
+			RecordBasedCoreManager::closeFile(fileHandle);
+		}
+	}
+
+	return RecordBasedCoreManager::destroyFile(fileName);
+}
+
+RC LsmIndexManager::openFile(const string &fileName, FileHandle &fileHandle)
+{
+	RC ret = RecordBasedCoreManager::openFile(fileName, fileHandle);
+	RETURN_ON_ERR(ret);
+
+	std::lock_guard<std::mutex> lock(_indexesMutex);
+	++_openCounts[fileName];
+	return rc::OK;
+}
+
+RC LsmIndexManager::closeFile(FileHandle &fileHandle)
+{
+	const std::string fileName = fileHandle.getFilename();
+	RC ret = RecordBasedCoreManager::closeFile(fileHandle);
+	RETURN_ON_ERR(ret);
+
+	// The last close lets go of the memtable and runs, the log still has every change the memtable held
+	LX_Index* index = NULL;
+	{
+		std::lock_guard<std::mutex> lock(_indexesMutex);
+		std::map<std::string, unsigned>::iterator count = _openCounts.find(fileName);
+		if (count == _openCounts.end() || --count->second > 0)
+		{
+			return rc::OK;
+		}
+
+		_openCounts.erase(count);
+		std::map<std::string, LX_Index*>::iterator it = _indexes.find(fileName);
+		if (it != _indexes.end())
+		{
+			index = it->second;
+			_indexes.erase(it);
+		}
+	}
+
+	return index ? unloadIndex(index, false) : rc::OK;
+}
+
+RC LsmIndexManager::deleteRecords(FileHandle &fileHandle)
+{
+	LX_Index* index = NULL;
+	{
+		std::lock_guard<std::mutex> lock(_indexesMutex);
+		std::map<std::string, LX_Index*>::iterator it = _indexes.find(fileHandle.getFilename());
+		if (it != _indexes.end())
+			index = it->second;
+	}
+
+	// Without a key type nothing was ever loaded, but the runs the header names can go all the same
+	if (!index)
+	{
+		return dropRuns(fileHandle);
+	}
+
+	std::unique_lock<std::mutex> lock(index->mutex);
+	while (index->compacting)
+	{
+		index->compactionDone.wait(lock);
+	}
+
+	for (unsigned i = 0; i < index->runs.size(); ++i)
+	{
+		index->runs[i]->obsolete = true;
+		releaseRun(index->runs[i]);
+	}
+
+	index->runs.clear();
+	index->memtable.clear();
+	index->memtableBytes = 0;
+	index->logPages = 0;
+	memset(index->logPage, 0, PAGE_SIZE);
+	return writeHeader(*index);
+}
+
+RC LsmIndexManager::dropRuns(FileHandle& fileHandle)
+{
+	unsigned char headerPage[PAGE_SIZE];
+	RC ret = fileHandle.readPage(0, headerPage);
+	RETURN_ON_ERR(ret);
+
+	LX_Header* header = getHeader(headerPage);
+	for (unsigned i = 0; i < header->numRuns && i < LX_MAX_RUNS; ++i)
+	{
+		PagedFileManager::instance()->destroyFile(getRunFileName(fileHandle.getFilename(), header->runs[i].runId).c_str());
+	}
+
+	header->numRuns = 0;
+	header->logPages = 0;
+	return fileHandle.writePage(0, headerPage);
+}
+
+RC LsmIndexManager::getIndex(FileHandle& fileHandle, AttrType type, LX_Index*& index)
+{
+	if (!fileHandle.hasFile())
+		return rc::FILE_HANDLE_NOT_INITIALIZED;
+
+	// The index is loaded the first time a key comes along, the memtable cannot be ordered before then
+	std::lock_guard<std::mutex> lock(_indexesMutex);
+	std::map<std::string, LX_Index*>::iterator it = _indexes.find(fileHandle.getFilename());
+	if (it != _indexes.end())
+	{
+		index = it->second;
+		return index->type == type ? rc::OK : rc::ATTRIBUTE_INVALID_TYPE;
+	}
+
+	LX_Index* loaded = new LX_Index(fileHandle.getFilename(), type);
+	RC ret = loadIndex(*loaded);
+	if (ret != rc::OK)
+	{
+		unloadIndex(loaded, false);
+		return ret;
+	}
+
+	loaded->compactor = std::thread(&LsmIndexManager::compactionLoop, this, loaded);
+	_indexes[loaded->fileName] = loaded;
+	index = loaded;
+	return rc::OK;
+}
+
+RC LsmIndexManager::loadIndex(LX_Index& index)
+{
+	// Keep a handle of our own, the compaction thread outlives any one caller's
+	RC ret = RecordBasedCoreManager::openFile(index.fileName, index.fileHandle);
+	RETURN_ON_ERR(ret);
+
+	unsigned char headerPage[PAGE_SIZE];
+	ret = index.fileHandle.readPage(0, headerPage);
+	RETURN_ON_ERR(ret);
+
+	const LX_Header* header = getHeader(headerPage);
+	index.nextRunId = header->nextRunId;
+	for (unsigned i = 0; i < header->numRuns && i < LX_MAX_RUNS; ++i)
+	{
+		LX_Run* run = NULL;
+		ret = openRun(index, header->runs[i].runId, header->runs[i].level, run);
+		RETURN_ON_ERR(ret);
+
+		index.runs.push_back(run);
+	}
+
+	// Replay the log into the memtable, the last log page stays in memory for the next change
+	std::vector<char> entry;
+	for (PageNum pageNum = 1; pageNum <= header->logPages; ++pageNum)
+	{
+		ret = index.fileHandle.readPage(pageNum, index.logPage);
+		RETURN_ON_ERR(ret);
+
+		const char* page = (const char*)index.logPage;
+		const LX_PageFooter* footer = getPageFooter(index.logPage);
+		for (unsigned offset = 0; offset < footer->freeSpaceOffset; )
+		{
+			const unsigned entryLength = getEntryLength(index.type, page + offset);
+			entry.assign(page + offset, page + offset + entryLength);
+			applyChange(index, entry, page[offset + entryLength] != 0);
+			offset += entryLength + 1;
+		}
+	}
+
+	index.logPages = header->logPages;
+	return rc::OK;
+}
+
+RC LsmIndexManager::unloadIndex(LX_Index* index, bool destroyRuns)
+{
+	{
+		std::lock_guard<std::mutex> lock(index->mutex);
+		index->stopping = true;
+	}
+
+	index->compactionWanted.notify_all();
+	if (index->compactor.joinable())
+	{
+		index->compactor.join();
+	}
+
+	for (unsigned i = 0; i < index->runs.size(); ++i)
+	{
+		index->runs[i]->obsolete = destroyRuns;
+		releaseRun(index->runs[i]);
+	}
+
+	RC ret = rc::OK;
+	if (index->fileHandle.hasFile())
+	{
+		ret = RecordBasedCoreManager::closeFile(index->fileHandle);
+	}
+
+	delete index;
+	return ret;
+}
+
+RC LsmIndexManager::writeHeader(LX_Index& index)
+{
+	unsigned char headerPage[PAGE_SIZE];
+	RC ret = index.fileHandle.readPage(0, headerPage);
+	RETURN_ON_ERR(ret);
+
+	LX_Header* header = getHeader(headerPage);
+	header->numRuns = index.runs.size();
+	header->nextRunId = index.nextRunId;
+	header->logPages = index.logPages;
+	for (unsigned i = 0; i < index.runs.size(); ++i)
+	{
+		header->runs[i].runId = index.runs[i]->runId;
+		header->runs[i].level = index.runs[i]->level;
+	}
+
+	return index.fileHandle.writePage(0, headerPage);
+}
+
+RC LsmIndexManager::insertEntry(FileHandle &fileHandle, const Attribute &attribute, const void *key, const RID &rid)
+{
+	return changeEntry(fileHandle, attribute, key, rid, false);
+}
+
+RC LsmIndexManager::deleteEntry(FileHandle &fileHandle, const Attribute &attribute, const void *key, const RID &rid)
+{
+	return changeEntry(fileHandle, attribute, key, rid, true);
+}
+
+RC LsmIndexManager::changeEntry(FileHandle& fileHandle, const Attribute& attribute, const void* key, const RID& rid, bool tombstone)
+{
+	// Entries and their tombstone byte have to fit on a run page
+	std::vector<char> entry;
+	makeEntry(attribute.type, key, rid, entry);
+	if (entry.size() + 1 > PAGE_SIZE - sizeof(LX_PageFooter))
+	{
+		return rc::LSM_INDEX_KEY_TOO_LARGE;
+	}
+
+	LX_Index* index = NULL;
+	RC ret = getIndex(fileHandle, attribute.type, index);
+	RETURN_ON_ERR(ret);
+
+	std::unique_lock<std::mutex> lock(index->mutex);
+	ret = appendLog(*index, entry, tombstone);
+	RETURN_ON_ERR(ret);
+
+	applyChange(*index, entry, tombstone);
+	if (index->memtableBytes >= _memtableSize)
+	{
+		ret = flushMemtable(*index, lock);
+		RETURN_ON_ERR(ret);
+	}
+
+	return rc::OK;
+}
+
+RC LsmIndexManager::appendLog(LX_Index& index, const std::vector<char>& entry, bool tombstone)
+{
+	LX_PageFooter* footer = getPageFooter(index.logPage);
+	const bool newPage = index.logPages == 0 || footer->freeSpaceOffset + entry.size() + 1 > PAGE_SIZE - sizeof(LX_PageFooter);
+	if (newPage)
+	{
+		memset(index.logPage, 0, PAGE_SIZE);
+		++index.logPages;
+	}
+
+	memcpy(index.logPage + footer->freeSpaceOffset, &entry[0], entry.size());
+	index.logPage[footer->freeSpaceOffset + entry.size()] = tombstone ? 1 : 0;
+	footer->freeSpaceOffset += entry.size() + 1;
+	++footer->numEntries;
+
+	// Log pages left over from before the last flush are written over
+	RC ret = index.logPages < index.fileHandle.getNumberOfPages() ? index.fileHandle.writePage(index.logPages, index.logPage) : index.fileHandle.appendPage(index.logPage);
+	RETURN_ON_ERR(ret);
+
+	// The header only changes when the log grows by a page
+	return newPage ? writeHeader(index) : rc::OK;
+}
+
+void LsmIndexManager::applyChange(LX_Index& index, const std::vector<char>& entry, bool tombstone)
+{
+	std::pair<LX_Memtable::iterator, bool> inserted = index.memtable.insert(std::make_pair(entry, tombstone));
+	if (inserted.second)
+	{
+		index.memtableBytes += entry.size() + 1;
+	}
+	else
+	{
+		inserted.first->second = tombstone;
+	}
+
+	// With no runs behind the memtable there is nothing for a tombstone to hide
+	if (tombstone && index.runs.empty())
+	{
+		index.memtableBytes -= entry.size() + 1;
+		index.memtable.erase(inserted.first);
+	}
+}
+
+RC LsmIndexManager::flushMemtable(LX_Index& index, std::unique_lock<std::mutex>& lock)
+{
+	if (!index.memtable.empty())
+	{
+		// Compaction has to make room in the header first
+		while (index.runs.size() >= LX_MAX_RUNS)
+		{
+			index.compactionDone.wait(lock);
+		}
+
+		const unsigned runId = index.nextRunId++;
+		LX_RunWriter writer(index.type);
+		RC ret = writer.open(getRunFileName(index.fileName, runId));
+		RETURN_ON_ERR(ret);
+
+		for (LX_Memtable::const_iterator it = index.memtable.begin(); it != index.memtable.end(); ++it)
+		{
+			ret = writer.add(&it->first[0], it->first.size(), it->second);
+			RETURN_ON_ERR(ret);
+		}
+
+		ret = writer.finish();
+		RETURN_ON_ERR(ret);
+
+		LX_Run* run = NULL;
+		ret = openRun(index, runId, 0, run);
+		RETURN_ON_ERR(ret);
+
+		index.runs.insert(index.runs.begin(), run);
+	}
+
+	// The run has everything the log did
+	index.memtable.clear();
+	index.memtableBytes = 0;
+	index.logPages = 0;
+	memset(index.logPage, 0, PAGE_SIZE);
+
+	RC ret = writeHeader(index);
+	RETURN_ON_ERR(ret);
+
+	unsigned first = 0, count = 0;
+	if (needsCompaction(index, first, count))
+	{
+		index.compactionWanted.notify_one();
+	}
+
+	return rc::OK;
+}
+
+RC LsmIndexManager::openRun(LX_Index& index, unsigned runId, unsigned level, LX_Run*& run)
+{
+	LX_Run* opened = new LX_Run();
+	opened->fileName = getRunFileName(index.fileName, runId);
+	opened->runId = runId;
+	opened->level = level;
+
+	RC ret = PagedFileManager::instance()->openFile(opened->fileName.c_str(), opened->fileHandle);
+	if (ret != rc::OK)
+	{
+		delete opened;
+		return ret;
+	}
+
+	unsigned char pageBuffer[PAGE_SIZE];
+	ret = opened->fileHandle.readPage(0, pageBuffer);
+	if (ret == rc::OK)
+	{
+		memcpy(&opened->header, pageBuffer, sizeof(LX_RunHeader));
+	}
+
+	// Keep the Bloom filter and fence keys in memory, they are all a lookup needs to rule out a run or a page
+	const LX_RunHeader& header = opened->header;
+	opened->bloom.resize(header.numBloomPages * PAGE_SIZE);
+	for (unsigned i = 0; ret == rc::OK && i < header.numBloomPages; ++i)
+	{
+		ret = opened->fileHandle.readPage(1 + header.numDataPages + i, &opened->bloom[i * PAGE_SIZE]);
+	}
+
+	for (unsigned i = 0; ret == rc::OK && i < header.numFencePages; ++i)
+	{
+		ret = opened->fileHandle.readPage(1 + header.numDataPages + header.numBloomPages + i, pageBuffer);
+		const char* page = (const char*)pageBuffer;
+		const LX_PageFooter* footer = getPageFooter(pageBuffer);
+		for (unsigned offset = 0; ret == rc::OK && offset < footer->freeSpaceOffset; )
+		{
+			const unsigned keySize = Attribute::sizeInBytes(index.type, page + offset);
+			opened->fenceOffsets.push_back(opened->fenceKeys.size());
+			opened->fenceKeys.insert(opened->fenceKeys.end(), page + offset, page + offset + keySize);
+			offset += keySize;
+		}
+	}
+
+	if (ret != rc::OK)
+	{
+		releaseRun(opened);
+		return ret;
+	}
+
+	run = opened;
+	return rc::OK;
+}
+
+void LsmIndexManager::releaseRun(LX_Run* run)
+{
+	if (--run->refs > 0)
+		return;
+
+	PagedFileManager::instance()->closeFile(run->fileHandle);
+	if (run->obsolete)
+	{
+		PagedFileManager::instance()->destroyFile(run->fileName.c_str());
+	}
+
+	delete run;
+}
+
+bool LsmIndexManager::needsCompaction(const LX_Index& index, unsigned& first, unsigned& count)
+{
+	// Levels only grow towards the older end of the list, so each level's runs sit next to each other
+	for (unsigned i = 0; i < index.runs.size(); i += count)
+	{
+		first = i;
+		count = 1;
+		while (first + count < index.runs.size() && index.runs[first + count]->level == index.runs[first]->level)
+		{
+			++count;
+		}
+
+		if (count >= LX_RUNS_PER_LEVEL)
+			return true;
+	}
+
+	return false;
+}
+
+void LsmIndexManager::compactionLoop(LX_Index* index)
+{
+	std::unique_lock<std::mutex> lock(index->mutex);
+	while (!index->stopping)
+	{
+		bool compacted = false;
+		RC ret = compactLevel(*index, lock, compacted);
+		if (ret != rc::OK)
+		{
+			dbg::out << dbg::LOG_EXTREMEDEBUG;
+			dbg::out << "LsmIndexManager::compactionLoop: compacting " << index->fileName << " failed with " << rc::rcToString(ret) << "\n";
+		}
+
+		// A failed compaction waits for the next flush to try again
+		if ((ret != rc::OK || !compacted) && !index->stopping)
+		{
+			index->compactionWanted.wait(lock);
+		}
+	}
+}
+
+RC LsmIndexManager::compactLevel(LX_Index& index, std::unique_lock<std::mutex>& lock, bool& compacted)
+{
+	compacted = false;
+	unsigned first = 0, count = 0;
+	if (!needsCompaction(index, first, count))
+	{
+		return rc::OK;
+	}
+
+	// Tombstones have nothing left to hide once the oldest run is part of the merge
+	std::vector<LX_Run*> merging(index.runs.begin() + first, index.runs.begin() + first + count);
+	const bool dropTombstones = first + count == index.runs.size();
+	const unsigned runId = index.nextRunId++;
+	const unsigned level = merging.front()->level + 1;
+
+	LX_ScanIterator merge;
+	RC ret = merge.initMerge(index.type, merging);
+	RETURN_ON_ERR(ret);
+
+	// Merge without the latch, runs never change and flushes only put new runs in front of ours
+	index.compacting = true;
+	lock.unlock();
+
+	LX_RunWriter writer(index.type);
+	ret = writer.open(getRunFileName(index.fileName, runId));
+
+	bool tombstone = false;
+	std::vector<char> entry;
+	while (ret == rc::OK && (ret = merge.getNextVersion(entry, tombstone)) == rc::OK)
+	{
+		if (!tombstone || !dropTombstones)
+		{
+			ret = writer.add(&entry[0], entry.size(), tombstone);
+		}
+	}
+
+	if (ret == IX_EOF)
+	{
+		ret = writer.finish();
+	}
+
+	// Every entry may have been a dropped tombstone
+	LX_Run* merged = NULL;
+	if (ret == rc::OK && writer.numEntries() > 0)
+	{
+		ret = openRun(index, runId, level, merged);
+	}
+	else if (ret == rc::OK)
+	{
+		PagedFileManager::instance()->destroyFile(getRunFileName(index.fileName, runId).c_str());
+	}
+
+	merge.close();
+	lock.lock();
+	index.compacting = false;
+	if (ret == rc::OK)
+	{
+		std::vector<LX_Run*>::iterator position = std::find(index.runs.begin(), index.runs.end(), merging.front());
+		position = index.runs.erase(position, position + count);
+		if (merged)
+		{
+			index.runs.insert(position, merged);
+		}
+
+		ret = writeHeader(index);
+		for (unsigned i = 0; i < merging.size(); ++i)
+		{
+			merging[i]->obsolete = true;
+			releaseRun(merging[i]);
+		}
+
+		compacted = true;
+	}
+
+	index.compactionDone.notify_all();
+	return ret;
+}
+
+RC LsmIndexManager::flush(FileHandle &fileHandle, const Attribute &attribute)
+{
+	LX_Index* index = NULL;
+	RC ret = getIndex(fileHandle, attribute.type, index);
+	RETURN_ON_ERR(ret);
+
+	std::unique_lock<std::mutex> lock(index->mutex);
+	ret = flushMemtable(*index, lock);
+	RETURN_ON_ERR(ret);
+
+	unsigned first = 0, count = 0;
+	while (index->compacting || needsCompaction(*index, first, count))
+	{
+		index->compactionWanted.notify_one();
+		index->compactionDone.wait(lock);
+	}
+
+	return rc::OK;
+}
+
+RC LsmIndexManager::getRunLevels(FileHandle &fileHandle, const Attribute &attribute, std::vector<unsigned>& levels)
+{
+	LX_Index* index = NULL;
+	RC ret = getIndex(fileHandle, attribute.type, index);
+	RETURN_ON_ERR(ret);
+
+	std::lock_guard<std::mutex> lock(index->mutex);
+	levels.clear();
+	for (unsigned i = 0; i < index->runs.size(); ++i)
+	{
+		levels.push_back(index->runs[i]->level);
+	}
+
+	return rc::OK;
+}
+
+RC LsmIndexManager::bulkLoad(FileHandle &fileHandle, const Attribute &attribute, IX_BulkLoader &loader)
+{
+	LX_Index* index = NULL;
+	RC ret = getIndex(fileHandle, attribute.type, index);
+	RETURN_ON_ERR(ret);
+
+	ret = loader.sort();
+	RETURN_ON_ERR(ret);
+
+	std::unique_lock<std::mutex> lock(index->mutex);
+	if (!index->runs.empty() || !index->memtable.empty())
+	{
+		return rc::LSM_INDEX_NOT_EMPTY;
+	}
+
+	const unsigned runId = index->nextRunId++;
+	LX_RunWriter writer(attribute.type);
+	ret = writer.open(getRunFileName(index->fileName, runId));
+	RETURN_ON_ERR(ret);
+
+	char entry[PAGE_SIZE];
+	unsigned entryLength = 0;
+	while ((ret = loader.getNextEntry(entry, entryLength)) == rc::OK)
+	{
+		if (entryLength + 1 > PAGE_SIZE - sizeof(LX_PageFooter))
+		{
+			return rc::LSM_INDEX_KEY_TOO_LARGE;
+		}
+
+		ret = writer.add(entry, entryLength, false);
+		RETURN_ON_ERR(ret);
+	}
+
+	if (ret != IX_EOF)
+	{
+		return ret;
+	}
+
+	if (writer.numEntries() == 0)
+	{
+		return rc::OK;
+	}
+
+	ret = writer.finish();
+	RETURN_ON_ERR(ret);
+
+	// Put the run on the level whose runs are about its size, so the next few flushes are not merged into it
+	unsigned level = 0;
+	for (unsigned long long levelBytes = _memtableSize; levelBytes * LX_RUNS_PER_LEVEL <= writer.bytes(); levelBytes *= LX_RUNS_PER_LEVEL)
+	{
+		++level;
+	}
+
+	LX_Run* run = NULL;
+	ret = openRun(*index, runId, level, run);
+	RETURN_ON_ERR(ret);
+
+	index->runs.push_back(run);
+	return writeHeader(*index);
+}
+
+RC LsmIndexManager::scan(FileHandle &fileHandle, const Attribute &attribute, const void *lowKey, const void *highKey, bool lowKeyInclusive, bool highKeyInclusive, LX_ScanIterator &lx_ScanIterator)
+{
+	LX_Index* index = NULL;
+	RC ret = getIndex(fileHandle, attribute.type, index);
+	RETURN_ON_ERR(ret);
+
+	std::lock_guard<std::mutex> lock(index->mutex);
+	return lx_ScanIterator.init(*index, attribute, lowKey, highKey, lowKeyInclusive, highKeyInclusive);
+}
+
+LX_ScanIterator::LX_ScanIterator()
+	: _memtablePosition(0), _type(TypeInt), _hasLowKey(false), _hasHighKey(false), _lowKeyInclusive(false), _highKeyInclusive(false)
+{
+}
+
+LX_ScanIterator::~LX_ScanIterator()
+{
+	close();
+}
+
+RC LX_ScanIterator::init(LX_Index& index, const Attribute &attribute, const void *lowKey, const void *highKey, bool lowKeyInclusive, bool highKeyInclusive)
+{
+	close();
+
+	_type = attribute.type;
+	_hasLowKey = lowKey != NULL;
+	_hasHighKey = highKey != NULL;
+	_lowKeyInclusive = lowKeyInclusive;
+	_highKeyInclusive = highKeyInclusive;
+
+	RC ret = rc::OK;
+	if (lowKey)
+	{
+		ret = _lowKey.init(_type, lowKey);
+		RETURN_ON_ERR(ret);
+	}
+
+	if (highKey)
+	{
+		ret = _highKey.init(_type, highKey);
+		RETURN_ON_ERR(ret);
+	}
+
+	// Copy the part of the memtable in range, the first entry of lowKey has the smallest RID
+	LX_Memtable::const_iterator it = index.memtable.begin();
+	if (lowKey)
+	{
+		std::vector<char> probe;
+		makeEntry(_type, lowKey, RID(), probe);
+		memset(&probe[0], 0, sizeof(RID));
+		it = index.memtable.lower_bound(probe);
+	}
+
+	for (; it != index.memtable.end(); ++it)
+	{
+		if (highKey && IndexManager::compareKeys(_type, &it->first[sizeof(RID)], highKey) > 0)
+			break;
+
+		_memtable.push_back(*it);
+	}
+
+	Source memtable;
+	memtable.run = NULL;
+	memtable.done = false;
+	_sources.push_back(memtable);
+
+	// Leave out the runs which cannot have anything for us
+	const bool equality = lowKey && highKey && lowKeyInclusive && highKeyInclusive && IndexManager::compareKeys(_type, lowKey, highKey) == 0;
+	for (unsigned i = 0; i < index.runs.size(); ++i)
+	{
+		LX_Run* run = index.runs[i];
+		if (equality && !run->mayContain(_type, lowKey))
+			continue;
+
+		if (highKey && !run->fenceOffsets.empty() && IndexManager::compareKeys(_type, run->getFence(0), highKey) > 0)
+			continue;
+
+		++run->refs;
+		Source source;
+		source.run = run;
+		source.page = lowKey ? run->findFirstPage(_type, lowKey) : 0;
+		source.offset = 0;
+		source.pageBuffer.assign(PAGE_SIZE, 0);
+		source.done = false;
+		_sources.push_back(source);
+	}
+
+	for (unsigned i = 0; i < _sources.size(); ++i)
+	{
+		ret = advance(_sources[i]);
+		RETURN_ON_ERR(ret);
+	}
+
+	return rc::OK;
+}
+
+RC LX_ScanIterator::initMerge(AttrType type, const std::vector<LX_Run*>& runs)
+{
+	close();
+
+	_type = type;
+	for (unsigned i = 0; i < runs.size(); ++i)
+	{
+		++runs[i]->refs;
+		Source source;
+		source.run = runs[i];
+		source.page = 0;
+		source.offset = 0;
+		source.pageBuffer.assign(PAGE_SIZE, 0);
+		source.done = false;
+		_sources.push_back(source);
+	}
+
+	for (unsigned i = 0; i < _sources.size(); ++i)
+	{
+		RC ret = advance(_sources[i]);
+		RETURN_ON_ERR(ret);
+	}
+
+	return rc::OK;
+}
+
+RC LX_ScanIterator::advance(Source& source)
+{
+	if (!source.run)
+	{
+		if (_memtablePosition >= _memtable.size())
+		{
+			source.done = true;
+			return rc::OK;
+		}
+
+		source.entry = _memtable[_memtablePosition].first;
+		source.tombstone = _memtable[_memtablePosition].second;
+		++_memtablePosition;
+		return rc::OK;
+	}
+
+	// Move on to the next data page once this one is used up
+	unsigned char* pageBuffer = &source.pageBuffer[0];
+	while (source.offset >= LsmIndexManager::getPageFooter(pageBuffer)->freeSpaceOffset)
+	{
+		if (source.page >= source.run->header.numDataPages)
+		{
+			source.done = true;
+			return rc::OK;
+		}
+
+		RC ret = source.run->fileHandle.readPage(1 + source.page, pageBuffer);
+		RETURN_ON_ERR(ret);
+
+		++source.page;
+		source.offset = 0;
+	}
+
+	const char* page = (const char*)pageBuffer;
+	const unsigned entryLength = getEntryLength(_type, page + source.offset);
+	source.entry.assign(page + source.offset, page + source.offset + entryLength);
+	source.tombstone = page[source.offset + entryLength] != 0;
+	source.offset += entryLength + 1;
+	return rc::OK;
+}
+
+RC LX_ScanIterator::getNextVersion(std::vector<char>& entry, bool& tombstone)
+{
+	// Sources go newest first, so the first of several equal entries is the one that counts
+	Source* smallest = NULL;
+	for (unsigned i = 0; i < _sources.size(); ++i)
+	{
+		if (!_sources[i].done && (!smallest || compareEntries(_type, &_sources[i].entry[0], &smallest->entry[0]) < 0))
+			smallest = &_sources[i];
+	}
+
+	if (!smallest)
+		return IX_EOF;
+
+	entry.swap(smallest->entry);
+	tombstone = smallest->tombstone;
+
+	// Step past the older versions this one hides
+	RC ret = advance(*smallest);
+	RETURN_ON_ERR(ret);
+
+	for (unsigned i = 0; i < _sources.size(); ++i)
+	{
+		while (!_sources[i].done && compareEntries(_type, &_sources[i].entry[0], &entry[0]) == 0)
+		{
+			ret = advance(_sources[i]);
+			RETURN_ON_ERR(ret);
+		}
+	}
+
+	return rc::OK;
+}
+
+RC LX_ScanIterator::getNextEntry(RID &rid, void *key)
+{
+	RC ret = rc::OK;
+	bool tombstone = false;
+	while ((ret = getNextVersion(_entry, tombstone)) == rc::OK)
+	{
+		const char* entryKey = &_entry[sizeof(RID)];
+		if (_hasLowKey)
+		{
+			const int result = IndexManager::compareKeys(_type, entryKey, _lowKey.data());
+			if (result < 0 || (result == 0 && !_lowKeyInclusive))
+				continue;
+		}
+
+		if (_hasHighKey)
+		{
+			const int result = IndexManager::compareKeys(_type, entryKey, _highKey.data());
+			if (result > 0 || (result == 0 && !_highKeyInclusive))
+				return IX_EOF;
+		}
+
+		if (tombstone)
+			continue;
+
+		memcpy(&rid, &_entry[0], sizeof(RID));
+		memcpy(key, entryKey, _entry.size() - sizeof(RID));
+		return rc::OK;
+	}
+
+	return ret;
+}
+
+RC LX_ScanIterator::close()
+{
+	for (unsigned i = 0; i < _sources.size(); ++i)
+	{
+		if (_sources[i].run)
+			LsmIndexManager::instance()->releaseRun(_sources[i].run);
+	}
+
+	_sources.clear();
+	_memtable.clear();
+	_memtablePosition = 0;
+	return rc::OK;
+}
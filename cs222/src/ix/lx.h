@@ -0,0 +1,254 @@
+#ifndef _lx_h_
+#define _lx_h_
+
+#include <vector>
+#include <string>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <cstring>
+
+#include "ix.h"
+
+// Bytes of entries the memtable collects before it is written out as a run
+#define LX_DEFAULT_MEMTABLE_SIZE (1024 * 1024)
+
+// A level holding this many runs is merged into one run on the next level
+#define LX_RUNS_PER_LEVEL 4
+
+// The most runs the reserved page can name, a flush waits for compaction to catch up before going past it
+#define LX_MAX_RUNS 128
+
+// Bloom filter bits set aside per run entry and probes per key, around a 1% false positive rate
+#define LX_BLOOM_BITS_PER_KEY 10
+#define LX_BLOOM_HASHES 7
+
+// LSM-tree index layout
+/*
+The index file keeps the usual file header at the start of the reserved page and the LX_Header at its
+end. Inserts and deletes go into an in-memory memtable, sorted by key then RID, and into a log kept on
+pages 1 and up of the index file so the memtable survives a restart. A delete is a tombstone entry which
+hides every older version of the same (key, RID).
+A full memtable is written out as an immutable run in its own file, <index>.run<id>, and the log starts
+over. Runs never change once written, a level that collects LX_RUNS_PER_LEVEL runs is merged into a
+single run on the next level by a background thread, tombstones are dropped once the merge reaches the
+oldest run. A scan merges the memtable and every run, the newest version of each entry wins.
+/-----------------------------------------\
+| Run file                                |
+| --------------------------------------- |
+| Page 0       [LX_RunHeader]             |
+| Data pages   [Entry][Entry]...[Footer]  |
+| Bloom pages  the filter bits            |
+| Fence pages  first key of each data page|
+\-----------------------------------------/
+Data page entries are [RID][key][tombstone byte], log entries are the same. Fence pages hold packed keys
+and share the LX_PageFooter of data pages
+*/
+struct LX_RunInfo
+{
+	unsigned runId;
+	unsigned level;
+};
+
+struct LX_Header
+{
+	unsigned numRuns;
+	unsigned nextRunId;
+	PageNum logPages; // log pages in use, starting at page 1
+	LX_RunInfo runs[LX_MAX_RUNS]; // newest first
+};
+
+struct LX_RunHeader
+{
+	unsigned numEntries;
+	unsigned numDataPages;
+	unsigned numBloomPages;
+	unsigned numFencePages;
+	unsigned bloomBits;
+};
+
+struct LX_PageFooter
+{
+	unsigned numEntries;
+	unsigned freeSpaceOffset;
+};
+
+// An immutable run with its Bloom filter and fence keys kept in memory. Scans and compactions hold a
+// reference so the file outlives a compaction that replaces it
+struct LX_Run
+{
+	LX_Run() : runId(0), level(0), refs(1), obsolete(false) { memset(&header, 0, sizeof(header)); }
+
+	bool mayContain(AttrType type, const void* key) const;
+	PageNum findFirstPage(AttrType type, const void* key) const; // the data page to start looking for key on
+	const void* getFence(unsigned page) const { return &fenceKeys[fenceOffsets[page]]; }
+
+	std::string fileName;
+	unsigned runId;
+	unsigned level;
+	LX_RunHeader header;
+	FileHandle fileHandle;
+	std::vector<unsigned char> bloom;
+	std::vector<char> fenceKeys;
+	std::vector<unsigned> fenceOffsets;
+	std::atomic<unsigned> refs;
+	bool obsolete; // a compaction replaced the run, its file goes once the last reference is let go
+};
+
+// Memtable entries are [RID][key], ordered by key then RID
+struct LX_EntryLess
+{
+	LX_EntryLess(AttrType type) : type(type) {}
+	bool operator()(const std::vector<char>& lhs, const std::vector<char>& rhs) const;
+
+	AttrType type;
+};
+
+typedef std::map<std::vector<char>, bool, LX_EntryLess> LX_Memtable; // value is true for a tombstone
+
+// Everything we know about one open LSM index, guarded by mutex
+struct LX_Index
+{
+	LX_Index(const std::string& fileName, AttrType type);
+
+	std::string fileName;
+	AttrType type;
+	FileHandle fileHandle;
+
+	LX_Memtable memtable;
+	unsigned memtableBytes;
+	std::vector<LX_Run*> runs; // newest first
+	unsigned nextRunId;
+
+	// The last log page stays in memory, each change rewrites it
+	unsigned char logPage[PAGE_SIZE];
+	PageNum logPages;
+
+	std::mutex mutex;
+	std::condition_variable compactionWanted;
+	std::condition_variable compactionDone;
+	std::thread compactor;
+	bool compacting;
+	bool stopping;
+};
+
+class LX_ScanIterator;
+class LsmIndexManager : public RecordBasedCoreManager {
+ public:
+  static LsmIndexManager* instance();
+
+  // Override parent file operations, opening and closing keep count so the last close lets go of the memtable
+  virtual RC createFile(const string &fileName);
+  virtual RC destroyFile(const string &fileName);
+  virtual RC openFile(const string &fileName, FileHandle &fileHandle);
+  virtual RC closeFile(FileHandle &fileHandle);
+  virtual RC deleteRecords(FileHandle &fileHandle);
+
+	// From RecordBasedCoreManager
+	virtual RC readAttribute(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid, const string attributeName, void *data);
+	virtual RC reorganizePage(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const unsigned pageNumber);
+
+  // Keys use the same format as IndexManager::insertEntry(). A delete only writes a tombstone, so deleting an
+  // entry which is not there is not an error
+  RC insertEntry(FileHandle &fileHandle, const Attribute &attribute, const void *key, const RID &rid);
+  RC deleteEntry(FileHandle &fileHandle, const Attribute &attribute, const void *key, const RID &rid);
+
+  // Same as IndexManager::scan(), an equality scan skips the runs whose Bloom filter rules the key out
+  RC scan(FileHandle &fileHandle, const Attribute &attribute, const void *lowKey, const void *highKey, bool lowKeyInclusive, bool highKeyInclusive, LX_ScanIterator &lx_ScanIterator);
+
+  // Write the sorted entries of an empty index straight out as one run, on the level of runs its size
+  RC bulkLoad(FileHandle &fileHandle, const Attribute &attribute, IX_BulkLoader &loader);
+
+  // Write the memtable out as a run now, and wait for any compaction it starts to finish
+  RC flush(FileHandle &fileHandle, const Attribute &attribute);
+
+  // The level of every run, newest first
+  RC getRunLevels(FileHandle &fileHandle, const Attribute &attribute, std::vector<unsigned>& levels);
+
+  // Bytes of entries a memtable collects before it is flushed
+  void setMemtableSize(unsigned bytes);
+
+  static LX_Header* getHeader(void* headerPage);
+  static LX_PageFooter* getPageFooter(void* pageBuffer);
+
+ protected:
+  LsmIndexManager   ();                            // Constructor
+  virtual ~LsmIndexManager  ();                    // Destructor
+
+  RC getIndex(FileHandle& fileHandle, AttrType type, LX_Index*& index);
+  RC loadIndex(LX_Index& index);
+  RC unloadIndex(LX_Index* index, bool destroyRuns);
+  RC writeHeader(LX_Index& index);
+  RC changeEntry(FileHandle& fileHandle, const Attribute& attribute, const void* key, const RID& rid, bool tombstone);
+  RC appendLog(LX_Index& index, const std::vector<char>& entry, bool tombstone);
+  void applyChange(LX_Index& index, const std::vector<char>& entry, bool tombstone);
+  RC flushMemtable(LX_Index& index, std::unique_lock<std::mutex>& lock);
+  RC dropRuns(FileHandle& fileHandle);
+
+  RC openRun(LX_Index& index, unsigned runId, unsigned level, LX_Run*& run);
+  void releaseRun(LX_Run* run);
+
+  void compactionLoop(LX_Index* index);
+  RC compactLevel(LX_Index& index, std::unique_lock<std::mutex>& lock, bool& compacted);
+
+  static bool needsCompaction(const LX_Index& index, unsigned& first, unsigned& count);
+
+  static std::string getRunFileName(const std::string& fileName, unsigned runId);
+
+  friend class LX_ScanIterator;
+  friend class LX_RunWriter;
+
+ private:
+	std::mutex _indexesMutex;
+	std::map<std::string, LX_Index*> _indexes;
+	std::map<std::string, unsigned> _openCounts;
+	unsigned _memtableSize;
+
+	static LsmIndexManager *_lsm_index_manager;
+};
+
+class LX_ScanIterator {
+public:
+  LX_ScanIterator();  							// Constructor
+  ~LX_ScanIterator(); 							// Destructor
+
+  RC getNextEntry(RID &rid, void *key);  		// Get next matching entry
+  RC close();             						// Terminate index scan
+
+private:
+	// The memtable is copied when the scan starts, runs are read a page at a time
+	struct Source
+	{
+		LX_Run* run;
+		PageNum page;
+		unsigned offset;
+		std::vector<unsigned char> pageBuffer;
+		std::vector<char> entry;
+		bool tombstone;
+		bool done;
+	};
+
+	RC init(LX_Index& index, const Attribute &attribute, const void *lowKey, const void *highKey, bool lowKeyInclusive, bool highKeyInclusive);
+	RC initMerge(AttrType type, const std::vector<LX_Run*>& runs);
+	RC advance(Source& source);
+	RC getNextVersion(std::vector<char>& entry, bool& tombstone); // the newest version of the next (key, RID), tombstones too
+
+	std::vector<Source> _sources; // newest first, the memtable's source has no run
+	std::vector<char> _entry;
+	std::vector<std::pair<std::vector<char>, bool> > _memtable;
+	unsigned _memtablePosition;
+
+	AttrType _type;
+	KeyValueData _lowKey;
+	KeyValueData _highKey;
+	bool _hasLowKey;
+	bool _hasHighKey;
+	bool _lowKeyInclusive;
+	bool _highKeyInclusive;
+
+	friend class LsmIndexManager;
+};
+
+#endif
@@ -2,6 +2,8 @@
 #include <assert.h>
 #include <sstream>
 #include <limits>
+#include <cmath>
+#include <algorithm>
 
 bool Condition::compare(AttrType type, const void* left, const void* right) const
 {
@@ -74,6 +76,300 @@ RC Condition::splitAttr(const string& input, string& rel, string& attr)
 	return rc::OK;
 }
 
+bool IndexOnlyScan::covers(const vector<string> &attrNames) const
+{
+	for (vector<string>::const_iterator it = attrNames.begin(); it != attrNames.end(); ++it)
+	{
+		string rel;
+		string attr = *it;
+		if (Condition::splitAttr(*it, rel, attr) == rc::OK && rel != tableName)
+		{
+			return false;
+		}
+
+		bool found = false;
+		for (vector<Attribute>::const_iterator indexAttr = attrs.begin(); indexAttr != attrs.end() && !found; ++indexAttr)
+		{
+			found = indexAttr->name == attr;
+		}
+
+		if (!found)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool ridFileOrder(const RID& a, const RID& b)
+{
+	return a.pageNum < b.pageNum || (a.pageNum == b.pageNum && a.slotNum < b.slotNum);
+}
+
+void RidBitmap::set(const RID &rid)
+{
+	vector<unsigned>& words = _pages[rid.pageNum];
+	unsigned word = rid.slotNum / (8 * sizeof(unsigned));
+	if (words.size() <= word)
+	{
+		words.resize(word + 1, 0);
+	}
+	words[word] |= 1u << (rid.slotNum % (8 * sizeof(unsigned)));
+}
+
+bool RidBitmap::test(const RID &rid) const
+{
+	map<PageNum, vector<unsigned> >::const_iterator it = _pages.find(rid.pageNum);
+	unsigned word = rid.slotNum / (8 * sizeof(unsigned));
+	if (it == _pages.end() || it->second.size() <= word)
+	{
+		return false;
+	}
+	return (it->second[word] >> (rid.slotNum % (8 * sizeof(unsigned)))) & 1u;
+}
+
+void RidBitmap::intersect(const RidBitmap &that)
+{
+	map<PageNum, vector<unsigned> >::iterator it = _pages.begin();
+	while (it != _pages.end())
+	{
+		map<PageNum, vector<unsigned> >::const_iterator thatIt = that._pages.find(it->first);
+		vector<unsigned>& words = it->second;
+		if (thatIt != that._pages.end())
+		{
+			const vector<unsigned>& thatWords = thatIt->second;
+			words.resize(std::min(words.size(), thatWords.size()));
+			for (unsigned i = 0; i < words.size(); ++i)
+			{
+				words[i] &= thatWords[i];
+			}
+
+			// Trim to the highest set slot, a page with none left goes
+			while (!words.empty() && words.back() == 0)
+			{
+				words.pop_back();
+			}
+		}
+
+		if (thatIt == that._pages.end() || words.empty())
+		{
+			_pages.erase(it++);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+void RidBitmap::unite(const RidBitmap &that)
+{
+	for (map<PageNum, vector<unsigned> >::const_iterator thatIt = that._pages.begin(); thatIt != that._pages.end(); ++thatIt)
+	{
+		vector<unsigned>& words = _pages[thatIt->first];
+		const vector<unsigned>& thatWords = thatIt->second;
+		if (words.size() < thatWords.size())
+		{
+			words.resize(thatWords.size(), 0);
+		}
+		for (unsigned i = 0; i < thatWords.size(); ++i)
+		{
+			words[i] |= thatWords[i];
+		}
+	}
+}
+
+unsigned RidBitmap::count() const
+{
+	unsigned total = 0;
+	for (map<PageNum, vector<unsigned> >::const_iterator it = _pages.begin(); it != _pages.end(); ++it)
+	{
+		for (unsigned i = 0; i < it->second.size(); ++i)
+		{
+			total += __builtin_popcount(it->second[i]);
+		}
+	}
+	return total;
+}
+
+bool RidBitmap::nextPage(bool first, PageNum afterPage, PageNum &pageNum, vector<unsigned> &slots) const
+{
+	map<PageNum, vector<unsigned> >::const_iterator it = first ? _pages.begin() : _pages.upper_bound(afterPage);
+	if (it == _pages.end())
+	{
+		return false;
+	}
+
+	pageNum = it->first;
+	slots.clear();
+	for (unsigned i = 0; i < it->second.size(); ++i)
+	{
+		for (unsigned bits = it->second[i]; bits; bits &= bits - 1)
+		{
+			slots.push_back(i * 8 * sizeof(unsigned) + __builtin_ctz(bits));
+		}
+	}
+	return true;
+}
+
+RC HeapPageReader::readTuple(RelationManager &rm, const string &tableName, const RID &rid, void *data)
+{
+	if (!_pageLoaded || _loadedPage != rid.pageNum)
+	{
+		RC ret = rm.readTuplePage(tableName, rid.pageNum, _pageBuffer);
+		RETURN_ON_ERR(ret);
+
+		_pageLoaded = true;
+		_loadedPage = rid.pageNum;
+		++pagesRead;
+	}
+
+	return rm.readTuple(tableName, rid, data, _pageBuffer);
+}
+
+BitmapHeapScan::BitmapHeapScan(RelationManager &rm, const string &tableName, const string &attrName, const char *alias, unsigned memoryLimit)
+	: rm(rm), tableName(tableName), attrName(attrName), memoryLimit(memoryLimit), _alias(alias ? alias : tableName),
+	_position(0), _indexDone(false)
+{
+	// Get Attributes from RM
+	rm.getAttributes(tableName, attrs);
+
+	// Call rm indexScan to get iterator
+	rm.indexScan(tableName, attrName, NULL, NULL, true, true, iter);
+}
+
+void BitmapHeapScan::setIterator(void* lowKey, void* highKey, bool lowKeyInclusive, bool highKeyInclusive)
+{
+	iter.close();
+	rm.indexScan(tableName, attrName, lowKey, highKey, lowKeyInclusive, highKeyInclusive, iter);
+
+	_batch.clear();
+	_position = 0;
+	_indexDone = false;
+	reader.reset();
+}
+
+RC BitmapHeapScan::fillBatch()
+{
+	_batch.clear();
+	_position = 0;
+
+	// Gather RIDs up to the memory limit, always at least one so a tiny limit still makes progress
+	unsigned maxRids = std::max(1u, (unsigned)(memoryLimit / sizeof(RID)));
+	RID rid;
+	while (_batch.size() < maxRids)
+	{
+		RC ret = iter.getNextEntry(rid, key);
+		if (ret == IX_EOF)
+		{
+			_indexDone = true;
+			break;
+		}
+		RETURN_ON_ERR(ret);
+
+		_batch.push_back(rid);
+	}
+
+	// Page order, and slot order within a page
+	std::sort(_batch.begin(), _batch.end(), ridFileOrder);
+	return rc::OK;
+}
+
+RC BitmapHeapScan::getNextTuple(void *data)
+{
+	while (_position >= _batch.size())
+	{
+		if (_indexDone)
+		{
+			return QE_EOF;
+		}
+
+		RC ret = fillBatch();
+		RETURN_ON_ERR(ret);
+	}
+
+	return reader.readTuple(rm, tableName, _batch[_position++], data);
+}
+
+MultiIndexScan::MultiIndexScan(RelationManager &rm, const string &tableName, BitmapOp op, const char *alias)
+	: rm(rm), tableName(tableName), op(op), _alias(alias ? alias : tableName), _numRanges(0), _started(false), _pageNum(0), _position(0)
+{
+	// Get Attributes from RM
+	rm.getAttributes(tableName, attrs);
+}
+
+RC MultiIndexScan::addRange(const string &attrName, void* lowKey, void* highKey, bool lowKeyInclusive, bool highKeyInclusive)
+{
+	RM_IndexScanIterator iter;
+	RC ret = rm.indexScan(tableName, attrName, lowKey, highKey, lowKeyInclusive, highKeyInclusive, iter);
+	RETURN_ON_ERR(ret);
+
+	RidBitmap rids;
+	RID rid;
+	char key[PAGE_SIZE];
+	while ((ret = iter.getNextEntry(rid, key)) == rc::OK)
+	{
+		rids.set(rid);
+	}
+	iter.close();
+
+	if (ret != IX_EOF)
+	{
+		return ret;
+	}
+
+	// The first range starts the result whichever way they are combined
+	if (_numRanges++ == 0 || op == BITMAP_OR)
+	{
+		_result.unite(rids);
+	}
+	else
+	{
+		_result.intersect(rids);
+	}
+
+	_started = false;
+	return rc::OK;
+}
+
+void MultiIndexScan::reset()
+{
+	_result.clear();
+	_numRanges = 0;
+	_started = false;
+	reader.reset();
+}
+
+RC MultiIndexScan::getNextTuple(void *data)
+{
+	if (!_started)
+	{
+		_started = true;
+		_position = 0;
+		_slots.clear();
+		if (!_result.nextPage(true, 0, _pageNum, _slots))
+		{
+			return QE_EOF;
+		}
+	}
+
+	while (_position >= _slots.size())
+	{
+		_position = 0;
+		if (!_result.nextPage(false, _pageNum, _pageNum, _slots))
+		{
+			_slots.clear();
+			return QE_EOF;
+		}
+	}
+
+	RID rid;
+	rid.pageNum = _pageNum;
+	rid.slotNum = _slots[_position++];
+	return reader.readTuple(rm, tableName, rid, data);
+}
+
 Project::Project(Iterator* input, const vector<string> &attrNames) 
 {
 	_itr = input;
@@ -375,9 +671,10 @@ RC INLJoin::resetInner()
 }
 
 Aggregate::Aggregate(Iterator* input, Attribute aggAttr, AggregateOp op)
-: _input(input), _aggrigateAttribute(aggAttr), _operation(op), _hasGroup(false)
+: _input(input), _aggrigateAttribute(aggAttr), _operation(op), _groupCodes(NULL), _hasGroup(false), _groupOnCodes(false), _inputHasCodes(false)
 {
 	_input->getAttributes(_attributes);
+	_outputScale = (op == COUNT || op == SUM) ? 1.0f / _input->getSampleFraction() : 1.0f;
 
 	RC ret = RBFM_ScanIterator::findAttributeByName(_attributes, _aggrigateAttribute.name, _aggrigateAttributeIndex);
 	assert(ret == rc::OK);
@@ -386,9 +683,10 @@ Aggregate::Aggregate(Iterator* input, Attribute aggAttr, AggregateOp op)
 }
 
 Aggregate::Aggregate(Iterator* input, Attribute aggAttr, Attribute gAttr, AggregateOp op)
-: _input(input), _aggrigateAttribute(aggAttr), _groupAttribute(gAttr), _operation(op), _hasGroup(true)
+: _input(input), _aggrigateAttribute(aggAttr), _groupAttribute(gAttr), _operation(op), _groupCodes(NULL), _hasGroup(true), _groupOnCodes(false), _inputHasCodes(false)
 {
 	_input->getAttributes(_attributes);
+	_outputScale = (op == COUNT || op == SUM) ? 1.0f / _input->getSampleFraction() : 1.0f;
 
 	RC ret = RBFM_ScanIterator::findAttributeByName(_attributes, _aggrigateAttribute.name, _aggrigateAttributeIndex);
 	assert(ret == rc::OK);
@@ -399,6 +697,18 @@ Aggregate::Aggregate(Iterator* input, Attribute aggAttr, Attribute gAttr, Aggreg
 	_totalAggregate.init(_attributes[_aggrigateAttributeIndex].type, _operation);
 	_groupingAggregate.init(_attributes[_groupAttributeIndex].type, _operation);
 
+	// Group on the stored codes if the input can hand them over, otherwise every value gets a code of its own
+	if (_attributes[_groupAttributeIndex].type == TypeVarChar)
+	{
+		_groupOnCodes = true;
+		_groupCodes = &_groupDictionary;
+		if (_input->passCodes(_groupAttribute.name, _groupCodes) == rc::OK)
+		{
+			_inputHasCodes = true;
+			_input->getAttributes(_attributes);
+		}
+	}
+
 	// Scan through the entire table and populate our hash map with grouped aggregate data
 	ret = rc::OK;
 	while ((ret = getNextSingleTuple()) == rc::OK)
@@ -487,15 +797,22 @@ void AggregateData::append(AggregateOp op, float realData, int intData)
 	}
 }
 
-void AggregateData::write(void* dest) const
+void AggregateData::write(void* dest, float scale) const
 {
 	if (_writeAsInt)
 	{
-		memcpy(dest, &_intValue, sizeof(_intValue));
+		int value = _intValue;
+		if (scale != 1.0f)
+		{
+			value = (int)floor(_intValue * scale + 0.5f);
+		}
+
+		memcpy(dest, &value, sizeof(value));
 	}
 	else
 	{
-		memcpy(dest, &_realValue, sizeof(_realValue));
+		float value = _realValue * scale;
+		memcpy(dest, &value, sizeof(value));
 	}
 }
 
@@ -521,7 +838,7 @@ AggregateData* Aggregate::getGroupedAggregate(T value, std::map<T, AggregateData
 	{
 		// We need to initialize this grouping fresh
 		AggregateData newGrouping;
-		newGrouping.init(_attributes[_groupAttributeIndex].type, _operation);
+		newGrouping.init(_attributes[_aggrigateAttributeIndex].type, _operation);
 
 		// And insert it into the group
 		groupMap[value] = newGrouping;
@@ -561,8 +878,8 @@ RC Aggregate::getNextSingleTuple()
 	if (_hasGroup)
 	{
 		AggregateData* aggregate = NULL;
-		float groupingRealValue;
-		int groupingIntValue;
+		float groupingRealValue = 0.0f;
+		int groupingIntValue = 0;
 
 		// Find the offset of the attribute we want
 		attributeOffset = 0;
@@ -571,16 +888,32 @@ RC Aggregate::getNextSingleTuple()
 			attributeOffset += Attribute::sizeInBytes(_attributes[i].type, _buffer + attributeOffset);
 		}
 
-		_groupingAggregate.read(_buffer, attributeOffset, groupingRealValue, groupingIntValue);
-
 		// Determine which source mapping we're using based on the GROUPING values
-		if (_groupingAggregate._readAsInt)
+		if (_groupOnCodes)
 		{
+			if (_inputHasCodes)
+			{
+				memcpy(&groupingIntValue, _buffer + attributeOffset, sizeof(groupingIntValue));
+			}
+			else
+			{
+				bool added = false;
+				ret = _groupDictionary.encode(_buffer + attributeOffset, groupingIntValue, added);
+				RETURN_ON_ERR(ret);
+			}
+
+			aggregate = getGroupedAggregate<int>(groupingIntValue, _intGrouping);
+			memcpy(aggregate->_groupingData, &groupingIntValue, sizeof(groupingIntValue));
+		}
+		else if (_groupingAggregate._readAsInt)
+		{
+			_groupingAggregate.read(_buffer, attributeOffset, groupingRealValue, groupingIntValue);
 			aggregate = getGroupedAggregate<int>(groupingIntValue, _intGrouping);
 			memcpy(aggregate->_groupingData, &groupingIntValue, sizeof(groupingIntValue));
 		}
 		else
 		{
+			_groupingAggregate.read(_buffer, attributeOffset, groupingRealValue, groupingIntValue);
 			aggregate = getGroupedAggregate<float>(groupingRealValue, _realGrouping);
 			memcpy(aggregate->_groupingData, &groupingRealValue, sizeof(groupingRealValue));
 		}
@@ -603,11 +936,25 @@ RC Aggregate::getNextGroup(void* data, std::map<T, AggregateData>& groupMap, typ
 
 	void* groupingValue = (void*)groupIter->second._groupingData;
 
-	// Output the GROUPING value
-	memcpy(data, groupingValue, 4);
+	// Output the GROUPING value, varchar groups are translated back from their code
+	unsigned groupingSize = 4;
+	if (_groupOnCodes)
+	{
+		int code = 0;
+		memcpy(&code, groupingValue, sizeof(code));
+
+		RC ret = _groupCodes->decode(code, data);
+		RETURN_ON_ERR(ret);
+
+		groupingSize = Attribute::sizeInBytes(TypeVarChar, data);
+	}
+	else
+	{
+		memcpy(data, groupingValue, 4);
+	}
 
 	// Output the AGGREAGTE value
-	groupIter->second.write((char*)data + 4);
+	groupIter->second.write((char*)data + groupingSize, _outputScale);
 
 	// Advance our iterator and we're done
 	++groupIter;
@@ -623,13 +970,13 @@ RC Aggregate::getNextTuple(void* data)
 		// Without grouping, we simply get the next tuple and output the current total aggregate data
 		ret = getNextSingleTuple();
 		if (ret == rc::OK)
-			_totalAggregate.write(data);
+			_totalAggregate.write(data, _outputScale);
 	}
 	else
 	{
 		// With grouping, we must iterate through each of the grouping data values
 		// Assume we have already scanned the entire table and populated our hash map
-		if (_groupingAggregate._readAsInt)
+		if (_groupOnCodes || _groupingAggregate._readAsInt)
 		{
 			ret = getNextGroup<int>(data, _intGrouping, _intGroupingIterator);
 		}
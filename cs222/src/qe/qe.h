@@ -2,6 +2,7 @@
 #define _qe_h_
 
 #include <vector>
+#include <map>
 
 #include "../rbf/rbfm.h"
 #include "../rm/rm.h"
@@ -9,10 +10,16 @@
 
 # define QE_EOF (-1)  // end of the index scan
 
+// Bytes of RIDs a BitmapHeapScan gathers from the index before it starts reading the table
+# define QE_BITMAP_MEMORY_LIMIT (64 * PAGE_SIZE)
+
 using namespace std;
 
 typedef enum{ MIN = 0, MAX, SUM, AVG, COUNT } AggregateOp;
 
+// How MultiIndexScan combines the RIDs each index range finds
+typedef enum{ BITMAP_AND = 0, BITMAP_OR } BitmapOp;
+
 
 // The following functions use  the following
 // format for the passed data.
@@ -40,12 +47,56 @@ struct Condition {
 };
 
 
+// A set of RIDs kept as one bitmap of slot numbers per table page, pages without a set bit are not stored
+// and the words of a page stop at its highest set slot
+class RidBitmap {
+    public:
+        void set(const RID &rid);
+        bool test(const RID &rid) const;
+        void intersect(const RidBitmap &that);
+        void unite(const RidBitmap &that);
+        void clear() { _pages.clear(); }
+        bool empty() const { return _pages.empty(); }
+        unsigned count() const;
+
+        // Slots set on the first page after afterPage (any page when first), in slot order
+        bool nextPage(bool first, PageNum afterPage, PageNum &pageNum, vector<unsigned> &slots) const;
+
+    private:
+        map<PageNum, vector<unsigned> > _pages;
+};
+
+
+// Reads tuples through one cached table page, a run of RIDs on the same page costs a single page read
+class HeapPageReader {
+    public:
+        HeapPageReader() : pagesRead(0), _pageLoaded(false), _loadedPage(0) {}
+
+        RC readTuple(RelationManager &rm, const string &tableName, const RID &rid, void *data);
+        void reset() { _pageLoaded = false; }
+
+        unsigned pagesRead; // table pages read so far
+
+    private:
+        bool _pageLoaded;
+        PageNum _loadedPage;
+        char _pageBuffer[PAGE_SIZE];
+};
+
+
 class Iterator {
     // All the relational operators and access methods are iterators.
     public:
         virtual RC getNextTuple(void *data) = 0;
         virtual void getAttributes(vector<Attribute> &attrs) const = 0;
         virtual ~Iterator() {};
+
+        // Fraction of the input tuples this iterator produces when its source is a sampled scan
+        virtual float getSampleFraction() const { return 1.0f; }
+
+        // Ask for a dictionary encoded varchar attribute to come out as its stored TypeInt code, before the first
+        // tuple is read. On success dictionary turns the codes back into values
+        virtual RC passCodes(const string &attributeName, const ColumnDictionary*& dictionary) { return rc::FEATURE_NOT_YET_IMPLEMENTED; }
 };
 
 
@@ -59,8 +110,10 @@ class TableScan : public Iterator
         vector<Attribute> attrs;
         vector<string> attrNames;
         RID rid;
+        ScanSample sample;
+        vector<string> codedAttrNames;
 
-        TableScan(RelationManager &rm, const string &tableName, const char *alias = NULL):rm(rm)
+        TableScan(RelationManager &rm, const string &tableName, const char *alias = NULL, const ScanSample &sample = ScanSample()):rm(rm), sample(sample)
         {
         	//Set members
         	this->tableName = tableName;
@@ -78,7 +131,7 @@ class TableScan : public Iterator
 
             // Call rm scan to get iterator
             iter = new RM_ScanIterator();
-            rm.scan(tableName, "", NO_OP, NULL, attrNames, *iter);
+            rm.scan(tableName, "", NO_OP, NULL, attrNames, sample, *iter);
 
             // Set alias
             if(alias) this->tableName = alias;
@@ -90,7 +143,14 @@ class TableScan : public Iterator
             iter->close();
             delete iter;
             iter = new RM_ScanIterator();
-            rm.scan(tableName, "", NO_OP, NULL, attrNames, *iter);
+            rm.scan(tableName, "", NO_OP, NULL, attrNames, sample, *iter);
+
+            // Attributes handed out as codes stay that way
+            const ColumnDictionary* dictionary = NULL;
+            for (unsigned i = 0; i < codedAttrNames.size(); ++i)
+            {
+                iter->keepCodes(codedAttrNames[i], dictionary);
+            }
         };
 
         RC getNextTuple(void *data)
@@ -98,6 +158,38 @@ class TableScan : public Iterator
             return iter->getNextTuple(rid, data);
         };
 
+        float getSampleFraction() const
+        {
+            return sample.sampledFraction();
+        };
+
+        RC passCodes(const string &attributeName, const ColumnDictionary*& dictionary)
+        {
+            string relation, attribute;
+            if (Condition::splitAttr(attributeName, relation, attribute) != rc::OK || relation != tableName)
+            {
+                return rc::ATTRIBUTE_NOT_FOUND;
+            }
+
+            RC ret = iter->keepCodes(attribute, dictionary);
+            if (ret != rc::OK)
+            {
+                return ret;
+            }
+
+            for (unsigned i = 0; i < attrs.size(); ++i)
+            {
+                if (attrs[i].name == attribute)
+                {
+                    attrs[i].type = TypeInt;
+                    attrs[i].length = sizeof(int);
+                }
+            }
+
+            codedAttrNames.push_back(attribute);
+            return rc::OK;
+        };
+
         void getAttributes(vector<Attribute> &attrs) const
         {
             attrs.clear();
@@ -155,13 +247,14 @@ class IndexScan : public Iterator
         void setIterator(void* lowKey,
                          void* highKey,
                          bool lowKeyInclusive,
-                         bool highKeyInclusive)
+                         bool highKeyInclusive,
+                         IX_ScanOrder order = IX_SCAN_ASCENDING)
         {
             iter->close();
             delete iter;
             iter = new RM_IndexScanIterator();
             rm.indexScan(tableName, attrName, lowKey, highKey, lowKeyInclusive,
-                           highKeyInclusive, *iter);
+                           highKeyInclusive, order, *iter);
         };
 
         RC getNextTuple(void *data)
@@ -197,6 +290,276 @@ class IndexScan : public Iterator
 };
 
 
+class HashIndexScan : public Iterator
+{
+    // A wrapper inheriting Iterator over an equality lookup in a hash index, nothing comes out until setKey()
+    public:
+        RelationManager &rm;
+        RM_IndexScanIterator iter;
+        string tableName;
+        string attrName;
+        vector<Attribute> attrs;
+        char key[PAGE_SIZE];
+        RID rid;
+        bool hasKey;
+
+        HashIndexScan(RelationManager &rm, const string &tableName, const string &attrName, const char *alias = NULL):rm(rm), hasKey(false)
+        {
+        	// Set members
+        	this->tableName = tableName;
+        	this->attrName = attrName;
+
+            // Get Attributes from RM
+            rm.getAttributes(tableName, attrs);
+
+            // Set alias
+            if(alias) this->tableName = alias;
+        };
+
+        // Start a new lookup for every tuple whose attribute equals lookupKey
+        void setKey(const void* lookupKey)
+        {
+            iter.close();
+            hasKey = rm.indexScan(tableName, attrName, lookupKey, lookupKey, true, true, iter) == rc::OK;
+        };
+
+        RC getNextTuple(void *data)
+        {
+            if(!hasKey)
+            {
+                return QE_EOF;
+            }
+
+            int rc = iter.getNextEntry(rid, key);
+            if(rc == 0)
+            {
+                rc = rm.readTuple(tableName.c_str(), rid, data);
+            }
+            return rc;
+        };
+
+        void getAttributes(vector<Attribute> &attrs) const
+        {
+            attrs.clear();
+            attrs = this->attrs;
+            unsigned i;
+
+            // For attribute in vector<Attribute>, name it as rel.attr
+            for(i = 0; i < attrs.size(); ++i)
+            {
+                string tmp = tableName;
+                tmp += ".";
+                tmp += attrs[i].name;
+                attrs[i].name = tmp;
+            }
+        };
+
+        ~HashIndexScan()
+        {
+            iter.close();
+        };
+};
+
+
+class IndexOnlyScan : public Iterator
+{
+    // A wrapper inheriting Iterator over a covering index scan, tuples are built from the index entries alone and
+    // hold the key attributes followed by the included attributes, the table is never read
+    public:
+        RelationManager &rm;
+        RM_IndexScanIterator iter;
+        string tableName;
+        vector<string> keyAttrNames;
+        vector<string> includedAttrNames;
+        vector<Attribute> attrs;
+        RID rid;
+
+        IndexOnlyScan(RelationManager &rm, const string &tableName, const vector<string> &keyAttrNames, const vector<string> &includedAttrNames, const char *alias = NULL):rm(rm)
+        {
+        	// Set members
+        	this->tableName = tableName;
+        	this->keyAttrNames = keyAttrNames;
+        	this->includedAttrNames = includedAttrNames;
+
+            // Only the attributes in the index make up a tuple, in index order
+            vector<Attribute> tableAttrs;
+            rm.getAttributes(tableName, tableAttrs);
+
+            vector<string> indexAttrNames(keyAttrNames);
+            indexAttrNames.insert(indexAttrNames.end(), includedAttrNames.begin(), includedAttrNames.end());
+            for (unsigned i = 0; i < indexAttrNames.size(); ++i)
+            {
+                for (unsigned j = 0; j < tableAttrs.size(); ++j)
+                {
+                    if (tableAttrs[j].name == indexAttrNames[i])
+                        attrs.push_back(tableAttrs[j]);
+                }
+            }
+
+            // Call rm indexScan to get iterator
+            rm.indexScan(tableName, keyAttrNames, includedAttrNames, NULL, 0, NULL, 0, true, true, iter);
+
+            // Set alias
+            if(alias) this->tableName = alias;
+        };
+
+        // Start a new iterator given the new key range, either key may give just its leading values
+        void setIterator(const void* lowKey,
+                         unsigned lowKeyValues,
+                         const void* highKey,
+                         unsigned highKeyValues,
+                         bool lowKeyInclusive,
+                         bool highKeyInclusive)
+        {
+            iter.close();
+            rm.indexScan(tableName, keyAttrNames, includedAttrNames, lowKey, lowKeyValues, highKey, highKeyValues,
+                           lowKeyInclusive, highKeyInclusive, iter);
+        };
+
+        RC getNextTuple(void *data)
+        {
+            return iter.getNextEntry(rid, data);
+        };
+
+        void getAttributes(vector<Attribute> &attrs) const
+        {
+            attrs.clear();
+            attrs = this->attrs;
+            unsigned i;
+
+            // For attribute in vector<Attribute>, name it as rel.attr
+            for(i = 0; i < attrs.size(); ++i)
+            {
+                string tmp = tableName;
+                tmp += ".";
+                tmp += attrs[i].name;
+                attrs[i].name = tmp;
+            }
+        };
+
+        // Whether every one of attrNames ("rel.attr" or plain) is in the index, so a query which only
+        // projects and filters on them can use this scan in place of an IndexScan
+        bool covers(const vector<string> &attrNames) const;
+
+        ~IndexOnlyScan()
+        {
+            iter.close();
+        };
+};
+
+
+class BitmapHeapScan : public Iterator
+{
+    // A wrapper inheriting Iterator over IX_IndexScan that reads each table page once, the RIDs of a range are
+    // gathered and sorted into file order so every tuple on a page comes out of one read of it. Once memoryLimit
+    // bytes of RIDs are gathered that batch is fetched before the index scan goes on, tuples come out in file
+    // order within a batch rather than in key order
+    public:
+        RelationManager &rm;
+        RM_IndexScanIterator iter;
+        string tableName;
+        string attrName;
+        vector<Attribute> attrs;
+        char key[PAGE_SIZE];
+        unsigned memoryLimit;
+        HeapPageReader reader; // a page is read again only when RIDs on it land in different batches
+
+        BitmapHeapScan(RelationManager &rm, const string &tableName, const string &attrName, const char *alias = NULL, unsigned memoryLimit = QE_BITMAP_MEMORY_LIMIT);
+
+        // Start a new iterator given the new key range
+        void setIterator(void* lowKey,
+                         void* highKey,
+                         bool lowKeyInclusive,
+                         bool highKeyInclusive);
+
+        RC getNextTuple(void *data);
+
+        void getAttributes(vector<Attribute> &attrs) const
+        {
+            attrs.clear();
+            attrs = this->attrs;
+            unsigned i;
+
+            // For attribute in vector<Attribute>, name it as rel.attr
+            for(i = 0; i < attrs.size(); ++i)
+            {
+                string tmp = _alias;
+                tmp += ".";
+                tmp += attrs[i].name;
+                attrs[i].name = tmp;
+            }
+        };
+
+        ~BitmapHeapScan()
+        {
+            iter.close();
+        };
+
+    private:
+        RC fillBatch();
+
+        string _alias;
+        vector<RID> _batch; // RIDs of the current batch, sorted into file order
+        unsigned _position;
+        bool _indexDone;
+};
+
+
+class MultiIndexScan : public Iterator
+{
+    // Answers a conjunction or disjunction of range predicates on several indexed attributes of one table, every
+    // range is scanned into a RidBitmap as it is added and the bitmaps are combined with op. Only the tuples left
+    // in the result are read, page by page in file order
+    public:
+        RelationManager &rm;
+        string tableName;
+        vector<Attribute> attrs;
+        BitmapOp op;
+        HeapPageReader reader;
+
+        MultiIndexScan(RelationManager &rm, const string &tableName, BitmapOp op, const char *alias = NULL);
+
+        // Scan attrName's index over the range and fold what it finds into the result
+        RC addRange(const string &attrName,
+                    void* lowKey,
+                    void* highKey,
+                    bool lowKeyInclusive,
+                    bool highKeyInclusive);
+
+        // Drop every range added so far
+        void reset();
+
+        RC getNextTuple(void *data);
+
+        void getAttributes(vector<Attribute> &attrs) const
+        {
+            attrs.clear();
+            attrs = this->attrs;
+            unsigned i;
+
+            // For attribute in vector<Attribute>, name it as rel.attr
+            for(i = 0; i < attrs.size(); ++i)
+            {
+                string tmp = _alias;
+                tmp += ".";
+                tmp += attrs[i].name;
+                attrs[i].name = tmp;
+            }
+        };
+
+        ~MultiIndexScan() {};
+
+    private:
+        string _alias;
+        RidBitmap _result;
+        unsigned _numRanges;
+        bool _started;
+        PageNum _pageNum;
+        vector<unsigned> _slots;
+        unsigned _position;
+};
+
+
 class Filter : public Iterator {
     // Filter operator
     public:
@@ -208,6 +571,7 @@ class Filter : public Iterator {
 		RC getNextTuple(void *data);
         // For attribute in vector<Attribute>, name it as rel.attr
 		void getAttributes(vector<Attribute> &attrs) const;
+		float getSampleFraction() const { return _input->getSampleFraction(); }
 
 		RC getDataOffset(const vector<Attribute>& attrs, unsigned attrIndex, const void* data, unsigned& dataOffset);
 
@@ -230,6 +594,7 @@ class Project : public Iterator {
         RC getNextTuple(void *data);
         // For attribute in vector<Attribute>, name it as rel.attr
         void getAttributes(vector<Attribute> &attrs) const;
+        float getSampleFraction() const { return _itr->getSampleFraction(); }
 
     protected:
         unsigned _entrySize;
@@ -313,7 +678,7 @@ class INLJoin : public Joiner {
 struct AggregateData
 {
 	void init(AttrType type, AggregateOp op);
-	void write(void* dest) const;
+	void write(void* dest, float scale) const;
 	void read(const void* data, unsigned attributeOffset, float& f, int& i);
 	void append(AggregateOp op, float realData, int intData);
 
@@ -380,7 +745,15 @@ private:
 	std::map<float, AggregateData>::const_iterator _realGroupingIterator;
 	std::map<int, AggregateData>::const_iterator _intGroupingIterator;
 
+	// Varchar groups are keyed on int codes. An encoded column's stored codes come straight from the input when it
+	// can pass them through, _groupCodes then decodes them. Any other varchar is interned into _groupDictionary
+	ColumnDictionary _groupDictionary;
+	const ColumnDictionary* _groupCodes;
+
 	bool _hasGroup;
+	bool _groupOnCodes;
+	bool _inputHasCodes;
+	float _outputScale; // over a sampled input, COUNT and SUM are scaled up to estimate the full result
 	char _buffer[PAGE_SIZE];
 };
 
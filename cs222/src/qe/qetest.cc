@@ -2,6 +2,7 @@
 #include <iostream>
 
 #include <vector>
+#include <algorithm>
 
 #include <cstdlib>
 #include <cstdio>
@@ -29,6 +30,12 @@ bool RUN_TEST_E3 = true;
 bool RUN_TEST_E4 = true;
 bool RUN_TEST_X1 = true;
 bool RUN_TEST_X2 = true;
+bool RUN_TEST_X3 = true;
+bool RUN_TEST_X4 = true;
+bool RUN_TEST_X5 = true;
+bool RUN_TEST_X6 = true;
+bool RUN_TEST_X7 = true;
+bool RUN_TEST_X8 = true;
 
 #ifndef _success_
 #define _success_
@@ -1597,6 +1604,591 @@ clean_up:
 	return rc;
 }
 
+RC customTest_3()
+{
+	// Functions Tested;
+	// 1. Create Dictionary -- varchar column stored as codes
+	// 2. Aggregate -- SUM (with GroupBy on the encoded column)
+	cout << "****In Test Case CUSTOM 3****" << endl;
+	RC rc = success;
+
+	const string statuses[] = { "open", "closed", "pending", "rejected" };
+	const int numStatuses = 4;
+
+	vector<Attribute> attrs;
+	Attribute attr;
+	attr.name = "A";
+	attr.type = TypeInt;
+	attr.length = 4;
+	attrs.push_back(attr);
+
+	attr.name = "B";
+	attr.type = TypeVarChar;
+	attr.length = 30;
+	attrs.push_back(attr);
+
+	rc = rm->createTable("dictgroup", attrs);
+	if (rc != success) {
+		return rc;
+	}
+
+	rc = rm->createDictionary("dictgroup", "B");
+	if (rc != success) {
+		return rc;
+	}
+
+	// A in [0, 99], B cycles through the statuses
+	RID rid;
+	void *data = malloc(bufSize);
+	for (int i = 0; i < tupleCount; ++i) {
+		int length = statuses[i % numStatuses].size();
+		memcpy((char *)data, &i, sizeof(int));
+		memcpy((char *)data + sizeof(int), &length, sizeof(int));
+		memcpy((char *)data + 2 * sizeof(int), statuses[i % numStatuses].c_str(), length);
+
+		rc = rm->insertTuple("dictgroup", data, rid);
+		if (rc != success) {
+			free(data);
+			return rc;
+		}
+	}
+
+	// The second pass reads through an alias, the codes still come straight from the scan
+	const char* aliases[] = { NULL, "dg" };
+	TableScan *input = NULL;
+	Aggregate *agg = NULL;
+	for (int pass = 0; pass < 2; ++pass) {
+		input = new TableScan(*rm, "dictgroup", aliases[pass]);
+		const string relation = aliases[pass] ? aliases[pass] : "dictgroup";
+
+		Attribute aggAttr;
+		aggAttr.name = relation + ".A";
+		aggAttr.type = TypeInt;
+		aggAttr.length = 4;
+
+		Attribute gAttr;
+		gAttr.name = relation + ".B";
+		gAttr.type = TypeVarChar;
+		gAttr.length = 30;
+		agg = new Aggregate(input, aggAttr, gAttr, SUM);
+
+		// The scan hands over B as its stored code
+		vector<Attribute> scanAttrs;
+		input->getAttributes(scanAttrs);
+		if (scanAttrs[1].type != TypeInt) {
+			rc = fail;
+			goto clean_up;
+		}
+
+		int expectedResultCnt = numStatuses;
+		int actualResultCnt = 0;
+
+		memset(data, 0, bufSize);
+		while (agg->getNextTuple(data) != QE_EOF) {
+			// Find which status this group is, the sum is every i with i % 4 == status
+			int length = *(int *)data;
+			string status((char *)data + sizeof(int), length);
+			int sumVal = *(int *)((char *)data + sizeof(int) + length);
+
+			int expectedSum = -1;
+			for (int s = 0; s < numStatuses; ++s) {
+				if (statuses[s] == status) {
+					expectedSum = 0;
+					for (int i = s; i < tupleCount; i += numStatuses) {
+						expectedSum += i;
+					}
+				}
+			}
+
+			if (!QUIET_TESTS)
+				cout << relation << ".B " << status << " SUM(" << relation << ".A) " << sumVal << endl;
+
+			if (sumVal != expectedSum) {
+				rc = fail;
+				goto clean_up;
+			}
+
+			memset(data, 0, bufSize);
+			++actualResultCnt;
+		}
+
+		if (expectedResultCnt != actualResultCnt) {
+			rc = fail;
+			goto clean_up;
+		}
+
+		delete agg;
+		delete input;
+		agg = NULL;
+		input = NULL;
+	}
+
+clean_up:
+	delete agg;
+	delete input;
+	free(data);
+	return rc;
+}
+
+RC customTest_4()
+{
+	// Functions Tested;
+	// 1. TableScan over a Bernoulli sample
+	// 2. Aggregate -- COUNT scaled up from the sample
+	cout << "****In Test Case CUSTOM 4****" << endl;
+	RC rc = success;
+
+	const int numTuples = 2000;
+
+	vector<Attribute> attrs;
+	Attribute attr;
+	attr.name = "A";
+	attr.type = TypeInt;
+	attr.length = 4;
+	attrs.push_back(attr);
+
+	rc = rm->createTable("sampled", attrs);
+	if (rc != success) {
+		return rc;
+	}
+
+	RID rid;
+	void *data = malloc(bufSize);
+	for (int i = 0; i < numTuples; ++i) {
+		memcpy((char *)data, &i, sizeof(int));
+		rc = rm->insertTuple("sampled", data, rid);
+		if (rc != success) {
+			free(data);
+			return rc;
+		}
+	}
+
+	Attribute aggAttr;
+	aggAttr.name = "sampled.A";
+	aggAttr.type = TypeInt;
+	aggAttr.length = 4;
+
+	TableScan *input = new TableScan(*rm, "sampled", NULL, ScanSample(SampleBernoulli, 0.25f, 11));
+	Aggregate *agg = new Aggregate(input, aggAttr, COUNT);
+
+	int estimate = 0;
+	int rowsOut = 0;
+	while (agg->getNextTuple(data) != QE_EOF) {
+		estimate = *(int *)data;
+		++rowsOut;
+	}
+
+	if (!QUIET_TESTS)
+		cout << "COUNT(sampled.A) estimate " << estimate << " of " << numTuples << endl;
+
+	// One running total is output per sampled tuple, and the last should land near the true count
+	if (rowsOut == 0 || rowsOut >= numTuples || estimate < numTuples * 3 / 4 || estimate > numTuples * 5 / 4) {
+		rc = fail;
+	}
+
+	delete agg;
+	delete input;
+	free(data);
+	return rc;
+}
+
+RC customTest_5()
+{
+	// Functions Tested;
+	// 1. Create a hash index
+	// 2. HashIndexScan -- one lookup per key, nothing before the first key is set
+	cout << "****In Test Case CUSTOM 5****" << endl;
+	RC rc = success;
+
+	const int numTuples = 500;
+	const int numKeys = 25;
+
+	vector<Attribute> attrs;
+	Attribute attr;
+	attr.name = "A";
+	attr.type = TypeInt;
+	attr.length = 4;
+	attrs.push_back(attr);
+
+	attr.name = "B";
+	attrs.push_back(attr);
+
+	rc = rm->createTable("hashed", attrs);
+	if (rc != success) {
+		return rc;
+	}
+
+	rc = rm->createIndex("hashed", "B", IndexTypeHash);
+	if (rc != success) {
+		return rc;
+	}
+
+	RID rid;
+	void *data = malloc(bufSize);
+	for (int i = 0; i < numTuples; ++i) {
+		int b = i % numKeys;
+		memcpy((char *)data, &i, sizeof(int));
+		memcpy((char *)data + sizeof(int), &b, sizeof(int));
+		rc = rm->insertTuple("hashed", data, rid);
+		if (rc != success) {
+			free(data);
+			return rc;
+		}
+	}
+
+	HashIndexScan *scan = new HashIndexScan(*rm, "hashed", "B");
+	if (scan->getNextTuple(data) != QE_EOF) {
+		rc = fail;
+	}
+
+	// Every tuple with the key comes back, and nothing else
+	for (int key = 0; key <= numKeys && rc == success; ++key) {
+		scan->setKey(&key);
+
+		int count = 0;
+		while (scan->getNextTuple(data) != QE_EOF) {
+			int a = *(int *)data;
+			int b = *(int *)((char *)data + sizeof(int));
+			if (b != key || a % numKeys != key) {
+				rc = fail;
+			}
+			++count;
+		}
+
+		if (count != (key < numKeys ? numTuples / numKeys : 0)) {
+			rc = fail;
+		}
+	}
+
+	delete scan;
+	free(data);
+	return rc;
+}
+
+RC customTest_6()
+{
+	// Functions Tested;
+	// 1. Create a covering index with an included attribute
+	// 2. IndexOnlyScan -- answers a filtered projection from the index alone
+	// 3. Filter and Project over IndexOnlyScan agree with IndexScan over the table
+	cout << "****In Test Case CUSTOM 6****" << endl;
+	RC rc = success;
+
+	const int numTuples = 1000;
+	const int numKeys = 50;
+
+	vector<Attribute> attrs;
+	Attribute attr;
+	attr.name = "A";
+	attr.type = TypeInt;
+	attr.length = 4;
+	attrs.push_back(attr);
+
+	attr.name = "B";
+	attrs.push_back(attr);
+
+	attr.name = "C";
+	attr.type = TypeReal;
+	attrs.push_back(attr);
+
+	rc = rm->createTable("covered", attrs);
+	if (rc != success) {
+		return rc;
+	}
+
+	RID rid;
+	void *data = malloc(bufSize);
+	for (int i = 0; i < numTuples; ++i) {
+		int b = (i * 7) % numKeys;
+		float c = i * 0.5f;
+		memcpy((char *)data, &i, sizeof(int));
+		memcpy((char *)data + sizeof(int), &b, sizeof(int));
+		memcpy((char *)data + 2 * sizeof(int), &c, sizeof(float));
+		rc = rm->insertTuple("covered", data, rid);
+		if (rc != success) {
+			free(data);
+			return rc;
+		}
+	}
+
+	vector<string> keyAttrNames(1, "B");
+	vector<string> includedAttrNames(1, "C");
+	rc = rm->createIndex("covered", keyAttrNames, includedAttrNames);
+	if (rc != success) {
+		free(data);
+		return rc;
+	}
+
+	rc = rm->createIndex("covered", "B");
+	if (rc != success) {
+		free(data);
+		return rc;
+	}
+
+	// SELECT covered.C FROM covered WHERE covered.B >= 10 AND covered.B <= 19 AND covered.C > 200.0
+	int lowKey = 10;
+	int highKey = 19;
+	float minC = 200.0f;
+
+	Condition cond;
+	cond.lhsAttr = "covered.C";
+	cond.op = GT_OP;
+	cond.bRhsIsAttr = false;
+	cond.rhsValue.type = TypeReal;
+	cond.rhsValue.data = &minC;
+
+	vector<string> projectAttrNames(1, "covered.C");
+	vector<string> usedAttrNames(projectAttrNames);
+	usedAttrNames.push_back("covered.B");
+
+	IndexOnlyScan *covering = new IndexOnlyScan(*rm, "covered", keyAttrNames, includedAttrNames);
+	if (!covering->covers(usedAttrNames) || covering->covers(vector<string>(1, "covered.A"))) {
+		rc = fail;
+	}
+
+	covering->setIterator(&lowKey, 1, &highKey, 1, true, true);
+	Filter *coveringFilter = new Filter(covering, cond);
+	Project *coveringProject = new Project(coveringFilter, projectAttrNames);
+
+	IndexScan *table = new IndexScan(*rm, "covered", "B");
+	table->setIterator(&lowKey, &highKey, true, true);
+	Filter *tableFilter = new Filter(table, cond);
+	Project *tableProject = new Project(tableFilter, projectAttrNames);
+
+	// Both plans see the same values, the covering one ordered by C within each B
+	vector<float> coveringValues;
+	while (coveringProject->getNextTuple(data) != QE_EOF) {
+		coveringValues.push_back(*(float *)data);
+	}
+
+	vector<float> tableValues;
+	while (tableProject->getNextTuple(data) != QE_EOF) {
+		tableValues.push_back(*(float *)data);
+	}
+
+	std::sort(coveringValues.begin(), coveringValues.end());
+	std::sort(tableValues.begin(), tableValues.end());
+	if (coveringValues.empty() || coveringValues != tableValues) {
+		rc = fail;
+	}
+
+	if (!QUIET_TESTS)
+		cout << "Index-only scan found " << coveringValues.size() << " of " << tableValues.size() << " tuples" << endl;
+
+	delete coveringProject;
+	delete coveringFilter;
+	delete covering;
+	delete tableProject;
+	delete tableFilter;
+	delete table;
+	free(data);
+	return rc;
+}
+
+RC customTest_7()
+{
+	// Functions Tested;
+	// 1. BitmapHeapScan -- a range scan that reads each table page once
+	// 2. Agrees with IndexScan on the same range
+	// 3. A memory limit smaller than the range still returns every tuple
+	cout << "****In Test Case CUSTOM 7****" << endl;
+	RC rc = success;
+
+	const int numTuples = 3000;
+	const int numKeys = 1000;
+
+	vector<Attribute> attrs;
+	Attribute attr;
+	attr.name = "A";
+	attr.type = TypeInt;
+	attr.length = 4;
+	attrs.push_back(attr);
+
+	attr.name = "B";
+	attrs.push_back(attr);
+
+	attr.name = "C";
+	attr.type = TypeReal;
+	attrs.push_back(attr);
+
+	rc = rm->createTable("bitmapped", attrs);
+	if (rc != success) {
+		return rc;
+	}
+
+	rc = rm->createIndex("bitmapped", "B");
+	if (rc != success) {
+		return rc;
+	}
+
+	// Keys are scattered over the table so index order jumps between pages
+	int lowKey = 100;
+	int highKey = 399;
+	vector<PageNum> rangePages;
+	RID rid;
+	void *data = malloc(bufSize);
+	for (int i = 0; i < numTuples; ++i) {
+		int b = (i * 37) % numKeys;
+		float c = i * 0.25f;
+		memcpy((char *)data, &i, sizeof(int));
+		memcpy((char *)data + sizeof(int), &b, sizeof(int));
+		memcpy((char *)data + 2 * sizeof(int), &c, sizeof(float));
+		rc = rm->insertTuple("bitmapped", data, rid);
+		if (rc != success) {
+			free(data);
+			return rc;
+		}
+
+		if (b >= lowKey && b <= highKey)
+			rangePages.push_back(rid.pageNum);
+	}
+	std::sort(rangePages.begin(), rangePages.end());
+	rangePages.erase(std::unique(rangePages.begin(), rangePages.end()), rangePages.end());
+
+	IndexScan *indexScan = new IndexScan(*rm, "bitmapped", "B");
+	indexScan->setIterator(&lowKey, &highKey, true, true);
+	vector<int> indexValues;
+	while (indexScan->getNextTuple(data) != QE_EOF) {
+		indexValues.push_back(*(int *)data);
+	}
+	std::sort(indexValues.begin(), indexValues.end());
+
+	// Once with room for the whole range, once with a limit that splits it into batches
+	unsigned memoryLimits[] = { QE_BITMAP_MEMORY_LIMIT, 64 * sizeof(RID) };
+	for (unsigned l = 0; l < 2 && rc == success; ++l) {
+		BitmapHeapScan *bitmapScan = new BitmapHeapScan(*rm, "bitmapped", "B", NULL, memoryLimits[l]);
+		bitmapScan->setIterator(&lowKey, &highKey, true, true);
+
+		vector<int> bitmapValues;
+		while (bitmapScan->getNextTuple(data) != QE_EOF) {
+			int b = *(int *)((char *)data + sizeof(int));
+			if (b < lowKey || b > highKey) {
+				rc = fail;
+			}
+			bitmapValues.push_back(*(int *)data);
+		}
+		std::sort(bitmapValues.begin(), bitmapValues.end());
+
+		if (bitmapValues.empty() || bitmapValues != indexValues) {
+			rc = fail;
+		}
+
+		// With the whole range in memory every page is read exactly once
+		if (l == 0 && bitmapScan->reader.pagesRead != rangePages.size()) {
+			rc = fail;
+		}
+		if (bitmapScan->reader.pagesRead < rangePages.size() || bitmapScan->reader.pagesRead >= bitmapValues.size()) {
+			rc = fail;
+		}
+
+		if (!QUIET_TESTS)
+			cout << "Bitmap heap scan read " << bitmapScan->reader.pagesRead << " pages for " << bitmapValues.size() << " tuples on " << rangePages.size() << " pages" << endl;
+
+		delete bitmapScan;
+	}
+
+	delete indexScan;
+	free(data);
+	return rc;
+}
+
+RC customTest_8()
+{
+	// Functions Tested;
+	// 1. MultiIndexScan -- AND of range scans on two indexes
+	// 2. MultiIndexScan -- OR of range scans on two indexes
+	// 3. Only the tuples left after combining are read, each once
+	cout << "****In Test Case CUSTOM 8****" << endl;
+	RC rc = success;
+
+	const int numTuples = 3000;
+
+	vector<Attribute> attrs;
+	Attribute attr;
+	attr.name = "A";
+	attr.type = TypeInt;
+	attr.length = 4;
+	attrs.push_back(attr);
+
+	attr.name = "B";
+	attrs.push_back(attr);
+
+	attr.name = "C";
+	attrs.push_back(attr);
+
+	rc = rm->createTable("multi", attrs);
+	if (rc != success) {
+		return rc;
+	}
+
+	rc = rm->createIndex("multi", "B");
+	if (rc != success) {
+		return rc;
+	}
+
+	rc = rm->createIndex("multi", "C");
+	if (rc != success) {
+		return rc;
+	}
+
+	// WHERE B < 200 AND C >= 50 AND C < 90, and the same with OR
+	int lowB = 0;
+	int highB = 200;
+	int lowC = 50;
+	int highC = 90;
+	vector<int> andValues;
+	vector<int> orValues;
+	RID rid;
+	void *data = malloc(bufSize);
+	for (int i = 0; i < numTuples; ++i) {
+		int b = (i * 37) % 1000;
+		int c = (i * 11) % 300;
+		memcpy((char *)data, &i, sizeof(int));
+		memcpy((char *)data + sizeof(int), &b, sizeof(int));
+		memcpy((char *)data + 2 * sizeof(int), &c, sizeof(int));
+		rc = rm->insertTuple("multi", data, rid);
+		if (rc != success) {
+			free(data);
+			return rc;
+		}
+
+		bool inB = b >= lowB && b < highB;
+		bool inC = c >= lowC && c < highC;
+		if (inB && inC)
+			andValues.push_back(i);
+		if (inB || inC)
+			orValues.push_back(i);
+	}
+
+	BitmapOp ops[] = { BITMAP_AND, BITMAP_OR };
+	vector<int>* expected[] = { &andValues, &orValues };
+	for (unsigned o = 0; o < 2 && rc == success; ++o) {
+		MultiIndexScan *scan = new MultiIndexScan(*rm, "multi", ops[o]);
+		if (scan->addRange("B", &lowB, &highB, true, false) != success ||
+			scan->addRange("C", &lowC, &highC, true, false) != success) {
+			rc = fail;
+		}
+
+		vector<int> values;
+		while (rc == success && scan->getNextTuple(data) != QE_EOF) {
+			values.push_back(*(int *)data);
+		}
+		std::sort(values.begin(), values.end());
+
+		if (expected[o]->empty() || values != *expected[o] || scan->reader.pagesRead > values.size()) {
+			rc = fail;
+		}
+
+		if (!QUIET_TESTS)
+			cout << "Multi-index scan found " << values.size() << " tuples reading " << scan->reader.pagesRead << " pages" << endl;
+
+		delete scan;
+	}
+
+	free(data);
+	return rc;
+}
+
 void cleanup()
 {
 	remove("RM_SYS_CATALOG_TABLE.db");
@@ -1619,6 +2211,25 @@ void cleanup()
 	remove("leftvarchar");
 
 	remove("group");
+
+	remove("dictgroup");
+	remove("RM_SYS_DICTIONARY_TABLE.db");
+
+	remove("sampled");
+
+	remove("hashed");
+	remove("hashed.B");
+
+	remove("covered");
+	remove("covered.B");
+	remove("covered.B+C");
+
+	remove("bitmapped");
+	remove("bitmapped.B");
+
+	remove("multi");
+	remove("multi.B");
+	remove("multi.C");
 }
 
 int main() {
@@ -2044,6 +2655,114 @@ int main() {
 		}
 	}
 
+	if (RUN_TEST_X3)
+	{
+		cout << "\n\n---- ";
+		cout << "customTest_3()" << endl;
+
+		g_nTotalGradPoint += 3;
+		g_nTotalUndergradPoint += 3;
+		if (customTest_3() == success) {
+			g_nGradPoint += 3;
+			g_nUndergradPoint += 3;
+			cout << "\ncustomTest_3 SUCCESS\n";
+		}
+		else
+		{
+			cout << "\n!!!FAIL!!! customTest_3\n";
+		}
+	}
+
+	if (RUN_TEST_X4)
+	{
+		cout << "\n\n---- ";
+		cout << "customTest_4()" << endl;
+
+		g_nTotalGradPoint += 3;
+		g_nTotalUndergradPoint += 3;
+		if (customTest_4() == success) {
+			g_nGradPoint += 3;
+			g_nUndergradPoint += 3;
+			cout << "\ncustomTest_4 SUCCESS\n";
+		}
+		else
+		{
+			cout << "\n!!!FAIL!!! customTest_4\n";
+		}
+	}
+
+	if (RUN_TEST_X5)
+	{
+		cout << "\n\n---- ";
+		cout << "customTest_5()" << endl;
+
+		g_nTotalGradPoint += 3;
+		g_nTotalUndergradPoint += 3;
+		if (customTest_5() == success) {
+			g_nGradPoint += 3;
+			g_nUndergradPoint += 3;
+			cout << "\ncustomTest_5 SUCCESS\n";
+		}
+		else
+		{
+			cout << "\n!!!FAIL!!! customTest_5\n";
+		}
+	}
+
+	if (RUN_TEST_X6)
+	{
+		cout << "\n\n---- ";
+		cout << "customTest_6()" << endl;
+
+		g_nTotalGradPoint += 3;
+		g_nTotalUndergradPoint += 3;
+		if (customTest_6() == success) {
+			g_nGradPoint += 3;
+			g_nUndergradPoint += 3;
+			cout << "\ncustomTest_6 SUCCESS\n";
+		}
+		else
+		{
+			cout << "\n!!!FAIL!!! customTest_6\n";
+		}
+	}
+
+	if (RUN_TEST_X7)
+	{
+		cout << "\n\n---- ";
+		cout << "customTest_7()" << endl;
+
+		g_nTotalGradPoint += 3;
+		g_nTotalUndergradPoint += 3;
+		if (customTest_7() == success) {
+			g_nGradPoint += 3;
+			g_nUndergradPoint += 3;
+			cout << "\ncustomTest_7 SUCCESS\n";
+		}
+		else
+		{
+			cout << "\n!!!FAIL!!! customTest_7\n";
+		}
+	}
+
+	if (RUN_TEST_X8)
+	{
+		cout << "\n\n---- ";
+		cout << "customTest_8()" << endl;
+
+		g_nTotalGradPoint += 3;
+		g_nTotalUndergradPoint += 3;
+		if (customTest_8() == success) {
+			g_nGradPoint += 3;
+			g_nUndergradPoint += 3;
+			cout << "\ncustomTest_8 SUCCESS\n";
+		}
+		else
+		{
+			cout << "\n!!!FAIL!!! customTest_8\n";
+		}
+	}
+
 print_point: 
 	cleanup();
 
@@ -2,6 +2,7 @@
 #include "../util/returncodes.h"
 
 #include <sys/stat.h>
+#include <unistd.h>
 #include <assert.h>
 #include <cstring>
 #include <cstdlib>
@@ -159,11 +160,12 @@ FileHandle::~FileHandle()
 RC FileHandle::updatePageCount()
 {
 	assert(_file);
-    if (fseek(_file, 0, SEEK_END) != 0)
+    struct stat fileStat;
+    if (fstat(fileno(_file), &fileStat) != 0)
     {
         return rc::FILE_SEEK_FAILED;
     }
-    _numPages = ftell(_file) / PAGE_SIZE;
+    _numPages = fileStat.st_size / PAGE_SIZE;
     return rc::OK;
 }
 
@@ -187,70 +189,70 @@ RC FileHandle::unloadFile()
     return rc::OK;
 }
 
-RC FileHandle::readPage(PageNum pageNum, void *data)
+// Holds the stdio lock on a file, so appends from several threads sharing the handle each get their own page
+class FileLock
 {
-    RC ret = updatePageCount();
-    RETURN_ON_ERR(ret);
+public:
+    FileLock(FILE* file) : _file(file) { flockfile(_file); }
+    ~FileLock() { funlockfile(_file); }
 
-    if (pageNum < _numPages)
-    {
-        // Read the data from disk into the user buffer
-        int result = fseek(_file, PAGE_SIZE * pageNum, SEEK_SET);
-        if (result != 0)
-        {
-            return rc::FILE_SEEK_FAILED;
-        }
-        size_t read = fread(data, PAGE_SIZE, 1, _file);
-        if (read != 1)
-        {
-            return rc::FILE_CORRUPT;
-        }
+private:
+    FILE* _file;
+};
 
-        return rc::OK;
+// Pages are read and written with pread/pwrite on the descriptor, which never touch the stdio file position
+// or buffer, so threads sharing the handle read and write pages at the same time without taking a lock.
+// A page past the end of the file comes back short
+RC FileHandle::readPage(PageNum pageNum, void *data)
+{
+	assert(_file);
+    ssize_t read = pread(fileno(_file), data, PAGE_SIZE, (off_t)PAGE_SIZE * pageNum);
+    if (read < 0)
+    {
+        return rc::FILE_CORRUPT;
     }
-    else
+    else if (read != PAGE_SIZE)
     {
         return rc::FILE_PAGE_NOT_FOUND;
     }
+
+    return rc::OK;
 }
 
 RC FileHandle::writePage(PageNum pageNum, const void *data)
 {
-    RC ret = updatePageCount();
-    RETURN_ON_ERR(ret);
-
-    if (pageNum < _numPages)
+	assert(_file);
+    struct stat fileStat;
+    if (fstat(fileno(_file), &fileStat) != 0)
     {
-        // Flush the content in the user buffer to disk and update the page entry
-        int result = fseek(_file, PAGE_SIZE * pageNum, SEEK_SET);
-        if (result != 0)
-        {
-            return rc::FILE_SEEK_FAILED;
-        }
-        size_t written = fwrite(data, PAGE_SIZE, 1, _file);
-        if (written != 1)
-        {
-            return rc::FILE_CORRUPT;
-        }
-
-        return rc::OK;
+        return rc::FILE_SEEK_FAILED;
     }
-    else
+
+    // Only pages that already exist can be written, new ones come from appendPage()
+    if (pageNum >= fileStat.st_size / PAGE_SIZE)
     {
         return rc::FILE_PAGE_NOT_FOUND;
     }
+
+    ssize_t written = pwrite(fileno(_file), data, PAGE_SIZE, (off_t)PAGE_SIZE * pageNum);
+    if (written != PAGE_SIZE)
+    {
+        return rc::FILE_CORRUPT;
+    }
+
+    return rc::OK;
 }
 
 
 RC FileHandle::appendPage(const void *data)
 {
-    // Seek to the end of the file (last page) and write the new page data
-    if (fseek(_file, _numPages * PAGE_SIZE, SEEK_SET) != 0)
-    {
-        return rc::FILE_SEEK_FAILED;
-    }
-    size_t written = fwrite(data, PAGE_SIZE, 1, _file);
-    if (written != 1)
+    FileLock lock(_file);
+    RC ret = updatePageCount();
+    RETURN_ON_ERR(ret);
+
+    // Write the new page data just past the last page
+    ssize_t written = pwrite(fileno(_file), data, PAGE_SIZE, (off_t)PAGE_SIZE * _numPages);
+    if (written != PAGE_SIZE)
     {
         return rc::FILE_CORRUPT;
     }
@@ -262,6 +264,8 @@ RC FileHandle::appendPage(const void *data)
 
 unsigned FileHandle::getNumberOfPages()
 {
+    FileLock lock(_file);
+
     // Force update in case someone else modified the file through a different handle
     updatePageCount();
     return _numPages;
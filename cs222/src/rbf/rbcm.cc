@@ -827,7 +827,10 @@ RC RecordBasedCoreManager::readRecord(FileHandle &fileHandle, const vector<Attri
     }
 
     // Find the slot where the record is stored, walking tombstone chain if needed - O(1)
+    // A moved record is read from a copy of its new page, so the caller can keep reading others out of pageBuffer
 	PageIndexSlot* slotIndex = getPageIndexSlot(pageBuffer, rid.slotNum);
+	unsigned char tempBuffer[PAGE_SIZE];
+	void* recordPage = pageBuffer;
 	if (slotIndex->size == 0 && slotIndex->nextPage == 0) // if not a tombstone and empty, it was deleted
 	{
 		return rc::RECORD_DELETED;
@@ -836,20 +839,19 @@ RC RecordBasedCoreManager::readRecord(FileHandle &fileHandle, const vector<Attri
     {
         unsigned nextPage = slotIndex->nextPage;
         unsigned nextSlot = slotIndex->nextSlot;
-        unsigned char tempBuffer[PAGE_SIZE] = {0};
         ret = fileHandle.readPage(nextPage, tempBuffer);
         if (ret != rc::OK)
         {
             return ret;
         }
 
-        memcpy(pageBuffer, tempBuffer, PAGE_SIZE);
-        slotIndex = getPageIndexSlot(pageBuffer, nextSlot);
+        recordPage = tempBuffer;
+        slotIndex = getPageIndexSlot(recordPage, nextSlot);
     }
 
     // Copy the contents of the record into the data block - O(1)
     int fieldOffset = (recordDescriptor.size() * sizeof(unsigned)) + (2 * sizeof(unsigned));
-    memcpy(data, (char*)pageBuffer + slotIndex->pageOffset + fieldOffset, slotIndex->size - fieldOffset);
+    memcpy(data, (char*)recordPage + slotIndex->pageOffset + fieldOffset, slotIndex->size - fieldOffset);
 
     dbg::out << dbg::LOG_EXTREMEDEBUG;
     dbg::out << "RecordBasedCoreManager::readRecord: RID = (" << rid.pageNum << ", " << rid.slotNum << ")\n";;
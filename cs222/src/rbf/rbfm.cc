@@ -1,4 +1,5 @@
 #include "../util/returncodes.h"
+#include "../util/hash.h"
 #include "rbfm.h"
 
 #include <assert.h>
@@ -156,6 +157,17 @@ RC RecordBasedFileManager::scan(FileHandle& fileHandle, const vector<Attribute>
     return rbfm_ScanIterator.init(fileHandle, recordDescriptor, conditionAttributeString, compOp, value, attributeNames);
 }
 
+RC RecordBasedFileManager::scan(FileHandle& fileHandle, const vector<Attribute> &recordDescriptor, const string &conditionAttributeString, const CompOp compOp, const void *value, const vector<string> &attributeNames, const ScanSample &sample, RBFM_ScanIterator &rbfm_ScanIterator)
+{
+	// A sample needs something to scale up from, and the page/record tests only work on fractions of 1 or less
+	if (sample.mode != SampleNone && !(sample.fraction > 0.0f && sample.fraction <= 1.0f))
+	{
+		return rc::SCAN_SAMPLE_FRACTION_INVALID;
+	}
+
+    return rbfm_ScanIterator.init(fileHandle, recordDescriptor, conditionAttributeString, compOp, value, attributeNames, sample);
+}
+
 RBFM_PageIndexFooter* RecordBasedFileManager::getRBFMPageIndexFooter(void* pageBuffer)
 {
 	return (RBFM_PageIndexFooter*)getCorePageIndexFooter(pageBuffer);
@@ -209,6 +221,11 @@ RC RBFM_ScanIterator::findAttributeByName(const vector<Attribute>& recordDescrip
 }
 
 RC RBFM_ScanIterator::init(FileHandle& fileHandle, const vector<Attribute> &recordDescriptor, const string &conditionAttributeString, const CompOp compOp, const void *value, const vector<string> &attributeNames)
+{
+	return init(fileHandle, recordDescriptor, conditionAttributeString, compOp, value, attributeNames, ScanSample());
+}
+
+RC RBFM_ScanIterator::init(FileHandle& fileHandle, const vector<Attribute> &recordDescriptor, const string &conditionAttributeString, const CompOp compOp, const void *value, const vector<string> &attributeNames, const ScanSample& sample)
 {
 	RC ret = rc::OK;
 	
@@ -226,7 +243,9 @@ RC RBFM_ScanIterator::init(FileHandle& fileHandle, const vector<Attribute> &reco
     _fileHandle = &fileHandle;
 	_nextRid.pageNum = 1;
 	_nextRid.slotNum = 0;
+	_endPage = 0;
 	_comparasionOp = compOp;
+	_sample = sample;
 
 	if (compOp != NO_OP)
 	{
@@ -252,6 +271,14 @@ RC RBFM_ScanIterator::init(FileHandle& fileHandle, const vector<Attribute> &reco
 	return rc::OK;
 }
 
+void RBFM_ScanIterator::setPageRange(PageNum firstPage, PageNum endPage)
+{
+	// Page 0 holds no records
+	_nextRid.pageNum = std::max(firstPage, (PageNum)1);
+	_nextRid.slotNum = 0;
+	_endPage = endPage;
+}
+
 void RBFM_ScanIterator::nextRecord(unsigned numSlots)
 {
 	_nextRid.slotNum++;
@@ -262,6 +289,37 @@ void RBFM_ScanIterator::nextRecord(unsigned numSlots)
 	}
 }
 
+void RBFM_ScanIterator::skipUnsampledPages(unsigned numPages)
+{
+	// Pages left out of a block sample are never read
+	while (_nextRid.pageNum < numPages && _nextRid.slotNum == 0 && !_sample.includePage(_nextRid.pageNum))
+	{
+		_nextRid.pageNum++;
+	}
+}
+
+bool ScanSample::includePage(PageNum pageNum) const
+{
+	if (mode != SampleBlock)
+	{
+		return true;
+	}
+
+	unsigned hash = util::jenkins(util::multiplicitive(pageNum) ^ seed);
+	return (hash & 0xFFFFFF) < (unsigned)(fraction * 0x1000000);
+}
+
+bool ScanSample::includeRecord(const RID& rid) const
+{
+	if (mode != SampleBernoulli)
+	{
+		return true;
+	}
+
+	unsigned hash = util::jenkins(util::distinct_xy(util::multiplicitive(rid.pageNum), rid.slotNum) ^ seed);
+	return (hash & 0xFFFFFF) < (unsigned)(fraction * 0x1000000);
+}
+
 bool RBFM_ScanIterator::recordMatchesValue(char* record)
 {
 	if (_comparasionOp == NO_OP)
@@ -280,6 +338,12 @@ bool RBFM_ScanIterator::recordMatchesValue(char* record)
 RC RBFM_ScanIterator::getNextRecord(RID& rid, void* data)
 {
     unsigned numPages = _fileHandle->getNumberOfPages();
+	if (_endPage > 0 && _endPage < numPages)
+	{
+		numPages = _endPage;
+	}
+
+	skipUnsampledPages(numPages);
 
 	// Early exit if our next record is on a non-existant page
 	if (_nextRid.pageNum >= numPages)
@@ -310,6 +374,12 @@ RC RBFM_ScanIterator::getNextRecord(RID& rid, void* data)
 		// If we are looking on a new page, load that buffer into memory
 		if (_nextRid.pageNum != loadedPage)
 		{
+			skipUnsampledPages(numPages);
+			if (_nextRid.pageNum >= numPages)
+			{
+				break;
+			}
+
 			loadedPage = _nextRid.pageNum;
             ret = _fileHandle->readPage(loadedPage, pageBuffer);
 			if (ret != rc::OK)
@@ -327,10 +397,19 @@ RC RBFM_ScanIterator::getNextRecord(RID& rid, void* data)
 			continue;
 		}
 
+		// Records left out of a Bernoulli sample are skipped before we chase any tombstones
+		if (!_sample.includeRecord(_nextRid))
+		{
+			nextRecord(pageFooter->numSlots);
+			continue;
+		}
+
         // Pull up the next record, walking the tombstone chain if necessary
+		// The chain is walked in its own buffer so the rest of the loaded page stays intact
+		char* recordPage = pageBuffer;
+		unsigned char tempPageBuffer[PAGE_SIZE];
         if (slot->nextPage > 0 || slot->nextSlot > 0) // check to see if we moved to a different page
         {
-            unsigned char tempPageBuffer[PAGE_SIZE] = {0};
             while (slot->nextPage > 0 || slot->nextSlot > 0) // walk the forward pointers
             {
                 ret = _fileHandle->readPage(slot->nextPage, tempPageBuffer);
@@ -340,20 +419,21 @@ RC RBFM_ScanIterator::getNextRecord(RID& rid, void* data)
 				}
 
                 slot = RecordBasedCoreManager::getPageIndexSlot(tempPageBuffer, slot->nextSlot, sizeof(RBFM_PageIndexFooter));
-                memcpy(pageBuffer, tempPageBuffer, PAGE_SIZE);
             }
+
+			recordPage = (char*)tempPageBuffer;
         }
 
 		// Compare record with user's data, skip if it doesn't match
-		if (!recordMatchesValue(pageBuffer + slot->pageOffset))
+		if (!recordMatchesValue(recordPage + slot->pageOffset))
 		{
 			nextRecord(pageFooter->numSlots);
 			continue;
 		}
 
 		// Copy over the record to the user's buffer
-        unsigned* numAttributes = (unsigned*)(pageBuffer + slot->pageOffset);
-		copyRecord((char*)data, pageBuffer + slot->pageOffset, *numAttributes);
+        unsigned* numAttributes = (unsigned*)(recordPage + slot->pageOffset);
+		copyRecord((char*)data, recordPage + slot->pageOffset, *numAttributes);
 
         // Return the RID for the record we just copied out
         rid = _nextRid;
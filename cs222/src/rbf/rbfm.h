@@ -10,6 +10,28 @@ struct RBFM_PageIndexFooter : public CorePageIndexFooter
 
 # define RBFM_EOF (-1)  // end of a scan operator
 
+// Sampling modes for scans that only need an estimate
+typedef enum { SampleNone = 0,      // read every record
+               SampleBlock,         // keep each page with probability 'fraction', the rest are never read
+               SampleBernoulli      // keep each record with probability 'fraction', every page is still read
+} SampleMode;
+
+// Which pages/records a sampled scan visits is decided by hashing their location with the seed,
+// so the same seed always produces the same sample of an unchanged file
+struct ScanSample
+{
+	ScanSample() : mode(SampleNone), fraction(1.0f), seed(0) {}
+	ScanSample(SampleMode mode, float fraction, unsigned seed) : mode(mode), fraction(fraction), seed(seed) {}
+
+	bool includePage(PageNum pageNum) const;
+	bool includeRecord(const RID& rid) const;
+	float sampledFraction() const { return mode == SampleNone ? 1.0f : fraction; }
+
+	SampleMode mode;
+	float fraction;
+	unsigned seed;
+};
+
 // RBFM_ScanIterator is an iteratr to go through records
 class RBFM_ScanIterator {
 public:
@@ -21,6 +43,11 @@ public:
 	RC close();
 	
     RC init(FileHandle& fileHandle, const vector<Attribute> &recordDescriptor, const string &conditionAttributeString, const CompOp compOp, const void *value, const vector<string> &attributeNames);
+    RC init(FileHandle& fileHandle, const vector<Attribute> &recordDescriptor, const string &conditionAttributeString, const CompOp compOp, const void *value, const vector<string> &attributeNames, const ScanSample& sample);
+
+	// Only visit pages [firstPage, endPage), so a table can be split between several scans. An endPage of 0
+	// goes on to the end of the file
+	void setPageRange(PageNum firstPage, PageNum endPage);
 
 	static RC findAttributeByName(const vector<Attribute>& recordDescriptor, const string& conditionAttribute, unsigned& index);
 
@@ -31,11 +58,13 @@ public:
 
 private:
 	void nextRecord(unsigned numSlots);
+	void skipUnsampledPages(unsigned numPages);
 	void copyRecord(char* data, const char* record, unsigned numAttributes);
 	bool recordMatchesValue(char* record);
 
   FileHandle* _fileHandle;
 	RID _nextRid;
+	PageNum _endPage;
 
 	CompOp _comparasionOp;
 	void* _comparasionValue;
@@ -43,6 +72,8 @@ private:
 	unsigned _conditionAttributeIndex;
 	std::vector<unsigned> _returnAttributeIndices;
 	std::vector<AttrType> _returnAttributeTypes;
+
+	ScanSample _sample;
 };
 
 
@@ -73,6 +104,16 @@ public:
 		const vector<string> &attributeNames, // a list of projected attributes
 		RBFM_ScanIterator &rbfm_ScanIterator);
 
+	// Same as above, but only visits the pages/records picked by the sample
+	RC scan(FileHandle& fileHandle,
+		const vector<Attribute> &recordDescriptor,
+		const string &conditionAttribute,
+		const CompOp compOp,
+		const void *value,
+		const vector<string> &attributeNames,
+		const ScanSample &sample,
+		RBFM_ScanIterator &rbfm_ScanIterator);
+
 public:
 	virtual RC reorganizeFile(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor);
 
@@ -2,12 +2,22 @@
 #include "../util/returncodes.h"
 #include "../rbf/rbfm.h"
 #include <algorithm>
+#include <thread>
+#include <atomic>
 
 using namespace std;
 
 void Tests_1();
 void Tests_2();
 void Tests_Custom();
+void testDictionaryEncoding();
+void testSampledScan();
+void testHashIndex();
+void testCompositeIndex();
+void testParallelIndexBuild();
+void testOnlineIndexBuild();
+void testLsmIndex();
+void testArtIndex();
 
 struct RecData
 {
@@ -365,6 +375,8 @@ void cleanup()
 {
 	remove("RM_SYS_ATTRIBUTE_TABLE.db");
 	remove("RM_SYS_CATALOG_TABLE.db");
+	remove("RM_SYS_INDEX_TABLE.db");
+	remove("RM_SYS_DICTIONARY_TABLE.db");
 	remove("tbl_employee");
 	remove("tbl_employee1");
 	remove("tbl_employee2");
@@ -379,6 +391,13 @@ void cleanup()
 	remove("sortingTest4");
 	remove("sortingTest5");
 	remove("sortingTest6");
+	remove("tbl_dictionary");
+	remove("tbl_sampled");
+	remove("tbl_hashindex");
+	remove("tbl_hashindex.Age");
+	remove("tbl_compositeindex");
+	remove("tbl_compositeindex.Age");
+	remove("tbl_compositeindex.Age,Height");
 }
 
 int main()
@@ -443,6 +462,264 @@ void Tests_Custom()
     doScanTest(tupleDescriptor, "sortingTest4", 1000, 0.75f);
     doScanTest(tupleDescriptor, "sortingTest5", 250, 0.02f);
     doScanTest(tupleDescriptor, "sortingTest6", 123, 0.99f);
+
+    testDictionaryEncoding();
+    testSampledScan();
+    testHashIndex();
+    testCompositeIndex();
+    testParallelIndexBuild();
+    testOnlineIndexBuild();
+    testLsmIndex();
+    testArtIndex();
+}
+
+void testDictionaryEncoding()
+{
+    // Functions Tested
+    // 1. Create Dictionary on a populated table **
+    // 2. Insert/Read/Update Tuple and Read Attribute through the dictionary **
+    // 3. Scan with equality and range conditions on the encoded column **
+    cout << "****In Dictionary Encoding Test****" << endl;
+
+    const std::string tableName = "tbl_dictionary";
+    const std::string names[] = { "Sales", "Engineering", "Marketing" };
+    const int numTuples = 300;
+
+    createTable(tableName);
+
+    RC rc = success;
+    int tupleSize = 0;
+    char tuple[100];
+    char returnedData[100];
+    vector<RID> rids;
+
+    // Insert half of the tuples before the column is encoded, and half after
+    for (int i = 0; i < numTuples; ++i)
+    {
+        if (i == numTuples / 2)
+        {
+            rc = rm->createDictionary(tableName, "EmpName");
+            assert(rc == success);
+
+            assert(rm->createDictionary(tableName, "EmpName") == rc::DICTIONARY_ALREADY_CREATED);
+            assert(rm->createDictionary(tableName, "Age") == rc::ATTRIBUTE_INVALID_TYPE);
+        }
+
+        RID rid;
+        const std::string& name = names[i % 3];
+        prepareTuple(name.size(), name, i, 1.5f * i, i * 10, tuple, &tupleSize);
+        rc = rm->insertTuple(tableName, tuple, rid);
+        assert(rc == success);
+        rids.push_back(rid);
+    }
+
+    // Every tuple should read back exactly as it was inserted
+    for (int i = 0; i < numTuples; ++i)
+    {
+        const std::string& name = names[i % 3];
+        prepareTuple(name.size(), name, i, 1.5f * i, i * 10, tuple, &tupleSize);
+
+        memset(returnedData, 0, sizeof(returnedData));
+        rc = rm->readTuple(tableName, rids[i], returnedData);
+        assert(rc == success);
+        assert(memcmp(tuple, returnedData, tupleSize) == 0);
+    }
+
+    memset(returnedData, 0, sizeof(returnedData));
+    rc = rm->readAttribute(tableName, rids[4], "EmpName", returnedData);
+    assert(rc == success);
+    assert(*(int*)returnedData == (int)names[1].size());
+    assert(memcmp(returnedData + sizeof(int), names[1].c_str(), names[1].size()) == 0);
+
+    // Only the distinct values are kept
+    ColumnDictionary dictionary;
+    rc = rm->getDictionary(tableName, "EmpName", dictionary);
+    assert(rc == success);
+    assert(dictionary.values.size() == 3);
+
+    // Equality is decided on the codes
+    char value[100];
+    int valueLength = names[1].size();
+    memcpy(value, &valueLength, sizeof(int));
+    memcpy(value + sizeof(int), names[1].c_str(), valueLength);
+
+    vector<string> attributeNames;
+    attributeNames.push_back("EmpName");
+    attributeNames.push_back("Age");
+
+    RID rid;
+    int count = 0;
+    RM_ScanIterator scanner;
+    rc = rm->scan(tableName, "EmpName", EQ_OP, value, attributeNames, scanner);
+    assert(rc == success);
+    while (scanner.getNextTuple(rid, returnedData) != RM_EOF)
+    {
+        assert(memcmp(returnedData, value, sizeof(int) + valueLength) == 0);
+        assert(*(int*)(returnedData + sizeof(int) + valueLength) % 3 == 1);
+        ++count;
+    }
+    scanner.close();
+    assert(count == numTuples / 3);
+
+    // Ranges are decided on the decoded values, "Engineering" is the only name below "Marketing"
+    valueLength = names[2].size();
+    memcpy(value, &valueLength, sizeof(int));
+    memcpy(value + sizeof(int), names[2].c_str(), valueLength);
+
+    count = 0;
+    rc = rm->scan(tableName, "EmpName", LT_OP, value, attributeNames, scanner);
+    assert(rc == success);
+    while (scanner.getNextTuple(rid, returnedData) != RM_EOF)
+    {
+        assert(*(int*)returnedData == (int)names[1].size());
+        ++count;
+    }
+    scanner.close();
+    assert(count == numTuples / 3);
+
+    // A value we have never seen matches nothing
+    const std::string unknown = "Legal";
+    valueLength = unknown.size();
+    memcpy(value, &valueLength, sizeof(int));
+    memcpy(value + sizeof(int), unknown.c_str(), valueLength);
+
+    count = 0;
+    rc = rm->scan(tableName, "EmpName", EQ_OP, value, attributeNames, scanner);
+    assert(rc == success);
+    while (scanner.getNextTuple(rid, returnedData) != RM_EOF)
+    {
+        ++count;
+    }
+    scanner.close();
+    assert(count == 0);
+
+    // Updating to a new value grows the dictionary
+    prepareTuple(unknown.size(), unknown, 7, 7.0f, 70, tuple, &tupleSize);
+    rc = rm->updateTuple(tableName, tuple, rids[7]);
+    assert(rc == success);
+
+    memset(returnedData, 0, sizeof(returnedData));
+    rc = rm->readTuple(tableName, rids[7], returnedData);
+    assert(rc == success);
+    assert(memcmp(tuple, returnedData, tupleSize) == 0);
+
+    rc = rm->getDictionary(tableName, "EmpName", dictionary);
+    assert(rc == success);
+    assert(dictionary.values.size() == 4);
+
+    rc = rm->deleteTable(tableName);
+    assert(rc == success);
+
+    cout << "****Dictionary Encoding Test passed****" << endl << endl;
+}
+
+void testSampledScan()
+{
+    // Functions Tested
+    // 1. Scan with block and Bernoulli samples **
+    // 2. Collect Statistics from a sample **
+    // 3. Sample fractions outside (0, 1] are refused **
+    cout << "****In Sampled Scan Test****" << endl;
+
+    const std::string tableName = "tbl_sampled";
+    const std::string name = "Sampled";
+    const int numTuples = 2000;
+
+    createTable(tableName);
+
+    RC rc = success;
+    int tupleSize = 0;
+    char tuple[100];
+    char returnedData[100];
+
+    for (int i = 0; i < numTuples; ++i)
+    {
+        RID rid;
+        prepareTuple(name.size(), name, i, 1.5f * i, i * 10, tuple, &tupleSize);
+        rc = rm->insertTuple(tableName, tuple, rid);
+        assert(rc == success);
+    }
+
+    vector<string> attributeNames;
+    attributeNames.push_back("Age");
+
+    // A full sample is the same as a plain scan
+    RID rid;
+    int count = 0;
+    RM_ScanIterator scanner;
+    rc = rm->scan(tableName, "", NO_OP, NULL, attributeNames, ScanSample(SampleBlock, 1.0f, 3), scanner);
+    assert(rc == success);
+    while (scanner.getNextTuple(rid, returnedData) != RM_EOF)
+    {
+        ++count;
+    }
+    scanner.close();
+    assert(count == numTuples);
+
+    // Half of the pages, and the same seed picks the same pages every time
+    vector<RID> firstRids, secondRids;
+    rc = rm->scan(tableName, "", NO_OP, NULL, attributeNames, ScanSample(SampleBlock, 0.5f, 3), scanner);
+    assert(rc == success);
+    while (scanner.getNextTuple(rid, returnedData) != RM_EOF)
+    {
+        firstRids.push_back(rid);
+    }
+    scanner.close();
+
+    rc = rm->scan(tableName, "", NO_OP, NULL, attributeNames, ScanSample(SampleBlock, 0.5f, 3), scanner);
+    assert(rc == success);
+    while (scanner.getNextTuple(rid, returnedData) != RM_EOF)
+    {
+        secondRids.push_back(rid);
+    }
+    scanner.close();
+
+    assert(firstRids.size() > 0 && firstRids.size() < (unsigned)numTuples);
+    assert(firstRids.size() == secondRids.size());
+    for (unsigned i = 0; i < firstRids.size(); ++i)
+    {
+        assert(firstRids[i].pageNum == secondRids[i].pageNum && firstRids[i].slotNum == secondRids[i].slotNum);
+    }
+
+    // Conditions still apply to the sampled tuples
+    int ageLimit = 100;
+    count = 0;
+    rc = rm->scan(tableName, "Age", LT_OP, &ageLimit, attributeNames, ScanSample(SampleBernoulli, 0.5f, 5), scanner);
+    assert(rc == success);
+    while (scanner.getNextTuple(rid, returnedData) != RM_EOF)
+    {
+        assert(*(int*)returnedData < ageLimit);
+        ++count;
+    }
+    scanner.close();
+    assert(count < ageLimit);
+
+    // The estimates should be in the right neighbourhood of the real table
+    TableStatistics stats;
+    rc = rm->collectStatistics(tableName, ScanSample(SampleBernoulli, 0.25f, 9), stats);
+    assert(rc == success);
+    assert(stats.numTuples > numTuples * 0.75f && stats.numTuples < numTuples * 1.25f);
+    assert(stats.averageTupleSize > 0 && stats.averageTupleSize < 100);
+    assert(stats.numPages > 0);
+
+    // Fractions with nothing to scale up from, or past a full sample, are refused for both modes
+    const float badFractions[] = { 0.0f, -0.5f, 1.5f };
+    for (unsigned i = 0; i < sizeof(badFractions) / sizeof(badFractions[0]); ++i)
+    {
+        rc = rm->scan(tableName, "", NO_OP, NULL, attributeNames, ScanSample(SampleBlock, badFractions[i], 3), scanner);
+        assert(rc == rc::SCAN_SAMPLE_FRACTION_INVALID);
+
+        rc = rm->scan(tableName, "", NO_OP, NULL, attributeNames, ScanSample(SampleBernoulli, badFractions[i], 3), scanner);
+        assert(rc == rc::SCAN_SAMPLE_FRACTION_INVALID);
+
+        rc = rm->collectStatistics(tableName, ScanSample(SampleBernoulli, badFractions[i], 9), stats);
+        assert(rc == rc::SCAN_SAMPLE_FRACTION_INVALID);
+    }
+
+    rc = rm->deleteTable(tableName);
+    assert(rc == success);
+
+    cout << "****Sampled Scan Test passed****" << endl << endl;
 }
 
 // tests from rmtest_1
@@ -1340,3 +1617,732 @@ void Tests_2()
     memProfile();
     return;
 }
+
+// Count the tuples a hash index lookup on Age finds, checking each one has that age
+static int countHashIndexLookup(const std::string& tableName, int age)
+{
+    RM_IndexScanIterator iter;
+    RC rc = rm->indexScan(tableName, "Age", &age, &age, true, true, iter);
+    assert(rc == success);
+
+    RID rid;
+    int key = 0;
+    int count = 0;
+    while (iter.getNextEntry(rid, &key) != RM_EOF)
+    {
+        assert(key == age);
+
+        int returnedAge = 0;
+        rc = rm->readAttribute(tableName, rid, "Age", &returnedAge);
+        assert(rc == success);
+        assert(returnedAge == age);
+        ++count;
+    }
+    iter.close();
+
+    return count;
+}
+
+void testHashIndex()
+{
+    // Functions Tested
+    // 1. Create a hash index on a populated table **
+    // 2. Insert/Update/Delete Tuple(s) keep the hash index up to date **
+    // 3. Index Scan for a single key, ranges are refused **
+    cout << "****In Hash Index Test****" << endl;
+
+    const std::string tableName = "tbl_hashindex";
+    const int numTuples = 1000;
+    const int numAges = 50;
+
+    createTable(tableName);
+
+    RC rc = success;
+    int tupleSize = 0;
+    char tuple[100];
+    vector<RID> rids;
+
+    // Half of the tuples are loaded into the index when it is created, the rest are inserted through it
+    for (int i = 0; i < numTuples; ++i)
+    {
+        if (i == numTuples / 2)
+        {
+            rc = rm->createIndex(tableName, "Age", IndexTypeHash);
+            assert(rc == success);
+        }
+
+        RID rid;
+        prepareTuple(4, "Name", i % numAges, 1.5f * i, i * 10, tuple, &tupleSize);
+        rc = rm->insertTuple(tableName, tuple, rid);
+        assert(rc == success);
+        rids.push_back(rid);
+    }
+
+    for (int age = 0; age < numAges; ++age)
+    {
+        assert(countHashIndexLookup(tableName, age) == numTuples / numAges);
+    }
+    assert(countHashIndexLookup(tableName, numAges) == 0);
+
+    // Only single keys can be looked up
+    int lowAge = 0;
+    int highAge = 10;
+    RM_IndexScanIterator iter;
+    assert(rm->indexScan(tableName, "Age", &lowAge, &highAge, true, true, iter) == rc::HASH_INDEX_RANGE_SCAN);
+    assert(rm->indexScan(tableName, "Age", NULL, NULL, true, true, iter) == rc::HASH_INDEX_RANGE_SCAN);
+
+    // Move every tuple of age 0 to age numAges, and delete every tuple of age 1
+    for (int i = 0; i < numTuples; i += numAges)
+    {
+        prepareTuple(4, "Name", numAges, 1.5f * i, i * 10, tuple, &tupleSize);
+        rc = rm->updateTuple(tableName, tuple, rids[i]);
+        assert(rc == success);
+
+        rc = rm->deleteTuple(tableName, rids[i + 1]);
+        assert(rc == success);
+    }
+
+    assert(countHashIndexLookup(tableName, 0) == 0);
+    assert(countHashIndexLookup(tableName, 1) == 0);
+    assert(countHashIndexLookup(tableName, 2) == numTuples / numAges);
+    assert(countHashIndexLookup(tableName, numAges) == numTuples / numAges);
+
+    rc = rm->deleteTuples(tableName);
+    assert(rc == success);
+    assert(countHashIndexLookup(tableName, 2) == 0);
+
+    rc = rm->deleteTable(tableName);
+    assert(rc == success);
+
+    cout << "****Hash Index Test passed****" << endl << endl;
+}
+
+// Count the tuples a composite (Age, Height) index scan finds, checking they come back ordered by age then height
+static int countCompositeIndexScan(const std::string& tableName, const void* lowKey, unsigned lowKeyValues, const void* highKey, unsigned highKeyValues, bool lowKeyInclusive, bool highKeyInclusive)
+{
+    vector<string> attributeNames;
+    attributeNames.push_back("Age");
+    attributeNames.push_back("Height");
+
+    RM_IndexScanIterator iter;
+    RC rc = rm->indexScan(tableName, attributeNames, lowKey, lowKeyValues, highKey, highKeyValues, lowKeyInclusive, highKeyInclusive, iter);
+    assert(rc == success);
+
+    RID rid;
+    char key[2 * sizeof(int)];
+    int lastAge = 0;
+    float lastHeight = 0;
+    int count = 0;
+    while (iter.getNextEntry(rid, key) != RM_EOF)
+    {
+        int age = 0;
+        float height = 0;
+        memcpy(&age, key, sizeof(int));
+        memcpy(&height, key + sizeof(int), sizeof(float));
+        assert(count == 0 || lastAge < age || (lastAge == age && lastHeight < height));
+
+        int returnedAge = 0;
+        rc = rm->readAttribute(tableName, rid, "Age", &returnedAge);
+        assert(rc == success);
+        assert(returnedAge == age);
+
+        lastAge = age;
+        lastHeight = height;
+        ++count;
+    }
+    iter.close();
+
+    return count;
+}
+
+void testCompositeIndex()
+{
+    // Functions Tested
+    // 1. Create a composite (Age, Height) index on a populated table **
+    // 2. Insert/Update/Delete Tuple(s) keep the composite index up to date **
+    // 3. Index Scan on a full key and on an Age prefix **
+    // 4. Destroy the composite index, leaving an index on Age alone **
+    cout << "****In Composite Index Test****" << endl;
+
+    const std::string tableName = "tbl_compositeindex";
+    const int numTuples = 1000;
+    const int numAges = 20;
+
+    createTable(tableName);
+
+    vector<string> attributeNames;
+    attributeNames.push_back("Age");
+    attributeNames.push_back("Height");
+
+    RC rc = success;
+    int tupleSize = 0;
+    char tuple[100];
+    vector<RID> rids;
+
+    // Heights run negative to positive within every age
+    for (int i = 0; i < numTuples; ++i)
+    {
+        if (i == numTuples / 2)
+        {
+            rc = rm->createIndex(tableName, attributeNames);
+            assert(rc == success);
+
+            rc = rm->createIndex(tableName, "Age");
+            assert(rc == success);
+        }
+
+        RID rid;
+        prepareTuple(4, "Name", i % numAges, 1.5f * (i - numTuples / 2), i * 10, tuple, &tupleSize);
+        rc = rm->insertTuple(tableName, tuple, rid);
+        assert(rc == success);
+        rids.push_back(rid);
+    }
+
+    assert(rm->createIndex(tableName, attributeNames, IndexTypeHash) == rc::FEATURE_NOT_YET_IMPLEMENTED);
+
+    // Every tuple in order, then all tuples of one age, then a height range within that age
+    const int perAge = numTuples / numAges;
+    char lowKey[2 * sizeof(int)];
+    char highKey[2 * sizeof(int)];
+    int age = 7;
+    memcpy(lowKey, &age, sizeof(int));
+    assert(countCompositeIndexScan(tableName, NULL, 0, NULL, 0, true, true) == numTuples);
+    assert(countCompositeIndexScan(tableName, lowKey, 1, lowKey, 1, true, true) == perAge);
+    assert(countCompositeIndexScan(tableName, lowKey, 1, NULL, 0, false, true) == (numAges - age - 1) * perAge);
+
+    // Heights of age 7 are 1.5 * (7 + 20k - 500), so [-1.5 * 493, 1.5 * 7] holds k = 0 up to 25
+    float lowHeight = 1.5f * (age - numTuples / 2);
+    float highHeight = 1.5f * age;
+    memcpy(lowKey + sizeof(int), &lowHeight, sizeof(float));
+    memcpy(highKey, &age, sizeof(int));
+    memcpy(highKey + sizeof(int), &highHeight, sizeof(float));
+    assert(countCompositeIndexScan(tableName, lowKey, 2, highKey, 2, true, true) == 26);
+    assert(countCompositeIndexScan(tableName, lowKey, 2, highKey, 2, false, false) == 24);
+
+    // Move every tuple of age 0 to age numAges, and delete every tuple of age 1
+    for (int i = 0; i < numTuples; i += numAges)
+    {
+        prepareTuple(4, "Name", numAges, 1.5f * (i - numTuples / 2), i * 10, tuple, &tupleSize);
+        rc = rm->updateTuple(tableName, tuple, rids[i]);
+        assert(rc == success);
+
+        rc = rm->deleteTuple(tableName, rids[i + 1]);
+        assert(rc == success);
+    }
+
+    for (age = 0; age <= numAges; ++age)
+    {
+        memcpy(lowKey, &age, sizeof(int));
+        assert(countCompositeIndexScan(tableName, lowKey, 1, lowKey, 1, true, true) == (age < 2 ? 0 : perAge));
+    }
+
+    // Dropping the composite index keeps the one on Age
+    rc = rm->destroyIndex(tableName, attributeNames);
+    assert(rc == success);
+
+    RM_IndexScanIterator iter;
+    assert(rm->indexScan(tableName, attributeNames, NULL, 0, NULL, 0, true, true, iter) == rc::INDEX_NOT_FOUND);
+
+    age = 2;
+    rc = rm->indexScan(tableName, "Age", &age, &age, true, true, iter);
+    assert(rc == success);
+
+    RID rid;
+    int key = 0;
+    int count = 0;
+    while (iter.getNextEntry(rid, &key) != RM_EOF)
+    {
+        ++count;
+    }
+    iter.close();
+    assert(count == perAge);
+
+    rc = rm->deleteTable(tableName);
+    assert(rc == success);
+
+    cout << "****Composite Index Test passed****" << endl << endl;
+}
+
+// Every (Age, RID) the index on Age hands back, checking they come back in key order
+static void collectAgeIndex(const std::string& tableName, vector<pair<int, RID> >& entries)
+{
+    entries.clear();
+
+    RM_IndexScanIterator iter;
+    RC rc = rm->indexScan(tableName, "Age", NULL, NULL, true, true, iter);
+    assert(rc == success);
+
+    RID rid;
+    int key = 0;
+    while (iter.getNextEntry(rid, &key) != RM_EOF)
+    {
+        assert(entries.empty() || entries.back().first <= key);
+        entries.push_back(make_pair(key, rid));
+    }
+    iter.close();
+}
+
+void testParallelIndexBuild()
+{
+    // Functions Tested
+    // 1. Create indexes with the table scan and sort split between threads, spilling runs to disk **
+    // 2. Rebuild every index of the table after a load, with one thread and no spills **
+    cout << "****In Parallel Index Build Test****" << endl;
+
+    const std::string tableName = "tbl_parallelindex";
+    const int numTuples = 20000;
+    const int numAges = 5000;
+
+    createTable(tableName);
+
+    RC rc = success;
+    int tupleSize = 0;
+    char tuple[100];
+    for (int i = 0; i < numTuples; ++i)
+    {
+        RID rid;
+        prepareTuple(4, "Name", (i * 7919) % numAges, 1.5f * i, i, tuple, &tupleSize);
+        rc = rm->insertTuple(tableName, tuple, rid);
+        assert(rc == success);
+    }
+
+    // A small budget split four ways has every thread spill several runs
+    rm->setIndexBuildResources(4, 64 * 1024);
+    rc = rm->createIndex(tableName, "Age");
+    assert(rc == success);
+
+    vector<string> attributeNames;
+    attributeNames.push_back("Age");
+    attributeNames.push_back("Height");
+    rc = rm->createIndex(tableName, attributeNames);
+    assert(rc == success);
+
+    vector<pair<int, RID> > parallelEntries;
+    collectAgeIndex(tableName, parallelEntries);
+    assert((int)parallelEntries.size() == numTuples);
+    for (unsigned i = 0; i < parallelEntries.size(); i += 97)
+    {
+        int age = 0;
+        rc = rm->readAttribute(tableName, parallelEntries[i].second, "Age", &age);
+        assert(rc == success);
+        assert(age == parallelEntries[i].first);
+    }
+
+    // Tuples loaded since go in one at a time, the rebuild packs them in with the rest
+    for (int i = numTuples; i < numTuples + numTuples / 4; ++i)
+    {
+        RID rid;
+        prepareTuple(4, "Name", (i * 7919) % numAges, 1.5f * i, i, tuple, &tupleSize);
+        rc = rm->insertTuple(tableName, tuple, rid);
+        assert(rc == success);
+    }
+
+    vector<pair<int, RID> > loadedEntries;
+    collectAgeIndex(tableName, loadedEntries);
+
+    rm->setIndexBuildResources(1, IX_BULK_LOAD_MEMORY);
+    rc = rm->rebuildIndexes(tableName);
+    assert(rc == success);
+
+    vector<pair<int, RID> > rebuiltEntries;
+    collectAgeIndex(tableName, rebuiltEntries);
+    assert(rebuiltEntries.size() == loadedEntries.size());
+    assert((int)rebuiltEntries.size() == numTuples + numTuples / 4);
+    for (unsigned i = 0; i < rebuiltEntries.size(); ++i)
+    {
+        assert(rebuiltEntries[i].first == loadedEntries[i].first);
+    }
+
+    int lowAge = 0;
+    int count = 0;
+    RM_IndexScanIterator iter;
+    rc = rm->indexScan(tableName, attributeNames, &lowAge, 1, &lowAge, 1, true, true, iter);
+    assert(rc == success);
+
+    RID rid;
+    char key[PAGE_SIZE];
+    while (iter.getNextEntry(rid, key) != RM_EOF)
+    {
+        ++count;
+    }
+    iter.close();
+    assert(count == (numTuples + numTuples / 4) / numAges);
+
+    rm->setIndexBuildResources(std::thread::hardware_concurrency(), IX_BULK_LOAD_MEMORY);
+    rc = rm->deleteTable(tableName);
+    assert(rc == success);
+
+    cout << "****Parallel Index Build Test passed****" << endl << endl;
+}
+
+static bool ridEntryLess(const pair<int, RID>& lhs, const pair<int, RID>& rhs)
+{
+    if (lhs.second.pageNum != rhs.second.pageNum)
+        return lhs.second.pageNum < rhs.second.pageNum;
+
+    return lhs.second.slotNum < rhs.second.slotNum;
+}
+
+// Insert, update and delete tuples until told to stop, then a few more once the index is live
+static void onlineIndexWriter(const std::string* tableName, vector<RID>* rids, int numAges, const std::atomic<bool>* stop)
+{
+    int tupleSize = 0;
+    char tuple[100];
+    unsigned seed = 12345;
+    int extraOps = 300;
+    for (int i = 0; extraOps > 0; ++i)
+    {
+        if (stop->load())
+            --extraOps;
+
+        seed = seed * 1103515245 + 12345;
+        const unsigned victim = (seed >> 8) % rids->size();
+        RC rc = success;
+        prepareTuple(4, "Name", (i * 31) % numAges, 1.5f * i, i, tuple, &tupleSize);
+        if (i % 3 == 0)
+        {
+            RID rid;
+            rc = rm->insertTuple(*tableName, tuple, rid);
+            rids->push_back(rid);
+        }
+        else if (i % 3 == 1)
+        {
+            rc = rm->updateTuple(*tableName, tuple, (*rids)[victim]);
+        }
+        else
+        {
+            rc = rm->deleteTuple(*tableName, (*rids)[victim]);
+            (*rids)[victim] = rids->back();
+            rids->pop_back();
+        }
+        assert(rc == success);
+
+        // Leave the builder a gap to take the table latch
+        std::this_thread::yield();
+    }
+}
+
+void testOnlineIndexBuild()
+{
+    // Functions Tested
+    // 1. Create an index online while another thread inserts, updates and deletes tuples **
+    // 2. The published index holds exactly the tuples of the table **
+    cout << "****In Online Index Build Test****" << endl;
+
+    const std::string tableName = "tbl_onlineindex";
+    const int numTuples = 20000;
+    const int numAges = 1000;
+
+    createTable(tableName);
+
+    RC rc = success;
+    int tupleSize = 0;
+    char tuple[100];
+    vector<RID> rids;
+    for (int i = 0; i < numTuples; ++i)
+    {
+        RID rid;
+        prepareTuple(4, "Name", i % numAges, 1.5f * i, i, tuple, &tupleSize);
+        rc = rm->insertTuple(tableName, tuple, rid);
+        assert(rc == success);
+        rids.push_back(rid);
+    }
+
+    std::atomic<bool> stop(false);
+    std::thread writer(onlineIndexWriter, &tableName, &rids, numAges, &stop);
+    rc = rm->createIndexOnline(tableName, vector<string>(1, "Age"));
+    stop.store(true);
+    writer.join();
+    assert(rc == success);
+
+    // Every live tuple is in the index under its current age, and nothing else is
+    vector<pair<int, RID> > indexEntries;
+    collectAgeIndex(tableName, indexEntries);
+    assert(indexEntries.size() == rids.size());
+
+    vector<pair<int, RID> > tableEntries;
+    for (unsigned i = 0; i < rids.size(); ++i)
+    {
+        int age = 0;
+        rc = rm->readAttribute(tableName, rids[i], "Age", &age);
+        assert(rc == success);
+        tableEntries.push_back(make_pair(age, rids[i]));
+    }
+
+    std::sort(indexEntries.begin(), indexEntries.end(), ridEntryLess);
+    std::sort(tableEntries.begin(), tableEntries.end(), ridEntryLess);
+    for (unsigned i = 0; i < tableEntries.size(); ++i)
+    {
+        assert(indexEntries[i].first == tableEntries[i].first);
+        assert(indexEntries[i].second.pageNum == tableEntries[i].second.pageNum);
+        assert(indexEntries[i].second.slotNum == tableEntries[i].second.slotNum);
+    }
+
+    rc = rm->deleteTable(tableName);
+    assert(rc == success);
+
+    cout << "****Online Index Build Test passed****" << endl << endl;
+}
+
+static bool ageEntryLess(const pair<int, RID>& lhs, const pair<int, RID>& rhs)
+{
+    if (lhs.first != rhs.first)
+        return lhs.first < rhs.first;
+
+    return ridEntryLess(lhs, rhs);
+}
+
+// Every (Age, RID) in the table, in the order an index on Age returns them
+static void collectAgeTuples(const std::string& tableName, vector<pair<int, RID> >& entries)
+{
+    entries.clear();
+
+    vector<string> attributeNames(1, "Age");
+    RM_ScanIterator scanner;
+    RC rc = rm->scan(tableName, "", NO_OP, NULL, attributeNames, scanner);
+    assert(rc == success);
+
+    RID rid;
+    int age = 0;
+    while (scanner.getNextTuple(rid, &age) != RM_EOF)
+    {
+        entries.push_back(make_pair(age, rid));
+    }
+    scanner.close();
+
+    std::sort(entries.begin(), entries.end(), ageEntryLess);
+}
+
+void testLsmIndex()
+{
+    // Functions Tested
+    // 1. Create an LSM index on a populated table, loaded as one run **
+    // 2. Insert/Update/Delete Tuple(s) go through the memtable, flushing and compacting runs **
+    // 3. Index Scan for ranges and single keys, composite LSM indexes are refused **
+    cout << "****In LSM Index Test****" << endl;
+
+    const std::string tableName = "tbl_lsmindex";
+    const int numTuples = 20000;
+    const int numAges = 500;
+
+    createTable(tableName);
+
+    // A small memtable flushes many times over the writes below
+    LsmIndexManager::instance()->setMemtableSize(16 * 1024);
+
+    RC rc = success;
+    int tupleSize = 0;
+    char tuple[100];
+    vector<RID> rids;
+    for (int i = 0; i < numTuples; ++i)
+    {
+        if (i == numTuples / 4)
+        {
+            rc = rm->createIndex(tableName, "Age", IndexTypeLsm);
+            assert(rc == success);
+        }
+
+        RID rid;
+        prepareTuple(4, "Name", (i * 7919) % numAges, 1.5f * i, i, tuple, &tupleSize);
+        rc = rm->insertTuple(tableName, tuple, rid);
+        assert(rc == success);
+        rids.push_back(rid);
+    }
+
+    vector<string> attributeNames;
+    attributeNames.push_back("Age");
+    attributeNames.push_back("Height");
+    assert(rm->createIndex(tableName, attributeNames, IndexTypeLsm) == rc::FEATURE_NOT_YET_IMPLEMENTED);
+
+    // Move every tenth tuple to a new age and delete every seventh
+    for (int i = 0; i < numTuples; i += 10)
+    {
+        prepareTuple(4, "Name", numAges + i % 3, 1.5f * i, i, tuple, &tupleSize);
+        rc = rm->updateTuple(tableName, tuple, rids[i]);
+        assert(rc == success);
+    }
+
+    for (int i = 3; i < numTuples; i += 7)
+    {
+        rc = rm->deleteTuple(tableName, rids[i]);
+        assert(rc == success);
+    }
+
+    vector<pair<int, RID> > indexed;
+    vector<pair<int, RID> > tuples;
+    collectAgeIndex(tableName, indexed);
+    collectAgeTuples(tableName, tuples);
+    assert(indexed.size() == tuples.size());
+    for (unsigned i = 0; i < indexed.size(); ++i)
+    {
+        assert(indexed[i].first == tuples[i].first);
+        assert(indexed[i].second.pageNum == tuples[i].second.pageNum && indexed[i].second.slotNum == tuples[i].second.slotNum);
+    }
+
+    // Ranges and single keys agree with the table too
+    const int lowAges[] = { 0, 17, numAges - 1, numAges + 1 };
+    const int highAges[] = { 5, 17, numAges + 1, numAges + 10 };
+    for (unsigned i = 0; i < sizeof(lowAges) / sizeof(lowAges[0]); ++i)
+    {
+        int expected = 0;
+        for (unsigned j = 0; j < tuples.size(); ++j)
+        {
+            if (tuples[j].first > lowAges[i] && tuples[j].first <= highAges[i])
+                ++expected;
+        }
+
+        RM_IndexScanIterator iter;
+        rc = rm->indexScan(tableName, "Age", &lowAges[i], &highAges[i], false, true, iter);
+        assert(rc == success);
+
+        RID rid;
+        int key = 0;
+        int count = 0;
+        while (iter.getNextEntry(rid, &key) != RM_EOF)
+        {
+            assert(key > lowAges[i] && key <= highAges[i]);
+            ++count;
+        }
+        iter.close();
+        assert(count == expected);
+    }
+
+    int age = 17;
+    RM_IndexScanIterator iter;
+    assert(rm->indexScan(tableName, "Age", &age, &age, true, true, IX_SCAN_DESCENDING, iter) == rc::FEATURE_NOT_YET_IMPLEMENTED);
+
+    rc = rm->deleteTuples(tableName);
+    assert(rc == success);
+    collectAgeIndex(tableName, indexed);
+    assert(indexed.empty());
+
+    rc = rm->deleteTable(tableName);
+    assert(rc == success);
+
+    LsmIndexManager::instance()->setMemtableSize(LX_DEFAULT_MEMTABLE_SIZE);
+
+    cout << "****LSM Index Test passed****" << endl << endl;
+}
+
+void testArtIndex()
+{
+    // Functions Tested
+    // 1. Create an adaptive radix tree index on a populated table **
+    // 2. Insert/Update/Delete Tuple(s) keep the in-memory index in step with the table **
+    // 3. Index Scan for ranges and single keys, rebuilt from the table, composite indexes are refused **
+    cout << "****In ART Index Test****" << endl;
+
+    const std::string tableName = "tbl_artindex";
+    const int numTuples = 20000;
+    const int numAges = 700;
+
+    createTable(tableName);
+
+    RC rc = success;
+    int tupleSize = 0;
+    char tuple[100];
+    vector<RID> rids;
+    for (int i = 0; i < numTuples; ++i)
+    {
+        if (i == numTuples / 2)
+        {
+            rc = rm->createIndex(tableName, "Age", IndexTypeArt);
+            assert(rc == success);
+        }
+
+        // Ages on both sides of zero
+        RID rid;
+        prepareTuple(4, "Name", (i * 7919) % numAges - numAges / 2, 1.5f * i, i, tuple, &tupleSize);
+        rc = rm->insertTuple(tableName, tuple, rid);
+        assert(rc == success);
+        rids.push_back(rid);
+    }
+
+    vector<string> attributeNames;
+    attributeNames.push_back("Age");
+    attributeNames.push_back("Height");
+    assert(rm->createIndex(tableName, attributeNames, IndexTypeArt) == rc::FEATURE_NOT_YET_IMPLEMENTED);
+
+    // Move every tenth tuple to a new age and delete every seventh
+    for (int i = 0; i < numTuples; i += 10)
+    {
+        prepareTuple(4, "Name", numAges + i % 3, 1.5f * i, i, tuple, &tupleSize);
+        rc = rm->updateTuple(tableName, tuple, rids[i]);
+        assert(rc == success);
+    }
+
+    for (int i = 3; i < numTuples; i += 7)
+    {
+        rc = rm->deleteTuple(tableName, rids[i]);
+        assert(rc == success);
+    }
+
+    vector<pair<int, RID> > indexed;
+    vector<pair<int, RID> > tuples;
+    collectAgeTuples(tableName, tuples);
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        // The second pass sees the index built again from the table, the way loading the catalog builds it
+        if (pass == 1)
+        {
+            rc = rm->rebuildIndexes(tableName);
+            assert(rc == success);
+        }
+
+        collectAgeIndex(tableName, indexed);
+        assert(indexed.size() == tuples.size());
+        for (unsigned i = 0; i < indexed.size(); ++i)
+        {
+            assert(indexed[i].first == tuples[i].first);
+            assert(indexed[i].second.pageNum == tuples[i].second.pageNum && indexed[i].second.slotNum == tuples[i].second.slotNum);
+        }
+    }
+
+    // Ranges and single keys agree with the table too
+    const int lowAges[] = { -numAges / 2, -3, 17, numAges / 2 - 10, numAges - 1 };
+    const int highAges[] = { -numAges / 2 + 5, 3, 17, numAges / 2 + 10, numAges + 10 };
+    for (unsigned i = 0; i < sizeof(lowAges) / sizeof(lowAges[0]); ++i)
+    {
+        for (int inclusive = 0; inclusive < 2; ++inclusive)
+        {
+            int expected = 0;
+            for (unsigned j = 0; j < tuples.size(); ++j)
+            {
+                if ((tuples[j].first > lowAges[i] || (inclusive && tuples[j].first == lowAges[i])) && tuples[j].first <= highAges[i])
+                    ++expected;
+            }
+
+            RM_IndexScanIterator iter;
+            rc = rm->indexScan(tableName, "Age", &lowAges[i], &highAges[i], inclusive, true, iter);
+            assert(rc == success);
+
+            RID rid;
+            int key = 0;
+            int count = 0;
+            while (iter.getNextEntry(rid, &key) != RM_EOF)
+            {
+                assert(key >= lowAges[i] && key <= highAges[i]);
+                ++count;
+            }
+            iter.close();
+            assert(count == expected);
+        }
+    }
+
+    int age = 17;
+    RM_IndexScanIterator iter;
+    assert(rm->indexScan(tableName, "Age", &age, &age, true, true, IX_SCAN_DESCENDING, iter) == rc::FEATURE_NOT_YET_IMPLEMENTED);
+
+    rc = rm->deleteTuples(tableName);
+    assert(rc == success);
+    collectAgeIndex(tableName, indexed);
+    assert(indexed.empty());
+
+    rc = rm->destroyIndex(tableName, "Age");
+    assert(rc == success);
+
+    rc = rm->deleteTable(tableName);
+    assert(rc == success);
+
+    cout << "****ART Index Test passed****" << endl << endl;
+}
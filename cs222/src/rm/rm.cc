@@ -3,10 +3,15 @@
 #include "../util/hash.h"
 #include <assert.h>
 #include <sstream>
+#include <algorithm>
+#include <thread>
+#include <limits>
+#include <cstddef>
 
 #define SYSTEM_TABLE_CATALOG_NAME "RM_SYS_CATALOG_TABLE.db"
 #define SYSTEM_TABLE_ATTRIBUTE_NAME "RM_SYS_ATTRIBUTE_TABLE.db"
 #define SYSTEM_TABLE_INDEX_NAME "RM_SYS_INDEX_TABLE.db"
+#define SYSTEM_TABLE_DICTIONARY_NAME "RM_SYS_DICTIONARY_TABLE.db"
 
 RelationManager* RelationManager::_rm = 0;
 
@@ -19,7 +24,7 @@ RelationManager* RelationManager::instance()
 }
 
 RelationManager::RelationManager()
-	: _lastTableRID()
+	: _lastTableRID(), _indexBuildThreads(std::max(std::thread::hardware_concurrency(), 1u)), _indexBuildMemory(IX_BULK_LOAD_MEMORY)
 {
 	_rbfm = RecordBasedFileManager::instance();
 	assert(_rbfm);
@@ -50,6 +55,7 @@ RelationManager::RelationManager()
 	attr.name = "NextAttributeRID_slot";		_systemTableAttributeRecordDescriptor.push_back(attr);
 	attr.name = "Type";							_systemTableAttributeRecordDescriptor.push_back(attr);
 	attr.name = "Length";						_systemTableAttributeRecordDescriptor.push_back(attr);
+	attr.name = "Encoding";						_systemTableAttributeRecordDescriptor.push_back(attr);
 	attr.name = "TableName";
 	attr.type = TypeVarChar;
 	attr.length = MAX_ATTRIBUTENAME_SIZE;
@@ -65,6 +71,21 @@ RelationManager::RelationManager()
 	attr.name = "SourceTable";					_systemTableIndexRecordDescriptor.push_back(attr);
 	attr.name = "FileName";						_systemTableIndexRecordDescriptor.push_back(attr);
 	attr.name = "AttrName";						_systemTableIndexRecordDescriptor.push_back(attr);
+	attr.type = TypeInt;
+	attr.length = sizeof(int);
+	attr.name = "IndexType";					_systemTableIndexRecordDescriptor.push_back(attr);
+
+	// Columns of the dictionary table
+	attr.type = TypeInt;
+	attr.length = sizeof(int);
+	attr.name = "Code";							_systemTableDictionaryRecordDescriptor.push_back(attr);
+	attr.type = TypeVarChar;
+	attr.length = MAX_TABLENAME_SIZE;
+	attr.name = "SourceTable";					_systemTableDictionaryRecordDescriptor.push_back(attr);
+	attr.length = MAX_ATTRIBUTENAME_SIZE;
+	attr.name = "AttrName";						_systemTableDictionaryRecordDescriptor.push_back(attr);
+	attr.length = PAGE_SIZE;
+	attr.name = "Value";						_systemTableDictionaryRecordDescriptor.push_back(attr);
 
 	// Generate the system table which will hold data about all other created tables
 	ASSERT_ON_BAD_RETURN = false;
@@ -87,6 +108,11 @@ RelationManager::~RelationManager()
 	for (std::map<std::string, TableMetaData>::iterator it = _catalog.begin(); it != _catalog.end(); ++it)
 	{
 		_rbfm->closeFile( ((*it).second).fileHandle );
+
+		for (std::map<std::string, IndexMetaData>::iterator indexIt = it->second.indexes.begin(); indexIt != it->second.indexes.end(); ++indexIt)
+		{
+			delete indexIt->second.art;
+		}
 	}
 }
 
@@ -95,13 +121,13 @@ RC RelationManager::loadSystemTables()
     RC ret = rc::OK;
 
     // If table exists in our catalog, it has been created and we know about it already
-	if (_catalog.find(SYSTEM_TABLE_CATALOG_NAME) != _catalog.end() && _catalog.find(SYSTEM_TABLE_ATTRIBUTE_NAME) != _catalog.end() && _catalog.find(SYSTEM_TABLE_INDEX_NAME) != _catalog.end())
+	if (_catalog.find(SYSTEM_TABLE_CATALOG_NAME) != _catalog.end() && _catalog.find(SYSTEM_TABLE_ATTRIBUTE_NAME) != _catalog.end() && _catalog.find(SYSTEM_TABLE_INDEX_NAME) != _catalog.end() && _catalog.find(SYSTEM_TABLE_DICTIONARY_NAME) != _catalog.end())
     {
         return rc::TABLE_ALREADY_CREATED;
     }
 
 	// If one or more but not all are in our catalog, something went very wrong
-	if (_catalog.find(SYSTEM_TABLE_CATALOG_NAME) != _catalog.end() || _catalog.find(SYSTEM_TABLE_ATTRIBUTE_NAME) != _catalog.end() || _catalog.find(SYSTEM_TABLE_INDEX_NAME) != _catalog.end())
+	if (_catalog.find(SYSTEM_TABLE_CATALOG_NAME) != _catalog.end() || _catalog.find(SYSTEM_TABLE_ATTRIBUTE_NAME) != _catalog.end() || _catalog.find(SYSTEM_TABLE_INDEX_NAME) != _catalog.end() || _catalog.find(SYSTEM_TABLE_DICTIONARY_NAME) != _catalog.end())
     {
         return rc::TABLE_SYSTEM_IN_BAD_STATE;
     }
@@ -121,13 +147,158 @@ RC RelationManager::loadSystemTables()
 	ret = _rbfm->openFile(SYSTEM_TABLE_INDEX_NAME, _catalog[SYSTEM_TABLE_INDEX_NAME].fileHandle);
     RETURN_ON_ERR(ret);
 
+	// Attempt to open the dictionary table if it exists, databases from before dictionary encoding have none yet
+	_catalog[SYSTEM_TABLE_DICTIONARY_NAME] = TableMetaData();
+	ret = _rbfm->openFile(SYSTEM_TABLE_DICTIONARY_NAME, _catalog[SYSTEM_TABLE_DICTIONARY_NAME].fileHandle);
+	if (ret != rc::OK)
+	{
+		_catalog.erase(SYSTEM_TABLE_DICTIONARY_NAME);
+		ret = upgradeSystemTables();
+		RETURN_ON_ERR(ret);
+	}
+
     return rc::OK;
 }
 
+RC RelationManager::upgradeSystemTables()
+{
+	RC ret = rc::OK;
+
+	// Attribute rows were written without the Encoding column, which sits right before the name
+	vector<Attribute> legacyAttributeRecordDescriptor;
+	unsigned encodingIndex = 0;
+	for (vector<Attribute>::const_iterator it = _systemTableAttributeRecordDescriptor.begin(); it != _systemTableAttributeRecordDescriptor.end(); ++it)
+	{
+		if (it->name == "Encoding")
+		{
+			encodingIndex = legacyAttributeRecordDescriptor.size();
+			continue;
+		}
+
+		legacyAttributeRecordDescriptor.push_back(*it);
+	}
+
+	// Rewrite the attribute rows of every table with no encoding
+	RID currentRID;
+	currentRID.pageNum = 1;
+	currentRID.slotNum = 0;
+	while (currentRID.pageNum > 0)
+	{
+		TableMetadataRow currentRow;
+		ret = _rbfm->readRecord(_catalog[SYSTEM_TABLE_CATALOG_NAME].fileHandle, _systemTableRecordDescriptor, currentRID, &currentRow);
+		RETURN_ON_ERR(ret);
+
+		const std::string tableName((char*)(currentRow.tableName + sizeof(int)));
+
+		int readAttributes = 0;
+		RID attributeRID = currentRow.firstAttribute;
+		RID precedingRID = attributeRID;
+		AttributeRecord precedingRec;
+		while (attributeRID.pageNum > 0)
+		{
+			char legacyRow[sizeof(AttributeRecord)] = {0};
+			ret = _rbfm->readRecord(_catalog[SYSTEM_TABLE_ATTRIBUTE_NAME].fileHandle, legacyAttributeRecordDescriptor, attributeRID, legacyRow);
+			RETURN_ON_ERR(ret);
+
+			AttributeRecord attrRec;
+			memcpy(&attrRec.nextAttribute, legacyRow, sizeof(attrRec.nextAttribute));
+			memcpy(&attrRec.type, legacyRow + offsetof(AttributeRecord, type), sizeof(attrRec.type));
+			memcpy(&attrRec.length, legacyRow + offsetof(AttributeRecord, length), sizeof(attrRec.length));
+			memcpy(attrRec.name, legacyRow + offsetof(AttributeRecord, encoding), sizeof(attrRec.name));
+			attrRec.encoding = AttributeEncodingNone;
+
+			ret = _rbfm->updateRecord(_catalog[SYSTEM_TABLE_ATTRIBUTE_NAME].fileHandle, _systemTableAttributeRecordDescriptor, &attrRec, attributeRID);
+			RETURN_ON_ERR(ret);
+
+			// Remember the column the attribute table's new Encoding column follows
+			if (++readAttributes == (int)encodingIndex)
+			{
+				precedingRID = attributeRID;
+				precedingRec = attrRec;
+			}
+
+			attributeRID = attrRec.nextAttribute;
+		}
+
+		if (readAttributes != currentRow.numAttributes)
+		{
+			return rc::TABLE_SYSTEM_IN_BAD_STATE;
+		}
+
+		// The attribute table itself gains the Encoding column
+		if (tableName == SYSTEM_TABLE_ATTRIBUTE_NAME)
+		{
+			if (readAttributes + 1 != (int)_systemTableAttributeRecordDescriptor.size())
+			{
+				return rc::TABLE_SYSTEM_IN_BAD_STATE;
+			}
+
+			const Attribute& encodingAttr = _systemTableAttributeRecordDescriptor[encodingIndex];
+			AttributeRecord encodingRec;
+			encodingRec.type = encodingAttr.type;
+			encodingRec.length = encodingAttr.length;
+			encodingRec.encoding = AttributeEncodingNone;
+			encodingRec.nextAttribute = precedingRec.nextAttribute;
+
+			int nameLen = encodingAttr.name.length();
+			memcpy(encodingRec.name, &nameLen, sizeof(int));
+			memcpy(encodingRec.name + sizeof(int), encodingAttr.name.c_str(), nameLen);
+
+			// Link it in after the column it follows
+			RID encodingRID;
+			ret = _rbfm->insertRecord(_catalog[SYSTEM_TABLE_ATTRIBUTE_NAME].fileHandle, _systemTableAttributeRecordDescriptor, &encodingRec, encodingRID);
+			RETURN_ON_ERR(ret);
+
+			precedingRec.nextAttribute = encodingRID;
+
+			ret = _rbfm->updateRecord(_catalog[SYSTEM_TABLE_ATTRIBUTE_NAME].fileHandle, _systemTableAttributeRecordDescriptor, &precedingRec, precedingRID);
+			RETURN_ON_ERR(ret);
+
+			++currentRow.numAttributes;
+			ret = _rbfm->updateRecord(_catalog[SYSTEM_TABLE_CATALOG_NAME].fileHandle, _systemTableRecordDescriptor, &currentRow, currentRID);
+			RETURN_ON_ERR(ret);
+		}
+
+		// The dictionary table's row goes after the last one
+		_lastTableRID = currentRID;
+		currentRID = currentRow.nextRow;
+	}
+
+	// Add the missing dictionary table, there are no encoded columns yet
+	ret = createCatalogEntry(SYSTEM_TABLE_DICTIONARY_NAME, _systemTableDictionaryRecordDescriptor);
+	RETURN_ON_ERR(ret);
+
+	return insertTableMetadata(true, SYSTEM_TABLE_DICTIONARY_NAME, _systemTableDictionaryRecordDescriptor);
+}
+
 RC RelationManager::createSystemTables()
 {
     RC ret = rc::OK;
 
+	// Without a loadable catalog, refuse to overwrite any system files left behind
+	const char* systemTableNames[] = { SYSTEM_TABLE_CATALOG_NAME, SYSTEM_TABLE_ATTRIBUTE_NAME, SYSTEM_TABLE_INDEX_NAME, SYSTEM_TABLE_DICTIONARY_NAME };
+	for (unsigned i = 0; i < sizeof(systemTableNames) / sizeof(systemTableNames[0]); ++i)
+	{
+		// Let go of anything a failed load left open
+		std::map<std::string, TableMetaData>::iterator it = _catalog.find(systemTableNames[i]);
+		if (it != _catalog.end())
+		{
+			if (it->second.fileHandle.hasFile())
+			{
+				_rbfm->closeFile(it->second.fileHandle);
+			}
+
+			_catalog.erase(it);
+		}
+
+		FileHandle fileHandle;
+		if (_rbfm->openFile(systemTableNames[i], fileHandle) == rc::OK)
+		{
+			_rbfm->closeFile(fileHandle);
+			return rc::TABLE_SYSTEM_IN_BAD_STATE;
+		}
+	}
+
     // Create the system tables
     ret = createCatalogEntry(SYSTEM_TABLE_CATALOG_NAME, _systemTableRecordDescriptor);
     RETURN_ON_ERR(ret);
@@ -138,6 +309,9 @@ RC RelationManager::createSystemTables()
 	ret = createCatalogEntry(SYSTEM_TABLE_INDEX_NAME, _systemTableIndexRecordDescriptor);
     RETURN_ON_ERR(ret);
 
+	ret = createCatalogEntry(SYSTEM_TABLE_DICTIONARY_NAME, _systemTableDictionaryRecordDescriptor);
+    RETURN_ON_ERR(ret);
+
     // Write out entries in the system tables for the system data
     ret = insertTableMetadata(true, SYSTEM_TABLE_CATALOG_NAME, _systemTableRecordDescriptor);
     RETURN_ON_ERR(ret);
@@ -148,6 +322,9 @@ RC RelationManager::createSystemTables()
 	ret = insertTableMetadata(true, SYSTEM_TABLE_INDEX_NAME, _systemTableIndexRecordDescriptor);
     RETURN_ON_ERR(ret);
 
+	ret = insertTableMetadata(true, SYSTEM_TABLE_DICTIONARY_NAME, _systemTableDictionaryRecordDescriptor);
+    RETURN_ON_ERR(ret);
+
     return rc::OK;
 }
 
@@ -167,6 +344,8 @@ RC RelationManager::createCatalogEntry(const string &tableName, const vector<Att
         _catalog[tableName].recordDescriptor.push_back(*it);
     }
 
+    updateStorageDescriptor(_catalog[tableName]);
+
     return rc::OK;
 }
 
@@ -214,6 +393,7 @@ RC RelationManager::insertTableMetadata(bool isSystemTable, const string &tableN
         AttributeRecord attrRec;
         attrRec.type = attr.type;
         attrRec.length = attr.length;
+        attrRec.encoding = AttributeEncodingNone;
         attrRec.nextAttribute.pageNum = attributeRID.pageNum;
         attrRec.nextAttribute.slotNum = attributeRID.slotNum;
 
@@ -298,13 +478,16 @@ RC RelationManager::loadTableMetadata()
         // Clear out any old data we have about this table
         const std::string tableName((char*)(currentRow.tableName + sizeof(int)));
         _catalog[tableName].recordDescriptor.clear();
+        _catalog[tableName].dictionaries.clear();
 
         // Load in the attribute table data for this row
-		ret = loadTableColumnMetadata(currentRow.numAttributes, currentRow.firstAttribute, _catalog[tableName].recordDescriptor);
+		ret = loadTableColumnMetadata(currentRow.numAttributes, currentRow.firstAttribute, _catalog[tableName].recordDescriptor, _catalog[tableName].dictionaries);
 		RETURN_ON_ERR(ret);
 
+		updateStorageDescriptor(_catalog[tableName]);
+
         // Open a file handle for the table
-		if (tableName != SYSTEM_TABLE_CATALOG_NAME && tableName != SYSTEM_TABLE_ATTRIBUTE_NAME && tableName != SYSTEM_TABLE_INDEX_NAME)
+		if (tableName != SYSTEM_TABLE_CATALOG_NAME && tableName != SYSTEM_TABLE_ATTRIBUTE_NAME && tableName != SYSTEM_TABLE_INDEX_NAME && tableName != SYSTEM_TABLE_DICTIONARY_NAME)
         {
             ret = _rbfm->openFile(tableName, _catalog[tableName].fileHandle);
             RETURN_ON_ERR(ret);
@@ -346,36 +529,136 @@ RC RelationManager::loadTableMetadata()
 			int attrNameLen = 0;
 			memcpy(&attrNameLen, indexRow.buffer + offset, sizeof(int));
 			memcpy(pulledAttrName, indexRow.buffer + offset + sizeof(int), attrNameLen);
-			offset += attrNameLen;
+			offset += attrNameLen + sizeof(int);
 			pulledAttrName[attrNameLen] = 0;
 			std::string attrName = string(pulledAttrName);
 
-			// Open a handle to the index
-			IndexMetaData indexData;
-			ret = _rbfm->openFile(pulledIndexName, indexData.fileHandle);
-			RETURN_ON_ERR(ret);
+			int indexType = IndexTypeBTree;
+			memcpy(&indexType, indexRow.buffer + offset, sizeof(int));
 
-			// Create a new metadata record for the index
+			// Create a new metadata record for the index, hash indexes need the real type of the key to hash it
 			IndexMetaData indexMetaData;
 			Attribute indexAttr;
 			indexAttr.type = TypeVarChar;
 			indexAttr.length = attrNameLen;
 			indexAttr.name = attrName;
-			indexMetaData.fileHandle = indexData.fileHandle;
+
+			unsigned attributeIndex = 0;
+			if (RBFM_ScanIterator::findAttributeByName(_catalog[tableName].recordDescriptor, attrName, attributeIndex) == rc::OK)
+			{
+				indexAttr = _catalog[tableName].recordDescriptor[attributeIndex];
+			}
+			else if (attrName.find_first_of(",+") != std::string::npos)
+			{
+				// Composite indexes list their attributes separated by commas, and any included ones after a '+'
+				const size_t includedStart = attrName.find('+');
+				for (unsigned part = 0; part < 2; ++part)
+				{
+					std::stringstream names(part == 0 ? attrName.substr(0, includedStart) : includedStart == std::string::npos ? "" : attrName.substr(includedStart + 1));
+					std::string name;
+					while (std::getline(names, name, ','))
+					{
+						ret = RBFM_ScanIterator::findAttributeByName(_catalog[tableName].recordDescriptor, name, attributeIndex);
+						RETURN_ON_ERR(ret);
+
+						indexMetaData.keyAttributes.push_back(_catalog[tableName].recordDescriptor[attributeIndex]);
+						indexMetaData.numIncludedAttributes += part;
+					}
+				}
+
+				indexAttr = IndexManager::getCompositeAttribute(indexMetaData.keyAttributes);
+			}
+
 			indexMetaData.attribute = indexAttr;
+			indexMetaData.type = (IndexType)indexType;
 
-			// Now add this index entry to the catalog
-			_catalog[tableName].indexes.insert(std::pair<std::string,IndexMetaData>(indexName, indexMetaData));
+			// Now add this index entry to the catalog, and open a handle to the index in place. A copied handle
+			// would close the file a second time when it goes away
+			IndexMetaData& indexData = _catalog[tableName].indexes.insert(std::pair<std::string,IndexMetaData>(indexName, indexMetaData)).first->second;
+			ret = _rbfm->openFile(pulledIndexName, indexData.fileHandle);
+			RETURN_ON_ERR(ret);
 
 			// Advance!
 			indexRid = indexRow.nextIndex;
 		}
 	}
 
+	// With every table known, fill in the values of the dictionary encoded columns
+	ret = loadDictionaries();
+	RETURN_ON_ERR(ret);
+
+	// The in-memory indexes are built last, scanning a table needs its dictionaries
+	return loadArtIndexes();
+}
+
+RC RelationManager::loadDictionaries()
+{
+	std::vector<std::string> attributeNames;
+	for (vector<Attribute>::const_iterator it = _systemTableDictionaryRecordDescriptor.begin(); it != _systemTableDictionaryRecordDescriptor.end(); ++it)
+	{
+		attributeNames.push_back(it->name);
+	}
+
+	RBFM_ScanIterator scanner;
+	RC ret = _rbfm->scan(_catalog[SYSTEM_TABLE_DICTIONARY_NAME].fileHandle, _systemTableDictionaryRecordDescriptor, "", NO_OP, NULL, attributeNames, scanner);
+	RETURN_ON_ERR(ret);
+
+	RID rid;
+	DictionarySystemRecord dictionaryRow;
+	while ((ret = scanner.getNextRecord(rid, &dictionaryRow)) == rc::OK)
+	{
+		std::string sourceTable, attrName, value;
+		dictionaryRow.parse(sourceTable, attrName, value);
+
+		// Skip entries left behind by tables or columns we no longer know about
+		std::map<std::string, TableMetaData>::iterator table = _catalog.find(sourceTable);
+		if (table != _catalog.end())
+		{
+			std::map<std::string, ColumnDictionary>::iterator dictionary = table->second.dictionaries.find(attrName);
+			if (dictionary != table->second.dictionaries.end() && dictionaryRow.code >= 0)
+			{
+				if (dictionary->second.values.size() <= (unsigned)dictionaryRow.code)
+				{
+					dictionary->second.values.resize(dictionaryRow.code + 1);
+				}
+
+				dictionary->second.values[dictionaryRow.code] = value;
+				dictionary->second.codes[value] = dictionaryRow.code;
+			}
+		}
+
+		dictionaryRow = DictionarySystemRecord();
+	}
+
+	scanner.close();
+	if (ret != RBFM_EOF)
+	{
+		return ret;
+	}
+
+	return rc::OK;
+}
+
+RC RelationManager::loadArtIndexes()
+{
+	for (std::map<std::string, TableMetaData>::iterator it = _catalog.begin(); it != _catalog.end(); ++it)
+	{
+		for (std::map<std::string, IndexMetaData>::iterator indexIt = it->second.indexes.begin(); indexIt != it->second.indexes.end(); ++indexIt)
+		{
+			IndexMetaData& indexData = indexIt->second;
+			if (indexData.type != IndexTypeArt)
+				continue;
+
+			indexData.art = new ArtIndex(indexData.attribute);
+			RC ret = loadIndex(it->first, indexData, std::vector<std::string>(1, indexData.attribute.name), IX_DEFAULT_FILL_FACTOR);
+			RETURN_ON_ERR(ret);
+		}
+	}
+
 	return rc::OK;
 }
 
-RC RelationManager::loadTableColumnMetadata(int numAttributes, RID firstAttributeRID, std::vector<Attribute>& recordDescriptor)
+RC RelationManager::loadTableColumnMetadata(int numAttributes, RID firstAttributeRID, std::vector<Attribute>& recordDescriptor, std::map<std::string, ColumnDictionary>& dictionaries)
 {
 	RC ret = rc::OK;
 	int readAttributes = 0;
@@ -398,6 +681,12 @@ RC RelationManager::loadTableColumnMetadata(int numAttributes, RID firstAttribut
         attr.name = std::string((char*)(attrRec.name + sizeof(int)));
 		recordDescriptor.push_back(attr);
 
+		// The values themselves are filled in once every table has been loaded
+		if (attrRec.encoding == AttributeEncodingDictionary)
+		{
+			dictionaries[attr.name] = ColumnDictionary();
+		}
+
 		// Move on to the next attribute
 		currentRID.pageNum = attrRec.nextAttribute.pageNum;
 		currentRID.slotNum = attrRec.nextAttribute.slotNum;
@@ -434,7 +723,18 @@ RC RelationManager::deleteTable(const string &tableName)
 		ret = _rbfm->closeFile(indexIt->second.fileHandle);
 		RETURN_ON_ERR(ret);
 
-		ret = _rbfm->destroyFile(indexIt->second.fileHandle.getFilename());
+		delete indexIt->second.art;
+		indexIt->second.art = NULL;
+
+		// LSM indexes keep their runs in files of their own
+		ret = getIndexFileManager(indexIt->second.type)->destroyFile(indexIt->first);
+		RETURN_ON_ERR(ret);
+	}
+
+	// Drop the values of any dictionary encoded columns
+	if (!it->second.dictionaries.empty())
+	{
+		ret = deleteDictionaries(tableName);
 		RETURN_ON_ERR(ret);
 	}
 
@@ -550,19 +850,34 @@ RC RelationManager::insertTuple(const string &tableName, const void *data, RID &
 	}
 
 	TableMetaData& tableData = _catalog[tableName];
-	RC ret = _rbfm->insertRecord(tableData.fileHandle, tableData.recordDescriptor, data, rid);
+	TableLatch& latch = getTableLatch(tableName);
+	std::lock_guard<std::mutex> guard(latch.mutex);
+
+	// Swap dictionary encoded values for their codes before the tuple hits the disk
+	char encodedData[PAGE_SIZE];
+	const void* storedData = data;
+	if (!tableData.dictionaries.empty())
+	{
+		RC ret = encodeTuple(tableName, tableData, data, encodedData);
+		RETURN_ON_ERR(ret);
+		storedData = encodedData;
+	}
+
+	RC ret = _rbfm->insertRecord(tableData.fileHandle, tableData.storageDescriptor, storedData, rid);
+	RETURN_ON_ERR(ret);
+
+	ret = logIndexChange(latch, tableData, data, rid, true);
 	RETURN_ON_ERR(ret);
 
 	// Update indices if they exist
-	IndexManager* im = IndexManager::instance();
 	for (std::map<std::string, IndexMetaData>::iterator it = tableData.indexes.begin(); it != tableData.indexes.end(); ++it)
 	{
-		// Find the offset into the tuple which has the data we care about in this index
-		unsigned dataOffset = 0;
-		ret = findDataOffset(data, tableData.recordDescriptor, it->second.attribute.name, dataOffset);
+		// Pull the key this index holds out of the tuple
+		char key[PAGE_SIZE];
+		ret = getIndexKey(tableData.recordDescriptor, it->second, data, key);
 		RETURN_ON_ERR(ret);
-		
-		ret = im->insertEntry(it->second.fileHandle, it->second.attribute, (char*)data + dataOffset, rid);
+
+		ret = insertIndexEntry(it->second, key, rid);
 		RETURN_ON_ERR(ret);
 	}
 
@@ -577,14 +892,24 @@ RC RelationManager::deleteTuples(const string &tableName)
 	}
 
 	TableMetaData& tableData = _catalog[tableName];
+	TableLatch& latch = getTableLatch(tableName);
+	std::lock_guard<std::mutex> guard(latch.mutex);
+
 	RC ret = _rbfm->deleteRecords(tableData.fileHandle);
 	RETURN_ON_ERR(ret);
 
+	// Online builds start over from an empty index, and everything written from now on is logged
+	for (unsigned i = 0; i < latch.builds.size(); ++i)
+	{
+		latch.builds[i]->truncated = true;
+		latch.builds[i]->scannedPages = std::numeric_limits<PageNum>::max();
+		latch.builds[i]->log.clear();
+	}
+
 	// Update indices if they exist
-	IndexManager* im = IndexManager::instance();
 	for (std::map<std::string, IndexMetaData>::iterator it = tableData.indexes.begin(); it != tableData.indexes.end(); ++it)
 	{
-		ret = im->deleteRecords(it->second.fileHandle);
+		ret = deleteIndexEntries(it->second);
 		RETURN_ON_ERR(ret);
 	}
 
@@ -599,26 +924,30 @@ RC RelationManager::deleteTuple(const string &tableName, const RID &rid)
 	}
 
 	TableMetaData& tableData = _catalog[tableName];
+	TableLatch& latch = getTableLatch(tableName);
+	std::lock_guard<std::mutex> guard(latch.mutex);
 
 	// Read the tuple in since we need it to search for the corresponding values in the index
 	char oldData[PAGE_SIZE] = {0};
-	RC ret = _rbfm->readRecord(tableData.fileHandle, tableData.recordDescriptor, rid, oldData);
+	RC ret = readStoredTuple(tableData, rid, oldData);
 	RETURN_ON_ERR(ret);
 
 	// Now we can delete the actual data
-	ret =  _rbfm->deleteRecord(tableData.fileHandle, tableData.recordDescriptor, rid);
+	ret =  _rbfm->deleteRecord(tableData.fileHandle, tableData.storageDescriptor, rid);
+	RETURN_ON_ERR(ret);
+
+	ret = logIndexChange(latch, tableData, oldData, rid, false);
 	RETURN_ON_ERR(ret);
 
 	// Update indices if they exist
-	IndexManager* im = IndexManager::instance();
 	for (std::map<std::string, IndexMetaData>::iterator it = tableData.indexes.begin(); it != tableData.indexes.end(); ++it)
 	{
-		// Find the offset into the tuple which has the data we care about in this index
-		unsigned dataOffset = 0;
-		ret = findDataOffset(oldData, tableData.recordDescriptor, it->second.attribute.name, dataOffset);
+		// Pull the key this index holds out of the tuple
+		char key[PAGE_SIZE];
+		ret = getIndexKey(tableData.recordDescriptor, it->second, oldData, key);
 		RETURN_ON_ERR(ret);
 
-		ret = im->deleteEntry(it->second.fileHandle, it->second.attribute, oldData + dataOffset, rid);
+		ret = deleteIndexEntry(it->second, key, rid);
 		RETURN_ON_ERR(ret);
 	}
 
@@ -633,40 +962,56 @@ RC RelationManager::updateTuple(const string &tableName, const void *data, const
 	}
 
 	TableMetaData& tableData = _catalog[tableName];
+	TableLatch& latch = getTableLatch(tableName);
+	std::lock_guard<std::mutex> guard(latch.mutex);
 
 	// Read the tuple in since we need it to search for the corresponding values in the index
 	char oldData[PAGE_SIZE] = {0};
-	RC ret = _rbfm->readRecord(tableData.fileHandle, tableData.recordDescriptor, rid, oldData);
+	RC ret = readStoredTuple(tableData, rid, oldData);
 	RETURN_ON_ERR(ret);
 
 	// Now we can update the actual record entry
-	ret = _rbfm->updateRecord(tableData.fileHandle, tableData.recordDescriptor, data, rid);
+	char encodedData[PAGE_SIZE];
+	const void* storedData = data;
+	if (!tableData.dictionaries.empty())
+	{
+		ret = encodeTuple(tableName, tableData, data, encodedData);
+		RETURN_ON_ERR(ret);
+		storedData = encodedData;
+	}
+
+	ret = _rbfm->updateRecord(tableData.fileHandle, tableData.storageDescriptor, storedData, rid);
+	RETURN_ON_ERR(ret);
+
+	ret = logIndexChange(latch, tableData, oldData, rid, false);
+	RETURN_ON_ERR(ret);
+
+	ret = logIndexChange(latch, tableData, data, rid, true);
 	RETURN_ON_ERR(ret);
 
 	// Delete old index entries
-	IndexManager* im = IndexManager::instance();
 	for (std::map<std::string, IndexMetaData>::iterator it = tableData.indexes.begin(); it != tableData.indexes.end(); ++it)
 	{
-		// Find the offset into the tuple which has the data we care about in this index
-		unsigned dataOffset = 0;
-		ret = findDataOffset(oldData, tableData.recordDescriptor, it->second.attribute.name, dataOffset);
+		// Pull the key this index holds out of the tuple
+		char key[PAGE_SIZE];
+		ret = getIndexKey(tableData.recordDescriptor, it->second, oldData, key);
 		RETURN_ON_ERR(ret);
 
 		// Delete the old index entry
-		ret = im->deleteEntry(it->second.fileHandle, it->second.attribute, oldData + dataOffset, rid);
+		ret = deleteIndexEntry(it->second, key, rid);
 		RETURN_ON_ERR(ret);
 	}
 
 	// Insert new index entries
 	for (std::map<std::string, IndexMetaData>::iterator it = tableData.indexes.begin(); it != tableData.indexes.end(); ++it)
 	{
-		// Find the offset into the tuple which has the data we care about in this index
-		unsigned dataOffset = 0;
-		ret = findDataOffset(data, tableData.recordDescriptor, it->second.attribute.name, dataOffset);
+		// Pull the key this index holds out of the tuple
+		char key[PAGE_SIZE];
+		ret = getIndexKey(tableData.recordDescriptor, it->second, data, key);
 		RETURN_ON_ERR(ret);
 
-		// Delete the old index entry
-		ret = im->insertEntry(it->second.fileHandle, it->second.attribute, (char*)data + dataOffset, rid);
+		// Insert the new index entry
+		ret = insertIndexEntry(it->second, key, rid);
 		RETURN_ON_ERR(ret);
 	}
 
@@ -680,131 +1025,658 @@ RC RelationManager::readTuple(const string &tableName, const RID &rid, void *dat
 		return rc::TABLE_NOT_FOUND;
 	}
 
-	TableMetaData& tableData = _catalog[tableName];
-	return _rbfm->readRecord(tableData.fileHandle, tableData.recordDescriptor, rid, data);
+	return readStoredTuple(_catalog[tableName], rid, data);
 }
 
-RC RelationManager::readAttribute(const string &tableName, const RID &rid, const string &attributeName, void *data)
+RC RelationManager::readTuplePage(const string &tableName, PageNum pageNum, void *pageBuffer)
 {
 	if (_catalog.find(tableName) == _catalog.end())
 	{
 		return rc::TABLE_NOT_FOUND;
 	}
 
-	TableMetaData& tableData = _catalog[tableName];
-	return _rbfm->readAttribute(tableData.fileHandle, tableData.recordDescriptor, rid, attributeName, data);
+	return _catalog[tableName].fileHandle.readPage(pageNum, pageBuffer);
 }
 
-RC RelationManager::reorganizePage(const string &tableName, const unsigned pageNumber)
+RC RelationManager::readTuple(const string &tableName, const RID &rid, void *data, void *pageBuffer)
 {
 	if (_catalog.find(tableName) == _catalog.end())
 	{
 		return rc::TABLE_NOT_FOUND;
 	}
 
-	TableMetaData& tableData = _catalog[tableName];
-	return _rbfm->reorganizePage(tableData.fileHandle, tableData.recordDescriptor, pageNumber);
+	return readStoredTuple(_catalog[tableName], rid, data, pageBuffer);
 }
 
-std::string RelationManager::getIndexName(const string& baseTable, const string& attributeName)
+RC RelationManager::readStoredTuple(TableMetaData& tableData, const RID &rid, void *data, void *pageBuffer)
 {
-	std::stringstream out;
-	out << baseTable;
-	out << '.';
-	//out << util::strhash(attributeName);
-	out << attributeName;
+	void* storedData = data;
+	char encodedData[PAGE_SIZE] = {0};
+	if (!tableData.dictionaries.empty())
+	{
+		storedData = encodedData;
+	}
 
-	return out.str();
-}
+	RC ret = rc::OK;
+	if (pageBuffer)
+	{
+		ret = _rbfm->readRecord(tableData.fileHandle, tableData.storageDescriptor, rid, storedData, pageBuffer);
+	}
+	else
+	{
+		ret = _rbfm->readRecord(tableData.fileHandle, tableData.storageDescriptor, rid, storedData);
+	}
+	RETURN_ON_ERR(ret);
 
-RC RelationManager::scan(const string &tableName,
-      const string &conditionAttribute,
-      const CompOp compOp,                  
-      const void *value,                    
-      const vector<string> &attributeNames,
-      RM_ScanIterator &rm_ScanIterator)
-{
-	if (_catalog.find(tableName) == _catalog.end())
+	if (tableData.dictionaries.empty())
 	{
-		return rc::TABLE_NOT_FOUND;
+		return rc::OK;
 	}
 
-	TableMetaData& tableData = _catalog[tableName];
-	return _rbfm->scan(
-        tableData.fileHandle,
-		tableData.recordDescriptor, 
-		conditionAttribute, 
-		compOp, 
-		value, 
-		attributeNames, 
-		rm_ScanIterator.iter);
+	return decodeTuple(tableData, encodedData, data);
 }
 
-RC RM_ScanIterator::getNextTuple(RID &rid, void *data)
+RC RelationManager::insertIndexEntry(IndexMetaData& indexData, const void* key, const RID& rid)
 {
-	return iter.getNextRecord(rid, data);
+	if (indexData.type == IndexTypeHash)
+		return HashIndexManager::instance()->insertEntry(indexData.fileHandle, indexData.attribute, key, rid);
+
+	if (indexData.type == IndexTypeLsm)
+		return LsmIndexManager::instance()->insertEntry(indexData.fileHandle, indexData.attribute, key, rid);
+
+	if (indexData.type == IndexTypeArt)
+		return indexData.art->insertEntry(key, rid);
+
+	return IndexManager::instance()->insertEntry(indexData.fileHandle, indexData.attribute, key, rid);
 }
 
-RC RM_ScanIterator::close()
+RC RelationManager::deleteIndexEntry(IndexMetaData& indexData, const void* key, const RID& rid)
 {
-	return iter.close();
+	if (indexData.type == IndexTypeHash)
+		return HashIndexManager::instance()->deleteEntry(indexData.fileHandle, indexData.attribute, key, rid);
+
+	if (indexData.type == IndexTypeLsm)
+		return LsmIndexManager::instance()->deleteEntry(indexData.fileHandle, indexData.attribute, key, rid);
+
+	if (indexData.type == IndexTypeArt)
+		return indexData.art->deleteEntry(key, rid);
+
+	return IndexManager::instance()->deleteEntry(indexData.fileHandle, indexData.attribute, key, rid);
 }
 
-RC RM_IndexScanIterator::getNextEntry(RID &rid, void *key)
+RC RelationManager::deleteIndexEntries(IndexMetaData& indexData)
 {
-	return iter.getNextEntry(rid, key);
+	if (indexData.type == IndexTypeHash)
+		return HashIndexManager::instance()->deleteRecords(indexData.fileHandle);
+
+	if (indexData.type == IndexTypeLsm)
+		return LsmIndexManager::instance()->deleteRecords(indexData.fileHandle);
+
+	if (indexData.type == IndexTypeArt)
+	{
+		indexData.art->clear();
+		return rc::OK;
+	}
+
+	return IndexManager::instance()->deleteRecords(indexData.fileHandle);
 }
 
-RC RM_IndexScanIterator::close()
+RecordBasedCoreManager* RelationManager::getIndexFileManager(IndexType type)
 {
-	tableData = NULL;
-	return iter.close();
+	switch (type)
+	{
+		case IndexTypeHash:
+			return HashIndexManager::instance();
+
+		case IndexTypeLsm:
+			return LsmIndexManager::instance();
+
+		// Nothing is ever written to the file of an in-memory index, it only holds the index's name on disk
+		case IndexTypeArt:
+			return RecordBasedFileManager::instance();
+
+		default:
+			return IndexManager::instance();
+	}
 }
 
-RC RM_IndexScanIterator::init(TableMetaData& _tableData, const string& indexName, const string& attributeName, const void *lowKey, const void *highKey, bool lowKeyInclusive, bool highKeyInclusive)
+RC RelationManager::getIndexKey(const std::vector<Attribute>& recordDescriptor, const IndexMetaData& indexData, const void* tuple, void* key)
 {
-	tableData = &_tableData;
-	
-	// Find the attribute we care about
-	unsigned attributeIndex = 0;
-	RC ret = RBFM_ScanIterator::findAttributeByName(tableData->recordDescriptor, attributeName, attributeIndex);
-	RETURN_ON_ERR(ret);
+	if (indexData.keyAttributes.empty())
+	{
+		unsigned dataOffset = 0;
+		RC ret = findDataOffset(tuple, recordDescriptor, indexData.attribute.name, dataOffset);
+		RETURN_ON_ERR(ret);
 
-	// Find the index we care about
-	if (tableData->indexes.find(indexName) == tableData->indexes.end())
+		const char* value = (const char*)tuple + dataOffset;
+		memcpy(key, value, Attribute::sizeInBytes(indexData.attribute.type, value));
+		return rc::OK;
+	}
+
+	// Gather the values of a composite key in index order and encode them as one
+	char values[PAGE_SIZE];
+	unsigned valuesLength = 0;
+	for (std::vector<Attribute>::const_iterator it = indexData.keyAttributes.begin(); it != indexData.keyAttributes.end(); ++it)
 	{
-		return rc::INDEX_NOT_FOUND;
+		unsigned dataOffset = 0;
+		RC ret = findDataOffset(tuple, recordDescriptor, it->name, dataOffset);
+		RETURN_ON_ERR(ret);
+
+		const char* value = (const char*)tuple + dataOffset;
+		unsigned valueLength = Attribute::sizeInBytes(it->type, value);
+		memcpy(values + valuesLength, value, valueLength);
+		valuesLength += valueLength;
 	}
 
-	return iter.init(&(tableData->indexes[indexName].fileHandle), tableData->recordDescriptor[attributeIndex], lowKey, highKey, lowKeyInclusive, highKeyInclusive);
+	return IndexManager::encodeCompositeKey(indexData.keyAttributes, values, indexData.keyAttributes.size(), key);
 }
 
-RC RelationManager::createIndex(const string &tableName, const string &attributeName)
+RC RelationManager::readAttribute(const string &tableName, const RID &rid, const string &attributeName, void *data)
 {
-	IndexManager* im = IndexManager::instance();
 	if (_catalog.find(tableName) == _catalog.end())
 	{
 		return rc::TABLE_NOT_FOUND;
 	}
 
 	TableMetaData& tableData = _catalog[tableName];
+	std::map<std::string, ColumnDictionary>::const_iterator dictionary = tableData.dictionaries.find(attributeName);
+	if (dictionary == tableData.dictionaries.end())
+	{
+		return _rbfm->readAttribute(tableData.fileHandle, tableData.storageDescriptor, rid, attributeName, data);
+	}
 
-	// Create the file that will hold our index
-	const std::string indexName = getIndexName(tableName, attributeName);
-	RC ret = im->createFile(indexName);
+	int code = 0;
+	RC ret = _rbfm->readAttribute(tableData.fileHandle, tableData.storageDescriptor, rid, attributeName, &code);
+	RETURN_ON_ERR(ret);
+
+	return dictionary->second.decode(code, data);
+}
+
+RC RelationManager::reorganizePage(const string &tableName, const unsigned pageNumber)
+{
+	if (_catalog.find(tableName) == _catalog.end())
+	{
+		return rc::TABLE_NOT_FOUND;
+	}
+
+	TableMetaData& tableData = _catalog[tableName];
+	return _rbfm->reorganizePage(tableData.fileHandle, tableData.storageDescriptor, pageNumber);
+}
+
+std::string RelationManager::getIndexName(const string& baseTable, const string& attributeName)
+{
+	std::stringstream out;
+	out << baseTable;
+	out << '.';
+	//out << util::strhash(attributeName);
+	out << attributeName;
+
+	return out.str();
+}
+
+std::string RelationManager::getIndexName(const string& baseTable, const vector<string>& attributeNames)
+{
+	return getIndexName(baseTable, attributeNames, vector<string>());
+}
+
+std::string RelationManager::getIndexName(const string& baseTable, const vector<string>& attributeNames, const vector<string>& includedAttributeNames)
+{
+	std::string attributeName;
+	for (unsigned i = 0; i < attributeNames.size(); ++i)
+	{
+		attributeName += (i > 0 ? "," : "") + attributeNames[i];
+	}
+
+	for (unsigned i = 0; i < includedAttributeNames.size(); ++i)
+	{
+		attributeName += (i > 0 ? "," : "+") + includedAttributeNames[i];
+	}
+
+	return getIndexName(baseTable, attributeName);
+}
+
+RC RelationManager::scan(const string &tableName,
+      const string &conditionAttribute,
+      const CompOp compOp,                  
+      const void *value,                    
+      const vector<string> &attributeNames,
+      RM_ScanIterator &rm_ScanIterator)
+{
+	return scan(tableName, conditionAttribute, compOp, value, attributeNames, ScanSample(), rm_ScanIterator);
+}
+
+RC RelationManager::scan(const string &tableName,
+      const string &conditionAttribute,
+      const CompOp compOp,
+      const void *value,
+      const vector<string> &attributeNames,
+      const ScanSample &sample,
+      RM_ScanIterator &rm_ScanIterator)
+{
+	if (_catalog.find(tableName) == _catalog.end())
+	{
+		return rc::TABLE_NOT_FOUND;
+	}
+
+	TableMetaData& tableData = _catalog[tableName];
+
+	CompOp scanOp = compOp;
+	const void* scanValue = value;
+	CompOp postFilterOp = NO_OP;
+	std::vector<string> scanAttributeNames = attributeNames;
+	int code = -1;
+
+	std::map<std::string, ColumnDictionary>::const_iterator dictionary = tableData.dictionaries.find(conditionAttribute);
+	if (compOp != NO_OP && dictionary != tableData.dictionaries.end())
+	{
+		if (compOp == EQ_OP || compOp == NE_OP)
+		{
+			// Equality only needs the code, a value we have never seen can't match any tuple
+			if (dictionary->second.lookup(value, code) != rc::OK)
+			{
+				code = -1;
+			}
+
+			scanValue = &code;
+		}
+		else
+		{
+			// Codes are handed out in insertion order, so ranges are checked against the decoded value
+			scanOp = NO_OP;
+			postFilterOp = compOp;
+			scanAttributeNames.push_back(conditionAttribute);
+		}
+	}
+
+	RC ret = _rbfm->scan(
+        tableData.fileHandle,
+		tableData.storageDescriptor, 
+		conditionAttribute, 
+		scanOp, 
+		scanValue, 
+		scanAttributeNames, 
+		sample,
+		rm_ScanIterator.iter);
+	RETURN_ON_ERR(ret);
+
+	return rm_ScanIterator.init(tableData, scanAttributeNames, postFilterOp, value);
+}
+
+RC RelationManager::collectStatistics(const string &tableName, const ScanSample &sample, TableStatistics &statistics)
+{
+	if (_catalog.find(tableName) == _catalog.end())
+	{
+		return rc::TABLE_NOT_FOUND;
+	}
+
+	TableMetaData& tableData = _catalog[tableName];
+
+	std::vector<std::string> attributeNames;
+	for (vector<Attribute>::const_iterator it = tableData.recordDescriptor.begin(); it != tableData.recordDescriptor.end(); ++it)
+	{
+		attributeNames.push_back(it->name);
+	}
+
+	RM_ScanIterator scanner;
+	RC ret = scan(tableName, "", NO_OP, NULL, attributeNames, sample, scanner);
+	RETURN_ON_ERR(ret);
+
+	RID rid;
+	char tuple[PAGE_SIZE];
+	unsigned sampledTuples = 0;
+	unsigned sampledBytes = 0;
+	while ((ret = scanner.getNextTuple(rid, tuple)) == rc::OK)
+	{
+		unsigned offset = 0;
+		for (vector<Attribute>::const_iterator it = tableData.recordDescriptor.begin(); it != tableData.recordDescriptor.end(); ++it)
+		{
+			offset += Attribute::sizeInBytes(it->type, tuple + offset);
+		}
+
+		++sampledTuples;
+		sampledBytes += offset;
+	}
+
+	scanner.close();
+	if (ret != RM_EOF)
+	{
+		return ret;
+	}
+
+	// Page 0 only holds the file header
+	statistics.numPages = tableData.fileHandle.getNumberOfPages() - 1;
+	statistics.numTuples = sampledTuples / sample.sampledFraction();
+	statistics.averageTupleSize = sampledTuples > 0 ? (float)sampledBytes / sampledTuples : 0.0f;
+
+	return rc::OK;
+}
+
+RC RM_ScanIterator::init(const TableMetaData& tableData, const vector<string> &attributeNames, const CompOp postFilterOp, const void* postFilterValue)
+{
+	_attributeNames = attributeNames;
+	_storedTypes.clear();
+	_dictionaries.clear();
+	_postFilterValue.clear();
+	_decode = (postFilterOp != NO_OP);
+	_postFilterOp = postFilterOp;
+
+	for (vector<string>::const_iterator it = attributeNames.begin(); it != attributeNames.end(); ++it)
+	{
+		unsigned index = 0;
+		RC ret = RBFM_ScanIterator::findAttributeByName(tableData.storageDescriptor, *it, index);
+		RETURN_ON_ERR(ret);
+
+		const ColumnDictionary* dictionary = NULL;
+		std::map<std::string, ColumnDictionary>::const_iterator dictIt = tableData.dictionaries.find(*it);
+		if (dictIt != tableData.dictionaries.end())
+		{
+			dictionary = &(dictIt->second);
+			_decode = true;
+		}
+
+		_storedTypes.push_back(tableData.storageDescriptor[index].type);
+		_dictionaries.push_back(dictionary);
+	}
+
+	if (_postFilterOp != NO_OP)
+	{
+		const char* value = (const char*)postFilterValue;
+		_postFilterValue.assign(value, value + Attribute::sizeInBytes(TypeVarChar, value));
+	}
+
+	_recordBuffer.resize(_decode ? PAGE_SIZE : 0);
+	return rc::OK;
+}
+
+RC RM_ScanIterator::keepCodes(const string &attributeName, const ColumnDictionary*& dictionary)
+{
+	// The post filter attribute is never handed back, so its codes are not ours to give out
+	const unsigned numReturned = _storedTypes.size() - (_postFilterOp != NO_OP ? 1 : 0);
+	for (unsigned i = 0; i < numReturned; ++i)
+	{
+		if (_attributeNames[i] != attributeName)
+			continue;
+
+		if (!_dictionaries[i])
+			return rc::DICTIONARY_NOT_FOUND;
+
+		// Leaving the attribute without a dictionary copies the stored code straight through
+		dictionary = _dictionaries[i];
+		_dictionaries[i] = NULL;
+		return rc::OK;
+	}
+
+	return rc::ATTRIBUTE_NOT_FOUND;
+}
+
+RC RM_ScanIterator::getNextTuple(RID &rid, void *data)
+{
+	if (!_decode)
+	{
+		return iter.getNextRecord(rid, data);
+	}
+
+	// The post filter attribute is fetched last and never handed back to the user
+	unsigned numReturned = _storedTypes.size();
+	if (_postFilterOp != NO_OP)
+	{
+		--numReturned;
+	}
+
+	RC ret = rc::OK;
+	while ((ret = iter.getNextRecord(rid, &_recordBuffer[0])) == rc::OK)
+	{
+		const char* stored = &_recordBuffer[0];
+		char* out = (char*)data;
+		for (unsigned i = 0; i < numReturned; ++i)
+		{
+			unsigned storedSize = Attribute::sizeInBytes(_storedTypes[i], stored);
+			if (_dictionaries[i])
+			{
+				ret = _dictionaries[i]->decode(*(const int*)stored, out);
+				RETURN_ON_ERR(ret);
+				out += Attribute::sizeInBytes(TypeVarChar, out);
+			}
+			else
+			{
+				memcpy(out, stored, storedSize);
+				out += storedSize;
+			}
+
+			stored += storedSize;
+		}
+
+		if (_postFilterOp == NO_OP)
+		{
+			return rc::OK;
+		}
+
+		char value[PAGE_SIZE];
+		ret = _dictionaries.back()->decode(*(const int*)stored, value);
+		RETURN_ON_ERR(ret);
+
+		if (RBFM_ScanIterator::compareVarChar(_postFilterOp, value, &_postFilterValue[0]))
+		{
+			return rc::OK;
+		}
+	}
+
+	return ret;
+}
+
+RC RM_ScanIterator::close()
+{
+	_attributeNames.clear();
+	_storedTypes.clear();
+	_dictionaries.clear();
+	_postFilterValue.clear();
+	_recordBuffer.clear();
+	_decode = false;
+	_postFilterOp = NO_OP;
+
+	return iter.close();
+}
+
+RC RM_IndexScanIterator::getNextEntry(RID &rid, void *key)
+{
+	if (_type == IndexTypeHash)
+		return hashIter.getNextEntry(rid, key);
+
+	if (_type == IndexTypeLsm)
+		return lsmIter.getNextEntry(rid, key);
+
+	if (_type == IndexTypeArt)
+		return artIter.getNextEntry(rid, key);
+
+	return iter.getNextEntry(rid, key);
+}
+
+RC RM_IndexScanIterator::close()
+{
+	tableData = NULL;
+	const IndexType type = _type;
+	_type = IndexTypeBTree;
+	if (type == IndexTypeHash)
+		return hashIter.close();
+
+	if (type == IndexTypeLsm)
+		return lsmIter.close();
+
+	if (type == IndexTypeArt)
+		return artIter.close();
+
+	return iter.close();
+}
+
+RC RM_IndexScanIterator::init(TableMetaData& _tableData, const string& indexName, const string& attributeName, const void *lowKey, const void *highKey, bool lowKeyInclusive, bool highKeyInclusive, IX_ScanOrder order)
+{
+	tableData = &_tableData;
+	
+	// Find the attribute we care about
+	unsigned attributeIndex = 0;
+	RC ret = RBFM_ScanIterator::findAttributeByName(tableData->recordDescriptor, attributeName, attributeIndex);
+	RETURN_ON_ERR(ret);
+
+	// Find the index we care about
+	std::map<std::string, IndexMetaData>::iterator indexIt = tableData->indexes.find(indexName);
+	if (indexIt == tableData->indexes.end())
+	{
+		return rc::INDEX_NOT_FOUND;
+	}
+
+	const Attribute& attribute = tableData->recordDescriptor[attributeIndex];
+	_type = indexIt->second.type;
+	if (_type == IndexTypeBTree)
+	{
+		return iter.init(&(indexIt->second.fileHandle), attribute, lowKey, highKey, lowKeyInclusive, highKeyInclusive, order);
+	}
+
+	// LSM runs and the memtable are merged in ascending order only
+	if (_type == IndexTypeLsm)
+	{
+		if (order != IX_SCAN_ASCENDING)
+			return rc::FEATURE_NOT_YET_IMPLEMENTED;
+
+		return LsmIndexManager::instance()->scan(indexIt->second.fileHandle, attribute, lowKey, highKey, lowKeyInclusive, highKeyInclusive, lsmIter);
+	}
+
+	// The radix tree is only walked forwards
+	if (_type == IndexTypeArt)
+	{
+		if (order != IX_SCAN_ASCENDING)
+			return rc::FEATURE_NOT_YET_IMPLEMENTED;
+
+		return indexIt->second.art->scan(lowKey, highKey, lowKeyInclusive, highKeyInclusive, artIter);
+	}
+
+	// A hash index can only look up a single key
+	if (!lowKey || !highKey || !lowKeyInclusive || !highKeyInclusive || IndexManager::compareKeys(attribute.type, lowKey, highKey) != 0)
+	{
+		return rc::HASH_INDEX_RANGE_SCAN;
+	}
+
+	return hashIter.init(&(indexIt->second.fileHandle), attribute, lowKey);
+}
+
+RC RM_IndexScanIterator::init(TableMetaData& _tableData, const string& indexName, const void *lowKey, unsigned lowKeyValues, const void *highKey, unsigned highKeyValues, bool lowKeyInclusive, bool highKeyInclusive)
+{
+	tableData = &_tableData;
+
+	std::map<std::string, IndexMetaData>::iterator indexIt = tableData->indexes.find(indexName);
+	if (indexIt == tableData->indexes.end() || indexIt->second.keyAttributes.empty())
+	{
+		return rc::INDEX_NOT_FOUND;
+	}
+
+	_type = IndexTypeBTree;
+	return IndexManager::instance()->scan(indexIt->second.fileHandle, indexIt->second.keyAttributes, lowKey, lowKeyValues, highKey, highKeyValues, lowKeyInclusive, highKeyInclusive, iter);
+}
+
+RC RelationManager::createIndex(const string &tableName, const string &attributeName, float fillFactor)
+{
+	return createIndex(tableName, attributeName, IndexTypeBTree, fillFactor);
+}
+
+RC RelationManager::createIndex(const string &tableName, const string &attributeName, IndexType indexType, float fillFactor)
+{
+	return createIndex(tableName, vector<string>(1, attributeName), indexType, fillFactor);
+}
+
+RC RelationManager::createIndex(const string &tableName, const vector<string> &attributeNames, IndexType indexType, float fillFactor)
+{
+	return createIndex(tableName, attributeNames, vector<string>(), indexType, fillFactor);
+}
+
+RC RelationManager::createIndex(const string &tableName, const vector<string> &attributeNames, const vector<string> &includedAttributeNames, IndexType indexType, float fillFactor)
+{
+	RecordBasedCoreManager* manager = getIndexFileManager(indexType);
+	if (_catalog.find(tableName) == _catalog.end())
+	{
+		return rc::TABLE_NOT_FOUND;
+	}
+
+	TableMetaData& tableData = _catalog[tableName];
+	if (attributeNames.empty())
+	{
+		return rc::ATTRIBUTE_NOT_FOUND;
+	}
+
+	// A composite key is only worth its ordering, which a hash index would throw away. LSM runs and radix trees only
+	// order single keys
+	const bool composite = attributeNames.size() + includedAttributeNames.size() > 1;
+	if (composite && indexType != IndexTypeBTree)
+	{
+		return rc::FEATURE_NOT_YET_IMPLEMENTED;
+	}
+
+	// Work out which attributes the index stores before we create anything
+	IndexMetaData description;
+	std::vector<std::string> storedAttributeNames;
+	RC ret = describeIndex(tableData, attributeNames, includedAttributeNames, description, storedAttributeNames);
+	RETURN_ON_ERR(ret);
+
+	// Create the file that will hold our index, a composite index goes by its attribute names joined with commas
+	const std::string indexName = getIndexName(tableName, attributeNames, includedAttributeNames);
+	ret = manager->createFile(indexName);
 	RETURN_ON_ERR(ret);
 
 	// Open a file handle and save it with the cached table data
 	IndexMetaData& indexData = tableData.indexes[indexName];
-	ret = im->openFile(indexName, indexData.fileHandle);
+	indexData.type = indexType;
+	ret = manager->openFile(indexName, indexData.fileHandle);
 	RETURN_ON_ERR(ret);
 
+	ret = insertIndexCatalogEntry(tableName, indexName, indexType);
+	RETURN_ON_ERR(ret);
+
+	// Save the attributes for this index in the cached table data
+	indexData.attribute = description.attribute;
+	indexData.keyAttributes = description.keyAttributes;
+	indexData.numIncludedAttributes = description.numIncludedAttributes;
+	if (indexType == IndexTypeArt)
+	{
+		indexData.art = new ArtIndex(indexData.attribute);
+	}
+
+	return loadIndex(tableName, indexData, storedAttributeNames, fillFactor);
+}
+
+RC RelationManager::describeIndex(TableMetaData& tableData, const vector<string> &attributeNames, const vector<string> &includedAttributeNames, IndexMetaData& indexData, std::vector<std::string>& storedAttributeNames)
+{
+	// Pull out the attribute data from the attribute names, included attributes are stored after the key
+	storedAttributeNames = attributeNames;
+	storedAttributeNames.insert(storedAttributeNames.end(), includedAttributeNames.begin(), includedAttributeNames.end());
+
+	std::vector<Attribute> keyAttributes;
+	for (unsigned i = 0; i < storedAttributeNames.size(); ++i)
+	{
+		unsigned attributeIndex = 0;
+		RC ret = RBFM_ScanIterator::findAttributeByName(tableData.recordDescriptor, storedAttributeNames[i], attributeIndex);
+		RETURN_ON_ERR(ret);
+
+		keyAttributes.push_back(tableData.recordDescriptor[attributeIndex]);
+	}
+
+	indexData.attribute = keyAttributes.front();
+	if (keyAttributes.size() > 1)
+	{
+		indexData.keyAttributes = keyAttributes;
+		indexData.numIncludedAttributes = includedAttributeNames.size();
+		indexData.attribute = IndexManager::getCompositeAttribute(keyAttributes);
+	}
+
+	return rc::OK;
+}
+
+RC RelationManager::insertIndexCatalogEntry(const string &tableName, const string &indexName, IndexType indexType)
+{
 	// Keep track that we have created this index system index table
 	RID indexRid;
-	IndexSystemRecord indexRecord(tableName, indexName, attributeName);
+	const std::string attributeName = indexName.substr(tableName.size() + 1);
+	IndexSystemRecord indexRecord(tableName, indexName, attributeName, indexType);
 	indexRecord.nextIndex.pageNum = 0;
 	indexRecord.nextIndex.slotNum = 0;
-	ret = _rbfm->insertRecord(_catalog[SYSTEM_TABLE_INDEX_NAME].fileHandle, _systemTableIndexRecordDescriptor, &indexRecord, indexRid);
+	RC ret = _rbfm->insertRecord(_catalog[SYSTEM_TABLE_INDEX_NAME].fileHandle, _systemTableIndexRecordDescriptor, &indexRecord, indexRid);
 	RETURN_ON_ERR(ret);
 
 	// Store the RID of this row in the in-memory catalog for easy access
@@ -842,33 +1714,334 @@ RC RelationManager::createIndex(const string &tableName, const string &attribute
     	RETURN_ON_ERR(ret);
 	}
 
-	// We only want to extract the attribute for this index
-	std::vector<std::string> attributeNames;
-	attributeNames.push_back(attributeName);
-
-	// Pull out the attribute data from the attribute name
-	unsigned attributeIndex = 0;
-	ret = RBFM_ScanIterator::findAttributeByName(tableData.recordDescriptor, attributeName, attributeIndex);
-	RETURN_ON_ERR(ret);
+	return rc::OK;
+}
+
+// Add the key of every tuple the scan has left to the loader
+static RC addIndexEntries(RM_ScanIterator& scanner, IX_BulkLoader& loader, const std::vector<Attribute>& keyAttributes)
+{
+	RID rid;
+	char tupleBuffer[PAGE_SIZE] = {0};
+	char keyBuffer[PAGE_SIZE];
+	RC ret = rc::OK;
+	while((ret = scanner.getNextTuple(rid, tupleBuffer)) == rc::OK)
+	{
+		if (!keyAttributes.empty())
+		{
+			ret = IndexManager::encodeCompositeKey(keyAttributes, tupleBuffer, keyAttributes.size(), keyBuffer);
+			RETURN_ON_ERR(ret);
+		}
+
+		ret = loader.addEntry(keyAttributes.empty() ? tupleBuffer : keyBuffer, rid);
+		RETURN_ON_ERR(ret);
+
+		memset(tupleBuffer, 0, PAGE_SIZE);
+	}
+
+	return ret == RM_EOF ? rc::OK : ret;
+}
+
+// Collect the keys of one share of the table into its own loader, and sort them while we are still on our own thread
+static void collectIndexEntries(RM_ScanIterator* scanner, IX_BulkLoader* loader, const std::vector<Attribute>* keyAttributes, RC* result)
+{
+	RC ret = addIndexEntries(*scanner, *loader, *keyAttributes);
+	scanner->close();
+	*result = (ret == rc::OK) ? loader->sort() : ret;
+}
+
+RC RelationManager::loadIndex(const string& tableName, IndexMetaData& indexData, const std::vector<std::string>& storedAttributeNames, float fillFactor)
+{
+	TableMetaData& tableData = _catalog[tableName];
+
+	// Hash and radix tree indexes have no use for sorted input, every existing key just goes in one at a time
+	RC ret = rc::OK;
+	if (indexData.type == IndexTypeHash || indexData.type == IndexTypeArt)
+	{
+		RM_ScanIterator scanner;
+		ret = scan(tableName, storedAttributeNames.front(), NO_OP, NULL, storedAttributeNames, scanner);
+		RETURN_ON_ERR(ret);
+
+		RID rid;
+		char tupleBuffer[PAGE_SIZE] = {0};
+		while((ret = scanner.getNextTuple(rid, tupleBuffer)) == rc::OK)
+		{
+			ret = insertIndexEntry(indexData, tupleBuffer, rid);
+			RETURN_ON_ERR(ret);
+
+			memset(tupleBuffer, 0, PAGE_SIZE);
+		}
+
+		scanner.close();
+		return rc::OK;
+	}
+
+	// Split the table pages between the build threads. Each scans and sorts its share within its part of
+	// the memory budget, then their sorted runs are merged into one bottom-up build
+	const unsigned numPages = tableData.fileHandle.getNumberOfPages();
+	const unsigned numParts = std::max(1u, std::min(_indexBuildThreads, numPages > 1 ? numPages - 1 : 1));
+	std::vector<RM_ScanIterator> scanners(numParts);
+	std::vector<IX_BulkLoader*> parts;
+	std::vector<RC> results(numParts, rc::OK);
+	for (unsigned i = 0; i < numParts; ++i)
+	{
+		ret = scan(tableName, storedAttributeNames.front(), NO_OP, NULL, storedAttributeNames, scanners[i]);
+		RETURN_ON_ERR(ret);
+
+		const PageNum firstPage = 1 + (PageNum)((unsigned long long)(numPages - 1) * i / numParts);
+		const PageNum endPage = (i + 1 == numParts) ? 0 : 1 + (PageNum)((unsigned long long)(numPages - 1) * (i + 1) / numParts);
+		scanners[i].iter.setPageRange(firstPage, endPage);
+	}
+
+	for (unsigned i = 0; i < numParts; ++i)
+	{
+		parts.push_back(new IX_BulkLoader(indexData.attribute, std::max(_indexBuildMemory / numParts, (unsigned)PAGE_SIZE)));
+	}
+
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < numParts; ++i)
+	{
+		threads.push_back(std::thread(collectIndexEntries, &scanners[i], parts[i], &indexData.keyAttributes, &results[i]));
+	}
+
+	collectIndexEntries(&scanners[0], parts[0], &indexData.keyAttributes, &results[0]);
+	for (unsigned i = 0; i < threads.size(); ++i)
+	{
+		threads[i].join();
+	}
+
+	// The parts keep whatever entries they never spilled, so they stay around until the build is done
+	IX_BulkLoader loader(indexData.attribute);
+	for (unsigned i = 0; i < numParts; ++i)
+	{
+		if (ret == rc::OK)
+			ret = results[i];
+
+		if (ret == rc::OK)
+			ret = loader.addSortedRuns(*parts[i]);
+	}
+
+	// An LSM index takes the sorted entries as a single run
+	if (ret == rc::OK && indexData.type == IndexTypeLsm)
+	{
+		ret = LsmIndexManager::instance()->bulkLoad(indexData.fileHandle, indexData.attribute, loader);
+	}
+	else if (ret == rc::OK)
+	{
+		ret = IndexManager::instance()->bulkLoad(indexData.fileHandle, indexData.attribute, loader, fillFactor);
+	}
+
+	for (unsigned i = 0; i < numParts; ++i)
+	{
+		delete parts[i];
+	}
+
+	return ret;
+}
+
+void RelationManager::setIndexBuildResources(unsigned numThreads, unsigned memoryLimit)
+{
+	_indexBuildThreads = std::max(numThreads, 1u);
+	_indexBuildMemory = memoryLimit;
+}
+
+RC RelationManager::createIndexOnline(const string &tableName, const vector<string> &attributeNames, const vector<string> &includedAttributeNames, float fillFactor)
+{
+	IndexManager* im = IndexManager::instance();
+	if (_catalog.find(tableName) == _catalog.end())
+	{
+		return rc::TABLE_NOT_FOUND;
+	}
+
+	TableMetaData& tableData = _catalog[tableName];
+	if (attributeNames.empty())
+	{
+		return rc::ATTRIBUTE_NOT_FOUND;
+	}
+
+	// The index is built on the side, writers will not see it until it is published
+	OnlineIndexBuild build;
+	std::vector<std::string> storedAttributeNames;
+	RC ret = describeIndex(tableData, attributeNames, includedAttributeNames, build.indexData, storedAttributeNames);
+	RETURN_ON_ERR(ret);
+
+	const std::string indexName = getIndexName(tableName, attributeNames, includedAttributeNames);
+	ret = im->createFile(indexName);
+	RETURN_ON_ERR(ret);
+
+	ret = im->openFile(indexName, build.indexData.fileHandle);
+	RETURN_ON_ERR(ret);
+
+	RM_ScanIterator scanner;
+	ret = scan(tableName, storedAttributeNames.front(), NO_OP, NULL, storedAttributeNames, scanner);
+	RETURN_ON_ERR(ret);
+
+	// From here on writers log their changes behind our scan
+	TableLatch& latch = getTableLatch(tableName);
+	{
+		std::lock_guard<std::mutex> guard(latch.mutex);
+		latch.builds.push_back(&build);
+	}
+
+	// Scan a few pages at a time, writers get the table back in between. Pages added since we started are
+	// all scanned on our last turn, so the scan ends however fast the table grows. Emptying the table ends it
+	// early, nothing it collected is wanted any more
+	IX_BulkLoader loader(build.indexData.attribute, _indexBuildMemory);
+	const unsigned startPages = tableData.fileHandle.getNumberOfPages();
+	while (ret == rc::OK)
+	{
+		std::lock_guard<std::mutex> guard(latch.mutex);
+		const unsigned numPages = tableData.fileHandle.getNumberOfPages();
+		if (build.truncated || build.scannedPages >= numPages)
+		{
+			build.scannedPages = std::numeric_limits<PageNum>::max();
+			break;
+		}
+
+		const PageNum endPage = build.scannedPages + RM_ONLINE_INDEX_SCAN_PAGES < startPages ? build.scannedPages + RM_ONLINE_INDEX_SCAN_PAGES : numPages;
+		scanner.iter.setPageRange(build.scannedPages, endPage);
+		ret = addIndexEntries(scanner, loader, build.indexData.keyAttributes);
+		build.scannedPages = endPage;
+	}
+	scanner.close();
+
+	if (ret == rc::OK)
+	{
+		ret = im->bulkLoad(build.indexData.fileHandle, build.indexData.attribute, loader, fillFactor);
+	}
+
+	// Catch up on the log without the latch while it is long and getting shorter each time, then hold the
+	// latch to replay the rest and publish. If writers keep pace with us we stop chasing them
+	size_t lastLogSize = std::numeric_limits<size_t>::max();
+	while (ret == rc::OK)
+	{
+		std::vector<IndexLogEntry> log;
+		std::unique_lock<std::mutex> lock(latch.mutex);
+		if (build.truncated)
+		{
+			build.truncated = false;
+			lastLogSize = std::numeric_limits<size_t>::max();
+			lock.unlock();
+			ret = deleteIndexEntries(build.indexData);
+			continue;
+		}
+
+		if (build.log.size() > RM_ONLINE_INDEX_LOG_TAIL && build.log.size() < lastLogSize)
+		{
+			lastLogSize = build.log.size();
+			log.swap(build.log);
+			lock.unlock();
+			ret = replayIndexLog(build.indexData, log);
+			continue;
+		}
+
+		ret = replayIndexLog(build.indexData, build.log);
+		if (ret == rc::OK)
+		{
+			ret = insertIndexCatalogEntry(tableName, indexName, IndexTypeBTree);
+		}
+
+		if (ret != rc::OK)
+			break;
+
+		// Writers use the published copy from now on, which is a handle of its own on the same file
+		IndexMetaData& indexData = tableData.indexes[indexName];
+		indexData.type = IndexTypeBTree;
+		indexData.attribute = build.indexData.attribute;
+		indexData.keyAttributes = build.indexData.keyAttributes;
+		indexData.numIncludedAttributes = build.indexData.numIncludedAttributes;
+		ret = im->openFile(indexName, indexData.fileHandle);
+		latch.builds.erase(std::find(latch.builds.begin(), latch.builds.end(), &build));
+		lock.unlock();
+
+		RC closeRet = im->closeFile(build.indexData.fileHandle);
+		return ret == rc::OK ? closeRet : ret;
+	}
+
+	// Whatever went wrong, writers must stop logging to us before we go away
+	{
+		std::lock_guard<std::mutex> guard(latch.mutex);
+		latch.builds.erase(std::find(latch.builds.begin(), latch.builds.end(), &build));
+	}
+
+	im->closeFile(build.indexData.fileHandle);
+	im->destroyFile(indexName);
+	return ret;
+}
+
+TableLatch& RelationManager::getTableLatch(const string &tableName)
+{
+	std::lock_guard<std::mutex> guard(_tableLatchMutex);
+	TableLatch*& latch = _tableLatches[tableName];
+	if (!latch)
+	{
+		latch = new TableLatch();
+	}
+
+	return *latch;
+}
+
+RC RelationManager::logIndexChange(TableLatch& latch, const TableMetaData& tableData, const void* tuple, const RID& rid, bool insert)
+{
+	// Tuples the build has yet to scan will be picked up as they are then
+	for (unsigned i = 0; i < latch.builds.size(); ++i)
+	{
+		OnlineIndexBuild& build = *latch.builds[i];
+		if (rid.pageNum >= build.scannedPages)
+			continue;
+
+		char key[PAGE_SIZE];
+		RC ret = getIndexKey(tableData.recordDescriptor, build.indexData, tuple, key);
+		RETURN_ON_ERR(ret);
+
+		build.log.push_back(IndexLogEntry());
+		IndexLogEntry& entry = build.log.back();
+		entry.insert = insert;
+		entry.rid = rid;
+		entry.key.assign(key, key + Attribute::sizeInBytes(build.indexData.attribute.type, key));
+	}
+
+	return rc::OK;
+}
+
+RC RelationManager::replayIndexLog(IndexMetaData& indexData, const std::vector<IndexLogEntry>& log)
+{
+	for (unsigned i = 0; i < log.size(); ++i)
+	{
+		RC ret = log[i].insert ? insertIndexEntry(indexData, &log[i].key[0], log[i].rid) : deleteIndexEntry(indexData, &log[i].key[0], log[i].rid);
+		RETURN_ON_ERR(ret);
+	}
+
+	return rc::OK;
+}
+
+RC RelationManager::rebuildIndexes(const string &tableName)
+{
+	std::map<std::string, TableMetaData>::iterator it = _catalog.find(tableName);
+	if (it == _catalog.end())
+	{
+		return rc::TABLE_NOT_FOUND;
+	}
+
+	// One index at a time, each build already has every thread we were given
+	for (std::map<std::string, IndexMetaData>::iterator indexIt = it->second.indexes.begin(); indexIt != it->second.indexes.end(); ++indexIt)
+	{
+		IndexMetaData& indexData = indexIt->second;
+		std::vector<std::string> storedAttributeNames;
+		for (unsigned i = 0; i < indexData.keyAttributes.size(); ++i)
+		{
+			storedAttributeNames.push_back(indexData.keyAttributes[i].name);
+		}
 
-	// Save the attribute for this index in the cached table data
-	indexData.attribute = tableData.recordDescriptor[attributeIndex];
-	
-	RM_ScanIterator scanner;
-	ret = scan(tableName, attributeName, NO_OP, NULL, attributeNames, scanner);
-	RETURN_ON_ERR(ret);
+		if (storedAttributeNames.empty())
+		{
+			storedAttributeNames.push_back(indexData.attribute.name);
+		}
 
-	// Iterate through everything in the input table and add entries into the new index
-	// Repeated insert, oh well...
-	RID rid;
-	char tupleBuffer[PAGE_SIZE] = {0};
-	while((ret = scanner.getNextTuple(rid, tupleBuffer)) == rc::OK)
-	{
-		// Insert the value into our index now
-		ret = im->insertEntry(indexData.fileHandle, tableData.recordDescriptor[attributeIndex], tupleBuffer, rid);
+		RC ret = deleteIndexEntries(indexData);
 		RETURN_ON_ERR(ret);
 
-		memset(tupleBuffer, 0, PAGE_SIZE);
+		ret = loadIndex(tableName, indexData, storedAttributeNames, IX_DEFAULT_FILL_FACTOR);
+		RETURN_ON_ERR(ret);
 	}
 
 	return rc::OK;
@@ -932,7 +2105,8 @@ RC RelationManager::destroyIndex(const string &tableName, const string &attribut
 
 		if (!wipeAll)
 		{
-			if (strncmp(tableName.c_str(), pulledTableName, sourceNameLen) == 0 && strncmp(attributeName.c_str(), pulledAttrName, attrNameLen) == 0)
+			// Names have to match in full, "A" would otherwise find a composite index on "A,B"
+			if (tableName == pulledTableName && attributeName == pulledAttrName)
 			{
 				ret = _rbfm->deleteRecord(_catalog[SYSTEM_TABLE_INDEX_NAME].fileHandle, _systemTableIndexRecordDescriptor, indexRid);
 				RETURN_ON_ERR(ret);
@@ -976,19 +2150,19 @@ RC RelationManager::destroyIndex(const string &tableName, const string &attribut
 			RETURN_ON_ERR(ret);
 
 			// Find the index's open FileHandle
-			IndexManager* im = IndexManager::instance();
+			RecordBasedCoreManager* manager = IndexManager::instance();
 			std::map<std::string, IndexMetaData>::iterator indexMeta = it->second.indexes.find(indexFileNames.at(i));
 			if (indexMeta != it->second.indexes.end())
 			{
-				// Close the file
-				im->closeFile(indexMeta->second.fileHandle);
+				// Close the file, and remove it from our in-memory representation
+				manager = getIndexFileManager(indexMeta->second.type);
+				manager->closeFile(indexMeta->second.fileHandle);
+				delete indexMeta->second.art;
+				it->second.indexes.erase(indexMeta);
 			}
 
-			// And we can remove it from our in-memory representation
-			it->second.indexes.erase(indexMeta);
-
 			// Finally we can destroy the file
-			ret = IndexManager::instance()->destroyFile(indexFileNames.at(i));
+			ret = manager->destroyFile(indexFileNames.at(i));
 			RETURN_ON_ERR(ret);
 		}
 	}
@@ -996,19 +2170,19 @@ RC RelationManager::destroyIndex(const string &tableName, const string &attribut
 	{
 		// After the catalog is patched, destroy the file on disk
 		// Find the index's open FileHandle
-		IndexManager* im = IndexManager::instance();
+		RecordBasedCoreManager* manager = IndexManager::instance();
 		std::map<std::string, IndexMetaData>::iterator indexMeta = it->second.indexes.find(indexName);
 		if (indexMeta != it->second.indexes.end())
 		{
-			// Close the file
-			im->closeFile(indexMeta->second.fileHandle);
+			// Close the file, and remove it from our in-memory representation
+			manager = getIndexFileManager(indexMeta->second.type);
+			manager->closeFile(indexMeta->second.fileHandle);
+			delete indexMeta->second.art;
+			it->second.indexes.erase(indexMeta);
 		}
 
-		// And we can remove it from our in-memory representation
-		it->second.indexes.erase(indexMeta);
-		
 		// Finally we can destroy the file
-		ret = IndexManager::instance()->destroyFile(indexName);
+		ret = manager->destroyFile(indexName);
 		RETURN_ON_ERR(ret);
 	}
 
@@ -1020,12 +2194,35 @@ RC RelationManager::destroyIndex(const string &tableName, const string &attribut
 	return destroyIndex(tableName, attributeName, false);
 }
 
+RC RelationManager::destroyIndex(const string &tableName, const vector<string> &attributeNames)
+{
+	return destroyIndex(tableName, attributeNames, vector<string>());
+}
+
+RC RelationManager::destroyIndex(const string &tableName, const vector<string> &attributeNames, const vector<string> &includedAttributeNames)
+{
+	const std::string indexName = getIndexName(tableName, attributeNames, includedAttributeNames);
+	return destroyIndex(tableName, indexName.substr(tableName.size() + 1), false);
+}
+
+RC RelationManager::indexScan(const string &tableName,
+	const string &attributeName,
+	const void *lowKey,
+	const void *highKey,
+	bool lowKeyInclusive,
+	bool highKeyInclusive,
+	RM_IndexScanIterator &rm_IndexScanIterator)
+{
+	return indexScan(tableName, attributeName, lowKey, highKey, lowKeyInclusive, highKeyInclusive, IX_SCAN_ASCENDING, rm_IndexScanIterator);
+}
+
 RC RelationManager::indexScan(const string &tableName,
 	const string &attributeName,
 	const void *lowKey,
 	const void *highKey,
 	bool lowKeyInclusive,
 	bool highKeyInclusive,
+	IX_ScanOrder order,
 	RM_IndexScanIterator &rm_IndexScanIterator)
 {
 	if (_catalog.find(tableName) == _catalog.end())
@@ -1036,10 +2233,309 @@ RC RelationManager::indexScan(const string &tableName,
 	TableMetaData& tableData = _catalog[tableName];
 	const std::string indexName = getIndexName(tableName, attributeName);
 
-	return rm_IndexScanIterator.init(tableData, indexName, attributeName, lowKey, highKey, lowKeyInclusive, highKeyInclusive);
+	// An online build publishes its index under the table latch, so we look the index up under it too
+	TableLatch& latch = getTableLatch(tableName);
+	std::lock_guard<std::mutex> guard(latch.mutex);
+	return rm_IndexScanIterator.init(tableData, indexName, attributeName, lowKey, highKey, lowKeyInclusive, highKeyInclusive, order);
+}
+
+RC RelationManager::indexScan(const string &tableName,
+	const vector<string> &attributeNames,
+	const void *lowKey,
+	unsigned lowKeyValues,
+	const void *highKey,
+	unsigned highKeyValues,
+	bool lowKeyInclusive,
+	bool highKeyInclusive,
+	RM_IndexScanIterator &rm_IndexScanIterator)
+{
+	return indexScan(tableName, attributeNames, vector<string>(), lowKey, lowKeyValues, highKey, highKeyValues, lowKeyInclusive, highKeyInclusive, rm_IndexScanIterator);
+}
+
+RC RelationManager::indexScan(const string &tableName,
+	const vector<string> &attributeNames,
+	const vector<string> &includedAttributeNames,
+	const void *lowKey,
+	unsigned lowKeyValues,
+	const void *highKey,
+	unsigned highKeyValues,
+	bool lowKeyInclusive,
+	bool highKeyInclusive,
+	RM_IndexScanIterator &rm_IndexScanIterator)
+{
+	if (_catalog.find(tableName) == _catalog.end())
+	{
+		return rc::TABLE_NOT_FOUND;
+	}
+
+	// Bounds can only be on the key, the included values are not ordered
+	if (lowKeyValues > attributeNames.size() || highKeyValues > attributeNames.size())
+	{
+		return rc::ATTRIBUTE_COUNT_MISMATCH;
+	}
+
+	TableMetaData& tableData = _catalog[tableName];
+	const std::string indexName = getIndexName(tableName, attributeNames, includedAttributeNames);
+
+	TableLatch& latch = getTableLatch(tableName);
+	std::lock_guard<std::mutex> guard(latch.mutex);
+	return rm_IndexScanIterator.init(tableData, indexName, lowKey, lowKeyValues, highKey, highKeyValues, lowKeyInclusive, highKeyInclusive);
+}
+
+RC RelationManager::createDictionary(const string &tableName, const string &attributeName)
+{
+	if (_catalog.find(tableName) == _catalog.end())
+	{
+		return rc::TABLE_NOT_FOUND;
+	}
+
+	TableMetaData& tableData = _catalog[tableName];
+
+	unsigned attributeIndex = 0;
+	RC ret = RBFM_ScanIterator::findAttributeByName(tableData.recordDescriptor, attributeName, attributeIndex);
+	RETURN_ON_ERR(ret);
+
+	// Only strings benefit from being swapped out for a code
+	if (tableData.recordDescriptor[attributeIndex].type != TypeVarChar)
+	{
+		return rc::ATTRIBUTE_INVALID_TYPE;
+	}
+
+	if (tableData.dictionaries.find(attributeName) != tableData.dictionaries.end())
+	{
+		return rc::DICTIONARY_ALREADY_CREATED;
+	}
+
+	// Flag the column as encoded in the attribute table so we know how to read it back next time
+	TableMetadataRow tableRow;
+	ret = _rbfm->readRecord(_catalog[SYSTEM_TABLE_CATALOG_NAME].fileHandle, _systemTableRecordDescriptor, tableData.rowRID, &tableRow);
+	RETURN_ON_ERR(ret);
+
+	AttributeRecord attrRec;
+	RID attributeRid = tableRow.firstAttribute;
+	while (attributeRid.pageNum > 0)
+	{
+		memset(&attrRec, 0, sizeof(attrRec));
+		ret = _rbfm->readRecord(_catalog[SYSTEM_TABLE_ATTRIBUTE_NAME].fileHandle, _systemTableAttributeRecordDescriptor, attributeRid, &attrRec);
+		RETURN_ON_ERR(ret);
+
+		if (attributeName == std::string((char*)(attrRec.name + sizeof(int))))
+		{
+			attrRec.encoding = AttributeEncodingDictionary;
+			ret = _rbfm->updateRecord(_catalog[SYSTEM_TABLE_ATTRIBUTE_NAME].fileHandle, _systemTableAttributeRecordDescriptor, &attrRec, attributeRid);
+			RETURN_ON_ERR(ret);
+			break;
+		}
+
+		attributeRid = attrRec.nextAttribute;
+	}
+
+	// Find every existing tuple before we change the storage format underneath them
+	std::vector<RID> rids;
+	std::vector<std::string> noAttributes;
+	RBFM_ScanIterator scanner;
+	ret = _rbfm->scan(tableData.fileHandle, tableData.storageDescriptor, "", NO_OP, NULL, noAttributes, scanner);
+	RETURN_ON_ERR(ret);
+
+	RID rid;
+	while ((ret = scanner.getNextRecord(rid, NULL)) == rc::OK)
+	{
+		rids.push_back(rid);
+	}
+
+	scanner.close();
+	if (ret != RBFM_EOF)
+	{
+		return ret;
+	}
+
+	std::vector<Attribute> oldDescriptor = tableData.storageDescriptor;
+	ColumnDictionary& dictionary = tableData.dictionaries[attributeName];
+	updateStorageDescriptor(tableData);
+
+	// Rewrite each tuple with the column swapped out for its code, every other column is copied as is
+	char storedData[PAGE_SIZE];
+	char encodedData[PAGE_SIZE];
+	for (std::vector<RID>::const_iterator it = rids.begin(); it != rids.end(); ++it)
+	{
+		ret = _rbfm->readRecord(tableData.fileHandle, oldDescriptor, *it, storedData);
+		RETURN_ON_ERR(ret);
+
+		unsigned storedOffset = 0;
+		unsigned encodedOffset = 0;
+		for (unsigned i = 0; i < oldDescriptor.size(); ++i)
+		{
+			unsigned size = Attribute::sizeInBytes(oldDescriptor[i].type, storedData + storedOffset);
+			if (i == attributeIndex)
+			{
+				int code = 0;
+				bool added = false;
+				ret = dictionary.encode(storedData + storedOffset, code, added);
+				RETURN_ON_ERR(ret);
+
+				if (added)
+				{
+					ret = insertDictionaryValue(tableName, attributeName, code, storedData + storedOffset);
+					RETURN_ON_ERR(ret);
+				}
+
+				memcpy(encodedData + encodedOffset, &code, sizeof(code));
+				encodedOffset += sizeof(code);
+			}
+			else
+			{
+				memcpy(encodedData + encodedOffset, storedData + storedOffset, size);
+				encodedOffset += size;
+			}
+
+			storedOffset += size;
+		}
+
+		ret = _rbfm->updateRecord(tableData.fileHandle, tableData.storageDescriptor, encodedData, *it);
+		RETURN_ON_ERR(ret);
+	}
+
+	return rc::OK;
+}
+
+RC RelationManager::getDictionary(const string &tableName, const string &attributeName, ColumnDictionary &dictionary)
+{
+	if (_catalog.find(tableName) == _catalog.end())
+	{
+		return rc::TABLE_NOT_FOUND;
+	}
+
+	TableMetaData& tableData = _catalog[tableName];
+	std::map<std::string, ColumnDictionary>::const_iterator it = tableData.dictionaries.find(attributeName);
+	if (it == tableData.dictionaries.end())
+	{
+		return rc::DICTIONARY_NOT_FOUND;
+	}
+
+	dictionary = it->second;
+	return rc::OK;
+}
+
+RC RelationManager::insertDictionaryValue(const string &tableName, const string &attributeName, int code, const void* value)
+{
+	RID rid;
+	DictionarySystemRecord dictionaryRow(tableName, attributeName, code, value);
+	return _rbfm->insertRecord(_catalog[SYSTEM_TABLE_DICTIONARY_NAME].fileHandle, _systemTableDictionaryRecordDescriptor, &dictionaryRow, rid);
+}
+
+RC RelationManager::deleteDictionaries(const string &tableName)
+{
+	// The table name is compared in the same format as any other varchar
+	char tableNameValue[MAX_TABLENAME_SIZE + sizeof(int)];
+	int tableNameLen = tableName.size();
+	memcpy(tableNameValue, &tableNameLen, sizeof(int));
+	memcpy(tableNameValue + sizeof(int), tableName.c_str(), tableNameLen);
+
+	std::vector<RID> rids;
+	std::vector<std::string> noAttributes;
+	RBFM_ScanIterator scanner;
+	RC ret = _rbfm->scan(_catalog[SYSTEM_TABLE_DICTIONARY_NAME].fileHandle, _systemTableDictionaryRecordDescriptor, "SourceTable", EQ_OP, tableNameValue, noAttributes, scanner);
+	RETURN_ON_ERR(ret);
+
+	RID rid;
+	while ((ret = scanner.getNextRecord(rid, NULL)) == rc::OK)
+	{
+		rids.push_back(rid);
+	}
+
+	scanner.close();
+	if (ret != RBFM_EOF)
+	{
+		return ret;
+	}
+
+	for (std::vector<RID>::const_iterator it = rids.begin(); it != rids.end(); ++it)
+	{
+		ret = _rbfm->deleteRecord(_catalog[SYSTEM_TABLE_DICTIONARY_NAME].fileHandle, _systemTableDictionaryRecordDescriptor, *it);
+		RETURN_ON_ERR(ret);
+	}
+
+	return rc::OK;
+}
+
+RC RelationManager::encodeTuple(const string &tableName, TableMetaData& tableData, const void* data, void* encodedData)
+{
+	unsigned dataOffset = 0;
+	unsigned encodedOffset = 0;
+	for (vector<Attribute>::const_iterator it = tableData.recordDescriptor.begin(); it != tableData.recordDescriptor.end(); ++it)
+	{
+		const char* value = (const char*)data + dataOffset;
+		unsigned size = Attribute::sizeInBytes(it->type, value);
+		dataOffset += size;
+
+		std::map<std::string, ColumnDictionary>::iterator dictionary = tableData.dictionaries.find(it->name);
+		if (dictionary == tableData.dictionaries.end())
+		{
+			memcpy((char*)encodedData + encodedOffset, value, size);
+			encodedOffset += size;
+			continue;
+		}
+
+		// New values are written out to the dictionary table as soon as they are given a code
+		int code = 0;
+		bool added = false;
+		RC ret = dictionary->second.encode(value, code, added);
+		RETURN_ON_ERR(ret);
+
+		if (added)
+		{
+			ret = insertDictionaryValue(tableName, it->name, code, value);
+			RETURN_ON_ERR(ret);
+		}
+
+		memcpy((char*)encodedData + encodedOffset, &code, sizeof(code));
+		encodedOffset += sizeof(code);
+	}
+
+	return rc::OK;
+}
+
+RC RelationManager::decodeTuple(const TableMetaData& tableData, const void* encodedData, void* data)
+{
+	unsigned dataOffset = 0;
+	unsigned encodedOffset = 0;
+	for (vector<Attribute>::const_iterator it = tableData.storageDescriptor.begin(); it != tableData.storageDescriptor.end(); ++it)
+	{
+		const char* value = (const char*)encodedData + encodedOffset;
+		unsigned size = Attribute::sizeInBytes(it->type, value);
+		encodedOffset += size;
+
+		std::map<std::string, ColumnDictionary>::const_iterator dictionary = tableData.dictionaries.find(it->name);
+		if (dictionary == tableData.dictionaries.end())
+		{
+			memcpy((char*)data + dataOffset, value, size);
+			dataOffset += size;
+			continue;
+		}
+
+		RC ret = dictionary->second.decode(*(const int*)value, (char*)data + dataOffset);
+		RETURN_ON_ERR(ret);
+
+		dataOffset += Attribute::sizeInBytes(TypeVarChar, (char*)data + dataOffset);
+	}
+
+	return rc::OK;
+}
+
+void RelationManager::updateStorageDescriptor(TableMetaData& tableData)
+{
+	tableData.storageDescriptor = tableData.recordDescriptor;
+	for (vector<Attribute>::iterator it = tableData.storageDescriptor.begin(); it != tableData.storageDescriptor.end(); ++it)
+	{
+		if (tableData.dictionaries.find(it->name) != tableData.dictionaries.end())
+		{
+			it->type = TypeInt;
+			it->length = sizeof(int);
+		}
+	}
 }
 
-IndexSystemRecord::IndexSystemRecord(const std::string& sourceTable, const std::string& fileName, const std::string& attrName)
+IndexSystemRecord::IndexSystemRecord(const std::string& sourceTable, const std::string& fileName, const std::string& attrName, IndexType type)
 {
 	memset(buffer, 0, sizeof(buffer));
 
@@ -1063,6 +2559,98 @@ IndexSystemRecord::IndexSystemRecord(const std::string& sourceTable, const std::
 	offset += sizeof(len);
 	memcpy(buffer + offset, attrName.c_str(), len);
 	offset += len;
+
+	int indexType = type;
+	memcpy(buffer + offset, &indexType, sizeof(indexType));
+	offset += sizeof(indexType);
+}
+
+DictionarySystemRecord::DictionarySystemRecord(const std::string& sourceTable, const std::string& attrName, int code, const void* value)
+	: code(code)
+{
+	memset(buffer, 0, sizeof(buffer));
+
+	unsigned offset = 0;
+	unsigned len = 0;
+
+	len = sourceTable.length();
+	memcpy(buffer + offset, &len, sizeof(len));
+	offset += sizeof(len);
+	memcpy(buffer + offset, sourceTable.c_str(), len);
+	offset += len;
+
+	len = attrName.length();
+	memcpy(buffer + offset, &len, sizeof(len));
+	offset += sizeof(len);
+	memcpy(buffer + offset, attrName.c_str(), len);
+	offset += len;
+
+	// The value is already in the varchar format
+	memcpy(buffer + offset, value, Attribute::sizeInBytes(TypeVarChar, value));
+}
+
+void DictionarySystemRecord::parse(std::string& sourceTable, std::string& attrName, std::string& value) const
+{
+	unsigned offset = 0;
+	unsigned len = 0;
+
+	memcpy(&len, buffer + offset, sizeof(len));
+	sourceTable.assign(buffer + offset + sizeof(len), len);
+	offset += sizeof(len) + len;
+
+	memcpy(&len, buffer + offset, sizeof(len));
+	attrName.assign(buffer + offset + sizeof(len), len);
+	offset += sizeof(len) + len;
+
+	memcpy(&len, buffer + offset, sizeof(len));
+	value.assign(buffer + offset + sizeof(len), len);
+}
+
+RC ColumnDictionary::lookup(const void* value, int& code) const
+{
+	unsigned len = *(const unsigned*)value;
+	std::map<std::string, int>::const_iterator it = codes.find(std::string((const char*)value + sizeof(unsigned), len));
+	if (it == codes.end())
+	{
+		return rc::DICTIONARY_VALUE_NOT_FOUND;
+	}
+
+	code = it->second;
+	return rc::OK;
+}
+
+RC ColumnDictionary::encode(const void* value, int& code, bool& added)
+{
+	added = false;
+	if (lookup(value, code) == rc::OK)
+	{
+		return rc::OK;
+	}
+
+	unsigned len = *(const unsigned*)value;
+	std::string newValue((const char*)value + sizeof(unsigned), len);
+
+	code = values.size();
+	values.push_back(newValue);
+	codes[newValue] = code;
+	added = true;
+
+	return rc::OK;
+}
+
+RC ColumnDictionary::decode(int code, void* value) const
+{
+	if (code < 0 || (unsigned)code >= values.size())
+	{
+		return rc::DICTIONARY_CODE_NOT_FOUND;
+	}
+
+	const std::string& decoded = values[code];
+	unsigned len = decoded.size();
+	memcpy(value, &len, sizeof(len));
+	memcpy((char*)value + sizeof(len), decoded.c_str(), len);
+
+	return rc::OK;
 }
 
 // Extra credit
@@ -1102,5 +2690,5 @@ RC RelationManager::reorganizeTable(const string &tableName)
 	}
 
 	TableMetaData& tableData = _catalog[tableName];
-	return _rbfm->reorganizeFile(tableData.fileHandle, tableData.recordDescriptor);
+	return _rbfm->reorganizeFile(tableData.fileHandle, tableData.storageDescriptor);
 }
@@ -5,14 +5,23 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <mutex>
 
 #include "../rbf/rbfm.h"
 #include "../ix/ix.h"
+#include "../ix/hx.h"
+#include "../ix/lx.h"
+#include "../ix/ax.h"
 
 #define MAX_TABLENAME_SIZE 1024
 #define MAX_ATTRIBUTENAME_SIZE 1024
 #define MAX_INDEXNAME_SIZE MAX_TABLENAME_SIZE + MAX_ATTRIBUTENAME_SIZE + 1
 
+// An online index build scans this many table pages each time it holds the table's write latch, and once the
+// log of changes writers made behind it is down to this many entries it takes the latch to replay them and publish
+#define RM_ONLINE_INDEX_SCAN_PAGES 16
+#define RM_ONLINE_INDEX_LOG_TAIL 64
+
 #include <cstring>
 using namespace std;
 
@@ -22,6 +31,23 @@ enum TableOwner
     TableOwnerUser = 1
 };
 
+enum AttributeEncoding
+{
+	AttributeEncodingNone = 0,
+	AttributeEncodingDictionary = 1
+};
+
+// B+tree indexes answer range and equality scans, hash indexes only equality but in fewer page reads. LSM-tree
+// indexes answer both and take inserts and deletes in memory, for tables written far more often than read.
+// Adaptive radix tree indexes live entirely in memory and are rebuilt from the table whenever it is loaded
+enum IndexType
+{
+	IndexTypeBTree = 0,
+	IndexTypeHash = 1,
+	IndexTypeLsm = 2,
+	IndexTypeArt = 3
+};
+
 struct TableMetadataRow
 {
 	TableMetadataRow() { memset(this, 0, sizeof(*this)); }
@@ -37,15 +63,70 @@ struct TableMetadataRow
 
 struct IndexMetaData
 {
+	IndexMetaData() : type(IndexTypeBTree), numIncludedAttributes(0), art(NULL) {}
+
 	FileHandle fileHandle;
-	Attribute attribute;
+	Attribute attribute; // a composite index stores its keys as IndexManager::getCompositeAttribute(keyAttributes)
+	IndexType type;
+	std::vector<Attribute> keyAttributes; // only set for composite indexes, any included attributes come last
+	unsigned numIncludedAttributes; // carried in the leaves for index-only scans, but not part of the key
+	ArtIndex* art; // the entries of an adaptive radix tree index, its file stays empty
+};
+
+// A change to a tuple an online index build has already scanned, replayed into the new index later
+struct IndexLogEntry
+{
+	bool insert;
+	RID rid;
+	std::vector<char> key;
+};
+
+// An index being built while writers carry on. Pages below scannedPages have been read by the build, so
+// writers log their changes to tuples there instead. Emptying the table throws away what the build has so far
+struct OnlineIndexBuild
+{
+	OnlineIndexBuild() : scannedPages(1), truncated(false) {}
+
+	IndexMetaData indexData;
+	PageNum scannedPages;
+	bool truncated;
+	std::vector<IndexLogEntry> log;
+};
+
+// Writers to a table hold its latch, and log their changes to any online index builds under way
+struct TableLatch
+{
+	std::mutex mutex;
+	std::vector<OnlineIndexBuild*> builds;
+};
+
+// Maps the distinct values of a dictionary encoded varchar column to small integer codes
+// Codes are handed out in the order values are first seen and are never reused
+struct ColumnDictionary
+{
+	std::map<std::string, int> codes;
+	std::vector<std::string> values;
+
+	RC lookup(const void* value, int& code) const;
+	RC encode(const void* value, int& code, bool& added);
+	RC decode(int code, void* value) const;
+};
+
+// Estimated from a (possibly sampled) scan of the table
+struct TableStatistics
+{
+	unsigned numPages;
+	float numTuples;
+	float averageTupleSize;
 };
 
 struct TableMetaData
 {
 	FileHandle fileHandle;
 	std::vector<Attribute> recordDescriptor;
+	std::vector<Attribute> storageDescriptor; // recordDescriptor as written to disk, dictionary columns are stored as TypeInt
 	std::map<std::string, IndexMetaData> indexes;
+	std::map<std::string, ColumnDictionary> dictionaries;
 	RID rowRID;
 };
 
@@ -56,18 +137,30 @@ struct AttributeRecord
 	RID nextAttribute;
 	AttrType type;
 	AttrLength length;
+	int encoding;
 	char name[MAX_ATTRIBUTENAME_SIZE];
 };
 
 struct IndexSystemRecord
 {
 	IndexSystemRecord() { memset(this, 0, sizeof(*this)); }
-	IndexSystemRecord(const std::string& sourceTable, const std::string& fileName, const std::string& attrName);
+	IndexSystemRecord(const std::string& sourceTable, const std::string& fileName, const std::string& attrName, IndexType type);
 
   RID nextIndex;
 	char buffer[PAGE_SIZE - sizeof(RID)];
 };
 
+struct DictionarySystemRecord
+{
+	DictionarySystemRecord() { memset(this, 0, sizeof(*this)); }
+	DictionarySystemRecord(const std::string& sourceTable, const std::string& attrName, int code, const void* value);
+
+	void parse(std::string& sourceTable, std::string& attrName, std::string& value) const;
+
+	int code;
+	char buffer[PAGE_SIZE - sizeof(int)];
+};
+
 # define RM_EOF (-1)  // end of a scan operator
 
 // RM_ScanIterator is an iteratr to go through tuples
@@ -81,29 +174,55 @@ struct IndexSystemRecord
 
 class RM_ScanIterator {
 public:
-  RM_ScanIterator() {}
+  RM_ScanIterator() : _decode(false), _postFilterOp(NO_OP) {}
   ~RM_ScanIterator() {}
 
   // "data" follows the same format as RelationManager::insertTuple()
   RC getNextTuple(RID &rid, void *data);
   RC close();
 
+  RC init(const TableMetaData& tableData, const vector<string> &attributeNames, const CompOp postFilterOp, const void* postFilterValue);
+
+  // Return the stored code of a dictionary encoded attribute as a TypeInt in place of its value, from the next tuple
+  // on. dictionary turns the codes back into values and lives as long as the table
+  RC keepCodes(const string &attributeName, const ColumnDictionary*& dictionary);
+
   RBFM_ScanIterator iter;
+
+private:
+	// Types (as stored) and dictionaries (NULL if not encoded, or its codes are kept) of each attribute we return from the RBFM scan
+	std::vector<std::string> _attributeNames;
+	std::vector<AttrType> _storedTypes;
+	std::vector<const ColumnDictionary*> _dictionaries;
+	bool _decode;
+
+	// Range comparisons on dictionary columns cannot be done on the codes, so the RBFM scan returns
+	// the condition attribute as an extra last column which we decode and compare here
+	CompOp _postFilterOp;
+	std::vector<char> _postFilterValue;
+	std::vector<char> _recordBuffer;
 };
 
 class RM_IndexScanIterator {
 public:
-	RM_IndexScanIterator() {};  	// Constructor
+	RM_IndexScanIterator() : _type(IndexTypeBTree) {};  	// Constructor
 	~RM_IndexScanIterator() {}; 	// Destructor
 
 	// "key" follows the same format as in IndexManager::insertEntry()
 	RC getNextEntry(RID &rid, void *key);
 	RC close();
 
-	RC init(TableMetaData& tableData, const string& indexName, const string &attributeName, const void *lowKey, const void *highKey, bool lowKeyInclusive, bool highKeyInclusive);
+	RC init(TableMetaData& tableData, const string& indexName, const string &attributeName, const void *lowKey, const void *highKey, bool lowKeyInclusive, bool highKeyInclusive, IX_ScanOrder order = IX_SCAN_ASCENDING);
+	RC init(TableMetaData& tableData, const string& indexName, const void *lowKey, unsigned lowKeyValues, const void *highKey, unsigned highKeyValues, bool lowKeyInclusive, bool highKeyInclusive);
 
 	IX_ScanIterator iter;
+	HX_ScanIterator hashIter;
+	LX_ScanIterator lsmIter;
+	AX_ScanIterator artIter;
 	TableMetaData* tableData;
+
+private:
+	IndexType _type;
 };
 
 // Relation Manager
@@ -120,6 +239,10 @@ public:
   RC deleteTuple(const string &tableName, const RID &rid);
   RC updateTuple(const string &tableName, const void *data, const RID &rid);
   RC readTuple(const string &tableName, const RID &rid, void *data);
+
+  // Read a table page once so readTuple() can pull any number of its tuples out of pageBuffer
+  RC readTuplePage(const string &tableName, PageNum pageNum, void *pageBuffer);
+  RC readTuple(const string &tableName, const RID &rid, void *data, void *pageBuffer);
   RC readAttribute(const string &tableName, const RID &rid, const string &attributeName, void *data);
   RC reorganizePage(const string &tableName, const unsigned pageNumber);
 
@@ -131,19 +254,94 @@ public:
       const vector<string> &attributeNames, // a list of projected attributes
       RM_ScanIterator &rm_ScanIterator);
 
-  RC createIndex(const string &tableName, const string &attributeName);
+  // Same as above, but only visits the pages/records picked by the sample
+  RC scan(const string &tableName,
+      const string &conditionAttribute,
+      const CompOp compOp,
+      const void *value,
+      const vector<string> &attributeNames,
+      const ScanSample &sample,
+      RM_ScanIterator &rm_ScanIterator);
+
+  // Estimate the size of a table, scaling up whatever the sample saw
+  RC collectStatistics(const string &tableName, const ScanSample &sample, TableStatistics &statistics);
+
+  // Existing tuples are bulk loaded, leaving each index page fillFactor full
+  RC createIndex(const string &tableName, const string &attributeName, float fillFactor = IX_DEFAULT_FILL_FACTOR);
+  RC createIndex(const string &tableName, const string &attributeName, IndexType indexType, float fillFactor = IX_DEFAULT_FILL_FACTOR);
   RC destroyIndex(const string &tableName, const string &attributeName, bool wipeAll);
   RC destroyIndex(const string &tableName, const string &attributeName);
 
+  // Composite indexes order their entries by each attribute in turn, only B+tree indexes can be composite
+  RC createIndex(const string &tableName, const vector<string> &attributeNames, IndexType indexType = IndexTypeBTree, float fillFactor = IX_DEFAULT_FILL_FACTOR);
+  RC destroyIndex(const string &tableName, const vector<string> &attributeNames);
+
+  // Covering indexes also copy the included attributes into every entry, so scans which only need those and the
+  // key never have to read the tuple. They are composite indexes with the included attributes after the key
+  RC createIndex(const string &tableName, const vector<string> &attributeNames, const vector<string> &includedAttributeNames, IndexType indexType = IndexTypeBTree, float fillFactor = IX_DEFAULT_FILL_FACTOR);
+  RC destroyIndex(const string &tableName, const vector<string> &attributeNames, const vector<string> &includedAttributeNames);
+
+  // B+tree index builds split the table scan and the sort between numThreads threads, which between them keep
+  // at most memoryLimit bytes of entries in memory before spilling sorted runs to disk
+  void setIndexBuildResources(unsigned numThreads, unsigned memoryLimit);
+
+  // Empty every index of the table and build each of them again from its tuples, say after a large load
+  RC rebuildIndexes(const string &tableName);
+
+  // Build a B+tree index while other threads keep inserting, updating and deleting tuples. The table is scanned
+  // a few pages at a time under its write latch, and the index only goes live once the changes writers made
+  // behind the scan have been replayed into it. Writers and index scans take the table latch, so they may run during
+  // the build; other changes to the table's indexes (createIndex, destroyIndex, rebuildIndexes, deleteTable) may not
+  RC createIndexOnline(const string &tableName, const vector<string> &attributeNames, const vector<string> &includedAttributeNames = vector<string>(), float fillFactor = IX_DEFAULT_FILL_FACTOR);
+
   // indexScan returns an iterator to allow the caller to go through qualified entries in index
+  // Hash indexes can only be scanned for one key, passed as both lowKey and highKey, inclusive
+  RC indexScan(const string &tableName,
+                        const string &attributeName,
+                        const void *lowKey,
+                        const void *highKey,
+                        bool lowKeyInclusive,
+                        bool highKeyInclusive,
+                        RM_IndexScanIterator &rm_IndexScanIterator);
+
+  // Same, in the given key order. Hash indexes have no order to give, LSM indexes only scan ascending
   RC indexScan(const string &tableName,
                         const string &attributeName,
                         const void *lowKey,
                         const void *highKey,
                         bool lowKeyInclusive,
                         bool highKeyInclusive,
+                        IX_ScanOrder order,
+                        RM_IndexScanIterator &rm_IndexScanIterator);
+
+  // Keys are the attribute values of the composite index concatenated, and a bound may give only its leading
+  // lowKeyValues (highKeyValues) of them to cover every key starting with those. Entries come back as full keys
+  RC indexScan(const string &tableName,
+                        const vector<string> &attributeNames,
+                        const void *lowKey,
+                        unsigned lowKeyValues,
+                        const void *highKey,
+                        unsigned highKeyValues,
+                        bool lowKeyInclusive,
+                        bool highKeyInclusive,
+                        RM_IndexScanIterator &rm_IndexScanIterator);
+
+  // Entries of a covering index come back as their key values followed by their included values
+  RC indexScan(const string &tableName,
+                        const vector<string> &attributeNames,
+                        const vector<string> &includedAttributeNames,
+                        const void *lowKey,
+                        unsigned lowKeyValues,
+                        const void *highKey,
+                        unsigned highKeyValues,
+                        bool lowKeyInclusive,
+                        bool highKeyInclusive,
                         RM_IndexScanIterator &rm_IndexScanIterator);
 
+  // Store a varchar column as integer codes into a per-column dictionary, existing tuples are re-encoded
+  RC createDictionary(const string &tableName, const string &attributeName);
+  RC getDictionary(const string &tableName, const string &attributeName, ColumnDictionary &dictionary);
+
 
 // Extra credit
 public:
@@ -152,6 +350,8 @@ public:
   RC reorganizeTable(const string &tableName);
 
   static std::string getIndexName(const string& baseTable, const string& attributeName);
+  static std::string getIndexName(const string& baseTable, const vector<string>& attributeNames);
+  static std::string getIndexName(const string& baseTable, const vector<string>& attributeNames, const vector<string>& includedAttributeNames);
   static RC findDataOffset(const void* data, const std::vector<Attribute>& recordDescriptor, const std::string& attributeName, unsigned& dataOffset);
 
 protected:
@@ -164,8 +364,32 @@ private:
 
     RC loadSystemTables();
     RC createSystemTables();
+	RC upgradeSystemTables();
     RC loadTableMetadata();
-	RC loadTableColumnMetadata(int numAttributes, RID firstAttributeRID, std::vector<Attribute>& recordDescriptor);
+	RC loadTableColumnMetadata(int numAttributes, RID firstAttributeRID, std::vector<Attribute>& recordDescriptor, std::map<std::string, ColumnDictionary>& dictionaries);
+	RC loadDictionaries();
+	RC loadArtIndexes();
+
+	RC insertDictionaryValue(const string &tableName, const string &attributeName, int code, const void* value);
+	RC deleteDictionaries(const string &tableName);
+	RC encodeTuple(const string &tableName, TableMetaData& tableData, const void* data, void* encodedData);
+	RC decodeTuple(const TableMetaData& tableData, const void* encodedData, void* data);
+	RC readStoredTuple(TableMetaData& tableData, const RID &rid, void *data, void *pageBuffer = NULL);
+
+	// Send index maintenance to whichever manager owns the index
+	static RC insertIndexEntry(IndexMetaData& indexData, const void* key, const RID& rid);
+	static RC deleteIndexEntry(IndexMetaData& indexData, const void* key, const RID& rid);
+	static RC deleteIndexEntries(IndexMetaData& indexData);
+	static RecordBasedCoreManager* getIndexFileManager(IndexType type);
+	static RC getIndexKey(const std::vector<Attribute>& recordDescriptor, const IndexMetaData& indexData, const void* tuple, void* key);
+	RC loadIndex(const string& tableName, IndexMetaData& indexData, const std::vector<std::string>& storedAttributeNames, float fillFactor);
+	RC describeIndex(TableMetaData& tableData, const vector<string> &attributeNames, const vector<string> &includedAttributeNames, IndexMetaData& indexData, std::vector<std::string>& storedAttributeNames);
+	RC insertIndexCatalogEntry(const string &tableName, const string &indexName, IndexType indexType);
+
+	TableLatch& getTableLatch(const string &tableName);
+	static RC logIndexChange(TableLatch& latch, const TableMetaData& tableData, const void* tuple, const RID& rid, bool insert);
+	static RC replayIndexLog(IndexMetaData& indexData, const std::vector<IndexLogEntry>& log);
+	static void updateStorageDescriptor(TableMetaData& tableData);
 
 	RecordBasedFileManager* _rbfm;
 	std::map<std::string, TableMetaData> _catalog;
@@ -173,8 +397,15 @@ private:
 	std::vector<Attribute> _systemTableRecordDescriptor;
 	std::vector<Attribute> _systemTableAttributeRecordDescriptor;
 	std::vector<Attribute> _systemTableIndexRecordDescriptor;
+	std::vector<Attribute> _systemTableDictionaryRecordDescriptor;
 	RID _lastTableRID;
 
+	unsigned _indexBuildThreads;
+	unsigned _indexBuildMemory;
+
+	std::mutex _tableLatchMutex;
+	std::map<std::string, TableLatch*> _tableLatches;
+
 	static RelationManager *_rm;
 };
 
@@ -36,6 +36,7 @@ namespace rc
         case HEADER_SIZE_TOO_LARGE:                 return "HEADER_SIZE_TOO_LARGE";
         case PAGE_CANNOT_BE_ORGANIZED:              return "PAGE_CANNOT_BE_ORGANIZED";
 		case PAGE_NUM_INVALID:						return "PAGE_NUM_INVALID";
+		case SCAN_SAMPLE_FRACTION_INVALID:			return "SCAN_SAMPLE_FRACTION_INVALID";
         case RECORD_SIZE_INVALID:                   return "RECORD_SIZE_INVALID";
 		case TABLE_NOT_FOUND:						return "TABLE_NOT_FOUND";
 		case TABLE_ALREADY_CREATED:					return "TABLE_ALREADY_CREATED";
@@ -58,9 +59,23 @@ namespace rc
 		case BTREE_CANNOT_FIND_LEAF:				return "BTREE_CANNOT_FIND_LEAF";
 		case BTREE_KEY_TOO_LARGE:					return "BTREE_KEY_TOO_LARGE";
 		case BTREE_ITERATOR_ILLEGAL_NON_LEAF_RECORD:return "BTREE_ITERATOR_ILLEGAL_NON_LEAF_RECORD";
+		case BTREE_INDEX_NOT_EMPTY:					return "BTREE_INDEX_NOT_EMPTY";
+		case BTREE_KEYS_NOT_SORTED:					return "BTREE_KEYS_NOT_SORTED";
+		case HASH_INDEX_ENTRY_NOT_FOUND:			return "HASH_INDEX_ENTRY_NOT_FOUND";
+		case HASH_INDEX_KEY_TOO_LARGE:				return "HASH_INDEX_KEY_TOO_LARGE";
+		case HASH_INDEX_DIRECTORY_FULL:				return "HASH_INDEX_DIRECTORY_FULL";
+		case HASH_INDEX_RANGE_SCAN:					return "HASH_INDEX_RANGE_SCAN";
+		case LSM_INDEX_KEY_TOO_LARGE:				return "LSM_INDEX_KEY_TOO_LARGE";
+		case LSM_INDEX_NOT_EMPTY:					return "LSM_INDEX_NOT_EMPTY";
+		case ART_INDEX_DUPLICATE_ENTRY:			return "ART_INDEX_DUPLICATE_ENTRY";
+		case ART_INDEX_ENTRY_NOT_FOUND:			return "ART_INDEX_ENTRY_NOT_FOUND";
 		case TUPLE_COMPARE_CONDITION_FAILED:		return "TUPLE_COMPARE_CONDITION_FAILED";
 		case INDEX_NOT_FOUND:						return "INDEX_NOT_FOUND";
 		case ITERATOR_NEVER_CALLED:					return "ITERATOR_NEVER_CALLED";
+		case DICTIONARY_NOT_FOUND:					return "DICTIONARY_NOT_FOUND";
+		case DICTIONARY_ALREADY_CREATED:			return "DICTIONARY_ALREADY_CREATED";
+		case DICTIONARY_VALUE_NOT_FOUND:			return "DICTIONARY_VALUE_NOT_FOUND";
+		case DICTIONARY_CODE_NOT_FOUND:				return "DICTIONARY_CODE_NOT_FOUND";
 		case OUT_OF_MEMORY:							return "OUT_OF_MEMORY";
         }
 
@@ -49,6 +49,8 @@ namespace rc
         PAGE_CANNOT_BE_ORGANIZED,
 		PAGE_NUM_INVALID,
 
+		SCAN_SAMPLE_FRACTION_INVALID,
+
 		TABLE_NOT_FOUND,
 		TABLE_ALREADY_CREATED,
 		TABLE_NAME_TOO_LONG,
@@ -72,11 +74,28 @@ namespace rc
 		BTREE_CANNOT_FIND_LEAF,
 		BTREE_KEY_TOO_LARGE,
 		BTREE_ITERATOR_ILLEGAL_NON_LEAF_RECORD,
+		BTREE_INDEX_NOT_EMPTY,
+		BTREE_KEYS_NOT_SORTED,
+
+		HASH_INDEX_ENTRY_NOT_FOUND,
+		HASH_INDEX_KEY_TOO_LARGE,
+		HASH_INDEX_DIRECTORY_FULL,
+		HASH_INDEX_RANGE_SCAN,
+
+		LSM_INDEX_KEY_TOO_LARGE,
+		LSM_INDEX_NOT_EMPTY,
+		ART_INDEX_DUPLICATE_ENTRY,
+		ART_INDEX_ENTRY_NOT_FOUND,
 
 		TUPLE_COMPARE_CONDITION_FAILED,
 		INDEX_NOT_FOUND,
 		ITERATOR_NEVER_CALLED,
 
+		DICTIONARY_NOT_FOUND,
+		DICTIONARY_ALREADY_CREATED,
+		DICTIONARY_VALUE_NOT_FOUND,
+		DICTIONARY_CODE_NOT_FOUND,
+
 		OUT_OF_MEMORY
     };
 